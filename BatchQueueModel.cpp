@@ -0,0 +1,297 @@
+#include "BatchQueueModel.h"
+#include "ThumbnailLoader.h"
+#include <QFileInfo>
+#include <QLocale>
+
+BatchQueueModel::BatchQueueModel(QObject *parent)
+    : QAbstractListModel(parent), m_thumbnails(new ThumbnailLoader(QSize(64, 64), this))
+{
+    connect(m_thumbnails, &ThumbnailLoader::thumbnailReady,
+            this, &BatchQueueModel::handleThumbnailReady);
+    m_clock.start();
+}
+
+int BatchQueueModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant BatchQueueModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size()) {
+        return QVariant();
+    }
+
+    const BatchItem &item = m_items.at(index.row());
+    if ((role == Qt::DisplayRole || role == SizeRole) && item.fileSize < 0) {
+        item.fileSize = QFileInfo(item.path).size();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        QStringList details;
+        details << statusText(item.status)
+                << QLocale().formattedDataSize(item.fileSize);
+        if (!item.regions.isEmpty()) {
+            details << QString("%1 个区域").arg(item.regions.size());
+        }
+        if (item.elapsedMs >= 0) {
+            details << QString("%1 秒").arg(item.elapsedMs / 1000.0, 0, 'f', 1);
+        }
+        if (!item.note.isEmpty()) {
+            details << item.note;
+        }
+        if (!item.message.isEmpty()) {
+            details << item.message;
+        }
+        return QString("%1\n%2").arg(QFileInfo(item.path).fileName(), details.join(" · "));
+    }
+    case Qt::DecorationRole:
+        return m_thumbnails->thumbnail(item.path);
+    case Qt::ToolTipRole:
+        return item.outputPath.isEmpty() ? item.path : item.path + "\n→ " + item.outputPath;
+    case PathRole:
+        return item.path;
+    case StatusRole:
+        return item.status;
+    case SizeRole:
+        return item.fileSize;
+    case ElapsedRole:
+        return item.elapsedMs;
+    case OutputRole:
+        return item.outputPath;
+    case RegionsRole:
+        return QVariant::fromValue(item.regions);
+    }
+    return QVariant();
+}
+
+bool BatchQueueModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || row < 0 || count <= 0 || row + count > m_items.size()) {
+        return false;
+    }
+
+    beginRemoveRows(QModelIndex(), row, row + count - 1);
+    m_items.erase(m_items.begin() + row, m_items.begin() + row + count);
+    endRemoveRows();
+    rebuildRowIndex();
+    return true;
+}
+
+bool BatchQueueModel::moveRows(const QModelIndex &sourceParent, int sourceRow, int count,
+                               const QModelIndex &destinationParent, int destinationChild)
+{
+    if (sourceParent.isValid() || destinationParent.isValid() || count <= 0
+        || sourceRow < 0 || sourceRow + count > m_items.size()
+        || destinationChild < 0 || destinationChild > m_items.size()
+        || (destinationChild >= sourceRow && destinationChild <= sourceRow + count)) {
+        return false;
+    }
+
+    if (!beginMoveRows(QModelIndex(), sourceRow, sourceRow + count - 1, QModelIndex(), destinationChild)) {
+        return false;
+    }
+
+    QList<BatchItem> moved = m_items.mid(sourceRow, count);
+    m_items.erase(m_items.begin() + sourceRow, m_items.begin() + sourceRow + count);
+    int insertAt = destinationChild > sourceRow ? destinationChild - count : destinationChild;
+    for (int i = 0; i < moved.size(); ++i) {
+        m_items.insert(insertAt + i, moved.at(i));
+    }
+
+    endMoveRows();
+    rebuildRowIndex();
+    return true;
+}
+
+void BatchQueueModel::setFiles(const QStringList &paths)
+{
+    beginResetModel();
+    m_items.clear();
+    m_rowByPath.clear();
+    m_thumbnails->clearPending();
+    endResetModel();
+
+    appendFiles(paths);
+}
+
+int BatchQueueModel::appendFiles(const QStringList &paths)
+{
+    QList<BatchItem> added;
+    for (const QString &path : paths) {
+        if (m_rowByPath.contains(path)) {
+            continue;
+        }
+        m_rowByPath.insert(path, m_items.size() + added.size());
+        BatchItem item;
+        item.path = path;
+        added << item;
+    }
+
+    if (added.isEmpty()) {
+        return 0;
+    }
+
+    // 一次插入整批，视图只收到一个信号
+    beginInsertRows(QModelIndex(), m_items.size(), m_items.size() + added.size() - 1);
+    m_items.append(added);
+    endInsertRows();
+    return added.size();
+}
+
+void BatchQueueModel::clear()
+{
+    setFiles(QStringList());
+}
+
+QStringList BatchQueueModel::paths() const
+{
+    QStringList result;
+    result.reserve(m_items.size());
+    for (const BatchItem &item : m_items) {
+        result << item.path;
+    }
+    return result;
+}
+
+int BatchQueueModel::countByStatus(ItemStatus status) const
+{
+    int result = 0;
+    for (const BatchItem &item : m_items) {
+        if (item.status == status) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+void BatchQueueModel::resetStatus()
+{
+    if (m_items.isEmpty()) {
+        return;
+    }
+
+    for (BatchItem &item : m_items) {
+        item.status = Pending;
+        item.elapsedMs = -1;
+        item.outputPath.clear();
+        item.message.clear();
+        item.note.clear();
+    }
+    emit dataChanged(index(0), index(m_items.size() - 1));
+}
+
+void BatchQueueModel::setItemStarted(int row)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    BatchItem &item = m_items[row];
+    item.status = Processing;
+    item.startedMs = m_clock.elapsed();
+    item.elapsedMs = -1;
+    emitRowChanged(row);
+}
+
+void BatchQueueModel::setItemFinished(int row, const QString &outputPath)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    BatchItem &item = m_items[row];
+    item.status = Done;
+    item.elapsedMs = m_clock.elapsed() - item.startedMs;
+    item.outputPath = outputPath;
+    emitRowChanged(row);
+}
+
+void BatchQueueModel::setItemFailed(int row, const QString &message)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    BatchItem &item = m_items[row];
+    item.status = Failed;
+    item.elapsedMs = m_clock.elapsed() - item.startedMs;
+    item.message = message.left(120);
+    emitRowChanged(row);
+}
+
+void BatchQueueModel::setItemNote(int row, const QString &note)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    m_items[row].note = note;
+    emitRowChanged(row);
+}
+
+void BatchQueueModel::setItemRegions(int row, const QList<QRect> &regions)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    m_items[row].regions = regions;
+    emitRowChanged(row);
+}
+
+QList<QRect> BatchQueueModel::itemRegions(int row) const
+{
+    return row >= 0 && row < m_items.size() ? m_items.at(row).regions : QList<QRect>();
+}
+
+QHash<int, QList<QRect>> BatchQueueModel::regions() const
+{
+    QHash<int, QList<QRect>> regions;
+    for (int row = 0; row < m_items.size(); ++row) {
+        if (!m_items.at(row).regions.isEmpty()) {
+            regions.insert(row, m_items.at(row).regions);
+        }
+    }
+    return regions;
+}
+
+QString BatchQueueModel::statusText(ItemStatus status)
+{
+    switch (status) {
+    case Pending:
+        return "等待中";
+    case Processing:
+        return "处理中";
+    case Done:
+        return "已完成";
+    case Failed:
+        return "失败";
+    }
+    return QString();
+}
+
+void BatchQueueModel::handleThumbnailReady(const QString &path)
+{
+    int row = m_rowByPath.value(path, -1);
+    if (row >= 0) {
+        QModelIndex changed = index(row);
+        emit dataChanged(changed, changed, {Qt::DecorationRole});
+    }
+}
+
+void BatchQueueModel::rebuildRowIndex()
+{
+    m_rowByPath.clear();
+    m_rowByPath.reserve(m_items.size());
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_rowByPath.insert(m_items.at(i).path, i);
+    }
+}
+
+void BatchQueueModel::emitRowChanged(int row)
+{
+    QModelIndex changed = index(row);
+    emit dataChanged(changed, changed);
+}
@@ -0,0 +1,91 @@
+#ifndef BATCHQUEUEMODEL_H
+#define BATCHQUEUEMODEL_H
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QRect>
+
+class ThumbnailLoader;
+
+// 图片批处理队列。文件大小和缩略图只在视图请求对应行时才读取，
+// 十万级条目也只占用每条一个小结构体
+class BatchQueueModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum ItemStatus {
+        Pending,
+        Processing,
+        Done,
+        Failed
+    };
+    Q_ENUM(ItemStatus)
+
+    enum Roles {
+        PathRole = Qt::UserRole + 1,
+        StatusRole,
+        SizeRole,
+        ElapsedRole,
+        OutputRole,
+        RegionsRole
+    };
+
+    explicit BatchQueueModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+    bool moveRows(const QModelIndex &sourceParent, int sourceRow, int count,
+                  const QModelIndex &destinationParent, int destinationChild) override;
+
+    void setFiles(const QStringList &paths);
+    // 追加时跳过已在队列中的文件，返回实际追加的数量
+    int appendFiles(const QStringList &paths);
+    void clear();
+    QStringList paths() const;
+    int count() const { return m_items.size(); }
+    int countByStatus(ItemStatus status) const;
+
+    void resetStatus();
+    void setItemStarted(int row);
+    void setItemFinished(int row, const QString &outputPath);
+    void setItemFailed(int row, const QString &message);
+    // 附加在状态后面的说明，如透明通道处理节省的时间
+    void setItemNote(int row, const QString &note);
+    // 区域放大的选区（原图坐标），为空时整图放大
+    void setItemRegions(int row, const QList<QRect> &regions);
+    QList<QRect> itemRegions(int row) const;
+    // 按行号列出所有设置了选区的条目，行号与 paths() 中的位置一致
+    QHash<int, QList<QRect>> regions() const;
+
+    static QString statusText(ItemStatus status);
+
+private slots:
+    void handleThumbnailReady(const QString &path);
+
+private:
+    struct BatchItem {
+        QString path;
+        ItemStatus status = Pending;
+        mutable qint64 fileSize = -1;
+        qint64 startedMs = 0;
+        qint64 elapsedMs = -1;
+        QString outputPath;
+        QString message;
+        QString note;
+        QList<QRect> regions;
+    };
+
+    void rebuildRowIndex();
+    void emitRowChanged(int row);
+
+    QList<BatchItem> m_items;
+    QHash<QString, int> m_rowByPath;
+    ThumbnailLoader *m_thumbnails;
+    QElapsedTimer m_clock;
+};
+
+#endif // BATCHQUEUEMODEL_H
@@ -0,0 +1,301 @@
+#include "BenchmarkRunner.h"
+#include "ScalePlanner.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+
+BenchmarkRunner::BenchmarkRunner(QObject *parent)
+    : QObject(parent), m_backgroundOwner(new QObject(this)), m_interactiveOwner(new QObject(this))
+{
+    m_backends << UpscaleBackend::CliBackend << UpscaleBackend::NcnnCpuBackend;
+    m_models << "realesr-animevideov3-x2";
+    m_placements << ProcessLauncher::policy();
+    m_preemptModes << PriorityScheduler::mode();
+    PriorityScheduler::setPriority(m_backgroundOwner, PriorityScheduler::Background);
+    PriorityScheduler::setPriority(m_interactiveOwner, PriorityScheduler::Interactive);
+}
+
+void BenchmarkRunner::setInput(const QString &inputPath)
+{
+    m_inputPath = inputPath;
+}
+
+void BenchmarkRunner::setModels(const QStringList &models)
+{
+    m_models = models;
+}
+
+void BenchmarkRunner::setRuns(int runs)
+{
+    m_runs = qMax(1, runs);
+}
+
+void BenchmarkRunner::setBackends(const QList<UpscaleBackend::Kind> &backends)
+{
+    m_backends = backends;
+}
+
+void BenchmarkRunner::setPlacements(const QList<ProcessLauncher::Policy> &placements)
+{
+    if (!placements.isEmpty()) {
+        m_placements = placements;
+    }
+}
+
+void BenchmarkRunner::setParallel(int parallel)
+{
+    m_parallel = qMax(1, parallel);
+}
+
+void BenchmarkRunner::setBackgroundLoad(int tasks)
+{
+    m_backgroundLoad = qMax(0, tasks);
+}
+
+void BenchmarkRunner::setPreemptModes(const QList<PriorityScheduler::Mode> &modes)
+{
+    if (!modes.isEmpty()) {
+        m_preemptModes = modes;
+    }
+}
+
+void BenchmarkRunner::start()
+{
+    m_results.clear();
+    for (PriorityScheduler::Mode preempt : m_preemptModes) {
+        for (ProcessLauncher::Policy placement : m_placements) {
+            for (UpscaleBackend::Kind kind : m_backends) {
+                for (const QString &model : m_models) {
+                    Result result;
+                    result.backend = kind;
+                    result.placement = placement;
+                    result.preempt = preempt;
+                    result.modelName = model;
+                    QString reason;
+                    if (!UpscaleBackend::instance(kind)->isAvailable(&reason)) {
+                        result.error = reason;
+                    }
+                    m_results << result;
+                }
+            }
+        }
+    }
+
+    m_done = false;
+    m_resultIndex = 0;
+    startNextRun();
+}
+
+void BenchmarkRunner::startNextRun()
+{
+    // 跳过已跑完或不可用的组合
+    while (m_resultIndex < m_results.size()) {
+        const Result &result = m_results.at(m_resultIndex);
+        if (result.error.isEmpty() && result.runMs.size() < m_runs) {
+            break;
+        }
+        ++m_resultIndex;
+    }
+
+    if (m_resultIndex >= m_results.size()) {
+        stopBackgroundLoad();
+        emit finished();
+        return;
+    }
+
+    const Result &result = m_results.at(m_resultIndex);
+    if (ProcessLauncher::policy() != result.placement) {
+        ProcessLauncher::setPolicy(result.placement);
+    }
+    PriorityScheduler::setMode(result.preempt);
+    while (m_backgroundTasks.size() < m_backgroundLoad) {
+        startBackgroundTask();
+    }
+
+    for (UpscaleTask *task : m_tasks) {
+        task->deleteLater();
+    }
+    m_tasks.clear();
+
+    // 同一轮的任务同时启动，耗时取全部完成的时间
+    for (int i = 0; i < m_parallel; ++i) {
+        UpscaleRequest request;
+        request.inputPath = m_inputPath;
+        request.outputPath = QDir(m_tempDir.path()).filePath(QString("bench_%1_%2.png").arg(m_resultIndex).arg(i));
+        request.modelName = result.modelName;
+        request.scale = ScalePlanner::nativeScale(result.modelName);
+
+        UpscaleTask *task = UpscaleBackend::instance(result.backend)->createTask(request, m_interactiveOwner);
+        connect(task, &UpscaleTask::finished, this, &BenchmarkRunner::handleRunFinished);
+        m_tasks << task;
+    }
+    m_runningTasks = m_tasks.size();
+    m_runError.clear();
+    // 有后台负载时被测任务按交互式作业运行，耗时即交互式延迟
+    if (m_backgroundLoad > 0) {
+        PriorityScheduler::beginInteractive(m_interactiveOwner);
+    }
+    m_timer.start();
+    for (UpscaleTask *task : m_tasks) {
+        task->start();
+    }
+}
+
+void BenchmarkRunner::handleRunFinished(bool ok)
+{
+    auto *task = qobject_cast<UpscaleTask *>(sender());
+    if (!ok && m_runError.isEmpty() && task) {
+        m_runError = task->errorString();
+    }
+    if (--m_runningTasks > 0) {
+        return;
+    }
+
+    Result &result = m_results[m_resultIndex];
+    if (m_runError.isEmpty()) {
+        result.runMs << m_timer.elapsed();
+    } else {
+        result.error = m_runError;
+    }
+    PriorityScheduler::endInteractive(m_interactiveOwner);
+    startNextRun();
+}
+
+void BenchmarkRunner::startBackgroundTask()
+{
+    // 后台负载使用当前组合的后端和模型，跑完一张立即开始下一张，直到测量结束
+    const Result &result = m_results.at(m_resultIndex);
+    UpscaleRequest request;
+    request.inputPath = m_inputPath;
+    request.outputPath = QDir(m_tempDir.path()).filePath(QString("background_%1.png").arg(m_backgroundTasks.size()));
+    request.modelName = result.modelName;
+    request.scale = ScalePlanner::nativeScale(result.modelName);
+
+    UpscaleTask *task = UpscaleBackend::instance(result.backend)->createTask(request, m_backgroundOwner);
+    connect(task, &UpscaleTask::finished, this, [this, task]() {
+        m_backgroundTasks.removeOne(task);
+        task->deleteLater();
+        if (!m_done && m_resultIndex < m_results.size()) {
+            startBackgroundTask();
+        }
+    });
+    m_backgroundTasks << task;
+    task->start();
+}
+
+void BenchmarkRunner::stopBackgroundLoad()
+{
+    m_done = true;
+    for (UpscaleTask *task : m_backgroundTasks) {
+        task->cancel();
+    }
+}
+
+QString BenchmarkRunner::report() const
+{
+    QString text;
+    QTextStream stream(&text);
+    stream << QString("输入: %1，每轮并发 %2 个任务\n").arg(m_inputPath).arg(m_parallel);
+    if (m_backgroundLoad > 0) {
+        stream << QString("后台负载 %1 个任务，耗时为交互式延迟\n").arg(m_backgroundLoad);
+    }
+    ProcessLauncher::Policy current = ProcessLauncher::policy();
+    for (ProcessLauncher::Policy placement : m_placements) {
+        ProcessLauncher::setPolicy(placement);
+        for (const QString &line : ProcessLauncher::planDescription()) {
+            stream << "  " << line << "\n";
+        }
+    }
+    ProcessLauncher::setPolicy(current);
+    for (const Result &result : m_results) {
+        QString backendName = UpscaleBackend::instance(result.backend)->name();
+        if (m_backgroundLoad > 0) {
+            stream << QString("%1 | ").arg(PriorityScheduler::modeName(result.preempt), -7);
+        }
+        stream << QString("%1 | %2 | %3 | ")
+                      .arg(ProcessLauncher::policyName(result.placement), -4)
+                      .arg(backendName, -24)
+                      .arg(result.modelName, -28);
+        if (result.runMs.isEmpty()) {
+            stream << "不可用: " << result.error << "\n";
+            continue;
+        }
+
+        // 首次包含模型加载，其余取最小值和平均值
+        QList<qint64> warm = result.runMs.mid(1);
+        stream << QString("首次 %1 ms").arg(result.runMs.first());
+        if (!warm.isEmpty()) {
+            qint64 total = 0;
+            for (qint64 ms : warm) {
+                total += ms;
+            }
+            stream << QString(" | 之后 最小 %1 ms 平均 %2 ms")
+                          .arg(*std::min_element(warm.begin(), warm.end()))
+                          .arg(total / warm.size());
+        }
+        if (!result.error.isEmpty()) {
+            stream << " | 错误: " << result.error;
+        }
+        stream << "\n";
+    }
+    return text;
+}
+
+int BenchmarkRunner::runFromArguments(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    int index = arguments.indexOf("--benchmark");
+    if (index < 0 || index + 1 >= arguments.size() || !QFileInfo::exists(arguments.at(index + 1))) {
+        out << "用法: --benchmark <图片> [--models a,b] [--runs N] [--parallel N] [--placement off,numa] "
+               "[--background N] [--preempt off,renice,suspend]\n";
+        return 1;
+    }
+
+    BenchmarkRunner runner;
+    runner.setInput(arguments.at(index + 1));
+
+    int modelsIndex = arguments.indexOf("--models");
+    if (modelsIndex >= 0 && modelsIndex + 1 < arguments.size()) {
+        runner.setModels(arguments.at(modelsIndex + 1).split(',', Qt::SkipEmptyParts));
+    }
+    int runsIndex = arguments.indexOf("--runs");
+    if (runsIndex >= 0 && runsIndex + 1 < arguments.size()) {
+        runner.setRuns(arguments.at(runsIndex + 1).toInt());
+    }
+    int parallelIndex = arguments.indexOf("--parallel");
+    if (parallelIndex >= 0 && parallelIndex + 1 < arguments.size()) {
+        runner.setParallel(arguments.at(parallelIndex + 1).toInt());
+    }
+    int placementIndex = arguments.indexOf("--placement");
+    if (placementIndex >= 0 && placementIndex + 1 < arguments.size()) {
+        QList<ProcessLauncher::Policy> placements;
+        for (const QString &name : arguments.at(placementIndex + 1).split(',', Qt::SkipEmptyParts)) {
+            placements << ProcessLauncher::policyFromName(name);
+        }
+        runner.setPlacements(placements);
+    }
+    int backgroundIndex = arguments.indexOf("--background");
+    if (backgroundIndex >= 0 && backgroundIndex + 1 < arguments.size()) {
+        runner.setBackgroundLoad(arguments.at(backgroundIndex + 1).toInt());
+    }
+    int preemptIndex = arguments.indexOf("--preempt");
+    if (preemptIndex >= 0 && preemptIndex + 1 < arguments.size()) {
+        QList<PriorityScheduler::Mode> modes;
+        for (const QString &name : arguments.at(preemptIndex + 1).split(',', Qt::SkipEmptyParts)) {
+            modes << PriorityScheduler::modeFromName(name);
+        }
+        runner.setPreemptModes(modes);
+    }
+
+    QEventLoop loop;
+    connect(&runner, &BenchmarkRunner::finished, &loop, &QEventLoop::quit);
+    runner.start();
+    loop.exec();
+
+    out << runner.report();
+    out.flush();
+    return 0;
+}
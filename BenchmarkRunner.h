@@ -0,0 +1,79 @@
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include "UpscaleBackend.h"
+#include "ProcessLauncher.h"
+#include "PriorityScheduler.h"
+
+// 用同一张图片依次跑各个后端和模型，对比首次（含模型加载）与后续的耗时。
+// --parallel 每轮同时启动 N 个任务，配合 --placement off,numa 对比进程放置策略。
+// --background N 在测量期间持续运行 N 个后台任务，配合 --preempt off,renice,suspend 测量交互式延迟。
+// 命令行: qtRealSR_GUI --benchmark <图片> [--models a,b] [--runs N] [--parallel N] [--placement off,numa]
+//         [--background N] [--preempt off,renice,suspend]
+class BenchmarkRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        UpscaleBackend::Kind backend;
+        ProcessLauncher::Policy placement;
+        PriorityScheduler::Mode preempt;
+        QString modelName;
+        QList<qint64> runMs;
+        QString error;
+    };
+
+    explicit BenchmarkRunner(QObject *parent = nullptr);
+
+    void setInput(const QString &inputPath);
+    void setModels(const QStringList &models);
+    void setRuns(int runs);
+    void setBackends(const QList<UpscaleBackend::Kind> &backends);
+    void setPlacements(const QList<ProcessLauncher::Policy> &placements);
+    void setParallel(int parallel);
+    void setBackgroundLoad(int tasks);
+    void setPreemptModes(const QList<PriorityScheduler::Mode> &modes);
+    void start();
+
+    const QList<Result> &results() const { return m_results; }
+    QString report() const;
+
+    static int runFromArguments(const QStringList &arguments);
+
+signals:
+    void finished();
+
+private:
+    void startNextRun();
+    void handleRunFinished(bool ok);
+    void startBackgroundTask();
+    void stopBackgroundLoad();
+
+    QString m_inputPath;
+    QStringList m_models;
+    int m_runs = 3;
+    QList<UpscaleBackend::Kind> m_backends;
+    QList<ProcessLauncher::Policy> m_placements;
+    int m_parallel = 1;
+    int m_backgroundLoad = 0;
+    QList<PriorityScheduler::Mode> m_preemptModes;
+    // 后台负载和被测任务分别挂在这两个对象下，以区分优先级
+    QObject *m_backgroundOwner;
+    QObject *m_interactiveOwner;
+    QList<UpscaleTask *> m_backgroundTasks;
+    bool m_done = false;
+    QTemporaryDir m_tempDir;
+
+    QList<Result> m_results;
+    int m_resultIndex = 0;
+    QList<UpscaleTask *> m_tasks;
+    int m_runningTasks = 0;
+    QString m_runError;
+    QElapsedTimer m_timer;
+};
+
+#endif // BENCHMARKRUNNER_H
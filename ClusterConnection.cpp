@@ -0,0 +1,130 @@
+#include "ClusterConnection.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTcpSocket>
+#include <QtEndian>
+
+namespace {
+const int kPrefixSize = 8;
+// 单条消息上限，超过视为协议错误直接断开
+const quint32 kMaxHeaderSize = 1 << 20;
+const quint32 kMaxPayloadSize = 1u << 30;
+}
+
+ClusterConnection::ClusterConnection(QTcpSocket *socket, QObject *parent)
+    : QObject(parent), m_socket(socket)
+{
+    m_socket->setParent(this);
+    m_lastActivity.start();
+    connect(m_socket, &QTcpSocket::readyRead, this, &ClusterConnection::readMessages);
+    connect(m_socket, &QTcpSocket::disconnected, this, &ClusterConnection::closed);
+}
+
+QString ClusterConnection::peerAddress() const
+{
+    return QString("%1:%2").arg(m_socket->peerAddress().toString()).arg(m_socket->peerPort());
+}
+
+void ClusterConnection::send(const QJsonObject &header, const QByteArray &payload)
+{
+    QByteArray json = QJsonDocument(header).toJson(QJsonDocument::Compact);
+    uchar prefix[kPrefixSize];
+    qToBigEndian<quint32>(quint32(json.size()), prefix);
+    qToBigEndian<quint32>(quint32(payload.size()), prefix + 4);
+
+    m_socket->write(reinterpret_cast<const char *>(prefix), kPrefixSize);
+    m_socket->write(json);
+    if (!payload.isEmpty()) {
+        m_socket->write(payload);
+    }
+    m_bytesSent += kPrefixSize + json.size() + payload.size();
+}
+
+void ClusterConnection::close()
+{
+    m_socket->abort();
+}
+
+void ClusterConnection::readMessages()
+{
+    m_lastActivity.restart();
+    QByteArray data = m_socket->readAll();
+    m_bytesReceived += data.size();
+    m_buffer.append(data);
+
+    while (m_buffer.size() >= kPrefixSize && m_socket->state() == QAbstractSocket::ConnectedState) {
+        const uchar *prefix = reinterpret_cast<const uchar *>(m_buffer.constData());
+        quint32 headerSize = qFromBigEndian<quint32>(prefix);
+        quint32 payloadSize = qFromBigEndian<quint32>(prefix + 4);
+        if (headerSize > kMaxHeaderSize || payloadSize > kMaxPayloadSize) {
+            qWarning() << "Cluster message too large from" << peerAddress();
+            close();
+            return;
+        }
+
+        qint64 total = qint64(kPrefixSize) + headerSize + payloadSize;
+        if (m_buffer.size() < total) {
+            return;
+        }
+
+        QJsonObject header = QJsonDocument::fromJson(m_buffer.mid(kPrefixSize, int(headerSize))).object();
+        QByteArray payload = m_buffer.mid(kPrefixSize + int(headerSize), int(payloadSize));
+        m_buffer.remove(0, int(total));
+        emit messageReceived(header, payload);
+    }
+}
+
+QByteArray ClusterConnection::packFiles(const QStringList &paths, QJsonArray *entries, QString *error)
+{
+    QByteArray payload;
+    for (const QString &path : paths) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            if (error) {
+                *error = QString("无法读取 %1").arg(path);
+            }
+            return QByteArray();
+        }
+        QByteArray data = file.readAll();
+        QJsonObject entry;
+        entry["name"] = QFileInfo(path).fileName();
+        entry["size"] = data.size();
+        entries->append(entry);
+        payload.append(data);
+    }
+    return payload;
+}
+
+bool ClusterConnection::unpackFiles(const QJsonArray &entries, const QByteArray &payload, const QString &dir,
+                                   QString *error)
+{
+    int offset = 0;
+    for (const QJsonValue &value : entries) {
+        QJsonObject entry = value.toObject();
+        // 只取文件名，防止对端传来带路径的名字
+        QString name = QFileInfo(entry["name"].toString()).fileName();
+        int size = entry["size"].toInt();
+        if (name.isEmpty() || size < 0 || offset + size > payload.size()) {
+            if (error) {
+                *error = "文件列表与数据长度不符";
+            }
+            return false;
+        }
+
+        QSaveFile file(QDir(dir).filePath(name));
+        if (!file.open(QIODevice::WriteOnly) || file.write(payload.constData() + offset, size) != size
+            || !file.commit()) {
+            if (error) {
+                *error = QString("无法写入 %1").arg(file.fileName());
+            }
+            return false;
+        }
+        offset += size;
+    }
+    return true;
+}
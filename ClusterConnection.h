@@ -0,0 +1,55 @@
+#ifndef CLUSTERCONNECTION_H
+#define CLUSTERCONNECTION_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+
+class QTcpSocket;
+
+// 协调端与工作节点之间的一条连接。每条消息为
+// 4 字节头长度 + 4 字节负载长度（均为大端）+ JSON 头 + 二进制负载，
+// 负载里是按头中 files 列表顺序拼接的文件内容
+class ClusterConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 协议版本，hello 消息里携带，不一致时拒绝连接
+    static const int kProtocolVersion = 1;
+
+    explicit ClusterConnection(QTcpSocket *socket, QObject *parent = nullptr);
+
+    void send(const QJsonObject &header, const QByteArray &payload = QByteArray());
+    void close();
+
+    QTcpSocket *socket() const { return m_socket; }
+    QString peerAddress() const;
+    // 距离上次收到数据的毫秒数，大文件传输期间也会持续刷新
+    qint64 idleMs() const { return m_lastActivity.elapsed(); }
+    qint64 bytesSent() const { return m_bytesSent; }
+    qint64 bytesReceived() const { return m_bytesReceived; }
+
+    // 读取 paths 中的文件拼成负载，entries 输出 {name, size} 列表
+    static QByteArray packFiles(const QStringList &paths, QJsonArray *entries, QString *error = nullptr);
+    // 按 entries 把负载拆回文件写入 dir
+    static bool unpackFiles(const QJsonArray &entries, const QByteArray &payload, const QString &dir,
+                            QString *error = nullptr);
+
+signals:
+    void messageReceived(const QJsonObject &header, const QByteArray &payload);
+    void closed();
+
+private:
+    void readMessages();
+
+    QTcpSocket *m_socket;
+    QByteArray m_buffer;
+    QElapsedTimer m_lastActivity;
+    qint64 m_bytesSent = 0;
+    qint64 m_bytesReceived = 0;
+};
+
+#endif // CLUSTERCONNECTION_H
@@ -0,0 +1,658 @@
+#include "ClusterCoordinator.h"
+#include "ClusterConnection.h"
+#include "ProcessSupervisor.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+namespace {
+// 工作节点每 2 秒发一次心跳，超过这个时间没有任何数据视为失联
+const int kHeartbeatTimeoutMs = 10000;
+const int kHeartbeatCheckMs = 2000;
+// 同一分片失败这么多次后整个任务失败
+const int kMaxAttempts = 3;
+// 每个节点大约分到这么多个分片，兼顾负载均衡与每片的固定开销
+const int kShardsPerWorker = 4;
+const int kMaxShardFrames = 32;
+
+const QStringList kImageFilters = {"*.png", "*.jpg", "*.jpeg", "*.webp", "*.bmp"};
+}
+
+ClusterCoordinator *ClusterCoordinator::instance()
+{
+    static ClusterCoordinator *coordinator = [] {
+        ClusterCoordinator *created = new ClusterCoordinator;
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, created, &ClusterCoordinator::stopLocalWorkers);
+        return created;
+    }();
+    return coordinator;
+}
+
+ClusterCoordinator::ClusterCoordinator(QObject *parent)
+    : QObject(parent), m_server(new QTcpServer(this)), m_heartbeatTimer(new QTimer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &ClusterCoordinator::handleNewConnection);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &ClusterCoordinator::checkHeartbeats);
+}
+
+ClusterCoordinator::~ClusterCoordinator()
+{
+    stopLocalWorkers();
+}
+
+bool ClusterCoordinator::listen(quint16 port, QString *error)
+{
+    if (m_server->isListening()) {
+        return true;
+    }
+    if (!m_server->listen(QHostAddress::Any, port)) {
+        if (error) {
+            *error = QString("无法监听端口 %1: %2").arg(port).arg(m_server->errorString());
+        }
+        return false;
+    }
+    m_heartbeatTimer->start(kHeartbeatCheckMs);
+    qDebug() << "Cluster coordinator listening on port" << m_server->serverPort();
+    return true;
+}
+
+bool ClusterCoordinator::isListening() const
+{
+    return m_server->isListening();
+}
+
+quint16 ClusterCoordinator::port() const
+{
+    return m_server->serverPort();
+}
+
+int ClusterCoordinator::workerCount() const
+{
+    int count = 0;
+    for (const Worker &worker : m_workers) {
+        if (worker.ready) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QList<ClusterCoordinator::WorkerStats> ClusterCoordinator::workerStats() const
+{
+    QList<WorkerStats> result = m_retiredStats;
+    for (const Worker &worker : m_workers) {
+        if (!worker.ready) {
+            continue;
+        }
+        WorkerStats stats = worker.stats;
+        stats.bytesSent = worker.connection->bytesSent();
+        stats.bytesReceived = worker.connection->bytesReceived();
+        if (stats.busy) {
+            stats.busyMs += worker.busyTimer.elapsed();
+        }
+        result << stats;
+    }
+    return result;
+}
+
+QString ClusterCoordinator::statsReport() const
+{
+    QStringList lines;
+    for (const WorkerStats &stats : workerStats()) {
+        lines << QString("%1 (%2, %3%4): %5 帧, %6 帧/秒, 失败分片 %7, 发送 %8 MB / 接收 %9 MB")
+                     .arg(stats.name, stats.address, stats.backend, stats.connected ? "" : ", 已断开")
+                     .arg(stats.framesDone)
+                     .arg(stats.framesPerSecond(), 0, 'f', 2)
+                     .arg(stats.shardsFailed)
+                     .arg(stats.bytesSent / 1048576.0, 0, 'f', 1)
+                     .arg(stats.bytesReceived / 1048576.0, 0, 'f', 1);
+    }
+    return lines.join('\n');
+}
+
+void ClusterCoordinator::spawnLocalWorkers(int count, const QStringList &extraArguments)
+{
+    for (int i = 0; i < count; ++i) {
+        QProcess *process = new QProcess(this);
+        process->setProcessChannelMode(QProcess::ForwardedChannels);
+        QStringList args;
+        args << "--worker" << QString("127.0.0.1:%1").arg(port())
+             << "--name" << QString("local-%1").arg(m_localWorkers.size() + 1)
+             << "--exit-on-disconnect" << extraArguments;
+        ProcessSupervisor::attach(process)->setLabel(QString("local-worker-%1").arg(m_localWorkers.size() + 1));
+        process->start(QCoreApplication::applicationFilePath(), args);
+        m_localWorkers << process;
+    }
+}
+
+void ClusterCoordinator::stopLocalWorkers()
+{
+    for (QProcess *process : m_localWorkers) {
+        // 不等待退出，结束后再释放
+        if (process->state() == QProcess::NotRunning) {
+            process->deleteLater();
+            continue;
+        }
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                process, &QObject::deleteLater);
+        ProcessSupervisor::stop(process, 1000);
+    }
+    m_localWorkers.clear();
+}
+
+bool ClusterCoordinator::dropBusyWorker()
+{
+    for (const Worker &worker : m_workers) {
+        if (worker.shardId >= 0) {
+            dropWorker(worker.id, "测试断开");
+            return true;
+        }
+    }
+    return false;
+}
+
+void ClusterCoordinator::handleNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        Worker worker;
+        worker.id = m_nextWorkerId++;
+        worker.connection = new ClusterConnection(socket, this);
+        worker.stats.address = worker.connection->peerAddress();
+
+        int workerId = worker.id;
+        connect(worker.connection, &ClusterConnection::messageReceived, this,
+                [this, workerId](const QJsonObject &header, const QByteArray &payload) {
+                    handleMessage(workerId, header, payload);
+                });
+        connect(worker.connection, &ClusterConnection::closed, this, [this, workerId]() {
+            dropWorker(workerId, "连接断开");
+        });
+        m_workers << worker;
+    }
+}
+
+ClusterCoordinator::Worker *ClusterCoordinator::findWorker(int workerId)
+{
+    for (Worker &worker : m_workers) {
+        if (worker.id == workerId) {
+            return &worker;
+        }
+    }
+    return nullptr;
+}
+
+void ClusterCoordinator::handleMessage(int workerId, const QJsonObject &header, const QByteArray &payload)
+{
+    Worker *worker = findWorker(workerId);
+    if (!worker) {
+        return;
+    }
+
+    QString type = header["type"].toString();
+    if (type == "hello") {
+        if (header["version"].toInt() != ClusterConnection::kProtocolVersion) {
+            dropWorker(workerId, "协议版本不一致");
+            return;
+        }
+        worker->ready = true;
+        worker->stats.name = header["name"].toString();
+        worker->stats.backend = header["backend"].toString();
+        emit statusMessage(QString("工作节点 %1 已连接").arg(worker->stats.name));
+        emit workersChanged(workerCount());
+        dispatch();
+    } else if (type == "output") {
+        handleOutput(*worker, header, payload);
+    } else if (type == "done") {
+        handleShardDone(*worker, header);
+    }
+    // heartbeat 只需刷新连接的活动时间
+}
+
+void ClusterCoordinator::handleOutput(Worker &worker, const QJsonObject &header, const QByteArray &payload)
+{
+    // 已被重新分配的分片，旧节点迟到的结果直接丢弃
+    int shardId = header["shard"].toInt();
+    if (!m_running.contains(shardId) || m_running.value(shardId).workerId != worker.id) {
+        return;
+    }
+    ClusterUpscaleTask *task = m_running.value(shardId).task;
+    if (!task || m_sharedStorage) {
+        return;
+    }
+
+    QString name = QFileInfo(header["name"].toString()).fileName();
+    QSaveFile file(QDir(task->outputDir()).filePath(name));
+    if (name.isEmpty() || !file.open(QIODevice::WriteOnly) || file.write(payload) != payload.size()
+        || !file.commit()) {
+        failTask(task, QString("无法写入 %1").arg(file.fileName()));
+    }
+}
+
+void ClusterCoordinator::handleShardDone(Worker &worker, const QJsonObject &header)
+{
+    int shardId = header["shard"].toInt();
+    if (worker.shardId != shardId) {
+        return;
+    }
+
+    worker.shardId = -1;
+    worker.stats.busy = false;
+    worker.stats.busyMs += worker.busyTimer.elapsed();
+    Shard shard = m_running.take(shardId);
+
+    if (shard.task) {
+        if (header["ok"].toBool()) {
+            worker.stats.shardsDone++;
+            worker.stats.framesDone += shard.files.size();
+            shard.task->shardFinished(shard.files.size(), worker.stats.name);
+        } else {
+            worker.stats.shardsFailed++;
+            requeue(shard, QString("%1: %2").arg(worker.stats.name, header["error"].toString()));
+        }
+    }
+    dispatch();
+}
+
+void ClusterCoordinator::dropWorker(int workerId, const QString &reason)
+{
+    int index = -1;
+    for (int i = 0; i < m_workers.size(); ++i) {
+        if (m_workers.at(i).id == workerId) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        return;
+    }
+
+    Worker worker = m_workers.takeAt(index);
+    worker.stats.connected = false;
+    worker.stats.bytesSent = worker.connection->bytesSent();
+    worker.stats.bytesReceived = worker.connection->bytesReceived();
+    if (worker.stats.busy) {
+        worker.stats.busy = false;
+        worker.stats.busyMs += worker.busyTimer.elapsed();
+    }
+    worker.connection->disconnect(this);
+    worker.connection->close();
+    worker.connection->deleteLater();
+
+    if (worker.shardId >= 0 && m_running.contains(worker.shardId)) {
+        requeue(m_running.take(worker.shardId), QString("%1 %2").arg(worker.stats.name, reason));
+    }
+
+    if (worker.ready) {
+        m_retiredStats << worker.stats;
+        qWarning() << "Cluster worker dropped:" << worker.stats.name << reason;
+        emit statusMessage(QString("工作节点 %1 %2").arg(worker.stats.name, reason));
+        emit workersChanged(workerCount());
+    }
+    dispatch();
+}
+
+void ClusterCoordinator::checkHeartbeats()
+{
+    QList<int> expired;
+    for (const Worker &worker : m_workers) {
+        if (worker.connection->idleMs() > kHeartbeatTimeoutMs) {
+            expired << worker.id;
+        }
+    }
+    for (int workerId : expired) {
+        dropWorker(workerId, "心跳超时");
+    }
+}
+
+int ClusterCoordinator::shardSize(int fileCount) const
+{
+    int workers = qMax(1, workerCount());
+    return qBound(1, fileCount / (workers * kShardsPerWorker), kMaxShardFrames);
+}
+
+void ClusterCoordinator::submit(ClusterUpscaleTask *task, const QStringList &files)
+{
+    int size = shardSize(files.size());
+    for (int i = 0; i < files.size(); i += size) {
+        Shard shard;
+        shard.id = m_nextShardId++;
+        shard.task = task;
+        shard.files = files.mid(i, size);
+        m_pending << shard;
+    }
+
+    if (workerCount() == 0) {
+        emit statusMessage("等待工作节点连接...");
+    }
+    dispatch();
+}
+
+void ClusterCoordinator::dispatch()
+{
+    for (Worker &worker : m_workers) {
+        if (m_pending.isEmpty()) {
+            return;
+        }
+        if (!worker.ready || worker.shardId >= 0) {
+            continue;
+        }
+
+        Shard shard = m_pending.takeFirst();
+        ClusterUpscaleTask *task = shard.task;
+        const UpscaleRequest &request = task->request();
+
+        QJsonObject header;
+        header["type"] = "shard";
+        header["shard"] = shard.id;
+        header["model"] = request.modelName;
+        header["scale"] = request.scale;
+        header["format"] = task->outputFormat();
+
+        QJsonArray outputs;
+        QStringList paths;
+        for (const QString &name : shard.files) {
+            outputs << task->outputName(name);
+            paths << QDir(task->inputDir()).filePath(name);
+        }
+        header["outputs"] = outputs;
+
+        QByteArray payload;
+        if (m_sharedStorage) {
+            QJsonArray files;
+            for (const QString &name : shard.files) {
+                QJsonObject entry;
+                entry["name"] = name;
+                files << entry;
+            }
+            header["files"] = files;
+            header["inputDir"] = task->inputDir();
+            header["outputDir"] = task->outputDir();
+        } else {
+            QJsonArray entries;
+            QString error;
+            payload = ClusterConnection::packFiles(paths, &entries, &error);
+            if (!error.isEmpty()) {
+                failTask(task, error);
+                continue;
+            }
+            header["files"] = entries;
+        }
+
+        worker.connection->send(header, payload);
+        shard.workerId = worker.id;
+        worker.shardId = shard.id;
+        worker.stats.busy = true;
+        worker.busyTimer.start();
+        m_running.insert(shard.id, shard);
+    }
+}
+
+void ClusterCoordinator::requeue(Shard shard, const QString &reason)
+{
+    if (!shard.task) {
+        return;
+    }
+
+    shard.workerId = -1;
+    if (++shard.attempts >= kMaxAttempts) {
+        failTask(shard.task, QString("分片重试 %1 次仍失败: %2").arg(kMaxAttempts).arg(reason));
+        return;
+    }
+    // 放回队首，尽快补上视频中间缺的这一段
+    m_pending.prepend(shard);
+    emit statusMessage(QString("分片重新分配: %1").arg(reason));
+}
+
+void ClusterCoordinator::failTask(ClusterUpscaleTask *task, const QString &error)
+{
+    cancel(task);
+    task->fail(error);
+}
+
+void ClusterCoordinator::cancel(ClusterUpscaleTask *task)
+{
+    for (int i = m_pending.size() - 1; i >= 0; --i) {
+        if (m_pending.at(i).task == task) {
+            m_pending.removeAt(i);
+        }
+    }
+
+    // 正在执行的分片通知节点取消，节点回复 done 之后才重新变为空闲
+    for (auto it = m_running.begin(); it != m_running.end(); ++it) {
+        if (it->task != task) {
+            continue;
+        }
+        it->task = nullptr;
+        if (Worker *worker = findWorker(it->workerId)) {
+            QJsonObject header;
+            header["type"] = "cancel";
+            header["shard"] = it->id;
+            worker->connection->send(header);
+        }
+    }
+}
+
+int ClusterCoordinator::runLocalTest(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    auto value = [&arguments](const QString &name, const QString &fallback) {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments.at(index + 1) : fallback;
+    };
+
+    QString inputDir = value("--cluster-test", QString());
+    if (!QFileInfo(inputDir).isDir()) {
+        out << "用法: --cluster-test <帧目录> [--local-workers N] [--model m] [--scale s] [--drop-one]\n";
+        return 2;
+    }
+    int workers = qMax(1, value("--local-workers", "3").toInt());
+    bool dropOne = arguments.contains("--drop-one");
+
+    ClusterCoordinator *coordinator = instance();
+    QString error;
+    if (!coordinator->listen(0, &error)) {
+        out << error << "\n";
+        return 1;
+    }
+    connect(coordinator, &ClusterCoordinator::statusMessage, [&out](const QString &message) {
+        out << message << "\n";
+        out.flush();
+    });
+
+    QStringList workerArguments;
+    for (const QString &name : {QString("--backend"), QString("--realesrgan")}) {
+        if (arguments.contains(name)) {
+            workerArguments << name << value(name, QString());
+        }
+    }
+    coordinator->spawnLocalWorkers(workers, workerArguments);
+
+    // 等所有本机节点都连上，分片才能均匀铺开
+    QEventLoop loop;
+    QTimer deadline;
+    deadline.setSingleShot(true);
+    connect(&deadline, &QTimer::timeout, &loop, &QEventLoop::quit);
+    connect(coordinator, &ClusterCoordinator::workersChanged, &loop, [&loop, workers](int count) {
+        if (count >= workers) {
+            loop.quit();
+        }
+    });
+    deadline.start(30000);
+    loop.exec();
+    if (coordinator->workerCount() == 0) {
+        out << "没有工作节点连接\n";
+        coordinator->stopLocalWorkers();
+        return 1;
+    }
+
+    QTemporaryDir outputDir;
+    UpscaleRequest request;
+    request.inputPath = inputDir;
+    request.outputPath = outputDir.path();
+    request.modelName = value("--model", "realesr-animevideov3");
+    request.scale = value("--scale", "2").toInt();
+    request.outputFormat = "png";
+
+    ClusterUpscaleTask task(request);
+    bool ok = false;
+    bool dropped = false;
+    connect(&task, &UpscaleTask::finished, &loop, [&](bool result) {
+        ok = result;
+        loop.quit();
+    });
+    connect(&task, &UpscaleTask::progress, &loop, [&](double percent) {
+        out << QString("进度 %1%\n").arg(percent, 0, 'f', 1);
+        out.flush();
+        if (dropOne && !dropped) {
+            dropped = coordinator->dropBusyWorker();
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    task.start();
+    deadline.stop();
+    loop.exec();
+
+    int inputCount = QDir(inputDir).entryList(kImageFilters, QDir::Files).size();
+    int outputCount = QDir(outputDir.path()).entryList({"*.png"}, QDir::Files).size();
+    out << QString("%1，用时 %2 秒，输出 %3/%4 帧\n")
+               .arg(ok ? "完成" : "失败: " + task.errorString())
+               .arg(timer.elapsed() / 1000.0, 0, 'f', 1)
+               .arg(outputCount)
+               .arg(inputCount);
+    out << coordinator->statsReport() << "\n";
+
+    coordinator->stopLocalWorkers();
+    return ok && outputCount == inputCount ? 0 : 1;
+}
+
+bool ClusterUpscaleBackend::isAvailable(QString *reason) const
+{
+    if (!ClusterCoordinator::instance()->isListening()) {
+        if (reason) {
+            *reason = "未启动分布式协调端（--coordinator）";
+        }
+        return false;
+    }
+    return true;
+}
+
+UpscaleTask *ClusterUpscaleBackend::createTask(const UpscaleRequest &request, QObject *parent)
+{
+    return new ClusterUpscaleTask(request, parent);
+}
+
+ClusterUpscaleTask::ClusterUpscaleTask(const UpscaleRequest &request, QObject *parent)
+    : UpscaleTask(request, parent)
+{
+    m_fileMode = QFileInfo(request.inputPath).isFile();
+}
+
+ClusterUpscaleTask::~ClusterUpscaleTask()
+{
+    if (!m_done) {
+        ClusterCoordinator::instance()->cancel(this);
+    }
+}
+
+QString ClusterUpscaleTask::inputDir() const
+{
+    return m_fileMode ? QFileInfo(m_request.inputPath).absolutePath() : m_request.inputPath;
+}
+
+QString ClusterUpscaleTask::outputDir() const
+{
+    return m_fileMode ? QFileInfo(m_request.outputPath).absolutePath() : m_request.outputPath;
+}
+
+QString ClusterUpscaleTask::outputFormat() const
+{
+    QString suffix = QFileInfo(m_request.outputPath).suffix().toLower();
+    return m_fileMode && !suffix.isEmpty() ? suffix : m_request.outputFormat;
+}
+
+QString ClusterUpscaleTask::outputName(const QString &inputName) const
+{
+    if (m_fileMode) {
+        return QFileInfo(m_request.outputPath).fileName();
+    }
+    return QFileInfo(inputName).completeBaseName() + "." + outputFormat();
+}
+
+void ClusterUpscaleTask::start()
+{
+    QStringList files;
+    if (m_fileMode) {
+        files << QFileInfo(m_request.inputPath).fileName();
+    } else {
+        files = QDir(m_request.inputPath).entryList(kImageFilters, QDir::Files, QDir::Name);
+    }
+
+    if (files.isEmpty()) {
+        fail(QString("没有需要处理的图片: %1").arg(m_request.inputPath));
+        return;
+    }
+    if (!ClusterCoordinator::instance()->isListening()) {
+        fail("未启动分布式协调端");
+        return;
+    }
+
+    QDir().mkpath(outputDir());
+    m_totalFrames = files.size();
+    ClusterCoordinator::instance()->submit(this, files);
+}
+
+void ClusterUpscaleTask::cancel()
+{
+    if (m_done) {
+        return;
+    }
+    ClusterCoordinator::instance()->cancel(this);
+    fail("已取消");
+}
+
+void ClusterUpscaleTask::shardFinished(int frames, const QString &workerName)
+{
+    if (m_done) {
+        return;
+    }
+
+    m_finishedFrames += frames;
+    m_framesByWorker[workerName] += frames;
+    emit progress(100.0 * m_finishedFrames / m_totalFrames);
+    if (m_finishedFrames < m_totalFrames) {
+        return;
+    }
+
+    QStringList parts;
+    for (auto it = m_framesByWorker.constBegin(); it != m_framesByWorker.constEnd(); ++it) {
+        parts << QString("%1 %2 帧").arg(it.key()).arg(it.value());
+    }
+    m_report = QString("分布式增强（%1 个节点）: %2").arg(m_framesByWorker.size()).arg(parts.join("，"));
+    m_done = true;
+    // 排队发出，调用方在 finished 里删除任务时协调端已经退出当前调用
+    QMetaObject::invokeMethod(this, [this]() { emit finished(true); }, Qt::QueuedConnection);
+}
+
+void ClusterUpscaleTask::fail(const QString &error)
+{
+    if (m_done) {
+        return;
+    }
+    m_done = true;
+    m_errorString = error;
+    QMetaObject::invokeMethod(this, [this]() { emit finished(false); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,163 @@
+#ifndef CLUSTERCOORDINATOR_H
+#define CLUSTERCOORDINATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QStringList>
+#include "UpscaleBackend.h"
+
+class QTcpServer;
+class QTimer;
+class QProcess;
+class ClusterConnection;
+class ClusterUpscaleTask;
+
+// 分布式模式的协调端：监听 TCP 端口等待工作节点（--worker）连接，
+// 把目录里的帧按连续片段拆成分片派给空闲节点，收回结果写入输出目录。
+// 节点断线或心跳超时后，它手上的分片放回队列由其他节点重做
+class ClusterCoordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct WorkerStats {
+        QString name;
+        QString address;
+        QString backend;
+        int shardsDone = 0;
+        int shardsFailed = 0;
+        int framesDone = 0;
+        qint64 busyMs = 0;
+        qint64 bytesSent = 0;
+        qint64 bytesReceived = 0;
+        bool busy = false;
+        bool connected = true;
+
+        double framesPerSecond() const { return busyMs > 0 ? framesDone * 1000.0 / busyMs : 0; }
+    };
+
+    static ClusterCoordinator *instance();
+
+    bool listen(quint16 port, QString *error = nullptr);
+    bool isListening() const;
+    quint16 port() const;
+
+    // 节点与本机共享存储时只传路径，否则输入输出随消息传输
+    void setSharedStorage(bool shared) { m_sharedStorage = shared; }
+    bool sharedStorage() const { return m_sharedStorage; }
+
+    int workerCount() const;
+    // 包括已断开的节点，便于事后查看吞吐
+    QList<WorkerStats> workerStats() const;
+    QString statsReport() const;
+
+    // 在本机启动 count 个工作进程连接到自己，用于单机测试
+    void spawnLocalWorkers(int count, const QStringList &extraArguments = QStringList());
+    void stopLocalWorkers();
+    // 测试用：强制断开一个正在工作的节点，验证分片重新分配
+    bool dropBusyWorker();
+
+    // 命令行: qtRealSR_GUI --cluster-test <帧目录> [--local-workers N] [--model m] [--scale s] [--drop-one]
+    static int runLocalTest(const QStringList &arguments);
+
+    // 以下由 ClusterUpscaleTask 调用
+    void submit(ClusterUpscaleTask *task, const QStringList &files);
+    void cancel(ClusterUpscaleTask *task);
+
+signals:
+    void workersChanged(int count);
+    void statusMessage(const QString &message);
+
+private:
+    struct Shard {
+        int id = 0;
+        ClusterUpscaleTask *task = nullptr;
+        QStringList files;
+        int attempts = 0;
+        int workerId = -1;
+    };
+
+    struct Worker {
+        int id = 0;
+        ClusterConnection *connection = nullptr;
+        bool ready = false;
+        int shardId = -1;
+        QElapsedTimer busyTimer;
+        WorkerStats stats;
+    };
+
+    explicit ClusterCoordinator(QObject *parent = nullptr);
+    ~ClusterCoordinator();
+
+    void handleNewConnection();
+    void handleMessage(int workerId, const QJsonObject &header, const QByteArray &payload);
+    void handleOutput(Worker &worker, const QJsonObject &header, const QByteArray &payload);
+    void handleShardDone(Worker &worker, const QJsonObject &header);
+    void dropWorker(int workerId, const QString &reason);
+    void checkHeartbeats();
+    void dispatch();
+    void requeue(Shard shard, const QString &reason);
+    void failTask(ClusterUpscaleTask *task, const QString &error);
+    int shardSize(int fileCount) const;
+    Worker *findWorker(int workerId);
+
+    QTcpServer *m_server;
+    QTimer *m_heartbeatTimer;
+    bool m_sharedStorage = false;
+
+    QList<Worker> m_workers;
+    QList<WorkerStats> m_retiredStats;
+    QList<Shard> m_pending;
+    QHash<int, Shard> m_running;
+    int m_nextWorkerId = 1;
+    int m_nextShardId = 1;
+    QList<QProcess *> m_localWorkers;
+};
+
+// 把请求交给协调端的后端，输入为目录时按帧分片，输入为单个文件时整个作为一个分片
+class ClusterUpscaleBackend : public UpscaleBackend
+{
+public:
+    Kind kind() const override { return ClusterBackend; }
+    QString name() const override { return "cluster"; }
+    bool isAvailable(QString *reason = nullptr) const override;
+    UpscaleTask *createTask(const UpscaleRequest &request, QObject *parent) override;
+};
+
+class ClusterUpscaleTask : public UpscaleTask
+{
+    Q_OBJECT
+
+public:
+    explicit ClusterUpscaleTask(const UpscaleRequest &request, QObject *parent = nullptr);
+    ~ClusterUpscaleTask();
+
+    void start() override;
+    void cancel() override;
+
+    // 源文件所在目录 / 结果写入的目录
+    QString inputDir() const;
+    QString outputDir() const;
+    // 输入文件对应的输出文件名
+    QString outputName(const QString &inputName) const;
+    QString outputFormat() const;
+    // 本任务期间各节点处理的帧数
+    QString report() const { return m_report; }
+
+private:
+    friend class ClusterCoordinator;
+    void shardFinished(int frames, const QString &workerName);
+    void fail(const QString &error);
+
+    bool m_fileMode = false;
+    bool m_done = false;
+    int m_totalFrames = 0;
+    int m_finishedFrames = 0;
+    QHash<QString, int> m_framesByWorker;
+    QString m_report;
+};
+
+#endif // CLUSTERCOORDINATOR_H
@@ -0,0 +1,264 @@
+#include "ClusterWorker.h"
+#include "ClusterConnection.h"
+#include "UpscaleBackend.h"
+#include "ProcessLauncher.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+const int kHeartbeatIntervalMs = 2000;
+const int kReconnectDelayMs = 3000;
+}
+
+ClusterWorker::ClusterWorker(QObject *parent)
+    : QObject(parent), m_heartbeatTimer(new QTimer(this)), m_reconnectTimer(new QTimer(this))
+{
+    m_name = QString("%1-%2").arg(QSysInfo::machineHostName()).arg(QCoreApplication::applicationPid());
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &ClusterWorker::sendHeartbeat);
+    connect(m_reconnectTimer, &QTimer::timeout, this, [this]() {
+        connectToCoordinator(m_host, m_port);
+    });
+}
+
+void ClusterWorker::connectToCoordinator(const QString &host, quint16 port)
+{
+    m_host = host;
+    m_port = port;
+    if (m_connection) {
+        m_connection->disconnect(this);
+        m_connection->deleteLater();
+    }
+
+    QTcpSocket *socket = new QTcpSocket;
+    m_connection = new ClusterConnection(socket, this);
+    connect(socket, &QTcpSocket::connected, this, &ClusterWorker::handleConnected);
+    connect(m_connection, &ClusterConnection::closed, this, &ClusterWorker::handleDisconnected);
+    connect(m_connection, &ClusterConnection::messageReceived, this, &ClusterWorker::handleMessage);
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket](QAbstractSocket::SocketError) {
+        // 连接建立前的失败不会触发 disconnected
+        if (socket->state() != QAbstractSocket::ConnectedState) {
+            handleDisconnected();
+        }
+    });
+    socket->connectToHost(host, port);
+}
+
+void ClusterWorker::handleConnected()
+{
+    qDebug() << "Connected to coordinator" << m_host << m_port;
+    m_connection->socket()->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    QJsonObject hello;
+    hello["type"] = "hello";
+    hello["version"] = ClusterConnection::kProtocolVersion;
+    hello["name"] = m_name;
+    hello["backend"] = UpscaleBackend::defaultBackend()->name();
+    hello["threads"] = QThread::idealThreadCount();
+    m_connection->send(hello);
+    m_heartbeatTimer->start(kHeartbeatIntervalMs);
+}
+
+void ClusterWorker::handleDisconnected()
+{
+    m_heartbeatTimer->stop();
+    // 协调端会把这个分片交给别的节点，本地不必做完
+    abortShard();
+
+    if (m_exitOnDisconnect) {
+        QCoreApplication::exit(0);
+        return;
+    }
+    if (!m_reconnectTimer->isActive()) {
+        qDebug() << "Coordinator unreachable, retrying in" << kReconnectDelayMs << "ms";
+        m_reconnectTimer->start(kReconnectDelayMs);
+    }
+}
+
+void ClusterWorker::handleMessage(const QJsonObject &header, const QByteArray &payload)
+{
+    QString type = header["type"].toString();
+    if (type == "shard") {
+        startShard(header, payload);
+    } else if (type == "cancel" && header["shard"].toInt() == m_shardId && m_task) {
+        m_task->cancel();
+    }
+}
+
+void ClusterWorker::sendHeartbeat()
+{
+    QJsonObject heartbeat;
+    heartbeat["type"] = "heartbeat";
+    heartbeat["shard"] = m_shardId;
+    heartbeat["percent"] = m_taskPercent;
+    m_connection->send(heartbeat);
+}
+
+void ClusterWorker::startShard(const QJsonObject &header, const QByteArray &payload)
+{
+    if (m_shardId >= 0) {
+        QJsonObject busy;
+        busy["type"] = "done";
+        busy["shard"] = header["shard"].toInt();
+        busy["ok"] = false;
+        busy["error"] = "节点正忙";
+        m_connection->send(busy);
+        return;
+    }
+
+    m_shardId = header["shard"].toInt();
+    m_shardHeader = header;
+    m_taskPercent = 0;
+    m_shardDir = std::make_unique<QTemporaryDir>();
+    QString inputDir = QDir(m_shardDir->path()).filePath("in");
+    QString outputDir = QDir(m_shardDir->path()).filePath("out");
+    QDir().mkpath(inputDir);
+    QDir().mkpath(outputDir);
+
+    const QJsonArray files = header["files"].toArray();
+    QString error;
+    if (header.contains("inputDir")) {
+        QDir sharedInput(header["inputDir"].toString());
+        for (const QJsonValue &value : files) {
+            QString name = QFileInfo(value.toObject()["name"].toString()).fileName();
+            if (!QFile::copy(sharedInput.filePath(name), QDir(inputDir).filePath(name))) {
+                finishShard(false, QString("无法读取共享文件 %1").arg(sharedInput.filePath(name)));
+                return;
+            }
+        }
+    } else if (!ClusterConnection::unpackFiles(files, payload, inputDir, &error)) {
+        finishShard(false, error);
+        return;
+    }
+
+    UpscaleRequest request;
+    request.inputPath = inputDir;
+    request.outputPath = outputDir;
+    request.modelName = header["model"].toString();
+    request.scale = header["scale"].toInt();
+    request.outputFormat = header["format"].toString();
+
+    qDebug() << "Shard" << m_shardId << ":" << files.size() << "frames";
+    m_task = UpscaleBackend::defaultBackend()->createTask(request, this);
+    connect(m_task, &UpscaleTask::progress, this, [this](double percent) { m_taskPercent = percent; });
+    connect(m_task, &UpscaleTask::finished, this, &ClusterWorker::handleShardFinished);
+    m_task->start();
+}
+
+void ClusterWorker::handleShardFinished(bool ok)
+{
+    if (!ok) {
+        finishShard(false, m_task->errorString());
+        return;
+    }
+
+    const QJsonArray files = m_shardHeader["files"].toArray();
+    const QJsonArray outputs = m_shardHeader["outputs"].toArray();
+    const QString format = m_shardHeader["format"].toString();
+    const QString sharedOutput = m_shardHeader["outputDir"].toString();
+    QDir outputDir(QDir(m_shardDir->path()).filePath("out"));
+
+    for (int i = 0; i < files.size(); ++i) {
+        QString inputName = files.at(i).toObject()["name"].toString();
+        QString produced = outputDir.filePath(QFileInfo(inputName).completeBaseName() + "." + format);
+        QString outputName = QFileInfo(outputs.at(i).toString()).fileName();
+
+        if (!sharedOutput.isEmpty()) {
+            QString target = QDir(sharedOutput).filePath(outputName);
+            QFile::remove(target);
+            if (!QFile::copy(produced, target)) {
+                finishShard(false, QString("无法写入共享目录 %1").arg(target));
+                return;
+            }
+            continue;
+        }
+
+        QFile file(produced);
+        if (!file.open(QIODevice::ReadOnly)) {
+            finishShard(false, QString("缺少输出 %1").arg(QFileInfo(produced).fileName()));
+            return;
+        }
+        QJsonObject header;
+        header["type"] = "output";
+        header["shard"] = m_shardId;
+        header["name"] = outputName;
+        m_connection->send(header, file.readAll());
+    }
+
+    finishShard(true, QString());
+}
+
+void ClusterWorker::finishShard(bool ok, const QString &error)
+{
+    QJsonObject done;
+    done["type"] = "done";
+    done["shard"] = m_shardId;
+    done["ok"] = ok;
+    done["error"] = error;
+    m_connection->send(done);
+
+    if (m_task) {
+        m_task->deleteLater();
+        m_task = nullptr;
+    }
+    m_shardDir.reset();
+    m_shardId = -1;
+}
+
+void ClusterWorker::abortShard()
+{
+    if (m_task) {
+        m_task->disconnect(this);
+        m_task->cancel();
+        m_task->deleteLater();
+        m_task = nullptr;
+    }
+    m_shardDir.reset();
+    m_shardId = -1;
+}
+
+int ClusterWorker::runFromArguments(const QStringList &arguments)
+{
+    auto value = [&arguments](const QString &name) {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments.at(index + 1) : QString();
+    };
+
+    QString address = value("--worker");
+    int colon = address.lastIndexOf(':');
+    bool portOk = false;
+    quint16 port = colon > 0 ? address.mid(colon + 1).toUShort(&portOk) : 0;
+    if (!portOk) {
+        qWarning() << "Usage: --worker <host:port> [--name name] [--backend cli|cpu] [--realesrgan path]";
+        return 2;
+    }
+
+    // 工作节点只用本机后端
+    UpscaleBackend::setDefaultKind(value("--backend") == "cpu" ? UpscaleBackend::NcnnCpuBackend
+                                                                : UpscaleBackend::CliBackend);
+    if (!value("--realesrgan").isEmpty()) {
+        static_cast<CliUpscaleBackend *>(UpscaleBackend::instance(UpscaleBackend::CliBackend))
+            ->setExecutablePath(value("--realesrgan"));
+    }
+    ProcessLauncher::configureFromArguments(arguments);
+    QString reason;
+    if (!UpscaleBackend::defaultBackend()->isAvailable(&reason)) {
+        qWarning() << "Backend unavailable:" << reason;
+        return 1;
+    }
+
+    ClusterWorker worker;
+    if (!value("--name").isEmpty()) {
+        worker.setName(value("--name"));
+    }
+    worker.setExitOnDisconnect(arguments.contains("--exit-on-disconnect"));
+    worker.connectToCoordinator(address.left(colon), port);
+    return QCoreApplication::exec();
+}
@@ -0,0 +1,58 @@
+#ifndef CLUSTERWORKER_H
+#define CLUSTERWORKER_H
+
+#include <QObject>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <memory>
+
+class QTimer;
+class ClusterConnection;
+class UpscaleTask;
+
+// 分布式模式的工作节点：连接协调端，定时发送心跳，
+// 每次接收一个分片，用本机的默认后端放大后把结果传回（或写入共享存储）。
+// 命令行: qtRealSR_GUI --worker <主机:端口> [--name 名称] [--backend cli|cpu] [--realesrgan 路径]
+class ClusterWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ClusterWorker(QObject *parent = nullptr);
+
+    void setName(const QString &name) { m_name = name; }
+    // 与协调端断开后直接退出，本机测试时随协调端一起结束
+    void setExitOnDisconnect(bool exit) { m_exitOnDisconnect = exit; }
+    void connectToCoordinator(const QString &host, quint16 port);
+
+    static int runFromArguments(const QStringList &arguments);
+
+private:
+    void handleConnected();
+    void handleDisconnected();
+    void handleMessage(const QJsonObject &header, const QByteArray &payload);
+    void startShard(const QJsonObject &header, const QByteArray &payload);
+    void handleShardFinished(bool ok);
+    void finishShard(bool ok, const QString &error);
+    void sendHeartbeat();
+    void abortShard();
+
+    QString m_name;
+    QString m_host;
+    quint16 m_port = 0;
+    bool m_exitOnDisconnect = false;
+
+    ClusterConnection *m_connection = nullptr;
+    QTimer *m_heartbeatTimer;
+    QTimer *m_reconnectTimer;
+
+    // 当前分片
+    int m_shardId = -1;
+    QJsonObject m_shardHeader;
+    std::unique_ptr<QTemporaryDir> m_shardDir;
+    UpscaleTask *m_task = nullptr;
+    double m_taskPercent = 0;
+};
+
+#endif // CLUSTERWORKER_H
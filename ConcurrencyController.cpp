@@ -0,0 +1,271 @@
+#include "ConcurrencyController.h"
+#include <QDebug>
+#include <QFile>
+#include <QTime>
+#include <QTimer>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+const int kDefaultWindowMs = 15000;
+// 增加并发后吞吐至少提高这么多才保留；减少并发后吞吐不低于这个比例就保留
+const double kIncreaseGain = 1.05;
+const double kDecreaseTolerance = 0.97;
+// 可用内存低于该比例时按比例减少并发
+const double kMemoryPressure = 0.10;
+const double kCpuSaturated = 0.95;
+// 试探失败后隔多少个满载窗口再试
+const int kCooldownWindows = 6;
+// 试探后等不到满载窗口就放弃
+const int kMaxWaitWindows = 3;
+const int kMaxDecisions = 50;
+}
+
+ConcurrencyController::ConcurrencyController(const QString &name, int minimum, int maximum, QObject *parent)
+    : QObject(parent), m_name(name), m_minimum(qMax(1, minimum)), m_maximum(qMax(m_minimum, maximum)),
+      m_limit(m_maximum), m_timer(new QTimer(this))
+{
+    connect(m_timer, &QTimer::timeout, this, &ConcurrencyController::evaluate);
+    m_timer->start(kDefaultWindowMs);
+    m_window.start();
+    sampleCpuBusy();
+}
+
+void ConcurrencyController::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_probeFrom = 0;
+    if (enabled) {
+        QMutexLocker locker(&m_mutex);
+        m_work = 0;
+        m_minDemand = m_demand;
+        m_window.restart();
+    }
+}
+
+void ConcurrencyController::setBounds(int minimum, int maximum)
+{
+    m_minimum = qMax(1, minimum);
+    m_maximum = qMax(m_minimum, maximum);
+    m_probeFrom = 0;
+    int bounded = qBound(m_minimum, m_limit, m_maximum);
+    if (bounded != m_limit) {
+        m_limit = bounded;
+        emit limitChanged(m_limit);
+    }
+}
+
+void ConcurrencyController::setWindowMs(int windowMs)
+{
+    m_timer->start(qMax(1000, windowMs));
+}
+
+void ConcurrencyController::addWork(double units)
+{
+    QMutexLocker locker(&m_mutex);
+    m_work += units;
+}
+
+void ConcurrencyController::setDemand(int demand)
+{
+    QMutexLocker locker(&m_mutex);
+    m_demand = demand;
+    m_minDemand = qMin(m_minDemand, demand);
+}
+
+QStringList ConcurrencyController::decisions() const
+{
+    return m_decisions;
+}
+
+QString ConcurrencyController::summary() const
+{
+    return QString("自适应并发（%1）：当前 %2，共调整 %3 次").arg(m_name).arg(m_limit).arg(m_changes);
+}
+
+void ConcurrencyController::evaluate()
+{
+    double units;
+    int minDemand;
+    int demand;
+    qint64 elapsed;
+    {
+        QMutexLocker locker(&m_mutex);
+        units = m_work;
+        m_work = 0;
+        minDemand = m_minDemand;
+        demand = m_demand;
+        m_minDemand = m_demand;
+        elapsed = m_window.restart();
+    }
+    double cpu = sampleCpuBusy();
+    if (!m_enabled || elapsed <= 0) {
+        return;
+    }
+
+    double rate = units * 1000.0 / elapsed;
+    double memory = availableMemoryRatio();
+
+    // 内存紧张时不等满载窗口，直接按比例减少
+    if (memory >= 0 && memory < kMemoryPressure && m_limit > m_minimum) {
+        m_probeFrom = 0;
+        m_direction = 1;
+        m_cooldown = kCooldownWindows;
+        changeLimit(qMax(m_minimum, qMin(m_limit - 1, m_limit * 3 / 4)),
+                    QString("可用内存仅剩 %1%").arg(memory * 100, 0, 'f', 0), rate);
+        return;
+    }
+
+    if (m_settleWindows > 0) {
+        --m_settleWindows;
+        return;
+    }
+
+    // 没有占满全部槽位的窗口说明不了并发数的影响
+    if (units <= 0 || minDemand < m_limit) {
+        if (m_probeFrom > 0 && ++m_waitedWindows >= kMaxWaitWindows) {
+            int from = m_probeFrom;
+            m_probeFrom = 0;
+            m_cooldown = kCooldownWindows;
+            changeLimit(from, "需求不足以验证试探结果，退回", rate);
+        }
+        return;
+    }
+    m_lastRate = rate;
+
+    if (m_probeFrom > 0) {
+        int from = m_probeFrom;
+        bool increased = m_limit > from;
+        bool better = increased ? rate >= m_rateBefore * kIncreaseGain : rate >= m_rateBefore * kDecreaseTolerance;
+        m_probeFrom = 0;
+        if (better) {
+            // 保留，稍后继续同方向试探
+            m_cooldown = 1;
+            qInfo().noquote() << QString("%1 并发保持 %2：吞吐 %3 → %4/秒")
+                                     .arg(m_name).arg(m_limit)
+                                     .arg(m_rateBefore, 0, 'f', 2).arg(rate, 0, 'f', 2);
+            return;
+        }
+        m_direction = increased ? -1 : 1;
+        m_cooldown = kCooldownWindows;
+        changeLimit(from, QString("试探后吞吐 %1 → %2/秒，退回").arg(m_rateBefore, 0, 'f', 2).arg(rate, 0, 'f', 2), rate);
+        return;
+    }
+
+    if (m_cooldown > 0) {
+        --m_cooldown;
+        return;
+    }
+
+    // CPU 已经跑满时先试着减少并发，吞吐不降就省下资源
+    int direction = cpu > kCpuSaturated ? -1 : m_direction;
+    int target = m_limit + direction;
+    if (target > m_maximum || target < m_minimum || (direction > 0 && demand <= m_limit)) {
+        direction = -direction;
+        target = m_limit + direction;
+    }
+    if (target > m_maximum || target < m_minimum || (direction > 0 && demand <= m_limit)) {
+        return;
+    }
+
+    m_probeFrom = m_limit;
+    m_rateBefore = rate;
+    m_waitedWindows = 0;
+    changeLimit(target, QString("试探%1（CPU %2%）").arg(direction > 0 ? "增加" : "减少").arg(cpu * 100, 0, 'f', 0),
+                rate);
+}
+
+void ConcurrencyController::changeLimit(int limit, const QString &reason, double rate)
+{
+    if (limit == m_limit) {
+        return;
+    }
+
+    int previous = m_limit;
+    m_limit = limit;
+    m_settleWindows = 1;
+    ++m_changes;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_minDemand = m_demand;
+    }
+
+    QString message = QString("%1 并发 %2 → %3：%4，当前吞吐 %5/秒")
+                          .arg(m_name).arg(previous).arg(limit).arg(reason).arg(rate, 0, 'f', 2);
+    m_decisions << QTime::currentTime().toString("HH:mm:ss ") + message;
+    while (m_decisions.size() > kMaxDecisions) {
+        m_decisions.removeFirst();
+    }
+    qInfo().noquote() << message;
+    emit limitChanged(limit);
+    emit decisionMade(message);
+}
+
+double ConcurrencyController::sampleCpuBusy()
+{
+    // 与上次采样之间整机 CPU 的忙碌比例，取不到时返回 0
+    quint64 busy = 0;
+    quint64 total = 0;
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/stat");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = file.readLine().simplified().split(' ');
+    // cpu user nice system idle iowait irq softirq steal
+    for (int i = 1; i < fields.size() && i <= 8; ++i) {
+        quint64 value = fields.at(i).toULongLong();
+        total += value;
+        if (i != 4 && i != 5) {
+            busy += value;
+        }
+    }
+#elif defined(Q_OS_WIN)
+    FILETIME idle, kernel, user;
+    if (!GetSystemTimes(&idle, &kernel, &user)) {
+        return 0;
+    }
+    auto value = [](const FILETIME &time) {
+        return (quint64(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    // 内核时间包含空闲时间
+    total = value(kernel) + value(user);
+    busy = total - value(idle);
+#endif
+    double ratio = total > m_cpuTotal ? double(busy - m_cpuBusy) / double(total - m_cpuTotal) : 0;
+    m_cpuBusy = busy;
+    m_cpuTotal = total;
+    return qBound(0.0, ratio, 1.0);
+}
+
+double ConcurrencyController::availableMemoryRatio()
+{
+    // 可用内存占总内存的比例，取不到时返回 -1
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/meminfo");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    double total = 0;
+    double available = -1;
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        if (line.startsWith("MemTotal:")) {
+            total = line.mid(9).trimmed().split(' ').first().toDouble();
+        } else if (line.startsWith("MemAvailable:")) {
+            available = line.mid(13).trimmed().split(' ').first().toDouble();
+        }
+    }
+    return total > 0 && available >= 0 ? available / total : -1;
+#elif defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status) || status.ullTotalPhys == 0) {
+        return -1;
+    }
+    return double(status.ullAvailPhys) / double(status.ullTotalPhys);
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,74 @@
+#ifndef CONCURRENCYCONTROLLER_H
+#define CONCURRENCYCONTROLLER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QStringList>
+
+class QTimer;
+
+// 按实测吞吐自动调整并发槽位数的反馈控制器。
+// 每个采样窗口统计完成的工作量（例如百万像素），只用槽位全部占满的窗口做比较：
+// 每次试探把并发加一或减一，下个窗口吞吐变好就保留并继续同方向试探，否则退回并换方向、隔一段时间再试；
+// 内存紧张时按比例减少并发，CPU 已满时优先试探减少。每次调整都记录原因
+class ConcurrencyController : public QObject
+{
+    Q_OBJECT
+
+public:
+    ConcurrencyController(const QString &name, int minimum, int maximum, QObject *parent = nullptr);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+    // 超出新范围时立即调整到边界
+    void setBounds(int minimum, int maximum);
+    void setWindowMs(int windowMs);
+    int limit() const { return m_limit; }
+
+    // 以下可在任意线程调用
+    void addWork(double units);
+    // 当前可以同时运行的工作数（运行中 + 等待中），小于并发上限时窗口不参与比较
+    void setDemand(int demand);
+
+    // 最近的调整记录，每条一行
+    QStringList decisions() const;
+    QString summary() const;
+
+signals:
+    void limitChanged(int limit);
+    void decisionMade(const QString &message);
+
+private:
+    void evaluate();
+    void changeLimit(int limit, const QString &reason, double rate);
+    double sampleCpuBusy();
+    static double availableMemoryRatio();
+
+    QString m_name;
+    int m_minimum;
+    int m_maximum;
+    int m_limit;
+    bool m_enabled = true;
+    QTimer *m_timer;
+
+    mutable QMutex m_mutex;
+    double m_work = 0;
+    int m_demand = 0;
+    int m_minDemand = 0; // 本窗口内的最小需求
+    QElapsedTimer m_window;
+
+    int m_direction = 1;     // 下次试探的方向
+    int m_probeFrom = 0;     // 正在试探时为试探前的并发数
+    double m_rateBefore = 0; // 试探前的吞吐
+    double m_lastRate = 0;
+    int m_settleWindows = 0; // 调整后先跳过的窗口数
+    int m_cooldown = 0;      // 距下次试探还需的有效窗口数
+    int m_waitedWindows = 0; // 试探后等待满载窗口的次数
+    int m_changes = 0;
+    QStringList m_decisions;
+    quint64 m_cpuBusy = 0;
+    quint64 m_cpuTotal = 0;
+};
+
+#endif // CONCURRENCYCONTROLLER_H
@@ -0,0 +1,179 @@
+#include "CropDetector.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include <QRegularExpression>
+#include <QtMath>
+#include <QDebug>
+
+namespace {
+// 每个采样点分析的帧数
+const int kFramesPerSample = 24;
+// 有效样本与一致样本的最低比例
+const double kMinAgreement = 0.6;
+// 两个样本的边界差异在该比例内视为一致
+const double kEdgeTolerance = 0.02;
+// 活动区域超过该比例时不值得裁剪
+const double kMinSavedFraction = 0.02;
+}
+
+CropDetector::CropDetector(QObject *parent) : QObject(parent)
+{
+#ifdef Q_OS_WIN
+    m_ffmpegPath = "ffmpeg.exe";
+#else
+    m_ffmpegPath = "ffmpeg";
+#endif
+}
+
+void CropDetector::setFfmpegPath(const QString &ffmpegPath)
+{
+    m_ffmpegPath = ffmpegPath;
+}
+
+void CropDetector::detect(const QString &inputPath, const QSize &frameSize, double durationSec,
+                          int sampleCount)
+{
+    m_inputPath = inputPath;
+    m_frameSize = frameSize;
+    m_samples.clear();
+    m_sampleTimes.clear();
+
+    // 避开片头片尾，在中间均匀取样
+    for (int i = 0; i < sampleCount; ++i) {
+        m_sampleTimes << durationSec * (i + 1) / (sampleCount + 1);
+    }
+
+    startNextSample();
+}
+
+void CropDetector::cancel()
+{
+    m_sampleTimes.clear();
+    ProcessSupervisor::stop(m_process);
+}
+
+void CropDetector::startNextSample()
+{
+    if (m_sampleTimes.isEmpty()) {
+        evaluate();
+        return;
+    }
+
+    if (m_process) {
+        m_process->deleteLater();
+    }
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &CropDetector::handleSampleFinished);
+
+    QStringList args;
+    args << "-hide_banner"
+         << "-ss" << QString::number(m_sampleTimes.takeFirst(), 'f', 3)
+         << "-i" << m_inputPath
+         << "-frames:v" << QString::number(kFramesPerSample)
+         << "-vf" << "cropdetect=limit=24:round=2:reset=0"
+         << "-an"
+         << "-f" << "null" << "-";
+
+    ProcessLauncher::start(m_process, m_ffmpegPath, args, ProcessLauncher::Utility);
+}
+
+void CropDetector::handleSampleFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus)
+
+    if (exitCode == 0) {
+        // reset=0 时最后一行是整个采样段的累计结果
+        QString output = ProcessSupervisor::attach(m_process)->tail();
+        static const QRegularExpression cropRegex(R"(crop=(-?\d+):(-?\d+):(-?\d+):(-?\d+))");
+        QRegularExpressionMatchIterator it = cropRegex.globalMatch(output);
+        QRect rect;
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            rect = QRect(match.captured(3).toInt(), match.captured(4).toInt(),
+                         match.captured(1).toInt(), match.captured(2).toInt());
+        }
+        m_samples << rect;
+    } else {
+        m_samples << QRect();
+    }
+
+    startNextSample();
+}
+
+void CropDetector::evaluate()
+{
+    QRect frame(QPoint(0, 0), m_frameSize);
+
+    // 全黑或淡入淡出的采样会给出极小的区域，视为无效
+    QList<QRect> valid;
+    for (const QRect &rect : m_samples) {
+        if (rect.width() >= frame.width() / 10 && rect.height() >= frame.height() / 10) {
+            valid << (rect & frame);
+        }
+    }
+
+    int required = qCeil(m_samples.size() * kMinAgreement);
+    if (valid.isEmpty() || valid.size() < required) {
+        emit finished(QRect(), "黑边检测：有效采样不足，跳过裁剪");
+        return;
+    }
+
+    int toleranceX = qMax(4, qRound(frame.width() * kEdgeTolerance));
+    int toleranceY = qMax(4, qRound(frame.height() * kEdgeTolerance));
+    auto agrees = [toleranceX, toleranceY](const QRect &a, const QRect &b) {
+        return qAbs(a.left() - b.left()) <= toleranceX && qAbs(a.right() - b.right()) <= toleranceX
+               && qAbs(a.top() - b.top()) <= toleranceY && qAbs(a.bottom() - b.bottom()) <= toleranceY;
+    };
+
+    // 找到与最多样本一致的参考区域
+    int bestAgreement = 0;
+    QRect reference;
+    for (const QRect &candidate : valid) {
+        int count = 0;
+        for (const QRect &other : valid) {
+            if (agrees(candidate, other)) {
+                ++count;
+            }
+        }
+        if (count > bestAgreement) {
+            bestAgreement = count;
+            reference = candidate;
+        }
+    }
+
+    if (bestAgreement < qCeil(valid.size() * kMinAgreement)) {
+        emit finished(QRect(), "黑边检测：各采样点结果不一致，跳过裁剪");
+        return;
+    }
+
+    // 取一致样本的并集，宁可少裁也不能裁掉画面
+    QRect active;
+    for (const QRect &rect : valid) {
+        if (agrees(reference, rect)) {
+            active = active.isNull() ? rect : active.united(rect);
+        }
+    }
+
+    // 对齐到偶数，方便后续 yuv420p 编码
+    int left = active.left() & ~1;
+    int top = active.top() & ~1;
+    int right = qMin(frame.width(), (active.right() + 2) & ~1);
+    int bottom = qMin(frame.height(), (active.bottom() + 2) & ~1);
+    active = QRect(left, top, right - left, bottom - top);
+
+    double saved = 1.0 - double(active.width()) * active.height()
+                             / (double(frame.width()) * frame.height());
+    if (saved < kMinSavedFraction) {
+        emit finished(QRect(), "黑边检测：未发现黑边");
+        return;
+    }
+
+    qDebug() << "Crop detected:" << active << "samples:" << m_samples;
+    emit finished(active, QString("黑边检测：有效区域 %1x%2+%3+%4，节省 %5% 像素")
+                              .arg(active.width()).arg(active.height())
+                              .arg(active.x()).arg(active.y())
+                              .arg(saved * 100.0, 0, 'f', 1));
+}
@@ -0,0 +1,41 @@
+#ifndef CROPDETECTOR_H
+#define CROPDETECTOR_H
+
+#include <QObject>
+#include <QProcess>
+#include <QRect>
+#include <QList>
+
+// 在视频多个时间点上运行 ffmpeg cropdetect，检测稳定的黑边区域
+class CropDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CropDetector(QObject *parent = nullptr);
+
+    void setFfmpegPath(const QString &ffmpegPath);
+    void detect(const QString &inputPath, const QSize &frameSize, double durationSec,
+                int sampleCount = 8);
+    void cancel();
+
+signals:
+    // activeRect 为空表示不需要裁剪
+    void finished(const QRect &activeRect, const QString &message);
+
+private slots:
+    void handleSampleFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    void startNextSample();
+    void evaluate();
+
+    QString m_ffmpegPath;
+    QString m_inputPath;
+    QSize m_frameSize;
+    QList<double> m_sampleTimes;
+    QList<QRect> m_samples;
+    QProcess *m_process = nullptr;
+};
+
+#endif // CROPDETECTOR_H
@@ -0,0 +1,194 @@
+#include "FolderScanner.h"
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+// 每批最多送回的文件数和最长间隔：既不让模型频繁插入，也能尽快看到结果
+const int kBatchSize = 2000;
+const int kFlushIntervalMs = 200;
+
+QString normalizedSuffix(const QString &suffix)
+{
+    QString lower = suffix.toLower();
+    return lower == "jpeg" ? QString("jpg") : lower;
+}
+}
+
+FolderScanner::FolderScanner(QObject *parent) : QObject(parent)
+{
+    // 扫描主要受磁盘限制，一个线程按顺序遍历即可
+    m_pool.setMaxThreadCount(1);
+}
+
+FolderScanner::~FolderScanner()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void FolderScanner::start(const QStringList &paths, const Filter &filter)
+{
+    // 换成新扫描时旧扫描的结果一并作废，不单独报告停止
+    if (m_cancelled) {
+        *m_cancelled = true;
+    }
+    m_scanned = 0;
+    m_accepted = 0;
+
+    m_cancelled = std::make_shared<std::atomic<bool>>(false);
+    m_running = true;
+    int generation = ++m_generation;
+    std::shared_ptr<std::atomic<bool>> cancelled = m_cancelled;
+
+    Filter normalized = filter;
+    normalized.suffixes.clear();
+    for (const QString &suffix : filter.suffixes) {
+        normalized.suffixes << normalizedSuffix(suffix.trimmed().remove('.'));
+    }
+
+    m_pool.start([this, generation, paths, normalized, cancelled]() {
+        run(generation, paths, normalized, cancelled);
+    });
+}
+
+void FolderScanner::cancel()
+{
+    if (m_cancelled) {
+        *m_cancelled = true;
+    }
+    // 已排队但尚未送达的结果随代数变化作废，取消之后不会再有文件加入
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished(m_scanned, m_accepted, true);
+    }
+}
+
+QByteArray FolderScanner::sniffFormat(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QByteArray header = file.read(12);
+
+    if (header.startsWith("\x89PNG\r\n\x1a\n")) {
+        return "png";
+    }
+    if (header.startsWith("\xff\xd8\xff")) {
+        return "jpg";
+    }
+    if (header.size() >= 12 && header.startsWith("RIFF") && header.mid(8, 4) == "WEBP") {
+        return "webp";
+    }
+    if (header.startsWith("BM")) {
+        return "bmp";
+    }
+    return QByteArray();
+}
+
+void FolderScanner::run(int generation, const QStringList &paths, const Filter &filter,
+                        std::shared_ptr<std::atomic<bool>> cancelled)
+{
+    int scanned = 0;
+    int accepted = 0;
+    QStringList batch;
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+
+    auto flush = [&]() {
+        std::sort(batch.begin(), batch.end());
+        QStringList found = batch;
+        batch.clear();
+        flushTimer.restart();
+        int scannedNow = scanned;
+        int acceptedNow = accepted;
+        QMetaObject::invokeMethod(this, [this, generation, found, scannedNow, acceptedNow]() {
+            if (generation != m_generation) {
+                return;
+            }
+            m_scanned = scannedNow;
+            m_accepted = acceptedNow;
+            if (!found.isEmpty()) {
+                emit filesFound(found);
+            }
+            emit progress(scannedNow, acceptedNow);
+        }, Qt::QueuedConnection);
+    };
+
+    auto consider = [&](const QFileInfo &info) {
+        ++scanned;
+        // 先做不需要打开文件的检查，目录项里已经带有大小
+        if (!filter.suffixes.isEmpty() && !filter.suffixes.contains(normalizedSuffix(info.suffix()))) {
+            return;
+        }
+        if (info.size() < filter.minBytes || (filter.maxBytes > 0 && info.size() > filter.maxBytes)) {
+            return;
+        }
+
+        QString path = info.absoluteFilePath();
+        QByteArray format = sniffFormat(path);
+        if (format.isEmpty()) {
+            return;
+        }
+
+        if (filter.minSide > 0 || filter.maxSide > 0) {
+            // 只解析文件头得到尺寸
+            QImageReader reader(path, format);
+            QSize size = reader.size();
+            if (!size.isValid()
+                || qMin(size.width(), size.height()) < filter.minSide
+                || (filter.maxSide > 0 && qMax(size.width(), size.height()) > filter.maxSide)) {
+                return;
+            }
+        }
+
+        batch << path;
+        ++accepted;
+    };
+
+    for (const QString &path : paths) {
+        if (*cancelled) {
+            break;
+        }
+
+        QFileInfo info(path);
+        if (info.isDir()) {
+            // 不跟随符号链接，避免目录环
+            QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while (!*cancelled && it.hasNext()) {
+                it.next();
+                consider(it.fileInfo());
+                if (batch.size() >= kBatchSize || flushTimer.elapsed() >= kFlushIntervalMs) {
+                    flush();
+                }
+            }
+        } else if (info.isFile()) {
+            consider(info);
+            if (batch.size() >= kBatchSize || flushTimer.elapsed() >= kFlushIntervalMs) {
+                flush();
+            }
+        }
+    }
+    if (!*cancelled) {
+        flush();
+    }
+
+    bool wasCancelled = *cancelled;
+    qDebug().noquote() << QString("Folder scan %1: %2 scanned, %3 accepted")
+                              .arg(wasCancelled ? "cancelled" : "finished")
+                              .arg(scanned)
+                              .arg(accepted);
+    QMetaObject::invokeMethod(this, [this, generation, scanned, accepted, wasCancelled]() {
+        if (generation != m_generation) {
+            return;
+        }
+        m_running = false;
+        emit finished(scanned, accepted, wasCancelled);
+    }, Qt::QueuedConnection);
+}
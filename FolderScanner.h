@@ -0,0 +1,55 @@
+#ifndef FOLDERSCANNER_H
+#define FOLDERSCANNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+// 在后台线程递归扫描拖入或选择的文件和文件夹。按文件头识别图片格式而不是只看扩展名，
+// 扩展名、文件大小和分辨率过滤也都在扫描线程完成，结果分批送回界面线程，
+// 几万个文件的目录也不会卡住窗口
+class FolderScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Filter {
+        QStringList suffixes; // 为空时不限扩展名，jpg 与 jpeg 视为相同
+        qint64 minBytes = 0;
+        qint64 maxBytes = 0;  // 0 为不限
+        int minSide = 0;      // 短边下限，0 为不限（需要读取文件头）
+        int maxSide = 0;      // 长边上限，0 为不限
+    };
+
+    explicit FolderScanner(QObject *parent = nullptr);
+    ~FolderScanner();
+
+    // 开始新扫描时取消尚未结束的扫描
+    void start(const QStringList &paths, const Filter &filter);
+    // 立即发出 finished(cancelled = true)，之后不再发出本次扫描的任何结果
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    // 按文件头识别支持的图片格式，返回 png/jpg/bmp/webp，不支持时为空
+    static QByteArray sniffFormat(const QString &path);
+
+signals:
+    void filesFound(const QStringList &paths);
+    void progress(int scanned, int accepted);
+    void finished(int scanned, int accepted, bool cancelled);
+
+private:
+    void run(int generation, const QStringList &paths, const Filter &filter,
+             std::shared_ptr<std::atomic<bool>> cancelled);
+
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+    int m_generation = 0;
+    bool m_running = false;
+    int m_scanned = 0;  // 最近一次送达界面的进度
+    int m_accepted = 0;
+};
+
+#endif // FOLDERSCANNER_H
@@ -1,11 +1,41 @@
 #include "ImageProcessor.h"
+#include "ProgressAggregator.h"
+#include "UpscaleBackend.h"
+#include "ImageResampler.h"
+#include "PngWriter.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include "ScratchManager.h"
 #include <QFileInfo>
 #include <QDebug>
 #include <QDir>
+#include <QImage>
+#include <QImageReader>
+#include <QMap>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+// 图集只收单边不超过该值的小图
+const int kAtlasMaxSide = 256;
+// 大于 realesrgan 的分块预留边缘（10 像素），模型看不到相邻小图
+const int kAtlasGutter = 16;
+// 4 倍放大后为 4096x4096，内存和单次推理时间都可接受
+const int kAtlasSheetSide = 1024;
+// 同一模型的小图少于这个数量时不值得拼图
+const int kMinAtlasSprites = 4;
+// 区域四周送进模型的上下文，也是接缝的过渡带宽度；大于 realesrgan 的分块预留边缘
+const int kRegionMargin = 32;
+// 上下文合计超过整图的这个比例时整图放大更省事
+const double kMaxRegionCoverage = 0.6;
+}
 
 ImageProcessor::ImageProcessor(QObject *parent, bool noWindow)
-    : QObject(parent), m_noWindow(noWindow), m_currentProcess(nullptr)
+    : QObject(parent), m_noWindow(noWindow), m_currentTask(nullptr),
+      m_renditionWriter(new RenditionWriter(this))
 {
+    connect(m_renditionWriter, &RenditionWriter::finished, this, &ImageProcessor::handleRenditionsFinished);
+
 #ifdef Q_OS_WIN
     m_realESRGANExecutable = "realesrgan-ncnn-vulkan.exe";
     m_ffmpegExecutable = "ffmpeg.exe";
@@ -15,11 +45,67 @@ ImageProcessor::ImageProcessor(QObject *parent, bool noWindow)
 #endif
 }
 
+ImageProcessor::~ImageProcessor()
+{
+    m_workerPool.waitForDone();
+    ScratchManager::release(m_scratchDir);
+}
+
 void ImageProcessor::setNoWindow(bool noWindow)
 {
     m_noWindow = noWindow;
 }
 
+void ImageProcessor::setScaleTarget(const ScaleTarget &target, const QStringList &availableModels)
+{
+    m_scaleTarget = target;
+    m_availableModels = availableModels;
+}
+
+void ImageProcessor::setProgressAggregator(ProgressAggregator *aggregator)
+{
+    m_progress = aggregator;
+}
+
+void ImageProcessor::setPriority(PriorityScheduler::Priority priority)
+{
+    PriorityScheduler::setPriority(this, priority);
+}
+
+void ImageProcessor::setRenditions(const QList<RenditionSpec> &renditions)
+{
+    m_renditions = renditions;
+}
+
+void ImageProcessor::setAtlasMode(bool enabled)
+{
+    m_atlasMode = enabled;
+}
+
+void ImageProcessor::setRegions(const QHash<int, QList<QRect>> &regions)
+{
+    m_regions = regions;
+}
+
+QString ImageProcessor::atlasReport() const
+{
+    if (m_atlasItems == 0) {
+        return QString();
+    }
+
+    double perItemMs = double(m_atlasMs) / m_atlasItems;
+    QString report = QString("图集模式处理 %1 张小图（%2 张图集），平均每张 %3 秒")
+                         .arg(m_atlasItems)
+                         .arg(m_atlasSheets)
+                         .arg(perItemMs / 1000.0, 0, 'f', 3);
+    if (m_atlasBaselineMs > 0 && perItemMs > 0) {
+        report += QString("，逐个处理实测每张 %1 秒，约快 %2 倍")
+                      .arg(m_atlasBaselineMs / 1000.0, 0, 'f', 2)
+                      .arg(m_atlasBaselineMs / perItemMs, 0, 'f', 1);
+    }
+    return report;
+}
+
 void ImageProcessor::processImages(const QStringList &inputPaths,
                                    const QString &modelName,
                                    const QString &outputFormat,
@@ -34,14 +120,316 @@ void ImageProcessor::processImages(const QStringList &inputPaths,
     m_currentModelName = modelName;
     m_currentOutputFormat = outputFormat;
     m_openOutputDirectory = openOutputDirectory;
-    m_remainingInputPaths = inputPaths;
+    m_inputPaths = inputPaths;
+    m_remainingIndices.clear();
+    for (int i = 0; i < inputPaths.size(); ++i) {
+        m_remainingIndices << i;
+    }
+    m_currentIndex = -1;
+    m_alphaSavedMs = 0;
+    m_atlasJobs.clear();
+    m_atlasBaselineIndex = -1;
+    m_atlasBaselineMs = 0;
+    m_atlasMs = 0;
+    m_atlasItems = 0;
+    m_atlasSheets = 0;
+
+    // 单张图片的中间文件不大，大小未知时放在普通临时目录
+    ScratchManager::release(m_scratchDir);
+    QString error;
+    m_scratchDir = ScratchManager::allocate("images", 0, &error);
+    if (m_scratchDir.isEmpty()) {
+        emit errorOccurred(error);
+        return;
+    }
+
+    if (PriorityScheduler::priorityOf(this) == PriorityScheduler::Interactive) {
+        PriorityScheduler::beginInteractive(this);
+    }
+
+    // 多规格输出每张都要单独缩放，不走图集
+    if (m_atlasMode && m_renditions.isEmpty()) {
+        // 成千上万张小图逐个读取文件头也要不少时间，放到线程池里做完再规划
+        QStringList paths;
+        QList<int> indices;
+        for (int index : m_remainingIndices) {
+            if (!m_regions.contains(index)) {
+                paths << m_inputPaths.at(index);
+                indices << index;
+            }
+        }
+        emit progressUpdate(0, "正在读取图片尺寸...");
+        m_workerPool.start([this, paths, indices]() {
+            QHash<int, QSize> sizes;
+            for (int i = 0; i < paths.size(); ++i) {
+                QSize size = QImageReader(paths.at(i)).size();
+                if (size.isValid() && qMax(size.width(), size.height()) <= kAtlasMaxSide) {
+                    sizes.insert(indices.at(i), size);
+                }
+            }
+            QMetaObject::invokeMethod(this, [this, sizes]() {
+                planAtlasJobs(sizes);
+                processNextImage();
+            }, Qt::QueuedConnection);
+        });
+        return;
+    }
+
+    processNextImage();
+}
+
+void ImageProcessor::planAtlasJobs(const QHash<int, QSize> &sizes)
+{
+    // 只有一遍原生倍率放大、不需要预缩放和最终重采样的小图才能拼进图集，按模型和倍率分组
+    ScalePlanner planner(m_availableModels);
+    QMap<QString, QList<int>> groups;
+    QHash<QString, ScalePass> groupPasses;
+    for (int index : m_remainingIndices) {
+        if (!sizes.contains(index)) {
+            continue;
+        }
+        QSize size = sizes.value(index);
+
+        ScalePlan plan = planner.plan(size, m_scaleTarget, m_currentModelName);
+        ScalePass pass{m_currentModelName, ScalePlanner::nativeScale(m_currentModelName)};
+        if (plan.valid) {
+            if (plan.passes.size() != 1 || plan.needsPreScale() || plan.needsFinalResample()) {
+                continue;
+            }
+            pass = plan.passes.first();
+        }
+
+        QString key = QString("%1:%2").arg(pass.modelName).arg(pass.scale);
+        groups[key] << index;
+        groupPasses.insert(key, pass);
+    }
+
+    QSet<int> atlased;
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        QList<int> indices = it.value();
+        if (indices.size() < kMinAtlasSprites) {
+            continue;
+        }
+        if (m_atlasBaselineIndex < 0) {
+            m_atlasBaselineIndex = indices.takeFirst();
+        }
+
+        QList<QSize> spriteSizes;
+        for (int index : indices) {
+            spriteSizes << sizes.value(index);
+            atlased.insert(index);
+        }
+        const ScalePass &pass = groupPasses.value(it.key());
+        for (const SpriteAtlas::Sheet &sheet : SpriteAtlas::pack(spriteSizes, kAtlasGutter, kAtlasSheetSide)) {
+            AtlasJob job;
+            job.sheet = sheet;
+            job.indices = indices;
+            job.modelName = pass.modelName;
+            job.scale = pass.scale;
+            m_atlasJobs << job;
+        }
+    }
+
+    if (m_atlasJobs.isEmpty()) {
+        return;
+    }
 
+    // 对照的那张排在最前面按原流程处理，其余不进图集的文件在图集之后处理
+    QList<int> remaining{m_atlasBaselineIndex};
+    for (int index : m_remainingIndices) {
+        if (index != m_atlasBaselineIndex && !atlased.contains(index)) {
+            remaining << index;
+        }
+    }
+    m_remainingIndices = remaining;
+    qDebug() << "Atlas mode:" << atlased.size() << "sprites in" << m_atlasJobs.size() << "sheets,"
+             << m_remainingIndices.size() << "files processed individually";
+}
+
+void ImageProcessor::startAtlasJob()
+{
+    m_currentAtlas = m_atlasJobs.takeFirst();
+    m_atlasTimer.start();
+
+    QStringList paths;
+    for (int index : m_currentAtlas.indices) {
+        paths << m_inputPaths.at(index);
+    }
+    for (const SpriteAtlas::Placement &placement : m_currentAtlas.sheet.placements) {
+        int index = m_currentAtlas.indices.at(placement.item);
+        emit itemStarted(index);
+        if (m_progress) {
+            m_progress->report(index, 0, QString("正在处理图集 %1").arg(m_atlasSheets + 1));
+        }
+    }
+
+    // 读取小图和拼图都在线程池里完成
+    QString sheetPath = QDir(m_scratchDir).filePath(QString("atlas_%1.png").arg(m_atlasSheets));
+    QString format = m_currentOutputFormat.toLower();
+    bool keepAlpha = format != "jpg" && format != "jpeg";
+    SpriteAtlas::Sheet sheet = m_currentAtlas.sheet;
+    m_workerPool.start([this, sheet, paths, sheetPath, keepAlpha]() {
+        SpriteAtlas::Composed composed = SpriteAtlas::compose(sheet, paths, kAtlasGutter, keepAlpha);
+        bool ok = !composed.sheet.isNull() && PngWriter::write(composed.sheet, sheetPath, PngWriter::Intermediate);
+        composed.sheet = QImage();
+        QMetaObject::invokeMethod(this, [this, composed, sheetPath, ok]() {
+            handleAtlasComposed(composed, sheetPath, ok);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageProcessor::handleAtlasComposed(const SpriteAtlas::Composed &composed, const QString &sheetPath, bool ok)
+{
+    QList<int> indices;
+    for (const SpriteAtlas::Placement &placement : m_currentAtlas.sheet.placements) {
+        indices << m_currentAtlas.indices.at(placement.item);
+    }
+    if (!ok) {
+        qWarning() << "Failed to compose atlas, processing sprites one by one";
+        QFile::remove(sheetPath);
+        fallBackToPerFile(indices);
+        processNextImage();
+        return;
+    }
+
+    // 读取失败的小图留给原流程报告具体错误
+    if (!composed.failed.isEmpty()) {
+        QList<int> failed;
+        QList<SpriteAtlas::Placement> kept;
+        for (const SpriteAtlas::Placement &placement : m_currentAtlas.sheet.placements) {
+            if (composed.failed.contains(placement.item)) {
+                failed << m_currentAtlas.indices.at(placement.item);
+            } else {
+                kept << placement;
+            }
+        }
+        m_currentAtlas.sheet.placements = kept;
+        fallBackToPerFile(failed);
+    }
+    m_atlasAlphas = composed.alphas;
+    m_atlasSheetPath = sheetPath;
+
+    if (m_currentTask) {
+        m_currentTask->deleteLater();
+    }
+
+    UpscaleRequest request;
+    request.inputPath = sheetPath;
+    request.outputPath = QDir(m_scratchDir).filePath(QString("atlas_%1_out.png").arg(m_atlasSheets));
+    request.modelName = m_currentAtlas.modelName;
+    request.scale = m_currentAtlas.scale;
+    request.executablePath = m_realESRGANExecutable;
+
+    m_currentTask = UpscaleBackend::defaultBackend()->createTask(request, this);
+    connect(m_currentTask, &UpscaleTask::progress, this, [this](double progress) {
+        emit progressUpdate(static_cast<int>(progress), QString("正在处理图集 %1...").arg(m_atlasSheets + 1));
+    });
+    connect(m_currentTask, &UpscaleTask::finished, this, &ImageProcessor::handleAtlasUpscaled);
+    m_currentTask->start();
+}
+
+void ImageProcessor::handleAtlasUpscaled(bool ok)
+{
+    QFile::remove(m_atlasSheetPath);
+    QString upscaledPath = m_currentTask->request().outputPath;
+
+    QList<int> indices;
+    QHash<int, QString> outputs;
+    QString format = m_currentOutputFormat.toLower();
+    for (const SpriteAtlas::Placement &placement : m_currentAtlas.sheet.placements) {
+        int index = m_currentAtlas.indices.at(placement.item);
+        indices << index;
+        QFileInfo inputInfo(m_inputPaths.at(index));
+        outputs.insert(index, QDir(inputInfo.absolutePath()).filePath(inputInfo.completeBaseName() + "-ENLARGE." + format));
+    }
+
+    if (!ok) {
+        qWarning() << "Atlas upscale failed, processing sprites one by one:" << m_currentTask->errorString();
+        QFile::remove(upscaledPath);
+        fallBackToPerFile(indices);
+        processNextImage();
+        return;
+    }
+
+    // 切图、合成透明度和编码都在线程池里完成，先写到输出目录的隐藏名再改名
+    SpriteAtlas::Sheet sheet = m_currentAtlas.sheet;
+    QList<int> itemIndices = m_currentAtlas.indices;
+    QHash<int, QImage> alphas = m_atlasAlphas;
+    m_atlasAlphas.clear();
+    int scale = m_currentAtlas.scale;
+    m_workerPool.start([this, sheet, itemIndices, alphas, scale, upscaledPath, outputs, format]() {
+        QImage upscaled(upscaledPath);
+        QFile::remove(upscaledPath);
+
+        QList<QPair<int, QString>> written;
+        QList<int> failed;
+        for (const SpriteAtlas::Placement &placement : sheet.placements) {
+            int index = itemIndices.at(placement.item);
+            QImage piece = upscaled.isNull()
+                               ? QImage()
+                               : SpriteAtlas::cut(upscaled, placement.rect, scale, alphas.value(placement.item));
+            QString finalOutput = outputs.value(index);
+            QString staging = ScratchManager::stagingPath(finalOutput);
+            bool saved = false;
+            if (!piece.isNull()) {
+                saved = format == "png"
+                            ? PngWriter::write(piece, staging, PngWriter::Deliverable)
+                            : piece.save(staging, format == "webp" ? "WEBP" : "JPG", format == "webp" ? 90 : 95);
+            }
+            if (saved && ScratchManager::moveToFinal(staging, finalOutput)) {
+                written << qMakePair(index, finalOutput);
+            } else {
+                QFile::remove(staging);
+                failed << index;
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, written, failed]() {
+            handleAtlasWritten(written, failed);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageProcessor::handleAtlasWritten(const QList<QPair<int, QString>> &written, const QList<int> &failed)
+{
+    for (const auto &item : written) {
+        m_currentIndex = item.first;
+        finishCurrentItem(item.second);
+    }
+    m_atlasMs += m_atlasTimer.elapsed();
+    m_atlasItems += written.size();
+    ++m_atlasSheets;
+
+    if (!failed.isEmpty()) {
+        qWarning() << "Failed to write" << failed.size() << "atlas sprites, processing them one by one";
+        fallBackToPerFile(failed);
+    }
     processNextImage();
 }
 
+void ImageProcessor::fallBackToPerFile(const QList<int> &indices)
+{
+    // 插到队首，紧接着按原流程逐个处理
+    for (int i = indices.size() - 1; i >= 0; --i) {
+        if (m_progress) {
+            m_progress->removeWorker(indices.at(i));
+        }
+        m_remainingIndices.prepend(indices.at(i));
+    }
+}
+
 void ImageProcessor::processNextImage()
 {
-    if (m_remainingInputPaths.isEmpty()) {
+    // 对照图处理完后再处理图集
+    if (!m_atlasJobs.isEmpty() && m_atlasBaselineIndex < 0) {
+        startAtlasJob();
+        return;
+    }
+
+    if (m_remainingIndices.isEmpty()) {
+        ScratchManager::release(m_scratchDir);
+        m_scratchDir.clear();
+        PriorityScheduler::endInteractive(this);
         emit processingFinished(m_outputFiles);
         if (m_openOutputDirectory && !m_outputFiles.isEmpty()) {
             QFileInfo fileInfo(m_outputFiles.first());
@@ -50,100 +438,500 @@ void ImageProcessor::processNextImage()
         return;
     }
 
-    QString inputPath = m_remainingInputPaths.takeFirst();
+    m_currentIndex = m_remainingIndices.takeFirst();
+    QString inputPath = m_inputPaths.at(m_currentIndex);
+    m_itemTimer.start();
+    emit itemStarted(m_currentIndex);
+    if (m_progress) {
+        m_progress->report(m_currentIndex, 0, QString("正在处理 %1").arg(QFileInfo(inputPath).fileName()));
+    }
     QFileInfo inputFileInfo(inputPath);
     QString outputDir = inputFileInfo.absolutePath();
     QString fileNameWithoutExt = inputFileInfo.completeBaseName();
 
-    QString tempOutput = QDir(outputDir).filePath(fileNameWithoutExt + "_temp.png");
-    QString finalOutput = QDir(outputDir).filePath(fileNameWithoutExt + "-ENLARGE." + m_currentOutputFormat.toLower());
+    m_currentOutputBase = QDir(outputDir).filePath(fileNameWithoutExt);
+    m_currentFinalOutput = m_currentOutputBase + "-ENLARGE." + m_currentOutputFormat.toLower();
 
     // Validate input file
     if (!QFile::exists(inputPath)) {
-        emit errorOccurred(QString("Input file not found: %1").arg(inputPath));
+        failCurrentItem(QString("Input file not found: %1").arg(inputPath));
         return;
     }
 
     // Create output directory if needed
-    QDir outputDirInfo = QFileInfo(tempOutput).absoluteDir();
+    QDir outputDirInfo(outputDir);
     if (!outputDirInfo.exists() && !outputDirInfo.mkpath(".")) {
-        emit errorOccurred(QString("Failed to create directory: %1").arg(outputDirInfo.path()));
+        failCurrentItem(QString("Failed to create directory: %1").arg(outputDirInfo.path()));
+        return;
+    }
+
+    // 规划缩放方案（只读取文件头获取尺寸）
+    QImageReader sizeReader(inputPath);
+    ScalePlanner planner(m_availableModels);
+    m_currentSourceSize = sizeReader.size();
+    m_currentPlan = planner.plan(m_currentSourceSize, m_scaleTarget, m_currentModelName);
+    if (!m_currentPlan.valid) {
+        m_currentPlan.passes << ScalePass{m_currentModelName, ScalePlanner::nativeScale(m_currentModelName)};
+    } else {
+        emit planReady(inputPath, m_currentPlan.summary());
+    }
+    qDebug() << "Scale plan:" << inputPath << m_currentPlan.summary();
+
+    // 序号避免不同目录下的同名文件在临时目录里冲突
+    m_currentBaseName = QDir(m_scratchDir).filePath(QString("%1_%2").arg(m_currentIndex).arg(fileNameWithoutExt));
+    m_currentTempFiles.clear();
+    m_currentPassIndex = 0;
+
+    if (m_regions.contains(m_currentIndex) && startRegionJob(inputPath)) {
+        return;
+    }
+
+    // 是否带透明度只看文件头，不透明格式无需解码
+    m_currentAlpha = QImage();
+    m_currentFlattened = false;
+    QImage::Format headerFormat = sizeReader.imageFormat();
+    bool mayHaveAlpha = headerFormat == QImage::Format_Invalid
+                        || QImage::toPixelFormat(headerFormat).alphaUsage() == QPixelFormat::UsesAlpha;
+    if (!mayHaveAlpha && !m_currentPlan.needsPreScale()) {
+        m_modelTimer.start();
+        startUpscalePass(inputPath, passOutputPath(0));
         return;
     }
 
-    // Start RealESRGAN process
-    if (m_currentProcess) {
-        m_currentProcess->deleteLater();
+    // 全不透明或只输出 JPG 时直接丢弃透明度
+    QStringList formats;
+    if (m_renditions.isEmpty()) {
+        formats << m_currentOutputFormat.toLower();
     }
+    for (const RenditionSpec &spec : m_renditions) {
+        formats << spec.format;
+    }
+    bool keepsAlpha = std::any_of(formats.begin(), formats.end(), [](const QString &format) {
+        return format != "jpg" && format != "jpeg";
+    });
+    QSize preScaledSize = m_currentPlan.needsPreScale() ? m_currentPlan.preScaledSize : QSize();
+    QString prepared = m_currentBaseName + "_rgb.png";
+
+    // 解码、预缩放、透明度检查和写出中间文件都在线程池里完成，大图不阻塞界面
+    m_workerPool.start([this, inputPath, preScaledSize, keepsAlpha, prepared]() {
+        PreparedInput result;
+        QImage image = QImageReader(inputPath).read();
+        if (image.isNull()) {
+            result.error = QString("Failed to read image: %1").arg(inputPath);
+        } else {
+            if (preScaledSize.isValid()) {
+                image = image.scaled(preScaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+
+            if (image.hasAlphaChannel()) {
+                image = image.convertToFormat(QImage::Format_ARGB32);
+                QImage alpha = image.convertToFormat(QImage::Format_Alpha8);
+                bool opaque = true;
+                for (int y = 0; opaque && y < alpha.height(); ++y) {
+                    const uchar *line = alpha.constScanLine(y);
+                    opaque = std::all_of(line, line + alpha.width(), [](uchar a) { return a == 255; });
+                }
+                if (opaque || !keepsAlpha) {
+                    result.flattened = true;
+                } else {
+                    result.alpha = alpha;
+                }
+                image = image.convertToFormat(QImage::Format_RGB888);
+            }
 
-    m_currentProcess = new QProcess(this);
-    m_currentProcess->setProcessChannelMode(QProcess::MergedChannels);
+            result.ok = true;
+            if (preScaledSize.isValid() || result.flattened || !result.alpha.isNull()) {
+                result.written = PngWriter::write(image, prepared, PngWriter::Intermediate);
+                if (!result.written) {
+                    result.ok = false;
+                    result.error = QString("Failed to prepare image: %1").arg(inputPath);
+                }
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, inputPath, prepared, result]() {
+            handleInputPrepared(inputPath, prepared, result);
+        }, Qt::QueuedConnection);
+    });
+}
 
-    connect(m_currentProcess, &QProcess::readyReadStandardOutput,
-            this, &ImageProcessor::handleProcessOutput);
-    connect(m_currentProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &ImageProcessor::handleRealESRGANFinished);
+void ImageProcessor::handleInputPrepared(const QString &inputPath, const QString &preparedPath,
+                                         const PreparedInput &result)
+{
+    if (!result.ok) {
+        QFile::remove(preparedPath);
+        failCurrentItem(result.error);
+        return;
+    }
 
-    QStringList args;
-    args << "-i" << inputPath
-         << "-o" << tempOutput
-         << "-n" << m_currentModelName;
+    m_currentAlpha = result.alpha;
+    m_currentFlattened = result.flattened;
+    QString passInput = inputPath;
+    if (result.written) {
+        m_currentTempFiles << preparedPath;
+        passInput = preparedPath;
+    }
 
-    qDebug() << "Executing RealESRGAN:" << m_realESRGANExecutable << args;
-    m_currentProcess->start(m_realESRGANExecutable, args);
+    m_modelTimer.start();
+    startUpscalePass(passInput, passOutputPath(0));
 }
 
+bool ImageProcessor::startRegionJob(const QString &inputPath)
+{
+    // 预缩放后模型输入与原图坐标不再对应；多规格输出需要整张模型结果
+    if (m_currentPlan.needsPreScale() || !m_renditions.isEmpty() || m_currentSourceSize.isEmpty()) {
+        emit itemNote(m_currentIndex, "区域放大不支持预缩放和多规格输出，已整图放大");
+        return false;
+    }
+
+    m_regionCrops = RegionUpscaler::plan(m_regions.value(m_currentIndex), m_currentSourceSize, kRegionMargin);
+    qint64 contextArea = 0;
+    for (const RegionUpscaler::Crop &crop : m_regionCrops) {
+        contextArea += qint64(crop.context.width()) * crop.context.height();
+    }
+    m_regionCoverage = double(contextArea) / (qint64(m_currentSourceSize.width()) * m_currentSourceSize.height());
+    if (m_regionCrops.isEmpty()) {
+        emit itemNote(m_currentIndex, "区域不在画面内，已整图放大");
+        return false;
+    }
+    if (m_regionCoverage > kMaxRegionCoverage) {
+        emit itemNote(m_currentIndex, "区域覆盖了大部分画面，已整图放大");
+        return false;
+    }
+
+    int scale = 1;
+    for (const ScalePass &pass : m_currentPlan.passes) {
+        scale *= pass.scale;
+    }
+    QSize target = m_currentPlan.valid ? m_currentPlan.targetSize : m_currentSourceSize * scale;
+    m_regionOutputs.clear();
+    m_regionCropIndex = 0;
+
+    // 裁出各上下文、把整图重采样为底图都在线程池里完成
+    QList<RegionUpscaler::Crop> crops = m_regionCrops;
+    QString baseName = m_currentBaseName;
+    for (int i = 0; i < crops.size(); ++i) {
+        m_currentTempFiles << QString("%1_region%2.png").arg(baseName).arg(i);
+    }
+    m_workerPool.start([this, inputPath, crops, baseName, target]() {
+        QImage image(inputPath);
+        bool ok = !image.isNull();
+        for (int i = 0; ok && i < crops.size(); ++i) {
+            QImage crop = image.copy(crops.at(i).context).convertToFormat(QImage::Format_RGB888);
+            ok = PngWriter::write(crop, QString("%1_region%2.png").arg(baseName).arg(i), PngWriter::Intermediate);
+        }
+        QImage background;
+        if (ok) {
+            background = ImageResampler::resample(image, target)
+                             .convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+            ok = !background.isNull();
+        }
+        QMetaObject::invokeMethod(this, [this, background, ok]() {
+            handleRegionsPrepared(background, ok);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
 
-void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus exitStatus)
+void ImageProcessor::handleRegionsPrepared(const QImage &background, bool ok)
 {
-    Q_UNUSED(exitStatus)
+    if (!ok) {
+        removeCurrentTempFiles();
+        failCurrentItem(QString("Failed to prepare regions: %1").arg(m_inputPaths.at(m_currentIndex)));
+        return;
+    }
 
-    QString output = QString::fromUtf8(m_currentProcess->readAllStandardOutput());
-    qDebug() << "RealESRGAN output:" << output;
+    m_regionBackground = background;
+    m_modelTimer.start();
+    startRegionPass(QString("%1_region0.png").arg(m_currentBaseName));
+}
 
-    static QRegularExpression progressRegex(R"((\d+\.\d+)%)");
-    QRegularExpressionMatchIterator i = progressRegex.globalMatch(output);
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        double progress = match.captured(1).toDouble();
-        emit progressUpdate(static_cast<int>(progress), "正在处理图像...");
+void ImageProcessor::startRegionPass(const QString &inputPath)
+{
+    const ScalePass &pass = m_currentPlan.passes.at(m_currentPassIndex);
+
+    if (m_currentTask) {
+        m_currentTask->deleteLater();
+    }
+
+    UpscaleRequest request;
+    request.inputPath = inputPath;
+    request.outputPath = QString("%1_region%2_pass%3.png").arg(m_currentBaseName).arg(m_regionCropIndex).arg(m_currentPassIndex + 1);
+    request.modelName = pass.modelName;
+    request.scale = pass.scale;
+    request.executablePath = m_realESRGANExecutable;
+    m_currentTempFiles << request.outputPath;
+
+    m_currentTask = UpscaleBackend::defaultBackend()->createTask(request, this);
+    connect(m_currentTask, &UpscaleTask::progress, this, [this](double progress) {
+        // 按区域和遍数折算成单个文件的进度
+        int passCount = qMax(1, int(m_currentPlan.passes.size()));
+        double steps = double(m_regionCrops.size()) * passCount;
+        double itemProgress = ((m_regionCropIndex * passCount + m_currentPassIndex) * 100.0 + progress) / steps;
+        if (m_progress) {
+            m_progress->report(m_currentIndex, itemProgress);
+        }
+        emit progressUpdate(static_cast<int>(itemProgress), "正在处理选定区域...");
+    });
+    connect(m_currentTask, &UpscaleTask::finished, this, &ImageProcessor::handleRegionUpscaled);
+    m_currentTask->start();
+}
+
+void ImageProcessor::handleRegionUpscaled(bool ok)
+{
+    if (!ok) {
+        removeCurrentTempFiles();
+        m_regionBackground = QImage();
+        failCurrentItem(m_currentTask->errorString());
+        return;
+    }
+
+    QString output = m_currentTask->request().outputPath;
+    if (m_currentPassIndex + 1 < m_currentPlan.passes.size()) {
+        ++m_currentPassIndex;
+        startRegionPass(output);
+        return;
     }
 
-    if (exitCode != 0) {
-        emit errorOccurred(QString("RealESRGAN failed (code %1): %2").arg(exitCode).arg(output));
+    m_regionOutputs << output;
+    m_currentPassIndex = 0;
+    if (++m_regionCropIndex < m_regionCrops.size()) {
+        startRegionPass(QString("%1_region%2.png").arg(m_currentBaseName).arg(m_regionCropIndex));
         return;
     }
 
-    // 解析临时输出路径
-    QString tempOutput;
-    QStringList args = m_currentProcess->arguments();
-    for (int i = 0; i < args.size(); ++i) {
-        if (args[i] == "-o" && i + 1 < args.size()) {
-            tempOutput = args[i + 1];
-            break;
+    // 贴回底图和编码在线程池里完成，先写到输出目录的隐藏名再改名
+    m_currentModelMs = m_modelTimer.elapsed();
+    QImage background = m_regionBackground;
+    m_regionBackground = QImage();
+    QList<RegionUpscaler::Crop> crops = m_regionCrops;
+    QStringList outputs = m_regionOutputs;
+    QSize sourceSize = m_currentSourceSize;
+    QString finalOutput = m_currentFinalOutput;
+    QString format = m_currentOutputFormat.toLower();
+    m_workerPool.start([this, background, crops, outputs, sourceSize, finalOutput, format]() mutable {
+        bool ok = true;
+        for (int i = 0; ok && i < crops.size(); ++i) {
+            QImage upscaled(outputs.at(i));
+            ok = !upscaled.isNull();
+            if (ok) {
+                RegionUpscaler::blend(background, upscaled, crops.at(i), sourceSize);
+            }
+        }
+
+        QString staging = ScratchManager::stagingPath(finalOutput);
+        if (ok) {
+            ok = format == "png"
+                     ? PngWriter::write(background, staging, PngWriter::Deliverable)
+                     : background.save(staging, format == "webp" ? "WEBP" : "JPG", format == "webp" ? 90 : 95);
+        }
+        ok = ok && ScratchManager::moveToFinal(staging, finalOutput);
+        if (!ok) {
+            QFile::remove(staging);
+        }
+        QMetaObject::invokeMethod(this, [this, ok]() { handleRegionsBlended(ok); }, Qt::QueuedConnection);
+    });
+}
+
+void ImageProcessor::handleRegionsBlended(bool ok)
+{
+    removeCurrentTempFiles();
+    if (!ok) {
+        failCurrentItem(QString("Failed to write region output: %1").arg(m_currentFinalOutput));
+        return;
+    }
+
+    // 模型耗时大致与输入面积成正比，按覆盖比例估计整图放大的耗时
+    qint64 savedMs = m_regionCoverage > 0 ? qint64(m_currentModelMs / m_regionCoverage) - m_currentModelMs : 0;
+    emit itemNote(m_currentIndex, QString("区域放大：模型只处理了 %1% 的画面（%2 个区域），约节省 %3 秒")
+                                      .arg(m_regionCoverage * 100, 0, 'f', 1)
+                                      .arg(m_regionCrops.size())
+                                      .arg(savedMs / 1000.0, 0, 'f', 1));
+    finishCurrentItem(m_currentFinalOutput);
+    processNextImage();
+}
+
+QString ImageProcessor::passOutputPath(int passIndex) const
+{
+    if (passIndex + 1 >= m_currentPlan.passes.size()) {
+        // 最后一遍直接就是最终文件时写到输出目录的隐藏名，完成后同目录改名即可
+        if (renamesLastPass()) {
+            return ScratchManager::stagingPath(m_currentFinalOutput);
+        }
+        return m_currentBaseName + "_temp.png";
+    }
+    return m_currentBaseName + QString("_pass%1.png").arg(passIndex + 1);
+}
+
+bool ImageProcessor::renamesLastPass() const
+{
+    return m_renditions.isEmpty() && m_currentOutputFormat.toLower() == "png"
+           && !m_currentPlan.needsFinalResample();
+}
+
+void ImageProcessor::removeCurrentTempFiles()
+{
+    for (const QString &file : m_currentTempFiles) {
+        QFile::remove(file);
+    }
+    m_currentTempFiles.clear();
+}
+
+void ImageProcessor::restoreAlpha(const QString &rgbPath, qint64 modelMs)
+{
+    QImage alpha = m_currentAlpha;
+    m_currentAlpha = QImage();
+    // 输出 PNG 且无需再缩放时该文件会直接改名为最终结果
+    PngWriter::Purpose purpose = renamesLastPass() ? PngWriter::Deliverable : PngWriter::Intermediate;
+
+    // 整图重采样和编码在线程池里完成，大图不阻塞界面
+    m_workerPool.start([this, rgbPath, alpha, purpose, modelMs]() {
+        QElapsedTimer alphaTimer;
+        alphaTimer.start();
+        QImage rgb(rgbPath);
+        bool ok = !rgb.isNull();
+        if (ok) {
+            QImage combined = rgb.convertToFormat(QImage::Format_ARGB32);
+            combined.setAlphaChannel(ImageResampler::resample(alpha, rgb.size()));
+            ok = PngWriter::write(combined, rgbPath, purpose);
         }
+        qint64 savedMs = modelMs - alphaTimer.elapsed();
+        QMetaObject::invokeMethod(this, [this, rgbPath, ok, savedMs]() {
+            handleAlphaRestored(rgbPath, ok, savedMs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageProcessor::handleAlphaRestored(const QString &rgbPath, bool ok, qint64 savedMs)
+{
+    if (!ok) {
+        failCurrentItem(QString("Failed to restore alpha channel: %1").arg(rgbPath));
+        return;
+    }
+    reportAlphaSaving(savedMs, "透明通道单独缩放");
+    writeFinalOutput(rgbPath);
+}
+
+void ImageProcessor::reportAlphaSaving(qint64 savedMs, const QString &label)
+{
+    savedMs = qMax<qint64>(0, savedMs);
+    m_alphaSavedMs += savedMs;
+    emit itemNote(m_currentIndex, QString("%1，约节省 %2 秒").arg(label).arg(savedMs / 1000.0, 0, 'f', 1));
+}
+
+void ImageProcessor::finishCurrentItem(const QString &outputPath)
+{
+    if (m_currentIndex == m_atlasBaselineIndex) {
+        m_atlasBaselineMs = m_itemTimer.elapsed();
+        m_atlasBaselineIndex = -1;
+    }
+    m_outputFiles.append(outputPath);
+    if (m_progress) {
+        m_progress->finishWorker(m_currentIndex);
+    }
+    emit itemFinished(m_currentIndex, outputPath);
+    emit fileProcessed();
+}
+
+void ImageProcessor::failCurrentItem(const QString &message)
+{
+    if (m_progress) {
+        m_progress->removeWorker(m_currentIndex);
+    }
+    PriorityScheduler::endInteractive(this);
+    emit itemFailed(m_currentIndex, message);
+    emit errorOccurred(message);
+}
+
+void ImageProcessor::startUpscalePass(const QString &inputPath, const QString &outputPath)
+{
+    const ScalePass &pass = m_currentPlan.passes.at(m_currentPassIndex);
+
+    if (m_currentTask) {
+        m_currentTask->deleteLater();
+    }
+
+    UpscaleRequest request;
+    request.inputPath = inputPath;
+    request.outputPath = outputPath;
+    request.modelName = pass.modelName;
+    request.scale = pass.scale;
+    request.executablePath = m_realESRGANExecutable;
+    // 最后一遍直接改名为最终文件时按交付文件压缩；需要恢复透明度的会在合并后重新编码
+    if (m_currentPassIndex + 1 >= m_currentPlan.passes.size() && renamesLastPass() && m_currentAlpha.isNull()) {
+        request.purpose = PngWriter::Deliverable;
     }
 
-    if (tempOutput.isEmpty()) {
-        emit errorOccurred("Failed to parse output path");
+    m_currentTask = UpscaleBackend::defaultBackend()->createTask(request, this);
+    connect(m_currentTask, &UpscaleTask::progress, this, &ImageProcessor::reportPassProgress);
+    connect(m_currentTask, &UpscaleTask::finished, this, &ImageProcessor::handleUpscaleFinished);
+    m_currentTask->start();
+}
+
+
+void ImageProcessor::handleUpscaleFinished(bool ok)
+{
+    if (!ok) {
+        failCurrentItem(m_currentTask->errorString());
+        return;
+    }
+
+    QString tempOutput = m_currentTask->request().outputPath;
+
+    // 多遍串联：上一遍的输出作为下一遍的输入
+    if (m_currentPassIndex + 1 < m_currentPlan.passes.size()) {
+        m_currentTempFiles << tempOutput;
+        ++m_currentPassIndex;
+        startUpscalePass(tempOutput, passOutputPath(m_currentPassIndex));
         return;
     }
+    removeCurrentTempFiles();
 
-    QFileInfo tempFileInfo(tempOutput);
-    QString finalOutput = QDir(tempFileInfo.absolutePath()).filePath(
-        tempFileInfo.completeBaseName().replace("_temp", "-ENLARGE") +
-        "." + m_currentOutputFormat.toLower());
+    // 按模型处理透明度时耗时与 RGB 相当，以本次模型耗时作为节省量的估计
+    qint64 modelMs = m_modelTimer.elapsed();
+
+    // 多规格输出：透明度恢复、缩放和编码都交给 RenditionWriter 在线程池中完成
+    if (!m_renditions.isEmpty()) {
+        m_currentModelMs = modelMs;
+        m_renditionWriter->start(tempOutput, m_currentAlpha, m_currentSourceSize,
+                                 m_currentOutputBase + "-ENLARGE", m_renditions);
+        return;
+    }
+
+    if (!m_currentAlpha.isNull()) {
+        restoreAlpha(tempOutput, modelMs);
+        return;
+    }
+    if (m_currentFlattened) {
+        reportAlphaSaving(modelMs, "已去除无用的透明通道");
+    }
+    writeFinalOutput(tempOutput);
+}
 
-    if (m_currentOutputFormat.toLower() != "png") {
+void ImageProcessor::writeFinalOutput(const QString &tempOutput)
+{
+    // 最终只做一次高质量重采样，与格式转换合并在同一次 FFmpeg 调用中
+    QString scaleFilter;
+    QString fallbackScaleFilter = "scale=iw/1.3:ih/1.3";
+    if (m_currentPlan.needsFinalResample()) {
+        const QSize &target = m_currentPlan.targetSize;
+        scaleFilter = QString("scale=%1:%2:flags=lanczos").arg(target.width()).arg(target.height());
+        fallbackScaleFilter = QString("scale=%1:%2:flags=lanczos")
+                                  .arg(qRound(target.width() / 1.3))
+                                  .arg(qRound(target.height() / 1.3));
+    }
+
+    QString finalOutput = m_currentFinalOutput;
+
+    if (m_currentOutputFormat.toLower() != "png" || !scaleFilter.isEmpty()) {
         QProcess *ffmpegProcess = new QProcess(this);
         QString format = m_currentOutputFormat.toLower(); // 捕获输出格式
 
         connect(ffmpegProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, [this, tempOutput, finalOutput, ffmpegProcess, format](int code, QProcess::ExitStatus status) {
+                this, [this, tempOutput, finalOutput, ffmpegProcess, format, fallbackScaleFilter](int code, QProcess::ExitStatus status) {
                     Q_UNUSED(status)
                     if (code != 0)
                     {
-                        QString error = QString::fromUtf8(ffmpegProcess->readAllStandardError());
+                        QString error = ProcessSupervisor::attach(ffmpegProcess)->tail(2000);
                         // 如果是JPG/JPEG格式，尝试备用方案
                         if (format == "jpg" || format == "jpeg")
                         {
@@ -153,8 +941,8 @@ void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus
                                         Q_UNUSED(fallbackStatus)
                                         if (fallbackCode != 0)
                                         {
-                                            QString fallbackError = QString::fromUtf8(fallbackProcess->readAllStandardError());
-                                            emit errorOccurred(QString("Fallback FFmpeg failed (code %1): %2").arg(fallbackCode).arg(fallbackError));
+                                            QString fallbackError = ProcessSupervisor::attach(fallbackProcess)->tail(2000);
+                                            failCurrentItem(QString("Fallback FFmpeg failed (code %1): %2").arg(fallbackCode).arg(fallbackError));
                                         }
                                         else
                                         {
@@ -162,7 +950,7 @@ void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus
                                             {
                                                 QFile::remove(tempOutput);
                                             }
-                                            m_outputFiles.append(finalOutput);
+                                            finishCurrentItem(finalOutput);
                                             processNextImage();
                                         }
                                         fallbackProcess->deleteLater();
@@ -171,16 +959,16 @@ void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus
                             QStringList fallbackArgs;
                             fallbackArgs << "-y"
                                          << "-i" << tempOutput
-                                         << "-vf" << "scale=iw/1.3:ih/1.3"
+                                         << "-vf" << fallbackScaleFilter
                                          << "-q:v" << "2"
                                          << finalOutput;
 
                             qDebug() << "Executing fallback FFmpeg command:" << m_ffmpegExecutable << fallbackArgs;
-                            fallbackProcess->start(m_ffmpegExecutable, fallbackArgs);
+                            ProcessLauncher::start(fallbackProcess, m_ffmpegExecutable, fallbackArgs, ProcessLauncher::Encoder);
                         }
                         else
                         {
-                            emit errorOccurred(QString("FFmpeg failed (code %1): %2").arg(code).arg(error));
+                            failCurrentItem(QString("FFmpeg failed (code %1): %2").arg(code).arg(error));
                         }
                     } else
                     {
@@ -188,8 +976,7 @@ void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus
                         {
                             QFile::remove(tempOutput);
                         }
-                        m_outputFiles.append(finalOutput);
-                        emit fileProcessed();
+                        finishCurrentItem(finalOutput);
                         processNextImage();
                     }
                     ffmpegProcess->deleteLater();
@@ -197,58 +984,78 @@ void ImageProcessor::handleRealESRGANFinished(int exitCode, QProcess::ExitStatus
 
         try {
             QStringList ffmpegArgs;
+            ffmpegArgs << "-y"
+                       << "-i" << tempOutput;
+            if (!scaleFilter.isEmpty()) {
+                ffmpegArgs << "-vf" << scaleFilter;
+            }
+
             if (format == "jpg" || format == "jpeg")
             {
-                ffmpegArgs << "-y"
-                           << "-i" << tempOutput
-                           << "-q:v" << "2"
+                ffmpegArgs << "-q:v" << "2"
                            << finalOutput;
             }
             else if (format == "webp")
             {
-                ffmpegArgs << "-y"
-                           << "-i" << tempOutput
-                           << "-quality" << "90"
+                ffmpegArgs << "-quality" << "90"
                            << "-compression_level" << "6"
                            << finalOutput;
+            }
+            else if (format == "png")
+            {
+                ffmpegArgs << finalOutput;
             } else {
                 throw std::runtime_error("Unsupported format: " + format.toStdString());
             }
 
             qDebug() << "Executing FFmpeg:" << m_ffmpegExecutable << ffmpegArgs;
-            ffmpegProcess->start(m_ffmpegExecutable, ffmpegArgs);
+            ProcessLauncher::start(ffmpegProcess, m_ffmpegExecutable, ffmpegArgs, ProcessLauncher::Encoder);
         } catch (const std::exception &e) {
-            emit errorOccurred(QString("FFmpeg error: %1").arg(e.what()));
+            failCurrentItem(QString("FFmpeg error: %1").arg(e.what()));
             ffmpegProcess->deleteLater();
         }
     } else {
-        if (QFile::rename(tempOutput, finalOutput)) {
-            m_outputFiles.append(finalOutput);
+        QString error;
+        if (ScratchManager::moveToFinal(tempOutput, finalOutput, &error)) {
+            finishCurrentItem(finalOutput);
             processNextImage();
         } else {
-            emit errorOccurred("Failed to rename output file");
+            failCurrentItem(error);
         }
     }
 }
 
-void ImageProcessor::handleProcessOutput()
+void ImageProcessor::handleRenditionsFinished(bool ok, const QStringList &outputFiles, const QString &error)
 {
-    QString output = QString::fromUtf8(m_currentProcess->readAllStandardOutput());
-    static QRegularExpression progressRegex(R"((\d+\.\d+)%)");
-    QRegularExpressionMatchIterator i = progressRegex.globalMatch(output);
+    QFile::remove(passOutputPath(m_currentPlan.passes.size() - 1));
+    if (!ok) {
+        failCurrentItem(error);
+        return;
+    }
 
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        double progress = match.captured(1).toDouble();
-        qDebug() << "Processing progress:" << progress << "%";
-        emit progressUpdate(static_cast<int>(progress), "正在处理图像...");
+    if (m_currentFlattened) {
+        reportAlphaSaving(m_currentModelMs, "已去除无用的透明通道");
+    } else if (!m_currentAlpha.isNull()) {
+        m_currentAlpha = QImage();
+        reportAlphaSaving(m_currentModelMs - m_renditionWriter->alphaElapsedMs(), "透明通道单独缩放");
     }
 
-    // 输出调试信息到控制台
-    qDebug() << "Process output:" << output;
+    // 队列中每项显示第一个规格，其余规格直接计入输出列表
+    m_outputFiles << outputFiles.mid(1);
+    finishCurrentItem(outputFiles.first());
+    processNextImage();
 }
 
-
+void ImageProcessor::reportPassProgress(double progress)
+{
+    // 多遍串联时按遍数折算成单个文件的进度
+    int passCount = qMax(1, int(m_currentPlan.passes.size()));
+    double itemProgress = (m_currentPassIndex * 100.0 + progress) / passCount;
+    if (m_progress) {
+        m_progress->report(m_currentIndex, itemProgress);
+    }
+    emit progressUpdate(static_cast<int>(itemProgress), "正在处理图像...");
+}
 
 void ImageProcessor::openOutputDirectory(const QString &path)
 {
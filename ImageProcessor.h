@@ -2,45 +2,168 @@
 #define IMAGEPROCESSOR_H
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QThreadPool>
+#include "ScalePlanner.h"
+#include "RenditionWriter.h"
+#include "PriorityScheduler.h"
+#include "SpriteAtlas.h"
+#include "RegionUpscaler.h"
+
+class ProgressAggregator;
+class UpscaleTask;
 
 class ImageProcessor : public QObject
 {
     Q_OBJECT
 public:
     explicit ImageProcessor(QObject *parent = nullptr, bool noWindow = false);
+    ~ImageProcessor();
     void setNoWindow(bool noWindow);
     void processImages(const QStringList &inputPaths,
                        const QString &modelName,
                        const QString &outputFormat,
                        bool openOutputDirectory);
+    void setScaleTarget(const ScaleTarget &target, const QStringList &availableModels);
+    // 进度写入聚合器，由聚合器限频发布给界面
+    void setProgressAggregator(ProgressAggregator *aggregator);
+    // 非空时一次模型放大后生成全部规格，代替单个输出文件
+    void setRenditions(const QList<RenditionSpec> &renditions);
+    // Interactive 时处理期间暂停后台视频作业
+    void setPriority(PriorityScheduler::Priority priority);
+    // 本批次因透明通道分离而估计节省的模型时间
+    qint64 alphaTimeSavedMs() const { return m_alphaSavedMs; }
+    // 图集模式：单遍放大的小图拼成大图一起放大，省去逐个文件的启动和模型加载开销
+    void setAtlasMode(bool enabled);
+    // 图集处理的统计和相对逐个处理的加速比，本批次未使用图集时为空
+    QString atlasReport() const;
+    // 区域放大：键为 processImages 输入列表中的位置，只有这些区域（含上下文边距）经过模型，
+    // 其余部分在进程内重采样，接缝处渐变过渡
+    void setRegions(const QHash<int, QList<QRect>> &regions);
 
 signals:
     void processingFinished(const QStringList &outputFiles);
     void errorOccurred(const QString &message);
     void progressUpdate(int percentage, const QString &status);
     void fileProcessed();
+    void planReady(const QString &inputPath, const QString &summary);
+    // index 为文件在 processImages 输入列表中的位置
+    void itemStarted(int index);
+    void itemFinished(int index, const QString &outputPath);
+    void itemFailed(int index, const QString &message);
+    void itemNote(int index, const QString &note);
 
 private slots:
-    void handleRealESRGANFinished(int exitCode, QProcess::ExitStatus exitStatus);
-    void handleProcessOutput();
+    void handleUpscaleFinished(bool ok);
+    void reportPassProgress(double progress);
+    void handleRenditionsFinished(bool ok, const QStringList &outputFiles, const QString &error);
 
 
 private:
+    // 送进模型前在线程池里准备好的输入：预缩放、去掉透明度后写出的 RGB 中间文件
+    struct PreparedInput {
+        bool ok = false;
+        bool written = false; // 写出了中间文件，模型改读它
+        bool flattened = false;
+        QImage alpha;         // 需要单独放大的透明度平面
+        QString error;
+    };
+
+    struct AtlasJob {
+        SpriteAtlas::Sheet sheet;
+        QList<int> indices; // Placement::item 对应的输入序号
+        QString modelName;
+        int scale = 0;
+    };
+
     void processNextImage();
+    void handleInputPrepared(const QString &inputPath, const QString &preparedPath, const PreparedInput &result);
+    // sizes 只含可以拼图的小图（由线程池读取文件头得到）
+    void planAtlasJobs(const QHash<int, QSize> &sizes);
+    void startAtlasJob();
+    void handleAtlasComposed(const SpriteAtlas::Composed &composed, const QString &sheetPath, bool ok);
+    void handleAtlasUpscaled(bool ok);
+    void handleAtlasWritten(const QList<QPair<int, QString>> &written, const QList<int> &failed);
+    void fallBackToPerFile(const QList<int> &indices);
+    bool startRegionJob(const QString &inputPath);
+    void handleRegionsPrepared(const QImage &background, bool ok);
+    void startRegionPass(const QString &inputPath);
+    void handleRegionUpscaled(bool ok);
+    void handleRegionsBlended(bool ok);
+    void startUpscalePass(const QString &inputPath, const QString &outputPath);
+    QString passOutputPath(int passIndex) const;
+    bool renamesLastPass() const;
+    void removeCurrentTempFiles();
+    void restoreAlpha(const QString &rgbPath, qint64 modelMs);
+    void handleAlphaRestored(const QString &rgbPath, bool ok, qint64 savedMs);
+    void writeFinalOutput(const QString &tempOutput);
+    void reportAlphaSaving(qint64 savedMs, const QString &label);
+    void finishCurrentItem(const QString &outputPath);
+    void failCurrentItem(const QString &message);
     void convertImageFormat(const QString &inputPath, const QString &outputPath);
     void openOutputDirectory(const QString &path);
 
     QString m_realESRGANExecutable = "realesrgan-ncnn-vulkan.exe";
     QString m_ffmpegExecutable = "ffmpeg.exe";
     bool m_noWindow;
-    QStringList m_remainingInputPaths;
+    QStringList m_inputPaths;
+    QList<int> m_remainingIndices;
+    int m_currentIndex = -1;
     QStringList m_outputFiles;
     QString m_currentModelName;
     QString m_currentOutputFormat;
     bool m_openOutputDirectory;
-    QProcess *m_currentProcess;
+    UpscaleTask *m_currentTask;
+
+    ScaleTarget m_scaleTarget;
+    QStringList m_availableModels;
+    ScalePlan m_currentPlan;
+    int m_currentPassIndex = 0;
+    // 中间文件在临时目录下，最终结果和多规格输出在源文件旁边
+    QString m_scratchDir;
+    QString m_currentBaseName;
+    QString m_currentOutputBase;
+    QString m_currentFinalOutput;
+    QStringList m_currentTempFiles;
+    ProgressAggregator *m_progress = nullptr;
+
+    // 透明图：模型只处理 RGB，透明度平面留在内存里最后单独放大
+    QImage m_currentAlpha;
+    bool m_currentFlattened = false;
+    QElapsedTimer m_modelTimer;
+    qint64 m_alphaSavedMs = 0;
+
+    QList<RenditionSpec> m_renditions;
+    RenditionWriter *m_renditionWriter;
+    QSize m_currentSourceSize;
+    qint64 m_currentModelMs = 0;
+
+    bool m_atlasMode = false;
+    QList<AtlasJob> m_atlasJobs;
+    AtlasJob m_currentAtlas;
+    QHash<int, QImage> m_atlasAlphas;
+    QString m_atlasSheetPath;
+    QElapsedTimer m_itemTimer;
+    QElapsedTimer m_atlasTimer;
+    // 先按原流程处理一张作为对照，用来计算加速比
+    int m_atlasBaselineIndex = -1;
+    qint64 m_atlasBaselineMs = 0;
+    qint64 m_atlasMs = 0;
+    int m_atlasItems = 0;
+    int m_atlasSheets = 0;
+
+    QHash<int, QList<QRect>> m_regions;
+    QList<RegionUpscaler::Crop> m_regionCrops;
+    QStringList m_regionOutputs; // 各上下文最后一遍的模型输出
+    int m_regionCropIndex = 0;
+    QImage m_regionBackground;
+    double m_regionCoverage = 0; // 送进模型的面积占整图的比例
+
+    // 图集、区域放大和透明通道恢复的读图、合成与编码
+    QThreadPool m_workerPool;
 
 };
 
@@ -0,0 +1,254 @@
+#include "ImageResampler.h"
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGERESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+const double kLanczosRadius = 3.0;
+// 每个分块的输出行数，中间结果大致能放进 L2
+const int kBandRows = 32;
+
+double lanczos(double x)
+{
+    x = std::abs(x);
+    if (x < 1e-8) {
+        return 1.0;
+    }
+    if (x >= kLanczosRadius) {
+        return 0.0;
+    }
+    double px = M_PI * x;
+    return kLanczosRadius * std::sin(px) * std::sin(px / kLanczosRadius) / (px * px);
+}
+
+// 一个方向上的权重表：每个输出位置从 start 开始取 taps 个输入
+struct Contributions {
+    int taps = 0;
+    std::vector<int> start;
+    std::vector<float> weights;
+};
+
+Contributions buildContributions(int inSize, int outSize)
+{
+    Contributions result;
+    double scale = double(outSize) / inSize;
+    // 缩小时按比例放宽核，起到低通作用
+    double filterScale = qMax(1.0, 1.0 / scale);
+    double support = kLanczosRadius * filterScale;
+    result.taps = qMin(inSize, int(std::ceil(support)) * 2 + 1);
+    result.start.resize(outSize);
+    result.weights.assign(size_t(outSize) * result.taps, 0.0f);
+
+    for (int out = 0; out < outSize; ++out) {
+        double center = (out + 0.5) / scale - 0.5;
+        int first = int(std::floor(center - support)) + 1;
+        // 贴边时整体平移窗口，越界的采样折回边缘像素
+        int start = qBound(0, first, inSize - result.taps);
+        result.start[out] = start;
+
+        float *weights = result.weights.data() + size_t(out) * result.taps;
+        double total = 0.0;
+        for (int i = first; i < first + int(std::ceil(support)) * 2 + 1; ++i) {
+            double w = lanczos((i - center) / filterScale);
+            if (w == 0.0) {
+                continue;
+            }
+            int index = qBound(0, i, inSize - 1) - start;
+            index = qBound(0, index, result.taps - 1);
+            weights[index] += float(w);
+            total += w;
+        }
+        if (total != 0.0) {
+            for (int t = 0; t < result.taps; ++t) {
+                weights[t] = float(weights[t] / total);
+            }
+        }
+    }
+    return result;
+}
+
+// 单通道：输入行与权重做点积
+float dot(const float *a, const float *b, int count)
+{
+    int i = 0;
+    float sum = 0.0f;
+#ifdef IMAGERESAMPLER_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// 四通道：一个像素正好占一个 SSE 寄存器，按权重累加整个像素
+void dotPixel(float *dst, const float *pixels, const float *weights, int count)
+{
+#ifdef IMAGERESAMPLER_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < count; ++i) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(pixels + i * 4), _mm_set1_ps(weights[i])));
+    }
+    _mm_storeu_ps(dst, acc);
+#else
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            acc[c] += pixels[i * 4 + c] * weights[i];
+        }
+    }
+    std::copy(acc, acc + 4, dst);
+#endif
+}
+
+// acc += row * weight，整行处理
+void accumulate(float *acc, const float *row, float weight, int count)
+{
+    int i = 0;
+#ifdef IMAGERESAMPLER_SSE2
+    __m128 w = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(row + i), w)));
+    }
+#endif
+    for (; i < count; ++i) {
+        acc[i] += row[i] * weight;
+    }
+}
+
+void storeClamped(uchar *dst, const float *src, int count)
+{
+    int i = 0;
+#ifdef IMAGERESAMPLER_SSE2
+    // 四舍五入后饱和压缩到 0-255
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(src + i));
+        __m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), packed);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = uchar(qBound(0, qRound(src[i]), 255));
+    }
+}
+}
+
+QImage ImageResampler::resample(const QImage &image, const QSize &size, QThreadPool *pool)
+{
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+
+    // 单通道平面保持原格式；彩色统一转为预乘 RGBA，避免透明边缘出现色晕
+    QImage::Format format;
+    if (image.format() == QImage::Format_Alpha8 || image.format() == QImage::Format_Grayscale8) {
+        format = image.format();
+    } else {
+        format = image.hasAlphaChannel() ? QImage::Format_RGBA8888_Premultiplied : QImage::Format_RGBX8888;
+    }
+    QImage source = image.format() == format ? image : image.convertToFormat(format);
+    if (source.size() == size) {
+        return source;
+    }
+
+    const int channels = source.depth() / 8;
+    const int inWidth = source.width();
+    const int inHeight = source.height();
+    const int outWidth = size.width();
+    const int outHeight = size.height();
+    const int rowFloats = outWidth * channels;
+    const Contributions horizontal = buildContributions(inWidth, outWidth);
+    const Contributions vertical = buildContributions(inHeight, outHeight);
+    QImage result(size, format);
+    if (result.isNull()) {
+        return QImage();
+    }
+    // 先取得可写指针，各线程只写自己的行
+    uchar *resultBits = result.bits();
+    const qsizetype resultStride = result.bytesPerLine();
+
+    // 输出按行带分块：每块只水平滤波自己需要的输入行，中间结果留在缓存里，
+    // 块与块之间互不依赖，可直接分给线程池
+    auto processBand = [&](int y0, int y1) {
+        int firstRow = vertical.start[y0];
+        int lastRow = vertical.start[y1 - 1] + vertical.taps;
+        std::vector<float> intermediate(size_t(lastRow - firstRow) * rowFloats);
+        std::vector<float> rowBuffer(size_t(inWidth) * channels);
+
+        for (int y = firstRow; y < lastRow; ++y) {
+            const uchar *src = source.constScanLine(y);
+            for (int i = 0; i < inWidth * channels; ++i) {
+                rowBuffer[i] = src[i];
+            }
+            float *dst = intermediate.data() + size_t(y - firstRow) * rowFloats;
+            for (int x = 0; x < outWidth; ++x) {
+                const float *weights = horizontal.weights.data() + size_t(x) * horizontal.taps;
+                if (channels == 4) {
+                    dotPixel(dst + x * 4, rowBuffer.data() + horizontal.start[x] * 4, weights, horizontal.taps);
+                } else {
+                    dst[x] = dot(rowBuffer.data() + horizontal.start[x], weights, horizontal.taps);
+                }
+            }
+        }
+
+        std::vector<float> acc(rowFloats);
+        for (int y = y0; y < y1; ++y) {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            const float *weights = vertical.weights.data() + size_t(y) * vertical.taps;
+            for (int t = 0; t < vertical.taps; ++t) {
+                if (weights[t] != 0.0f) {
+                    int row = vertical.start[y] + t - firstRow;
+                    accumulate(acc.data(), intermediate.data() + size_t(row) * rowFloats, weights[t], rowFloats);
+                }
+            }
+            uchar *dst = resultBits + y * resultStride;
+            storeClamped(dst, acc.data(), rowFloats);
+            if (format == QImage::Format_RGBA8888_Premultiplied) {
+                // Lanczos 会过冲，预乘格式要求颜色不超过 alpha
+                for (int x = 0; x < outWidth; ++x) {
+                    uchar *pixel = dst + x * 4;
+                    pixel[0] = qMin(pixel[0], pixel[3]);
+                    pixel[1] = qMin(pixel[1], pixel[3]);
+                    pixel[2] = qMin(pixel[2], pixel[3]);
+                }
+            } else if (format == QImage::Format_RGBX8888) {
+                for (int x = 0; x < outWidth; ++x) {
+                    dst[x * 4 + 3] = 255;
+                }
+            }
+        }
+    };
+
+    const int bands = (outHeight + kBandRows - 1) / kBandRows;
+    if (!pool || bands == 1) {
+        processBand(0, outHeight);
+        return result;
+    }
+
+    QSemaphore bandsDone;
+    for (int band = 0; band < bands; ++band) {
+        int y0 = band * kBandRows;
+        int y1 = qMin(y0 + kBandRows, outHeight);
+        pool->start([&, y0, y1]() {
+            processBand(y0, y1);
+            bandsDone.release();
+        });
+    }
+    bandsDone.acquire(bands);
+    return result;
+}
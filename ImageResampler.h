@@ -0,0 +1,21 @@
+#ifndef IMAGERESAMPLER_H
+#define IMAGERESAMPLER_H
+
+#include <QImage>
+#include <QSize>
+
+class QThreadPool;
+
+// 可分离 Lanczos3 重采样，用于透明度平面和多尺寸输出。
+// 每个输出像素的权重数固定，水平方向按权重做点积、垂直方向按整行累加，
+// 两步都用 SSE2 一次处理 4 个浮点（四通道时正好一个像素）；没有 SSE2 的平台走标量实现
+class ImageResampler
+{
+public:
+    // Format_Alpha8 / Format_Grayscale8 按单通道处理并保持原格式；
+    // 其余格式转为 RGBA8888（有透明度时为预乘）后处理。
+    // 给出 pool 时按行带分块并行，调用方不能是该线程池中的线程
+    static QImage resample(const QImage &image, const QSize &size, QThreadPool *pool = nullptr);
+};
+
+#endif // IMAGERESAMPLER_H
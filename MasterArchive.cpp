@@ -0,0 +1,158 @@
+#include "MasterArchive.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+QString s_directory;
+
+QJsonObject toJson(const MasterEntry &entry)
+{
+    QJsonObject object;
+    object["key"] = entry.key;
+    object["input"] = entry.inputPath;
+    object["model"] = entry.modelName;
+    object["settings"] = entry.settings;
+    object["master"] = entry.masterPath;
+    object["summary"] = entry.summary;
+    object["width"] = entry.size.width();
+    object["height"] = entry.size.height();
+    object["bytes"] = double(entry.bytes);
+    object["created"] = entry.created.toString(Qt::ISODate);
+    return object;
+}
+
+MasterEntry fromJson(const QJsonObject &object)
+{
+    MasterEntry entry;
+    entry.key = object["key"].toString();
+    entry.inputPath = object["input"].toString();
+    entry.modelName = object["model"].toString();
+    entry.settings = object["settings"].toString();
+    entry.masterPath = object["master"].toString();
+    entry.summary = object["summary"].toString();
+    entry.size = QSize(object["width"].toInt(), object["height"].toInt());
+    entry.bytes = qint64(object["bytes"].toDouble());
+    entry.created = QDateTime::fromString(object["created"].toString(), Qt::ISODate);
+    return entry;
+}
+}
+
+QString MasterArchive::directory()
+{
+    if (!s_directory.isEmpty()) {
+        return s_directory;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath("masters");
+}
+
+void MasterArchive::setDirectory(const QString &path)
+{
+    s_directory = path;
+}
+
+QString MasterArchive::settingsFor(const ScaleTarget &target, int cropMode)
+{
+    return QString("%1:%2:%3x%4:%5%6:crop%7")
+        .arg(int(target.mode))
+        .arg(target.mode == ScaleTarget::Factor ? target.factor : 0)
+        .arg(target.size.width())
+        .arg(target.size.height())
+        .arg(target.allowPreDownscale ? 1 : 0)
+        .arg(target.allowModelSwitch ? 1 : 0)
+        .arg(cropMode);
+}
+
+QString MasterArchive::keyFor(const QString &inputPath, const QString &modelName, const QString &settings)
+{
+    QFileInfo info(inputPath);
+    QByteArray identity = QString("%1|%2|%3|%4|%5")
+                              .arg(info.absoluteFilePath())
+                              .arg(info.size())
+                              .arg(info.lastModified().toMSecsSinceEpoch())
+                              .arg(modelName, settings)
+                              .toUtf8();
+    return QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex().left(20);
+}
+
+QString MasterArchive::masterPathFor(const QString &key)
+{
+    return QDir(directory()).filePath(key + ".mkv");
+}
+
+QString MasterArchive::indexPath()
+{
+    return QDir(directory()).filePath("index.json");
+}
+
+MasterEntry MasterArchive::find(const QString &inputPath, const QString &modelName, const QString &settings)
+{
+    QString key = keyFor(inputPath, modelName, settings);
+    for (const MasterEntry &entry : entries()) {
+        if (entry.key == key && QFileInfo::exists(entry.masterPath)) {
+            return entry;
+        }
+    }
+    return MasterEntry();
+}
+
+QList<MasterEntry> MasterArchive::entries()
+{
+    QList<MasterEntry> result;
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+
+    const QJsonArray array = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue &value : array) {
+        result << fromJson(value.toObject());
+    }
+    return result;
+}
+
+bool MasterArchive::record(const MasterEntry &entry)
+{
+    QList<MasterEntry> all = entries();
+    for (int i = all.size() - 1; i >= 0; --i) {
+        if (all.at(i).key == entry.key) {
+            all.removeAt(i);
+        }
+    }
+    all << entry;
+    return saveEntries(all);
+}
+
+bool MasterArchive::remove(const QString &key)
+{
+    QList<MasterEntry> all = entries();
+    for (int i = all.size() - 1; i >= 0; --i) {
+        if (all.at(i).key == key) {
+            QFile::remove(all.at(i).masterPath);
+            all.removeAt(i);
+        }
+    }
+    return saveEntries(all);
+}
+
+bool MasterArchive::saveEntries(const QList<MasterEntry> &entries)
+{
+    QDir().mkpath(directory());
+    QJsonArray array;
+    for (const MasterEntry &entry : entries) {
+        array << toJson(entry);
+    }
+
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(array).toJson());
+    return file.commit();
+}
@@ -0,0 +1,50 @@
+#ifndef MASTERARCHIVE_H
+#define MASTERARCHIVE_H
+
+#include <QDateTime>
+#include <QList>
+#include <QSize>
+#include <QString>
+#include "ScalePlanner.h"
+
+// 增强结果的无损母版（FFV1 + MKV），按输入文件、模型和输出尺寸设置建立索引，
+// 之后换编码、码率或封装时直接从母版转码，不必再跑一遍超分
+struct MasterEntry {
+    QString key;
+    QString inputPath;
+    QString modelName;
+    QString settings; // 目标尺寸和黑边处理，见 settingsFor
+    QString masterPath;
+    QString summary; // 缩放方案等说明
+    QSize size;
+    qint64 bytes = 0;
+    QDateTime created;
+
+    bool isValid() const { return !masterPath.isEmpty(); }
+};
+
+class MasterArchive
+{
+public:
+    // 母版和索引所在目录，默认为应用数据目录下的 masters
+    static QString directory();
+    static void setDirectory(const QString &path);
+
+    // 决定母版画面尺寸的设置；目标尺寸或黑边处理不同的母版不能互相替代
+    static QString settingsFor(const ScaleTarget &target, int cropMode);
+    // 由输入文件的路径、大小、修改时间、模型名和 settingsFor 得出
+    static QString keyFor(const QString &inputPath, const QString &modelName, const QString &settings);
+    static QString masterPathFor(const QString &key);
+
+    // 找不到或母版文件已被删除时返回无效条目
+    static MasterEntry find(const QString &inputPath, const QString &modelName, const QString &settings);
+    static QList<MasterEntry> entries();
+    static bool record(const MasterEntry &entry);
+    static bool remove(const QString &key);
+
+private:
+    static QString indexPath();
+    static bool saveEntries(const QList<MasterEntry> &entries);
+};
+
+#endif // MASTERARCHIVE_H
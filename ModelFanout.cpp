@@ -0,0 +1,364 @@
+#include "ModelFanout.h"
+#include "ThroughputLedger.h"
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QDebug>
+
+namespace {
+// 总进度中抽帧所占的比例，其余按各方案平均
+const double kExtractWeight = 0.1;
+// 单个方案中增强所占的比例，编码完成前停在这里
+const double kEnhanceWeight = 0.9;
+}
+
+QString ModelFanout::Variant::label() const
+{
+    return scale > 0 ? QString("%1_x%2").arg(modelName).arg(scale) : modelName;
+}
+
+ModelFanout::ModelFanout(QObject *parent) : QObject(parent)
+{
+}
+
+void ModelFanout::setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath,
+                                     const QString &ffprobePath)
+{
+    m_realesrganPath = realesrganPath;
+    m_ffmpegPath = ffmpegPath;
+    m_ffprobePath = ffprobePath;
+}
+
+void ModelFanout::setAvailableModels(const QStringList &models)
+{
+    m_availableModels = models;
+}
+
+void ModelFanout::setEncodeSettings(const VideoProcessor::EncodeSettings &settings)
+{
+    m_encodeSettings = settings;
+}
+
+void ModelFanout::setParallelism(int count)
+{
+    m_parallelism = qMax(1, count);
+}
+
+QList<ModelFanout::Variant> ModelFanout::parseVariants(const QString &text, bool *ok)
+{
+    QList<Variant> variants;
+    bool valid = true;
+    for (const QString &item : text.split(QRegularExpression("[,;，；]"), Qt::SkipEmptyParts)) {
+        QStringList parts = item.trimmed().split(':');
+        if (parts.first().trimmed().isEmpty() || parts.size() > 2) {
+            valid = false;
+            break;
+        }
+
+        Variant variant;
+        variant.modelName = parts.first().trimmed();
+        if (parts.size() == 2) {
+            bool scaleOk = false;
+            variant.scale = parts.at(1).trimmed().toInt(&scaleOk);
+            if (!scaleOk || variant.scale < 1 || variant.scale > 8) {
+                valid = false;
+                break;
+            }
+        }
+        variants << variant;
+    }
+
+    if (ok) {
+        *ok = valid && !variants.isEmpty();
+    }
+    return valid ? variants : QList<Variant>();
+}
+
+VideoProcessor *ModelFanout::createProcessor()
+{
+    VideoProcessor *processor = new VideoProcessor(this);
+    processor->setStageControlled(true);
+    processor->setEncodeSettings(m_encodeSettings);
+    if (!m_realesrganPath.isEmpty()) {
+        processor->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+    }
+    return processor;
+}
+
+bool ModelFanout::start(const QString &inputPath, const QList<Variant> &variants)
+{
+    if (m_running || variants.isEmpty()) {
+        return false;
+    }
+
+    for (const Run &run : m_runs) {
+        if (run.processor) {
+            run.processor->deleteLater();
+        }
+    }
+    m_runs.clear();
+    for (const Variant &variant : variants) {
+        Run run;
+        run.variant = variant;
+        m_runs << run;
+    }
+    m_inputPath = inputPath;
+    m_running = true;
+    m_extracted = false;
+    m_extractPercent = 0;
+    m_extractMs = 0;
+    m_frameCount = 0;
+    m_timer.start();
+
+    // 抽帧只做一次，不裁剪也不预缩放，所有方案都能直接使用
+    m_extractor = createProcessor();
+    connect(m_extractor, &VideoProcessor::errorOccurred, this, [this](const QString &error) {
+        if (!m_running) {
+            return;
+        }
+        qWarning() << "Fan-out extraction failed:" << error;
+        cancel();
+        emit finished(false, QString("抽帧失败: %1").arg(error));
+    });
+    connect(m_extractor, &VideoProcessor::progressPercentageChanged, this, [this](double percent) {
+        m_extractPercent = percent;
+        updateProgress();
+    });
+    connect(m_extractor, &VideoProcessor::progressUpdated, this, &ModelFanout::progressUpdated);
+    connect(m_extractor, &VideoProcessor::prepared, this, [this]() {
+        m_extractor->runStage(VideoProcessor::StageExtract);
+    });
+    connect(m_extractor, &VideoProcessor::stageFinished, this, [this](VideoProcessor::Stage stage) {
+        if (stage == VideoProcessor::StageExtract) {
+            QMetaObject::invokeMethod(this, [this]() { handleExtracted(); }, Qt::QueuedConnection);
+        }
+    });
+
+    const Variant &first = variants.first();
+    int scale = first.scale > 0 ? first.scale : ScalePlanner::nativeScale(first.modelName);
+    // 失败时 errorOccurred 会结束本次对比
+    m_extractor->prepare(inputPath, first.modelName, scale, "png", false);
+    return true;
+}
+
+void ModelFanout::cancel()
+{
+    m_running = false;
+    for (Run &run : m_runs) {
+        if (run.processor) {
+            disconnect(run.processor, nullptr, this, nullptr);
+            run.processor->cancelProcessing();
+            run.processor->deleteLater();
+            run.processor = nullptr;
+        }
+        if (run.state != Done) {
+            run.state = Failed;
+        }
+    }
+    if (m_extractor) {
+        disconnect(m_extractor, nullptr, this, nullptr);
+        m_extractor->cancelProcessing();
+        m_extractor->deleteLater();
+        m_extractor = nullptr;
+    }
+}
+
+void ModelFanout::handleExtracted()
+{
+    if (!m_running || !m_extractor) {
+        return;
+    }
+
+    m_extracted = true;
+    m_extractPercent = 100;
+    m_extractMs = m_extractor->stageMs(VideoProcessor::StageExtract);
+    m_frameCount = m_extractor->frameCount();
+    emit progressUpdated(QString("已抽取 %1 帧，%2 个方案共用").arg(m_frameCount).arg(m_runs.size()));
+    schedule();
+}
+
+void ModelFanout::schedule()
+{
+    if (!m_running || !m_extracted) {
+        return;
+    }
+
+    int enhancing = 0;
+    for (const Run &run : m_runs) {
+        if (run.state == Enhancing) {
+            ++enhancing;
+        }
+    }
+
+    for (int i = 0; i < m_runs.size() && enhancing < m_parallelism; ++i) {
+        if (m_runs[i].state != Waiting) {
+            continue;
+        }
+
+        const Variant variant = m_runs[i].variant;
+        VideoProcessor *processor = createProcessor();
+        m_runs[i].processor = processor;
+        m_runs[i].state = Enhancing;
+        ++enhancing;
+
+        ScaleTarget target;
+        if (variant.scale > 0) {
+            target.mode = ScaleTarget::Factor;
+            target.factor = variant.scale;
+        }
+        processor->setScaleTarget(target, m_availableModels);
+        processor->setOutputTag(variant.label());
+        connect(processor, &VideoProcessor::stageFinished, this, [this, i](VideoProcessor::Stage stage) {
+            handleStageFinished(i, stage);
+        });
+        connect(processor, &VideoProcessor::errorOccurred, this, [this, i](const QString &error) {
+            handleRunError(i, error);
+        });
+        connect(processor, &VideoProcessor::progressPercentageChanged, this, [this, i](double percent) {
+            if (m_runs[i].state == Enhancing) {
+                m_runs[i].percent = percent * kEnhanceWeight;
+                updateProgress();
+            }
+        });
+
+        int scale = variant.scale > 0 ? variant.scale : ScalePlanner::nativeScale(variant.modelName);
+        if (!processor->prepareShared(m_extractor, variant.modelName, scale, "png")) {
+            // errorOccurred 已将该方案标记为失败
+            --enhancing;
+            continue;
+        }
+        emit progressUpdated(QString("正在增强：%1").arg(variant.label()));
+        processor->runStage(VideoProcessor::StageEnhance);
+    }
+
+    releaseSharedFrames();
+}
+
+void ModelFanout::handleStageFinished(int index, VideoProcessor::Stage stage)
+{
+    Run &run = m_runs[index];
+    if (stage == VideoProcessor::StageEnhance) {
+        run.enhanceMs = run.processor->stageMs(VideoProcessor::StageEnhance);
+        run.state = Encoding;
+        run.percent = 100 * kEnhanceWeight;
+        emit progressUpdated(QString("%1 增强完成，正在编码").arg(run.variant.label()));
+        updateProgress();
+
+        // 不在信号发射过程中进入下一阶段；编码与下一个方案的增强并行
+        VideoProcessor *processor = run.processor;
+        QMetaObject::invokeMethod(this, [this, processor]() {
+            if (!m_running) {
+                return;
+            }
+            processor->runStage(VideoProcessor::StageRebuild);
+            schedule();
+        }, Qt::QueuedConnection);
+    } else if (stage == VideoProcessor::StageRebuild) {
+        run.encodeMs = run.processor->stageMs(VideoProcessor::StageRebuild);
+        run.outputPath = run.processor->outputPath();
+        run.state = Done;
+        run.percent = 100;
+        updateProgress();
+        QMetaObject::invokeMethod(this, [this]() { checkFinished(); }, Qt::QueuedConnection);
+    }
+}
+
+void ModelFanout::handleRunError(int index, const QString &error)
+{
+    Run &run = m_runs[index];
+    qWarning() << "Fan-out variant failed:" << run.variant.label() << error;
+    run.state = Failed;
+    run.error = error;
+    run.percent = 100;
+    if (run.processor) {
+        VideoProcessor *processor = run.processor;
+        run.processor = nullptr;
+        disconnect(processor, nullptr, this, nullptr);
+        processor->cancelProcessing();
+        processor->deleteLater();
+    }
+
+    QMetaObject::invokeMethod(this, [this]() {
+        schedule();
+        checkFinished();
+    }, Qt::QueuedConnection);
+}
+
+void ModelFanout::releaseSharedFrames()
+{
+    if (!m_extractor) {
+        return;
+    }
+    for (const Run &run : m_runs) {
+        if (run.state == Waiting || run.state == Enhancing) {
+            return;
+        }
+    }
+    // 所有方案都已增强完，析构时在后台删除共享的帧
+    m_extractor->deleteLater();
+    m_extractor = nullptr;
+}
+
+void ModelFanout::updateProgress()
+{
+    double total = 0;
+    for (const Run &run : m_runs) {
+        total += run.percent;
+    }
+    double runs = m_runs.isEmpty() ? 0 : total / m_runs.size();
+    emit progressPercentageChanged(m_extractPercent * kExtractWeight + runs * (1 - kExtractWeight));
+}
+
+void ModelFanout::checkFinished()
+{
+    if (!m_running) {
+        return;
+    }
+
+    bool anyDone = false;
+    for (const Run &run : m_runs) {
+        if (run.state == Waiting || run.state == Enhancing || run.state == Encoding) {
+            return;
+        }
+        anyDone = anyDone || run.state == Done;
+    }
+
+    m_running = false;
+    releaseSharedFrames();
+    for (Run &run : m_runs) {
+        if (run.processor) {
+            run.processor->deleteLater();
+            run.processor = nullptr;
+        }
+    }
+
+    QString text = report();
+    qDebug().noquote() << text;
+    emit progressPercentageChanged(100);
+    emit finished(anyDone, text);
+}
+
+QString ModelFanout::report() const
+{
+    QStringList lines;
+    lines << QString("多模型对比 %1：共 %2 帧，抽帧 %3（各方案共用）")
+                 .arg(QFileInfo(m_inputPath).fileName())
+                 .arg(m_frameCount)
+                 .arg(ThroughputLedger::formatDuration(m_extractMs));
+
+    for (const Run &run : m_runs) {
+        if (run.state != Done) {
+            lines << QString("%1：失败 - %2").arg(run.variant.label(), run.error);
+            continue;
+        }
+        double fps = run.enhanceMs > 0 ? m_frameCount * 1000.0 / run.enhanceMs : 0;
+        lines << QString("%1：增强 %2（%3 帧/秒），编码 %4 → %5")
+                     .arg(run.variant.label(), ThroughputLedger::formatDuration(run.enhanceMs))
+                     .arg(fps, 0, 'f', 2)
+                     .arg(ThroughputLedger::formatDuration(run.encodeMs), run.outputPath);
+    }
+
+    lines << QString("总耗时 %1，逐个处理需再抽帧 %2 次")
+                 .arg(ThroughputLedger::formatDuration(m_timer.elapsed()))
+                 .arg(m_runs.size() - 1);
+    return lines.join("\n");
+}
@@ -0,0 +1,90 @@
+#ifndef MODELFANOUT_H
+#define MODELFANOUT_H
+
+#include <QObject>
+#include <QList>
+#include <QElapsedTimer>
+#include "VideoProcessor.h"
+
+// 多模型对比：同一视频只探测和抽帧一次，抽出的帧交给多个模型/倍率方案分别增强并各自编码，
+// 全部方案增强完成后才释放共享的帧。结束时并排给出各方案的增强吞吐和输出
+class ModelFanout : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Variant {
+        QString modelName;
+        int scale = 0; // 0 为模型原生倍率
+        QString label() const;
+    };
+
+    explicit ModelFanout(QObject *parent = nullptr);
+
+    void setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath, const QString &ffprobePath);
+    void setAvailableModels(const QStringList &models);
+    void setEncodeSettings(const VideoProcessor::EncodeSettings &settings);
+    // 同时增强的方案数；为 1 时逐个增强，上一个方案的编码与下一个方案的增强重叠
+    void setParallelism(int count);
+
+    bool start(const QString &inputPath, const QList<Variant> &variants);
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    // 格式：模型[:倍率]，逗号分隔
+    static QList<Variant> parseVariants(const QString &text, bool *ok = nullptr);
+
+signals:
+    void progressUpdated(const QString &message);
+    void progressPercentageChanged(double percent);
+    void finished(bool ok, const QString &report);
+
+private:
+    enum RunState {
+        Waiting,
+        Enhancing,
+        Encoding,
+        Done,
+        Failed
+    };
+
+    struct Run {
+        Variant variant;
+        VideoProcessor *processor = nullptr;
+        RunState state = Waiting;
+        double percent = 0;
+        QString outputPath;
+        QString error;
+        qint64 enhanceMs = 0;
+        qint64 encodeMs = 0;
+    };
+
+    VideoProcessor *createProcessor();
+    void handleExtracted();
+    void schedule();
+    void handleStageFinished(int index, VideoProcessor::Stage stage);
+    void handleRunError(int index, const QString &error);
+    void releaseSharedFrames();
+    void updateProgress();
+    void checkFinished();
+    QString report() const;
+
+    QString m_realesrganPath;
+    QString m_ffmpegPath;
+    QString m_ffprobePath;
+    QStringList m_availableModels;
+    VideoProcessor::EncodeSettings m_encodeSettings;
+    int m_parallelism = 1;
+
+    QString m_inputPath;
+    VideoProcessor *m_extractor = nullptr;
+    QList<Run> m_runs;
+    bool m_running = false;
+    bool m_extracted = false;
+    double m_extractPercent = 0;
+    qint64 m_extractMs = 0;
+    int m_frameCount = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif // MODELFANOUT_H
@@ -0,0 +1,380 @@
+#include "NcnnUpscaleBackend.h"
+#include "ConcurrencyController.h"
+#include "PngWriter.h"
+#include "PriorityScheduler.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtMath>
+#include <QDebug>
+#include <cstring>
+#include <vector>
+
+#ifdef HAVE_NCNN
+#include "net.h"
+#endif
+
+namespace {
+// 分块边缘多取的像素，避免块与块之间出现接缝
+const int kPrepadding = 10;
+// 分块边长范围：小图也要拆成足够多的块让所有线程都有活干
+const int kMinTileSize = 64;
+const int kMaxTileSize = 200;
+const QStringList kImageFilters = {"*.png", "*.jpg", "*.jpeg", "*.webp", "*.bmp"};
+}
+
+NcnnUpscaleBackend::NcnnUpscaleBackend()
+{
+    m_computePool.setMaxThreadCount(QThread::idealThreadCount());
+    m_driverPool.setMaxThreadCount(2);
+}
+
+NcnnUpscaleBackend::~NcnnUpscaleBackend()
+{
+    m_driverPool.waitForDone();
+    m_computePool.waitForDone();
+}
+
+bool NcnnUpscaleBackend::isAvailable(QString *reason) const
+{
+#ifdef HAVE_NCNN
+    Q_UNUSED(reason)
+    return true;
+#else
+    if (reason) {
+        *reason = "编译时未启用 ncnn（HAVE_NCNN）";
+    }
+    return false;
+#endif
+}
+
+UpscaleTask *NcnnUpscaleBackend::createTask(const UpscaleRequest &request, QObject *parent)
+{
+    ensureController();
+    return new NcnnUpscaleTask(this, request, parent);
+}
+
+void NcnnUpscaleBackend::setAdaptiveThreads(bool enabled)
+{
+    m_adaptiveThreads = enabled;
+    ensureController();
+}
+
+void NcnnUpscaleBackend::ensureController()
+{
+    // 控制器的定时器需要事件循环，后端是静态对象，所以延迟到界面线程第一次用到时创建
+    if (!m_controller && QCoreApplication::instance()) {
+        m_controller = new ConcurrencyController("ncnn 分块", 1, QThread::idealThreadCount(),
+                                                 QCoreApplication::instance());
+        QObject::connect(m_controller.data(), &ConcurrencyController::limitChanged,
+                         [this](int limit) { m_computePool.setMaxThreadCount(limit); });
+    }
+    if (m_controller) {
+        m_controller->setEnabled(m_adaptiveThreads);
+    }
+}
+
+void NcnnUpscaleBackend::setModelSearchPaths(const QStringList &paths)
+{
+    QMutexLocker locker(&m_mutex);
+    m_searchPaths = paths;
+}
+
+QStringList NcnnUpscaleBackend::modelSearchPaths() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_searchPaths.isEmpty()) {
+        return m_searchPaths;
+    }
+
+    // 默认与 realesrgan-ncnn-vulkan 使用同一份模型文件
+    QStringList paths;
+    paths << QDir(QCoreApplication::applicationDirPath()).filePath("models")
+          << QDir::current().filePath("models");
+    QString cliPath = QStandardPaths::findExecutable(UpscaleBackend::defaultExecutablePath());
+    if (!cliPath.isEmpty()) {
+        paths << QDir(QFileInfo(cliPath).absolutePath()).filePath("models");
+    }
+    return paths;
+}
+
+QString NcnnUpscaleBackend::findModelFile(const QString &fileName) const
+{
+    for (const QString &dir : modelSearchPaths()) {
+        QString path = QDir(dir).filePath(fileName);
+        if (QFileInfo::exists(path)) {
+            return path;
+        }
+    }
+    return QString();
+}
+
+void NcnnUpscaleBackend::unloadModels()
+{
+    QMutexLocker locker(&m_mutex);
+    // 正在使用的任务持有 shared_ptr，结束后才真正释放
+    m_models.clear();
+}
+
+std::shared_ptr<ncnn::Net> NcnnUpscaleBackend::loadModel(const QString &modelName, QString *error)
+{
+#ifdef HAVE_NCNN
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_models.constFind(modelName);
+        if (it != m_models.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QString paramPath = findModelFile(modelName + ".param");
+    QString binPath = findModelFile(modelName + ".bin");
+    if (paramPath.isEmpty() || binPath.isEmpty()) {
+        *error = QString("找不到模型文件 %1.param/.bin").arg(modelName);
+        return nullptr;
+    }
+
+    std::shared_ptr<ncnn::Net> net = std::make_shared<ncnn::Net>();
+    net->opt.use_vulkan_compute = false;
+    // 并行放在分块层面，单个提取器只用一个线程
+    net->opt.num_threads = 1;
+    if (net->load_param(QFile::encodeName(paramPath).constData()) != 0
+        || net->load_model(QFile::encodeName(binPath).constData()) != 0) {
+        *error = QString("加载模型失败: %1").arg(paramPath);
+        return nullptr;
+    }
+    qDebug() << "ncnn model loaded:" << paramPath;
+
+    QMutexLocker locker(&m_mutex);
+    // 另一个任务可能同时加载了同一模型，以先到的为准
+    auto it = m_models.constFind(modelName);
+    if (it != m_models.constEnd()) {
+        return it.value();
+    }
+    m_models.insert(modelName, net);
+    return net;
+#else
+    Q_UNUSED(modelName)
+    *error = "编译时未启用 ncnn（HAVE_NCNN）";
+    return nullptr;
+#endif
+}
+
+QImage NcnnUpscaleBackend::upscale(const QImage &image, ncnn::Net *net, int scale,
+                                   const std::atomic<bool> &cancelled, QString *error)
+{
+#ifdef HAVE_NCNN
+    QImage input = image.convertToFormat(QImage::Format_RGB888);
+    const int width = input.width();
+    const int height = input.height();
+    QImage output(width * scale, height * scale, QImage::Format_RGB888);
+    if (output.isNull()) {
+        *error = QString("无法分配 %1x%2 的输出图像").arg(width * scale).arg(height * scale);
+        return QImage();
+    }
+
+    // 先取得可写指针，保证各线程写入的是同一块已分离的内存
+    uchar *outBits = output.bits();
+    const qsizetype outStride = output.bytesPerLine();
+    const uchar *inBits = input.constBits();
+    const qsizetype inStride = input.bytesPerLine();
+
+    int threads = qMax(1, m_computePool.maxThreadCount());
+    int tileSize = qBound(kMinTileSize, qCeil(std::sqrt(double(width) * height / threads)), kMaxTileSize);
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    std::atomic<bool> failed{false};
+    QSemaphore tilesDone;
+    ConcurrencyController *controller = m_controller.data();
+    if (controller) {
+        // 排队的分块数即为可并行的需求
+        controller->setDemand(m_pendingTiles += tilesX * tilesY);
+    }
+    static const float normIn[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
+    static const float normOut[3] = {255.f, 255.f, 255.f};
+
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            m_computePool.start([&, tx, ty]() {
+                if (cancelled || failed) {
+                    tilesDone.release();
+                    return;
+                }
+
+                int x0 = tx * tileSize;
+                int y0 = ty * tileSize;
+                int x1 = qMin(x0 + tileSize, width);
+                int y1 = qMin(y0 + tileSize, height);
+                int px0 = qMax(x0 - kPrepadding, 0);
+                int py0 = qMax(y0 - kPrepadding, 0);
+                int px1 = qMin(x1 + kPrepadding, width);
+                int py1 = qMin(y1 + kPrepadding, height);
+
+                // 直接在原图内存上按 stride 取子区域，不额外拷贝
+                ncnn::Mat in = ncnn::Mat::from_pixels(inBits + py0 * inStride + px0 * 3,
+                                                      ncnn::Mat::PIXEL_RGB, px1 - px0, py1 - py0,
+                                                      int(inStride));
+                in.substract_mean_normalize(nullptr, normIn);
+
+                ncnn::Extractor extractor = net->create_extractor();
+                extractor.input("data", in);
+                ncnn::Mat out;
+                if (extractor.extract("output", out) != 0
+                    || out.w != (px1 - px0) * scale || out.h != (py1 - py0) * scale) {
+                    failed = true;
+                    tilesDone.release();
+                    return;
+                }
+                out.substract_mean_normalize(nullptr, normOut);
+
+                std::vector<unsigned char> pixels(size_t(out.w) * out.h * 3);
+                out.to_pixels(pixels.data(), ncnn::Mat::PIXEL_RGB);
+
+                // 只写回去掉预留边缘后的中心区域
+                int srcX = (x0 - px0) * scale;
+                int srcY = (y0 - py0) * scale;
+                int copyWidth = (x1 - x0) * scale;
+                int copyHeight = (y1 - y0) * scale;
+                for (int row = 0; row < copyHeight; ++row) {
+                    std::memcpy(outBits + qsizetype(y0 * scale + row) * outStride + qsizetype(x0) * scale * 3,
+                                pixels.data() + (size_t(srcY + row) * out.w + srcX) * 3,
+                                size_t(copyWidth) * 3);
+                }
+                if (controller) {
+                    controller->addWork((x1 - x0) * double(y1 - y0) / 1e6);
+                }
+                tilesDone.release();
+            });
+        }
+    }
+    tilesDone.acquire(tilesX * tilesY);
+    if (controller) {
+        controller->setDemand(m_pendingTiles -= tilesX * tilesY);
+    }
+
+    if (cancelled) {
+        *error = "已取消";
+        return QImage();
+    }
+    if (failed) {
+        *error = "ncnn 推理失败";
+        return QImage();
+    }
+    return output;
+#else
+    Q_UNUSED(image)
+    Q_UNUSED(net)
+    Q_UNUSED(scale)
+    Q_UNUSED(cancelled)
+    *error = "编译时未启用 ncnn（HAVE_NCNN）";
+    return QImage();
+#endif
+}
+
+NcnnUpscaleTask::NcnnUpscaleTask(NcnnUpscaleBackend *backend, const UpscaleRequest &request,
+                                 QObject *parent)
+    : UpscaleTask(request, parent), m_backend(backend)
+{
+}
+
+NcnnUpscaleTask::~NcnnUpscaleTask()
+{
+    // 调度线程最多再跑完当前分块
+    cancel();
+    if (m_started) {
+        m_done.acquire();
+    }
+}
+
+void NcnnUpscaleTask::start()
+{
+    QString reason;
+    if (!m_backend->isAvailable(&reason)) {
+        m_errorString = reason;
+        QMetaObject::invokeMethod(this, [this]() { emit finished(false); }, Qt::QueuedConnection);
+        return;
+    }
+
+    // 交互式任务在调度线程池里排在后台任务前面
+    PriorityScheduler::Priority priority = PriorityScheduler::priorityOf(this);
+    m_background = priority == PriorityScheduler::Background;
+    m_started = true;
+    m_backend->driverPool()->start([this]() {
+        run();
+        m_done.release();
+    }, int(priority));
+}
+
+void NcnnUpscaleTask::cancel()
+{
+    m_cancelled = true;
+}
+
+void NcnnUpscaleTask::run()
+{
+    QStringList inputs;
+    QStringList outputs;
+    if (QFileInfo(m_request.inputPath).isDir()) {
+        QDir inputDir(m_request.inputPath);
+        QDir outputDir(m_request.outputPath);
+        outputDir.mkpath(".");
+        for (const QString &name : inputDir.entryList(kImageFilters, QDir::Files, QDir::Name)) {
+            inputs << inputDir.filePath(name);
+            outputs << outputDir.filePath(QFileInfo(name).completeBaseName() + "." + m_request.outputFormat);
+        }
+    } else {
+        inputs << m_request.inputPath;
+        outputs << m_request.outputPath;
+    }
+
+    QString error;
+    std::shared_ptr<ncnn::Net> net = m_backend->loadModel(m_request.modelName, &error);
+    bool ok = net != nullptr;
+
+    for (int i = 0; ok && i < inputs.size(); ++i) {
+        if (m_background) {
+            PriorityScheduler::waitWhilePreempted(m_cancelled);
+        }
+        if (m_cancelled) {
+            error = "已取消";
+            ok = false;
+            break;
+        }
+
+        QImage image(inputs.at(i));
+        if (image.isNull()) {
+            error = QString("无法读取图像: %1").arg(inputs.at(i));
+            ok = false;
+            break;
+        }
+
+        QImage result = m_backend->upscale(image, net.get(), m_request.scale, m_cancelled, &error);
+        if (result.isNull()) {
+            ok = false;
+            break;
+        }
+
+        // PNG 输出大多是中间帧或多遍串联的临时文件，按请求的用途选择压缩级别
+        QString format = QFileInfo(outputs.at(i)).suffix().toLower();
+        bool saved = format == "png"
+                         ? PngWriter::write(result, outputs.at(i), m_request.purpose)
+                         : result.save(outputs.at(i), nullptr, format == "webp" ? 90 : 95);
+        if (!saved) {
+            error = QString("无法写入: %1").arg(outputs.at(i));
+            ok = false;
+            break;
+        }
+
+        double percent = (i + 1) * 100.0 / inputs.size();
+        QMetaObject::invokeMethod(this, [this, percent]() { emit progress(percent); }, Qt::QueuedConnection);
+    }
+
+    if (!ok) {
+        m_errorString = error;
+    }
+    QMetaObject::invokeMethod(this, [this, ok]() { emit finished(ok); }, Qt::QueuedConnection);
+}
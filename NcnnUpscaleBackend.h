@@ -0,0 +1,82 @@
+#ifndef NCNNUPSCALEBACKEND_H
+#define NCNNUPSCALEBACKEND_H
+
+#include "UpscaleBackend.h"
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPointer>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+namespace ncnn { class Net; }
+class ConcurrencyController;
+
+// 进程内 CPU 推理：直接加载 models 目录下同名的 .param/.bin，
+// 模型加载一次后常驻，分块推理在线程池上并行执行（卷积核由 ncnn 的 SIMD 实现）。
+// 未定义 HAVE_NCNN 时该后端不可用
+class NcnnUpscaleBackend : public UpscaleBackend
+{
+public:
+    NcnnUpscaleBackend();
+    ~NcnnUpscaleBackend();
+
+    Kind kind() const override { return NcnnCpuBackend; }
+    QString name() const override { return "ncnn CPU"; }
+    bool isAvailable(QString *reason = nullptr) const override;
+    UpscaleTask *createTask(const UpscaleRequest &request, QObject *parent) override;
+
+    void setModelSearchPaths(const QStringList &paths);
+    QStringList modelSearchPaths() const;
+    // 释放所有常驻模型
+    void unloadModels();
+    // 开启后分块线程数在 1 到 CPU 线程数之间按实测吞吐自动调整
+    void setAdaptiveThreads(bool enabled);
+
+    // 以下在工作线程调用
+    std::shared_ptr<ncnn::Net> loadModel(const QString &modelName, QString *error);
+    QImage upscale(const QImage &image, ncnn::Net *net, int scale, const std::atomic<bool> &cancelled,
+                   QString *error);
+    QThreadPool *driverPool() { return &m_driverPool; }
+
+private:
+    QString findModelFile(const QString &fileName) const;
+    void ensureController();
+
+    mutable QMutex m_mutex;
+    QStringList m_searchPaths;
+    QHash<QString, std::shared_ptr<ncnn::Net>> m_models;
+    // 分块推理
+    QThreadPool m_computePool;
+    // 每个任务一个调度线程，负责读写文件和拆分分块
+    QThreadPool m_driverPool;
+    // 在界面线程创建，控制分块线程数
+    QPointer<ConcurrencyController> m_controller;
+    bool m_adaptiveThreads = false;
+    std::atomic<int> m_pendingTiles{0};
+};
+
+class NcnnUpscaleTask : public UpscaleTask
+{
+    Q_OBJECT
+
+public:
+    NcnnUpscaleTask(NcnnUpscaleBackend *backend, const UpscaleRequest &request, QObject *parent = nullptr);
+    ~NcnnUpscaleTask();
+
+    void start() override;
+    void cancel() override;
+
+private:
+    void run();
+
+    NcnnUpscaleBackend *m_backend;
+    std::atomic<bool> m_cancelled{false};
+    bool m_background = false; // 后台任务在帧之间让位给交互式作业
+    bool m_started = false;
+    QSemaphore m_done;
+};
+
+#endif // NCNNUPSCALEBACKEND_H
@@ -0,0 +1,331 @@
+#include "PngWriter.h"
+#include <QBuffer>
+#include <QSaveFile>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(HAVE_QT_ZLIB)
+#include <QtZlib/zlib.h>
+#elif defined(HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+std::atomic<int> s_deliverableLevel{PngWriter::Balanced};
+
+#ifdef HAVE_ZLIB
+// 每带大约 1MB 原始数据，小图只有一带时直接在调用线程完成
+const int kBandBytes = 1 << 20;
+// deflate 的窗口大小，也是每带预置字典的长度
+const int kWindowSize = 32768;
+
+struct LevelParams {
+    int zlibLevel;
+    int strategy;
+    bool adaptiveFilter;
+    int headerLevel; // zlib 头中的 FLEVEL
+};
+
+LevelParams levelParams(PngWriter::Level level)
+{
+    switch (level) {
+    case PngWriter::Fastest:
+        // 过滤后的图像数据以短重复为主，RLE 比完整匹配快得多
+        return {1, Z_RLE, false, 0};
+    case PngWriter::Balanced:
+        return {3, Z_DEFAULT_STRATEGY, true, 1};
+    case PngWriter::Smallest:
+        return {7, Z_FILTERED, true, 2};
+    }
+    return {3, Z_DEFAULT_STRATEGY, true, 1};
+}
+
+uchar paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return uchar(a);
+    }
+    return uchar(pb <= pc ? b : c);
+}
+
+// 按 PNG 过滤类型写出一行（首字节为类型），prev 为空表示第一行
+void applyFilter(uchar *dst, int type, const uchar *row, const uchar *prev, int rowBytes, int bpp)
+{
+    dst[0] = uchar(type);
+    uchar *out = dst + 1;
+    for (int i = 0; i < rowBytes; ++i) {
+        int left = i >= bpp ? row[i - bpp] : 0;
+        int up = prev ? prev[i] : 0;
+        int upLeft = (prev && i >= bpp) ? prev[i - bpp] : 0;
+        switch (type) {
+        case 0:
+            out[i] = row[i];
+            break;
+        case 1:
+            out[i] = uchar(row[i] - left);
+            break;
+        case 2:
+            out[i] = uchar(row[i] - up);
+            break;
+        case 3:
+            out[i] = uchar(row[i] - ((left + up) >> 1));
+            break;
+        default:
+            out[i] = uchar(row[i] - paeth(left, up, upLeft));
+            break;
+        }
+    }
+}
+
+// 自适应过滤：取按有符号字节绝对值之和最小的类型
+void filterRow(uchar *dst, std::vector<uchar> &scratch, const uchar *row, const uchar *prev,
+               int rowBytes, int bpp, bool adaptive)
+{
+    if (!adaptive) {
+        applyFilter(dst, 2, row, prev, rowBytes, bpp);
+        return;
+    }
+
+    quint64 bestSum = ~quint64(0);
+    scratch.resize(size_t(rowBytes) + 1);
+    for (int type = 0; type < 5; ++type) {
+        applyFilter(scratch.data(), type, row, prev, rowBytes, bpp);
+        quint64 sum = 0;
+        for (int i = 1; i <= rowBytes && sum < bestSum; ++i) {
+            sum += std::abs(int(static_cast<signed char>(scratch[i])));
+        }
+        if (sum < bestSum) {
+            bestSum = sum;
+            std::memcpy(dst, scratch.data(), size_t(rowBytes) + 1);
+        }
+    }
+}
+
+struct BandResult {
+    std::vector<uchar> deflated;
+    uLong adler = 1;
+    uLong length = 0;
+    bool ok = false;
+};
+
+// 过滤并压缩 [y0, y1) 行。非最后一带以同步刷新结束，保证各带输出可以直接拼接
+void encodeBand(const QImage &image, int bpp, int y0, int y1, bool last, const LevelParams &params,
+                BandResult &result)
+{
+    const int rowBytes = image.width() * bpp;
+    const int filteredRow = rowBytes + 1;
+    // 重新过滤上一带末尾的若干行作为字典，过滤结果与上一带完全一致
+    const int dictRows = y0 == 0 ? 0 : qMin(y0, (kWindowSize + filteredRow - 1) / filteredRow);
+    const int firstRow = y0 - dictRows;
+
+    std::vector<uchar> filtered(size_t(y1 - firstRow) * filteredRow);
+    std::vector<uchar> scratch;
+    for (int y = firstRow; y < y1; ++y) {
+        filterRow(filtered.data() + size_t(y - firstRow) * filteredRow, scratch, image.constScanLine(y),
+                  y > 0 ? image.constScanLine(y - 1) : nullptr, rowBytes, bpp, params.adaptiveFilter);
+    }
+
+    const uchar *data = filtered.data() + size_t(dictRows) * filteredRow;
+    result.length = uLong(y1 - y0) * filteredRow;
+    result.adler = adler32(adler32(0, Z_NULL, 0), data, uInt(result.length));
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, params.zlibLevel, Z_DEFLATED, -15, 8, params.strategy) != Z_OK) {
+        return;
+    }
+    if (dictRows > 0) {
+        uInt dictLength = uInt(qMin<size_t>(kWindowSize, size_t(dictRows) * filteredRow));
+        deflateSetDictionary(&stream, data - dictLength, dictLength);
+    }
+
+    // deflateBound 按 Z_FINISH 估算，同步刷新额外多几个字节
+    result.deflated.resize(deflateBound(&stream, result.length) + 64);
+    stream.next_in = const_cast<uchar *>(data);
+    stream.avail_in = uInt(result.length);
+    stream.next_out = result.deflated.data();
+    stream.avail_out = uInt(result.deflated.size());
+    int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    result.ok = last ? status == Z_STREAM_END : (status == Z_OK && stream.avail_in == 0);
+    result.deflated.resize(result.deflated.size() - stream.avail_out);
+    deflateEnd(&stream);
+}
+
+void appendUint32(QByteArray &out, quint32 value)
+{
+    out.append(char(value >> 24)).append(char(value >> 16)).append(char(value >> 8)).append(char(value));
+}
+
+void appendChunk(QByteArray &out, const char *type, const QByteArray &data)
+{
+    appendUint32(out, quint32(data.size()));
+    int start = out.size();
+    out.append(type, 4).append(data);
+    appendUint32(out, quint32(crc32(crc32(0, Z_NULL, 0),
+                                    reinterpret_cast<const Bytef *>(out.constData() + start),
+                                    uInt(data.size() + 4))));
+}
+#else
+int qtQuality(PngWriter::Level level)
+{
+    // Qt 按 (100 - quality) * 9 / 91 换算 zlib 级别，取与分带编码相同的 1 / 3 / 7 级
+    switch (level) {
+    case PngWriter::Fastest:
+        return 89;
+    case PngWriter::Balanced:
+        return 69;
+    case PngWriter::Smallest:
+        return 29;
+    }
+    return 69;
+}
+#endif
+}
+
+PngWriter::Level PngWriter::levelFor(Purpose purpose)
+{
+    return purpose == Intermediate ? Fastest : deliverableLevel();
+}
+
+void PngWriter::setDeliverableLevel(Level level)
+{
+    s_deliverableLevel = level;
+}
+
+PngWriter::Level PngWriter::deliverableLevel()
+{
+    return Level(s_deliverableLevel.load());
+}
+
+QThreadPool *PngWriter::pool()
+{
+    // 独立的线程池：调用方可能本身就在其他线程池里等待
+    static QThreadPool *instance = [] {
+        QThreadPool *threadPool = new QThreadPool;
+        threadPool->setMaxThreadCount(QThread::idealThreadCount());
+        return threadPool;
+    }();
+    return instance;
+}
+
+QByteArray PngWriter::encode(const QImage &image, Level level)
+{
+    if (image.isNull()) {
+        return QByteArray();
+    }
+
+#ifdef HAVE_ZLIB
+    QImage source;
+    int colorType;
+    int bpp;
+    if (image.format() == QImage::Format_Grayscale8) {
+        source = image;
+        colorType = 0;
+        bpp = 1;
+    } else if (image.hasAlphaChannel()) {
+        source = image.convertToFormat(QImage::Format_RGBA8888);
+        colorType = 6;
+        bpp = 4;
+    } else {
+        source = image.convertToFormat(QImage::Format_RGB888);
+        colorType = 2;
+        bpp = 3;
+    }
+
+    const LevelParams params = levelParams(level);
+    const int height = source.height();
+    const int filteredRow = source.width() * bpp + 1;
+    const int rowsPerBand = qMax(1, kBandBytes / filteredRow);
+    const int bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+
+    std::vector<BandResult> bands(bandCount);
+    auto runBand = [&](int band) {
+        int y0 = band * rowsPerBand;
+        int y1 = qMin(y0 + rowsPerBand, height);
+        encodeBand(source, bpp, y0, y1, band == bandCount - 1, params, bands[band]);
+    };
+    if (bandCount == 1) {
+        runBand(0);
+    } else {
+        QSemaphore done;
+        for (int band = 0; band < bandCount; ++band) {
+            pool()->start([&, band]() {
+                runBand(band);
+                done.release();
+            });
+        }
+        done.acquire(bandCount);
+    }
+
+    QByteArray png("\x89PNG\r\n\x1a\n", 8);
+    QByteArray header;
+    appendUint32(header, quint32(source.width()));
+    appendUint32(header, quint32(height));
+    header.append(char(8)).append(char(colorType)).append(char(0)).append(char(0)).append(char(0));
+    appendChunk(png, "IHDR", header);
+
+    // 每带一个 IDAT，第一个带 zlib 头，最后一个带合并后的 Adler-32
+    uLong adler = bands.front().adler;
+    for (int band = 0; band < bandCount; ++band) {
+        const BandResult &result = bands[band];
+        if (!result.ok) {
+            return QByteArray();
+        }
+        if (band > 0) {
+            adler = adler32_combine(adler, result.adler, z_off_t(result.length));
+        }
+
+        QByteArray data;
+        if (band == 0) {
+            int cmf = 0x78;
+            int flg = params.headerLevel << 6;
+            flg += 31 - (cmf * 256 + flg) % 31;
+            data.append(char(cmf)).append(char(flg));
+        }
+        data.append(reinterpret_cast<const char *>(result.deflated.data()), int(result.deflated.size()));
+        if (band == bandCount - 1) {
+            appendUint32(data, quint32(adler));
+        }
+        appendChunk(png, "IDAT", data);
+    }
+    appendChunk(png, "IEND", QByteArray());
+    return png;
+#else
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "PNG", qtQuality(level))) {
+        return QByteArray();
+    }
+    return png;
+#endif
+}
+
+bool PngWriter::write(const QImage &image, const QString &path, Level level, QString *error)
+{
+    QByteArray png = encode(image, level);
+    if (png.isEmpty()) {
+        if (error) {
+            *error = QString("Failed to encode PNG: %1").arg(path);
+        }
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(png) != png.size() || !file.commit()) {
+        if (error) {
+            *error = QString("Failed to write PNG: %1").arg(path);
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <QImage>
+#include <QString>
+
+class QThreadPool;
+
+// 程序自己写出的 PNG 都走这里。图像按行带拆分，各带独立做行过滤和 deflate，
+// 再用 adler32_combine 拼成一个 zlib 流；每带以前一带末尾 32KB 作为字典，压缩率几乎不受影响。
+// 系统没有 zlib 时使用 Qt 自带的 zlib（HAVE_QT_ZLIB）；两者都没有才退回 QImage::save
+class PngWriter
+{
+public:
+    enum Level {
+        Fastest,  // Up 过滤 + deflate 1 级 RLE
+        Balanced, // 逐行自适应过滤 + deflate 3 级
+        Smallest  // 逐行自适应过滤 + deflate 7 级
+    };
+
+    enum Purpose {
+        Intermediate, // 马上会被再次读取的临时文件
+        Deliverable   // 交给用户的最终文件
+    };
+
+    // 按用途选择级别，中间文件固定最快，最终文件可在界面上调整
+    static Level levelFor(Purpose purpose);
+    static void setDeliverableLevel(Level level);
+    static Level deliverableLevel();
+
+    static bool write(const QImage &image, const QString &path, Level level, QString *error = nullptr);
+    static bool write(const QImage &image, const QString &path, Purpose purpose, QString *error = nullptr)
+    {
+        return write(image, path, levelFor(purpose), error);
+    }
+    static QByteArray encode(const QImage &image, Level level);
+
+private:
+    static QThreadPool *pool();
+};
+
+#endif // PNGWRITER_H
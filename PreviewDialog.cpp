@@ -0,0 +1,412 @@
+#include "PreviewDialog.h"
+#include "ScalePlanner.h"
+#include "UpscaleBackend.h"
+#include "PngWriter.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include "PriorityScheduler.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPainterPath>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QListWidget>
+#include <QPushButton>
+#include <QDoubleSpinBox>
+#include <QScrollArea>
+#include <QTimer>
+#include <QDir>
+#include <QDebug>
+
+namespace {
+// 默认选区边长：CPU 上一秒左右出结果
+const int kDefaultCropSize = 256;
+}
+
+CropSelectView::CropSelectView(QWidget *parent) : QWidget(parent)
+{
+    setMinimumSize(320, 200);
+    setCursor(Qt::CrossCursor);
+}
+
+void CropSelectView::setSourceImage(const QImage &image)
+{
+    m_image = image;
+    centerSelection(QPoint(image.width() / 2, image.height() / 2));
+}
+
+void CropSelectView::centerSelection(const QPoint &pos)
+{
+    QRect rect(0, 0, qMin(kDefaultCropSize, m_image.width()), qMin(kDefaultCropSize, m_image.height()));
+    rect.moveCenter(pos);
+    rect.moveLeft(qBound(0, rect.left(), m_image.width() - rect.width()));
+    rect.moveTop(qBound(0, rect.top(), m_image.height() - rect.height()));
+    m_selection = rect;
+    update();
+}
+
+void CropSelectView::setMarkedRegions(const QList<QRect> &regions)
+{
+    m_marked = regions;
+    update();
+}
+
+QRectF CropSelectView::imageArea() const
+{
+    if (m_image.isNull()) {
+        return QRectF();
+    }
+
+    QSizeF size = QSizeF(m_image.size()).scaled(QSizeF(this->size()), Qt::KeepAspectRatio);
+    QPointF topLeft((width() - size.width()) / 2.0, (height() - size.height()) / 2.0);
+    return QRectF(topLeft, size);
+}
+
+QPoint CropSelectView::toImage(const QPointF &pos) const
+{
+    QRectF area = imageArea();
+    if (area.isEmpty()) {
+        return QPoint();
+    }
+
+    double scale = m_image.width() / area.width();
+    QPointF point = (pos - area.topLeft()) * scale;
+    return QPoint(qBound(0, qRound(point.x()), m_image.width()),
+                  qBound(0, qRound(point.y()), m_image.height()));
+}
+
+void CropSelectView::mousePressEvent(QMouseEvent *event)
+{
+    m_anchor = toImage(event->position());
+    m_dragged = false;
+}
+
+void CropSelectView::mouseMoveEvent(QMouseEvent *event)
+{
+    QPoint current = toImage(event->position());
+    if ((current - m_anchor).manhattanLength() < 8) {
+        return;
+    }
+    m_dragged = true;
+    m_selection = QRect(m_anchor, current).normalized();
+    update();
+}
+
+void CropSelectView::mouseReleaseEvent(QMouseEvent *event)
+{
+    // 单击时以点击位置为中心放置默认选区
+    if (!m_dragged) {
+        centerSelection(toImage(event->position()));
+    }
+}
+
+void CropSelectView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    QRectF area = imageArea();
+    if (area.isEmpty()) {
+        painter.drawText(rect(), Qt::AlignCenter, "无图像");
+        return;
+    }
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(area, m_image);
+
+    double scale = area.width() / m_image.width();
+    painter.setPen(QPen(Qt::green, 2));
+    for (const QRect &marked : m_marked) {
+        painter.drawRect(QRectF(area.topLeft() + QPointF(marked.topLeft()) * scale, QSizeF(marked.size()) * scale));
+    }
+
+    if (m_selection.isEmpty()) {
+        return;
+    }
+
+    QRectF selected(area.topLeft() + QPointF(m_selection.topLeft()) * scale,
+                    QSizeF(m_selection.size()) * scale);
+
+    // 选区外变暗
+    QPainterPath outside;
+    outside.addRect(area);
+    outside.addRect(selected);
+    painter.fillPath(outside, QColor(0, 0, 0, 120));
+    painter.setPen(QPen(Qt::yellow, 2));
+    painter.drawRect(selected);
+    painter.drawText(selected.topLeft() + QPointF(4, -4),
+                     QString("%1x%2").arg(m_selection.width()).arg(m_selection.height()));
+}
+
+PreviewDialog::PreviewDialog(const QString &sourcePath, bool isVideo, const QStringList &models,
+                             QWidget *parent)
+    : QDialog(parent), m_sourcePath(sourcePath), m_isVideo(isVideo)
+{
+    setWindowTitle("预览对比");
+    resize(1100, 800);
+
+#ifdef Q_OS_WIN
+    m_realesrganPath = "realesrgan-ncnn-vulkan.exe";
+    m_ffmpegPath = "ffmpeg.exe";
+#else
+    m_realesrganPath = "realesrgan-ncnn-vulkan";
+    m_ffmpegPath = "ffmpeg";
+#endif
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    QHBoxLayout *topLayout = new QHBoxLayout();
+    mainLayout->addLayout(topLayout, 1);
+
+    m_imageView = new CropSelectView(this);
+    topLayout->addWidget(m_imageView, 1);
+
+    QVBoxLayout *sideLayout = new QVBoxLayout();
+    topLayout->addLayout(sideLayout);
+
+    sideLayout->addWidget(new QLabel("对比模型:", this));
+    m_modelList = new QListWidget(this);
+    for (const QString &model : models) {
+        QListWidgetItem *item = new QListWidgetItem(model, m_modelList);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(Qt::Unchecked);
+    }
+    sideLayout->addWidget(m_modelList);
+
+    if (m_isVideo) {
+        sideLayout->addWidget(new QLabel("时间点（秒）:", this));
+        m_timeSpin = new QDoubleSpinBox(this);
+        m_timeSpin->setRange(0, 24 * 3600);
+        m_timeSpin->setDecimals(2);
+        m_timeSpin->setValue(10);
+        sideLayout->addWidget(m_timeSpin);
+
+        QPushButton *frameButton = new QPushButton("提取该帧", this);
+        connect(frameButton, &QPushButton::clicked, this, &PreviewDialog::extractVideoFrame);
+        sideLayout->addWidget(frameButton);
+    }
+
+    m_previewButton = new QPushButton("生成预览", this);
+    connect(m_previewButton, &QPushButton::clicked, this, &PreviewDialog::startPreview);
+    sideLayout->addWidget(m_previewButton);
+
+    m_statusLabel = new QLabel("单击或拖拽选择预览区域", this);
+    m_statusLabel->setWordWrap(true);
+    sideLayout->addWidget(m_statusLabel);
+    sideLayout->addStretch();
+
+    QScrollArea *resultArea = new QScrollArea(this);
+    resultArea->setWidgetResizable(true);
+    QWidget *resultWidget = new QWidget(resultArea);
+    m_resultLayout = new QHBoxLayout(resultWidget);
+    m_resultLayout->addStretch();
+    resultArea->setWidget(resultWidget);
+    mainLayout->addWidget(resultArea, 1);
+
+    if (m_isVideo) {
+        QTimer::singleShot(0, this, &PreviewDialog::extractVideoFrame);
+    } else {
+        loadImage(m_sourcePath);
+    }
+}
+
+PreviewDialog::~PreviewDialog()
+{
+    for (PreviewRun &run : m_runs) {
+        if (run.task) {
+            run.task->cancel();
+        }
+    }
+}
+
+void PreviewDialog::setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath)
+{
+    if (!realesrganPath.isEmpty()) {
+        m_realesrganPath = realesrganPath;
+    }
+    if (!ffmpegPath.isEmpty()) {
+        m_ffmpegPath = ffmpegPath;
+    }
+}
+
+void PreviewDialog::setCheckedModels(const QStringList &models)
+{
+    for (int i = 0; i < m_modelList->count(); ++i) {
+        QListWidgetItem *item = m_modelList->item(i);
+        item->setCheckState(models.contains(item->text()) ? Qt::Checked : Qt::Unchecked);
+    }
+}
+
+void PreviewDialog::loadImage(const QString &path)
+{
+    QImage image(path);
+    if (image.isNull()) {
+        m_statusLabel->setText(QString("无法读取图像: %1").arg(path));
+        return;
+    }
+
+    m_imageView->setSourceImage(image.convertToFormat(QImage::Format_RGB888));
+    m_statusLabel->setText(QString("图像尺寸 %1x%2，单击或拖拽选择预览区域")
+                               .arg(image.width()).arg(image.height()));
+}
+
+void PreviewDialog::extractVideoFrame()
+{
+    if (!m_tempDir.isValid() || (m_frameProcess && m_frameProcess->state() != QProcess::NotRunning)) {
+        return;
+    }
+
+    if (m_frameProcess) {
+        m_frameProcess->deleteLater();
+    }
+
+    // -ss 放在 -i 之前按关键帧快速定位，只解码目标帧附近
+    QString framePath = QDir(m_tempDir.path()).filePath("frame.png");
+    m_frameProcess = new QProcess(this);
+    connect(m_frameProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, framePath](int exitCode, QProcess::ExitStatus) {
+                if (exitCode != 0) {
+                    m_statusLabel->setText(QString("提取视频帧失败: %1")
+                                               .arg(ProcessSupervisor::attach(m_frameProcess)->tail(200)));
+                    return;
+                }
+                loadImage(framePath);
+            });
+
+    QStringList args;
+    args << "-y"
+         << "-ss" << QString::number(m_timeSpin->value(), 'f', 3)
+         << "-i" << m_sourcePath
+         << "-frames:v" << "1"
+         << framePath;
+
+    m_statusLabel->setText("正在提取视频帧...");
+    ProcessLauncher::start(m_frameProcess, m_ffmpegPath, args, ProcessLauncher::Utility);
+}
+
+void PreviewDialog::startPreview()
+{
+    const QImage &image = m_imageView->sourceImage();
+    QRect selection = m_imageView->selection();
+    if (image.isNull() || selection.isEmpty() || !m_tempDir.isValid()) {
+        m_statusLabel->setText("请先选择预览区域");
+        return;
+    }
+
+    QStringList models;
+    for (int i = 0; i < m_modelList->count(); ++i) {
+        if (m_modelList->item(i)->checkState() == Qt::Checked) {
+            models << m_modelList->item(i)->text();
+        }
+    }
+    if (models.isEmpty()) {
+        m_statusLabel->setText("请至少勾选一个模型");
+        return;
+    }
+
+    QImage crop = image.copy(selection);
+    QString cropPath = QDir(m_tempDir.path()).filePath("crop.png");
+    if (!PngWriter::write(crop, cropPath, PngWriter::Intermediate)) {
+        m_statusLabel->setText("无法写入临时文件");
+        return;
+    }
+
+    clearResults();
+
+    // 参考图：按最大模型倍率做普通插值放大
+    int maxScale = 1;
+    for (const QString &model : models) {
+        maxScale = qMax(maxScale, ScalePlanner::nativeScale(model));
+    }
+    addResult(QString("原图插值 ×%1").arg(maxScale),
+              crop.scaled(crop.size() * maxScale, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+
+    // 所有模型同时启动，预览期间后台视频作业让出资源
+    m_previewButton->setEnabled(false);
+    PriorityScheduler::setPriority(this, PriorityScheduler::Interactive);
+    PriorityScheduler::beginInteractive(this);
+    m_pendingRuns = models.size();
+    m_previewTimer.start();
+    for (const QString &model : models) {
+        PreviewRun run;
+        run.modelName = model;
+        run.outputPath = QDir(m_tempDir.path()).filePath(QString("preview_%1.png").arg(m_runs.size()));
+
+        UpscaleRequest request;
+        request.inputPath = cropPath;
+        request.outputPath = run.outputPath;
+        request.modelName = model;
+        request.scale = ScalePlanner::nativeScale(model);
+        request.executablePath = m_realesrganPath;
+        run.task = UpscaleBackend::defaultBackend()->createTask(request, this);
+
+        int runIndex = m_runs.size();
+        connect(run.task, &UpscaleTask::finished, this, [this, runIndex](bool ok) {
+            handleRunFinished(runIndex, ok);
+        });
+
+        run.timer.start();
+        run.task->start();
+        m_runs << run;
+    }
+
+    m_statusLabel->setText(QString("正在运行 %1 个模型...").arg(models.size()));
+}
+
+void PreviewDialog::handleRunFinished(int runIndex, bool ok)
+{
+    PreviewRun &run = m_runs[runIndex];
+    qint64 elapsed = run.timer.elapsed();
+
+    QImage result(run.outputPath);
+    if (ok && !result.isNull()) {
+        addResult(QString("%1\n%2 ms").arg(run.modelName).arg(elapsed), result);
+    } else {
+        addResult(QString("%1\n失败\n%2").arg(run.modelName, run.task->errorString().right(200)), QImage());
+    }
+    run.task->deleteLater();
+    run.task = nullptr;
+
+    if (--m_pendingRuns == 0) {
+        PriorityScheduler::endInteractive(this);
+        m_previewButton->setEnabled(true);
+        m_statusLabel->setText(QString("预览完成，总耗时 %1 ms").arg(m_previewTimer.elapsed()));
+    }
+}
+
+void PreviewDialog::addResult(const QString &title, const QImage &image)
+{
+    QWidget *container = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(container);
+    QLabel *titleLabel = new QLabel(title, container);
+    titleLabel->setAlignment(Qt::AlignCenter);
+    layout->addWidget(titleLabel);
+
+    if (!image.isNull()) {
+        QLabel *imageLabel = new QLabel(container);
+        imageLabel->setPixmap(QPixmap::fromImage(image));
+        layout->addWidget(imageLabel);
+    }
+    layout->addStretch();
+
+    // 保持结果从左到右排列，末尾的伸缩项始终在最后
+    m_resultLayout->insertWidget(m_resultLayout->count() - 1, container);
+}
+
+void PreviewDialog::clearResults()
+{
+    for (PreviewRun &run : m_runs) {
+        if (run.task) {
+            run.task->disconnect(this);
+            run.task->cancel();
+            run.task->deleteLater();
+        }
+    }
+    m_runs.clear();
+    m_pendingRuns = 0;
+
+    while (m_resultLayout->count() > 1) {
+        QLayoutItem *item = m_resultLayout->takeAt(0);
+        delete item->widget();
+        delete item;
+    }
+}
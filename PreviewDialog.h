@@ -0,0 +1,100 @@
+#ifndef PREVIEWDIALOG_H
+#define PREVIEWDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QWidget>
+#include <QImage>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+class QListWidget;
+class QPushButton;
+class QDoubleSpinBox;
+class QHBoxLayout;
+class UpscaleTask;
+
+// 可拖拽选择区域的图片视图，选区以原图坐标保存
+class CropSelectView : public QWidget
+{
+public:
+    explicit CropSelectView(QWidget *parent = nullptr);
+
+    void setSourceImage(const QImage &image);
+    const QImage &sourceImage() const { return m_image; }
+    QRect selection() const { return m_selection; }
+    // 以 pos 为中心放置默认大小的选区
+    void centerSelection(const QPoint &pos);
+    // 已确定的区域，用另一种颜色画出
+    void setMarkedRegions(const QList<QRect> &regions);
+
+    QSize sizeHint() const override { return QSize(640, 400); }
+
+protected:
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QRectF imageArea() const;
+    QPoint toImage(const QPointF &pos) const;
+
+    QImage m_image;
+    QRect m_selection;
+    QList<QRect> m_marked;
+    QPoint m_anchor;
+    bool m_dragged = false;
+};
+
+// 对选中区域（或视频某一时刻的单帧）同时运行多个模型，并排显示结果和耗时
+class PreviewDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    PreviewDialog(const QString &sourcePath, bool isVideo, const QStringList &models,
+                  QWidget *parent = nullptr);
+    ~PreviewDialog();
+
+    void setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath);
+    void setCheckedModels(const QStringList &models);
+
+private slots:
+    void extractVideoFrame();
+    void startPreview();
+
+private:
+    struct PreviewRun {
+        QString modelName;
+        QString outputPath;
+        UpscaleTask *task = nullptr;
+        QElapsedTimer timer;
+    };
+
+    void loadImage(const QString &path);
+    void handleRunFinished(int runIndex, bool ok);
+    void addResult(const QString &title, const QImage &image);
+    void clearResults();
+
+    QString m_sourcePath;
+    bool m_isVideo;
+    QString m_realesrganPath;
+    QString m_ffmpegPath;
+    QTemporaryDir m_tempDir;
+
+    CropSelectView *m_imageView;
+    QListWidget *m_modelList;
+    QDoubleSpinBox *m_timeSpin = nullptr;
+    QPushButton *m_previewButton;
+    QLabel *m_statusLabel;
+    QHBoxLayout *m_resultLayout;
+
+    QList<PreviewRun> m_runs;
+    int m_pendingRuns = 0;
+    QElapsedTimer m_previewTimer;
+    QProcess *m_frameProcess = nullptr;
+};
+
+#endif // PREVIEWDIALOG_H
@@ -0,0 +1,301 @@
+#include "PriorityScheduler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QProcess>
+#include <QVariant>
+#include <QWaitCondition>
+
+#if defined(Q_OS_LINUX)
+#include <cerrno>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+const char *kPriorityProperty = "qtRealSR_priority";
+// 原本的 nice 值，恢复时使用
+const char *kNiceProperty = "qtRealSR_nice";
+
+#if defined(Q_OS_LINUX)
+// 与 linux/ioprio.h 中的取值相同
+const int kIoprioWhoProcess = 1;
+const int kIoprioClassShift = 13;
+const int kIoprioClassBestEffort = 2;
+const int kIoprioClassIdle = 3;
+#endif
+
+struct SchedulerState {
+    QMutex mutex;
+    QWaitCondition resumed;
+    PriorityScheduler::Mode mode = PriorityScheduler::Suspend;
+    bool preempting = false;
+    QElapsedTimer preemptTimer;
+    qint64 preemptedTotalMs = 0;
+
+    // 以下只在界面线程访问
+    QHash<QObject *, int> claims;
+    QHash<QObject *, QMetaObject::Connection> claimGuards;
+    QList<QPointer<QProcess>> background;
+};
+
+SchedulerState &state()
+{
+    static SchedulerState instance;
+    return instance;
+}
+
+void applyPreemption(QProcess *process, PriorityScheduler::Mode mode, bool preempt)
+{
+    qint64 pid = process->processId();
+    if (pid <= 0 || mode == PriorityScheduler::Off) {
+        return;
+    }
+
+#if defined(Q_OS_LINUX)
+    if (mode == PriorityScheduler::Suspend) {
+        ::kill(pid_t(pid), preempt ? SIGSTOP : SIGCONT);
+        return;
+    }
+
+    if (preempt) {
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, id_t(pid));
+        if (errno == 0 && !process->property(kNiceProperty).isValid()) {
+            process->setProperty(kNiceProperty, nice);
+        }
+        setpriority(PRIO_PROCESS, id_t(pid), 19);
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, int(pid), kIoprioClassIdle << kIoprioClassShift);
+    } else {
+        // 普通用户不能调高优先级，恢复失败时后台进程保持低优先级，不影响正确性
+        int nice = process->property(kNiceProperty).toInt();
+        if (setpriority(PRIO_PROCESS, id_t(pid), nice) != 0) {
+            qDebug() << "Cannot restore nice level of" << pid << "- keeping it low";
+        }
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, int(pid), (kIoprioClassBestEffort << kIoprioClassShift) | 4);
+    }
+#elif defined(Q_OS_WIN)
+    HANDLE handle = OpenProcess(PROCESS_SUSPEND_RESUME | PROCESS_SET_INFORMATION, FALSE, DWORD(pid));
+    if (!handle) {
+        return;
+    }
+    if (mode == PriorityScheduler::Suspend) {
+        // NtSuspendProcess 未公开但自 XP 起一直存在，挂起进程内全部线程
+        using ProcessCall = LONG(NTAPI *)(HANDLE);
+        static ProcessCall suspend = reinterpret_cast<ProcessCall>(
+            GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSuspendProcess"));
+        static ProcessCall resume = reinterpret_cast<ProcessCall>(
+            GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtResumeProcess"));
+        ProcessCall call = preempt ? suspend : resume;
+        if (call) {
+            call(handle);
+        }
+    } else {
+        SetPriorityClass(handle, preempt ? IDLE_PRIORITY_CLASS : NORMAL_PRIORITY_CLASS);
+    }
+    CloseHandle(handle);
+#else
+    Q_UNUSED(preempt)
+#endif
+}
+
+void setPreempting(bool preempting)
+{
+    SchedulerState &s = state();
+    PriorityScheduler::Mode mode;
+    {
+        QMutexLocker locker(&s.mutex);
+        if (s.preempting == preempting) {
+            return;
+        }
+        s.preempting = preempting;
+        mode = s.mode;
+        if (preempting) {
+            s.preemptTimer.start();
+        } else {
+            // 降级模式下后台进程仍在运行，只有暂停的时间才从卡死检测中扣除
+            if (mode == PriorityScheduler::Suspend) {
+                s.preemptedTotalMs += s.preemptTimer.elapsed();
+            }
+            s.resumed.wakeAll();
+        }
+    }
+
+    int count = 0;
+    for (int i = s.background.size() - 1; i >= 0; --i) {
+        QProcess *process = s.background.at(i);
+        if (!process || process->state() == QProcess::NotRunning) {
+            s.background.removeAt(i);
+            continue;
+        }
+        applyPreemption(process, mode, preempting);
+        ++count;
+    }
+    qDebug().noquote() << QString("%1 %2 background process(es) (%3)")
+                              .arg(preempting ? "Preempting" : "Resuming")
+                              .arg(count)
+                              .arg(PriorityScheduler::modeName(mode));
+}
+}
+
+void PriorityScheduler::setMode(Mode mode)
+{
+    SchedulerState &s = state();
+    QMutexLocker locker(&s.mutex);
+    // 抢占期间切换模式时，已暂停的时间先计入，之后按新模式计时
+    if (s.preempting && s.mode == Suspend && mode != Suspend) {
+        s.preemptedTotalMs += s.preemptTimer.elapsed();
+    } else if (s.preempting && s.mode != Suspend && mode == Suspend) {
+        s.preemptTimer.start();
+    }
+    s.mode = mode;
+}
+
+PriorityScheduler::Mode PriorityScheduler::mode()
+{
+    QMutexLocker locker(&state().mutex);
+    return state().mode;
+}
+
+QString PriorityScheduler::modeName(Mode mode)
+{
+    switch (mode) {
+    case Off:
+        return "off";
+    case Renice:
+        return "renice";
+    case Suspend:
+        return "suspend";
+    }
+    return QString();
+}
+
+PriorityScheduler::Mode PriorityScheduler::modeFromName(const QString &name, bool *ok)
+{
+    QString lower = name.trimmed().toLower();
+    if (ok) {
+        *ok = lower == "off" || lower == "renice" || lower == "suspend";
+    }
+    if (lower == "off") {
+        return Off;
+    }
+    return lower == "renice" ? Renice : Suspend;
+}
+
+void PriorityScheduler::configureFromArguments(const QStringList &arguments)
+{
+    int index = arguments.indexOf("--preempt");
+    if (index < 0 || index + 1 >= arguments.size()) {
+        return;
+    }
+    // 基准测试可以传入多个模式对比，这里只取第一个作为默认
+    QString name = arguments.at(index + 1).split(',').first();
+    bool ok = false;
+    Mode parsed = modeFromName(name, &ok);
+    if (ok) {
+        setMode(parsed);
+    } else {
+        qWarning() << "Unknown preemption mode:" << name;
+    }
+}
+
+void PriorityScheduler::setPriority(QObject *owner, Priority priority)
+{
+    owner->setProperty(kPriorityProperty, int(priority));
+}
+
+PriorityScheduler::Priority PriorityScheduler::priorityOf(const QObject *object)
+{
+    for (const QObject *current = object; current; current = current->parent()) {
+        QVariant value = current->property(kPriorityProperty);
+        if (value.isValid()) {
+            return Priority(value.toInt());
+        }
+    }
+    return Normal;
+}
+
+void PriorityScheduler::track(QProcess *process)
+{
+    if (priorityOf(process) != Background) {
+        return;
+    }
+
+    state().background << process;
+    QObject::connect(process, &QProcess::started, process, [process]() {
+        if (isPreempting()) {
+            applyPreemption(process, mode(), true);
+        }
+    });
+}
+
+void PriorityScheduler::untrack(QProcess *process)
+{
+    SchedulerState &s = state();
+    if (!s.background.removeAll(process)) {
+        return;
+    }
+    if (isPreempting() && process->state() != QProcess::NotRunning) {
+        applyPreemption(process, mode(), false);
+    }
+}
+
+void PriorityScheduler::beginInteractive(QObject *owner)
+{
+    SchedulerState &s = state();
+    if (s.claims[owner]++ == 0) {
+        s.claimGuards.insert(owner, QObject::connect(owner, &QObject::destroyed, [owner]() {
+            SchedulerState &s = state();
+            s.claims.remove(owner);
+            s.claimGuards.remove(owner);
+            setPreempting(!s.claims.isEmpty());
+        }));
+    }
+    setPreempting(true);
+}
+
+void PriorityScheduler::endInteractive(QObject *owner)
+{
+    SchedulerState &s = state();
+    auto it = s.claims.find(owner);
+    if (it == s.claims.end()) {
+        return;
+    }
+    if (--it.value() <= 0) {
+        s.claims.erase(it);
+        QObject::disconnect(s.claimGuards.take(owner));
+    }
+    setPreempting(!s.claims.isEmpty());
+}
+
+bool PriorityScheduler::isPreempting()
+{
+    QMutexLocker locker(&state().mutex);
+    return state().preempting && state().mode != Off;
+}
+
+qint64 PriorityScheduler::preemptedMs()
+{
+    SchedulerState &s = state();
+    QMutexLocker locker(&s.mutex);
+    if (s.mode != Suspend) {
+        return s.preemptedTotalMs;
+    }
+    return s.preemptedTotalMs + (s.preempting ? s.preemptTimer.elapsed() : 0);
+}
+
+void PriorityScheduler::waitWhilePreempted(const std::atomic<bool> &cancelled)
+{
+    // 进程内的任务无法单独降低优先级，只在暂停模式下让出
+    SchedulerState &s = state();
+    QMutexLocker locker(&s.mutex);
+    while (s.preempting && s.mode == Suspend && !cancelled) {
+        s.resumed.wait(&s.mutex, 200);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef PRIORITYSCHEDULER_H
+#define PRIORITYSCHEDULER_H
+
+#include <QStringList>
+#include <atomic>
+
+class QObject;
+class QProcess;
+
+// 作业优先级与抢占：交互式作业（少量图片、预览）运行期间让出后台批处理占用的资源，结束后恢复。
+// 后台子进程按模式暂停（Linux SIGSTOP/SIGCONT，Windows 挂起线程）或降到最低 CPU / IO 优先级；
+// 进程内的 ncnn 后台任务在帧之间等待。优先级挂在 QObject 上，对其所有子对象生效
+class PriorityScheduler
+{
+public:
+    enum Priority {
+        Background, // 视频队列等长时间批处理，可被抢占
+        Normal,     // 不抢占别人，也不被抢占
+        Interactive // 运行期间抢占后台作业
+    };
+
+    enum Mode {
+        Off,     // 不抢占
+        Renice,  // 降低后台进程的 nice 和 IO 优先级
+        Suspend  // 暂停后台进程
+    };
+
+    static void setMode(Mode mode);
+    static Mode mode();
+    static QString modeName(Mode mode);
+    static Mode modeFromName(const QString &name, bool *ok = nullptr);
+    // 读取 --preempt off|renice|suspend
+    static void configureFromArguments(const QStringList &arguments);
+
+    // 未设置时沿父对象链向上查找，都没有时为 Normal
+    static void setPriority(QObject *owner, Priority priority);
+    static Priority priorityOf(const QObject *object);
+
+    // 由 ProcessLauncher::start 调用：登记后台进程，抢占期间启动的进程随即暂停或降级
+    static void track(QProcess *process);
+    // 结束进程前调用：暂停中的进程收不到 SIGTERM，先恢复
+    static void untrack(QProcess *process);
+
+    // 交互式作业开始 / 结束，按 owner 计数，owner 销毁时自动结束
+    static void beginInteractive(QObject *owner);
+    static void endInteractive(QObject *owner);
+    static bool isPreempting();
+    // 后台进程累计被暂停的时间（含正在进行的一次，只计 Suspend 模式），卡死检测据此扣除
+    static qint64 preemptedMs();
+    // 进程内的后台任务在帧之间调用：抢占期间阻塞，cancelled 置位后立即返回
+    static void waitWhilePreempted(const std::atomic<bool> &cancelled);
+};
+
+#endif // PRIORITYSCHEDULER_H
@@ -0,0 +1,431 @@
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include "PriorityScheduler.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QProcess>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+
+#if defined(Q_OS_LINUX)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+#if defined(Q_OS_LINUX)
+// 与 numaif.h 中的取值相同，不额外依赖 libnuma
+const int kMpolPreferred = 1;
+const int kMpolBind = 2;
+#endif
+
+struct LauncherState {
+    QMutex mutex;
+    ProcessLauncher::Policy policy = ProcessLauncher::NoPlacement;
+    int inferenceSlots = 0;
+    int encoderCores = 0;
+    bool planned = false;
+    QList<ProcessLauncher::Placement> slots;
+    ProcessLauncher::Placement encoder;
+    QList<int> slotUsers;
+};
+
+LauncherState &state()
+{
+    static LauncherState instance;
+    return instance;
+}
+
+QList<int> parseCpuList(const QString &text)
+{
+    QList<int> cpus;
+    for (const QString &part : text.trimmed().split(',', Qt::SkipEmptyParts)) {
+        QStringList range = part.split('-');
+        int first = range.first().toInt();
+        int last = range.size() > 1 ? range.at(1).toInt() : first;
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus << cpu;
+        }
+    }
+    return cpus;
+}
+
+QString formatCpuList(const QList<int> &cpus)
+{
+    QStringList parts;
+    for (int i = 0; i < cpus.size();) {
+        int j = i;
+        while (j + 1 < cpus.size() && cpus.at(j + 1) == cpus.at(j) + 1) {
+            ++j;
+        }
+        parts << (i == j ? QString::number(cpus.at(i)) : QString("%1-%2").arg(cpus.at(i)).arg(cpus.at(j)));
+        i = j + 1;
+    }
+    return parts.join(',');
+}
+
+QString roleName(ProcessLauncher::Role role)
+{
+    switch (role) {
+    case ProcessLauncher::Inference:
+        return "inference";
+    case ProcessLauncher::Encoder:
+        return "encoder";
+    case ProcessLauncher::Utility:
+        return "utility";
+    }
+    return QString();
+}
+
+// 调用方持有 state().mutex
+void buildPlan(LauncherState &s)
+{
+    s.planned = true;
+    s.slots.clear();
+    s.encoder = ProcessLauncher::Placement();
+    s.slotUsers.clear();
+    if (s.policy == ProcessLauncher::NoPlacement) {
+        return;
+    }
+
+    QList<ProcessLauncher::NumaNode> nodes = ProcessLauncher::topology();
+    const bool multiNode = nodes.size() > 1;
+    int total = 0;
+    for (const ProcessLauncher::NumaNode &node : nodes) {
+        total += node.cpus.size();
+    }
+
+    // 编码器核心取自最后一个节点的末尾；单节点时至少给推理留一个核心
+    int encoderCores = s.encoderCores > 0 ? s.encoderCores : qMax(2, total / 8);
+    encoderCores = qBound(1, encoderCores, qMax(1, total / 2));
+    ProcessLauncher::NumaNode &last = nodes.last();
+    int take = qMin(encoderCores, last.cpus.size() - (multiNode ? 0 : 1));
+    if (take > 0) {
+        s.encoder.cpus = last.cpus.mid(last.cpus.size() - take);
+        last.cpus = last.cpus.mid(0, last.cpus.size() - take);
+    } else {
+        s.encoder.cpus = last.cpus;
+    }
+    // 编码器读取的帧来自各个节点，只做优先而不强制
+    s.encoder.numaNode = multiNode ? last.id : -1;
+
+    QList<ProcessLauncher::NumaNode> inferenceNodes;
+    for (const ProcessLauncher::NumaNode &node : nodes) {
+        if (!node.cpus.isEmpty()) {
+            inferenceNodes << node;
+        }
+    }
+
+    // 槽位轮流分到各节点，同一节点上的槽位平分该节点的核心
+    int slotCount = s.inferenceSlots > 0 ? s.inferenceSlots : inferenceNodes.size();
+    int nodeCount = inferenceNodes.size();
+    for (int slot = 0; slot < slotCount; ++slot) {
+        const ProcessLauncher::NumaNode &node = inferenceNodes.at(slot % nodeCount);
+        int slotsOnNode = slotCount / nodeCount + (slot % nodeCount < slotCount % nodeCount ? 1 : 0);
+        int index = slot / nodeCount;
+
+        ProcessLauncher::Placement placement;
+        placement.slot = slot;
+        placement.numaNode = multiNode ? node.id : -1;
+        placement.strictMemory = true;
+        int chunk = node.cpus.size() / slotsOnNode;
+        if (chunk == 0) {
+            placement.cpus << node.cpus.at(index % node.cpus.size());
+        } else {
+            int begin = index * chunk;
+            int count = index + 1 == slotsOnNode ? node.cpus.size() - begin : chunk;
+            placement.cpus = node.cpus.mid(begin, count);
+        }
+        s.slots << placement;
+        s.slotUsers << 0;
+    }
+}
+
+void logPlan()
+{
+    for (const QString &line : ProcessLauncher::planDescription()) {
+        qDebug() << "Launch plan:" << line;
+    }
+}
+}
+
+QString ProcessLauncher::Placement::describe() const
+{
+    QString text = cpus.isEmpty() ? QString("CPU 不限") : QString("CPU %1").arg(formatCpuList(cpus));
+    if (numaNode >= 0) {
+        text += QString("，内存节点 %1（%2）").arg(numaNode).arg(strictMemory ? "绑定" : "优先");
+    }
+    return text;
+}
+
+void ProcessLauncher::setPolicy(Policy policy)
+{
+    {
+        QMutexLocker locker(&state().mutex);
+        state().policy = policy;
+        state().planned = false;
+    }
+    logPlan();
+}
+
+ProcessLauncher::Policy ProcessLauncher::policy()
+{
+    QMutexLocker locker(&state().mutex);
+    return state().policy;
+}
+
+QString ProcessLauncher::policyName(Policy policy)
+{
+    return policy == NumaPinned ? "numa" : "off";
+}
+
+ProcessLauncher::Policy ProcessLauncher::policyFromName(const QString &name, bool *ok)
+{
+    QString lower = name.trimmed().toLower();
+    if (ok) {
+        *ok = lower == "numa" || lower == "off";
+    }
+    return lower == "numa" ? NumaPinned : NoPlacement;
+}
+
+void ProcessLauncher::setInferenceSlots(int slots)
+{
+    QMutexLocker locker(&state().mutex);
+    state().inferenceSlots = qMax(0, slots);
+    state().planned = false;
+}
+
+void ProcessLauncher::setEncoderCores(int cores)
+{
+    QMutexLocker locker(&state().mutex);
+    state().encoderCores = qMax(0, cores);
+    state().planned = false;
+}
+
+void ProcessLauncher::configureFromArguments(const QStringList &arguments)
+{
+    auto value = [&arguments](const QString &name) {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments.at(index + 1) : QString();
+    };
+
+    if (!value("--inference-slots").isEmpty()) {
+        setInferenceSlots(value("--inference-slots").toInt());
+    }
+    if (!value("--encoder-cores").isEmpty()) {
+        setEncoderCores(value("--encoder-cores").toInt());
+    }
+    // 基准测试可以传入多个策略对比，这里只取第一个作为默认
+    QString placement = value("--placement").split(',').first();
+    if (!placement.isEmpty()) {
+        bool ok = false;
+        Policy parsed = policyFromName(placement, &ok);
+        if (ok) {
+            setPolicy(parsed);
+        } else {
+            qWarning() << "Unknown placement policy:" << placement;
+        }
+    }
+}
+
+QList<ProcessLauncher::NumaNode> ProcessLauncher::topology()
+{
+    QList<NumaNode> nodes;
+#if defined(Q_OS_LINUX)
+    // 只保留当前进程允许使用的核心（容器或 taskset 限制）
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveAllowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    QDir nodeDir("/sys/devices/system/node");
+    QStringList names = nodeDir.entryList({"node*"}, QDir::Dirs);
+    for (const QString &name : names) {
+        bool ok = false;
+        int id = name.mid(4).toInt(&ok);
+        QFile cpuList(nodeDir.filePath(name + "/cpulist"));
+        if (!ok || !cpuList.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        NumaNode node;
+        node.id = id;
+        for (int cpu : parseCpuList(QString::fromLatin1(cpuList.readAll()))) {
+            if (!haveAllowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+                node.cpus << cpu;
+            }
+        }
+        if (!node.cpus.isEmpty()) {
+            nodes << node;
+        }
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode &a, const NumaNode &b) { return a.id < b.id; });
+#endif
+
+    if (nodes.isEmpty()) {
+        // 没有 NUMA 信息时视为一个节点
+        NumaNode node;
+        for (int cpu = 0; cpu < QThread::idealThreadCount(); ++cpu) {
+            node.cpus << cpu;
+        }
+        nodes << node;
+    }
+    return nodes;
+}
+
+QStringList ProcessLauncher::planDescription()
+{
+    QStringList lines;
+    QStringList nodeTexts;
+    for (const NumaNode &node : topology()) {
+        nodeTexts << QString("节点 %1: CPU %2").arg(node.id).arg(formatCpuList(node.cpus));
+    }
+    lines << QString("拓扑 %1").arg(nodeTexts.join("；"));
+
+    QMutexLocker locker(&state().mutex);
+    LauncherState &s = state();
+    if (!s.planned) {
+        buildPlan(s);
+    }
+    if (s.policy == NoPlacement) {
+        lines << "策略 off: 不限制 CPU 和内存位置";
+        return lines;
+    }
+
+    lines << "策略 numa";
+    for (const Placement &placement : s.slots) {
+        lines << QString("推理槽位 %1: %2").arg(placement.slot).arg(placement.describe());
+    }
+    lines << QString("编码器及其他 ffmpeg: %1").arg(s.encoder.describe());
+    return lines;
+}
+
+ProcessLauncher::Placement ProcessLauncher::acquire(Role role)
+{
+    QMutexLocker locker(&state().mutex);
+    LauncherState &s = state();
+    if (!s.planned) {
+        buildPlan(s);
+    }
+    if (s.policy == NoPlacement) {
+        return Placement();
+    }
+    if (role != Inference || s.slots.isEmpty()) {
+        return s.encoder;
+    }
+
+    // 选当前进程数最少的槽位，并发数超过槽位数时多个进程共享
+    int best = 0;
+    for (int slot = 1; slot < s.slotUsers.size(); ++slot) {
+        if (s.slotUsers.at(slot) < s.slotUsers.at(best)) {
+            best = slot;
+        }
+    }
+    s.slotUsers[best]++;
+    return s.slots.at(best);
+}
+
+void ProcessLauncher::release(int slot)
+{
+    QMutexLocker locker(&state().mutex);
+    // 策略中途改变后旧进程的归还可能落在新计划上，计数不小于 0 即可
+    QList<int> &users = state().slotUsers;
+    if (slot >= 0 && slot < users.size() && users.at(slot) > 0) {
+        users[slot]--;
+    }
+}
+
+void ProcessLauncher::apply(QProcess *process, const Placement &placement)
+{
+#if defined(Q_OS_LINUX)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : placement.cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+    const bool pinCpus = !placement.cpus.isEmpty();
+    const unsigned long nodeMask = placement.numaNode >= 0 && placement.numaNode < 64
+                                       ? 1UL << placement.numaNode : 0;
+    const int mode = placement.strictMemory ? kMpolBind : kMpolPreferred;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // 在 fork 之后、exec 之前执行，子进程的所有线程和内存分配从一开始就受约束
+    process->setChildProcessModifier([cpuSet, pinCpus, nodeMask, mode]() {
+        if (pinCpus) {
+            sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+        }
+        if (nodeMask) {
+            syscall(SYS_set_mempolicy, mode, &nodeMask, sizeof(nodeMask) * 8 + 1);
+        }
+    });
+#else
+    // Qt5 没有子进程钩子，只能在启动后设置亲和性，内存策略无法从外部设置
+    Q_UNUSED(nodeMask)
+    Q_UNUSED(mode)
+    if (pinCpus) {
+        QObject::connect(process, &QProcess::started, process, [process, cpuSet]() {
+            sched_setaffinity(pid_t(process->processId()), sizeof(cpuSet), &cpuSet);
+        });
+    }
+#endif
+#elif defined(Q_OS_WIN)
+    // Windows 按线程所在处理器的节点分配内存，固定核心即可保证内存在本地
+    DWORD_PTR mask = 0;
+    for (int cpu : placement.cpus) {
+        if (cpu < int(sizeof(DWORD_PTR) * 8)) {
+            mask |= DWORD_PTR(1) << cpu;
+        }
+    }
+    if (mask) {
+        QObject::connect(process, &QProcess::started, process, [process, mask]() {
+            HANDLE handle = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION, FALSE,
+                                        DWORD(process->processId()));
+            if (handle) {
+                SetProcessAffinityMask(handle, mask);
+                CloseHandle(handle);
+            }
+        });
+    }
+#else
+    Q_UNUSED(process)
+    Q_UNUSED(placement)
+#endif
+}
+
+void ProcessLauncher::start(QProcess *process, const QString &program, const QStringList &arguments, Role role)
+{
+    Placement placement = acquire(role);
+    if (!placement.isEmpty()) {
+        apply(process, placement);
+        qDebug() << "Launch" << QFileInfo(program).fileName() << roleName(role) << placement.describe();
+    }
+
+    if (placement.slot >= 0) {
+        int slot = placement.slot;
+        auto released = std::make_shared<bool>(false);
+        auto releaseOnce = [released, slot]() {
+            if (!*released) {
+                *released = true;
+                release(slot);
+            }
+        };
+        QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), releaseOnce);
+        QObject::connect(process, &QProcess::errorOccurred, [releaseOnce](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                releaseOnce();
+            }
+        });
+        QObject::connect(process, &QObject::destroyed, releaseOnce);
+    }
+
+    // 输出缓冲、资源统计统一由监管对象负责
+    ProcessSupervisor::attach(process)->setLabel(QFileInfo(program).baseName());
+    PriorityScheduler::track(process);
+    process->start(program, arguments);
+}
@@ -0,0 +1,68 @@
+#ifndef PROCESSLAUNCHER_H
+#define PROCESSLAUNCHER_H
+
+#include <QList>
+#include <QStringList>
+
+class QProcess;
+
+// 所有 realesrgan / ffmpeg 子进程都经这里启动，按放置策略绑定 CPU 和 NUMA 节点：
+// 每个推理槽位固定在一个节点的一组核心上，内存只从该节点分配；
+// 编码器和其他 ffmpeg 进程使用单独保留的核心，不与推理争抢
+class ProcessLauncher
+{
+public:
+    enum Role {
+        Inference, // realesrgan 等放大进程
+        Encoder,   // 最终编码
+        Utility    // 提取帧、探测、黑边检测等短小的 ffmpeg 进程
+    };
+
+    enum Policy {
+        NoPlacement, // 交给系统调度
+        NumaPinned   // 按槽位绑定核心和内存节点
+    };
+
+    struct NumaNode {
+        int id = 0;
+        QList<int> cpus;
+    };
+
+    struct Placement {
+        QList<int> cpus;   // 空表示不限制
+        int numaNode = -1; // -1 表示不绑定内存
+        bool strictMemory = false;
+        int slot = -1;
+
+        bool isEmpty() const { return cpus.isEmpty() && numaNode < 0; }
+        QString describe() const;
+    };
+
+    static void setPolicy(Policy policy);
+    static Policy policy();
+    static QString policyName(Policy policy);
+    static Policy policyFromName(const QString &name, bool *ok = nullptr);
+
+    // 并发推理槽位数，0 表示每个 NUMA 节点一个
+    static void setInferenceSlots(int slots);
+    // 留给编码器和其他 ffmpeg 的核心数，0 表示总核数的 1/8（至少 2 个）
+    static void setEncoderCores(int cores);
+
+    // 读取 --placement off|numa、--inference-slots N、--encoder-cores N
+    static void configureFromArguments(const QStringList &arguments);
+
+    // 按角色选定放置后启动进程，进程结束时自动归还推理槽位；
+    // 进程同时交给 ProcessSupervisor 监管
+    static void start(QProcess *process, const QString &program, const QStringList &arguments, Role role);
+
+    static QList<NumaNode> topology();
+    // 当前策略下的放置计划，每个槽位一行
+    static QStringList planDescription();
+
+private:
+    static Placement acquire(Role role);
+    static void release(int slot);
+    static void apply(QProcess *process, const Placement &placement);
+};
+
+#endif // PROCESSLAUNCHER_H
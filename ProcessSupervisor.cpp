@@ -0,0 +1,314 @@
+#include "ProcessSupervisor.h"
+#include "PriorityScheduler.h"
+#include <QDebug>
+#include <QFile>
+#include <QLocale>
+#include <QMap>
+#include <QPointer>
+#include <QTimer>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace {
+// 进程结束后 /proc 条目随之消失，只能在运行期间采样
+const int kSampleIntervalMs = 500;
+const int kMaxFinished = 512;
+const qint64 kMinStallMs = 30000;
+
+struct FinishedEntry {
+    ProcessSupervisor::Usage usage;
+    QList<QPointer<QObject>> owners;
+};
+
+QList<FinishedEntry> s_finished;
+
+#if defined(Q_OS_LINUX)
+QByteArray readProcFile(qint64 pid, const char *name)
+{
+    QFile file(QString("/proc/%1/%2").arg(pid).arg(name));
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+qint64 procField(const QByteArray &content, const QByteArray &key)
+{
+    for (const QByteArray &line : content.split('\n')) {
+        if (line.startsWith(key)) {
+            return line.mid(key.size()).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+#endif
+}
+
+QString ProcessSupervisor::Usage::describe() const
+{
+    QLocale locale;
+    return QString("%1：耗时 %2 秒，CPU %3 秒，峰值内存 %4，读 %5 / 写 %6")
+        .arg(label)
+        .arg(wallMs / 1000.0, 0, 'f', 1)
+        .arg(cpuMs / 1000.0, 0, 'f', 1)
+        .arg(locale.formattedDataSize(peakRssBytes), locale.formattedDataSize(readBytes),
+             locale.formattedDataSize(writeBytes));
+}
+
+ProcessSupervisor::ProcessSupervisor(QProcess *process)
+    : QObject(process), m_process(process), m_sampleTimer(new QTimer(this))
+{
+    m_usage.label = process->program();
+    connect(process, &QProcess::readyReadStandardOutput, this, &ProcessSupervisor::readOutput);
+    connect(process, &QProcess::readyReadStandardError, this, &ProcessSupervisor::readOutput);
+    connect(process, &QProcess::started, this, &ProcessSupervisor::handleStarted);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ProcessSupervisor::handleFinished);
+    connect(m_sampleTimer, &QTimer::timeout, this, &ProcessSupervisor::sample);
+}
+
+ProcessSupervisor *ProcessSupervisor::attach(QProcess *process)
+{
+    if (auto *existing = process->findChild<ProcessSupervisor *>(QString(), Qt::FindDirectChildrenOnly)) {
+        return existing;
+    }
+    return new ProcessSupervisor(process);
+}
+
+void ProcessSupervisor::stop(QProcess *process, int graceMs)
+{
+    if (!process || process->state() == QProcess::NotRunning) {
+        return;
+    }
+
+    // 暂停中的进程要先恢复才能处理 SIGTERM
+    PriorityScheduler::untrack(process);
+    // ffmpeg 收到 SIGTERM 会正常收尾；Windows 控制台程序不响应 terminate，到时直接 kill
+    process->terminate();
+    QPointer<QProcess> guard(process);
+    QTimer::singleShot(graceMs, process, [guard]() {
+        if (guard && guard->state() != QProcess::NotRunning) {
+            qWarning() << "Process did not exit in time, killing:" << guard->program();
+            guard->kill();
+        }
+    });
+}
+
+QList<ProcessSupervisor::Usage> ProcessSupervisor::takeFinished(QObject *owner)
+{
+    QList<Usage> result;
+    for (int i = s_finished.size() - 1; i >= 0; --i) {
+        const FinishedEntry &entry = s_finished.at(i);
+        bool allGone = true;
+        bool owned = false;
+        for (const QPointer<QObject> &candidate : entry.owners) {
+            allGone = allGone && candidate.isNull();
+            owned = owned || candidate == owner;
+        }
+        if (owned) {
+            result.prepend(entry.usage);
+        }
+        if (owned || allGone) {
+            s_finished.removeAt(i);
+        }
+    }
+    return result;
+}
+
+QStringList ProcessSupervisor::usageReport(const QList<Usage> &usages)
+{
+    QMap<QString, Usage> totals;
+    QMap<QString, int> counts;
+    for (const Usage &usage : usages) {
+        Usage &total = totals[usage.label];
+        total.label = usage.label;
+        total.wallMs += usage.wallMs;
+        total.cpuMs += usage.cpuMs;
+        total.peakRssBytes = qMax(total.peakRssBytes, usage.peakRssBytes);
+        total.readBytes += usage.readBytes;
+        total.writeBytes += usage.writeBytes;
+        ++counts[usage.label];
+    }
+
+    QStringList lines;
+    for (auto it = totals.begin(); it != totals.end(); ++it) {
+        Usage total = it.value();
+        if (counts.value(it.key()) > 1) {
+            total.label = QString("%1 ×%2").arg(total.label).arg(counts.value(it.key()));
+        }
+        lines << total.describe();
+    }
+    return lines;
+}
+
+void ProcessSupervisor::setLabel(const QString &label)
+{
+    m_usage.label = label;
+}
+
+QString ProcessSupervisor::tail(int maxChars) const
+{
+    return QString::fromUtf8(m_tail.right(kTailBytes)).right(maxChars);
+}
+
+void ProcessSupervisor::readOutput()
+{
+    QByteArray data = m_process->readAllStandardOutput();
+    data += m_process->readAllStandardError();
+    if (data.isEmpty()) {
+        return;
+    }
+
+    // 超过两倍上限才截断一次，避免每次读取都搬动整个缓冲区
+    m_tail += data;
+    if (m_tail.size() > 2 * kTailBytes) {
+        m_tail = m_tail.right(kTailBytes);
+    }
+    emit outputReady(data);
+}
+
+void ProcessSupervisor::handleStarted()
+{
+    m_pid = m_process->processId();
+    m_wallTimer.start();
+    m_sampleTimer->start(kSampleIntervalMs);
+    sample();
+}
+
+void ProcessSupervisor::handleFinished(int exitCode)
+{
+    readOutput();
+    m_sampleTimer->stop();
+    m_usage.wallMs = m_wallTimer.isValid() ? m_wallTimer.elapsed() : 0;
+    m_usage.exitCode = exitCode;
+
+    // 登记到进程的每一层父对象名下，调用方按自己取回即可，不必关心进程由谁创建
+    FinishedEntry entry;
+    entry.usage = m_usage;
+    for (QObject *owner = m_process->parent(); owner; owner = owner->parent()) {
+        entry.owners << owner;
+    }
+    if (!entry.owners.isEmpty()) {
+        s_finished << entry;
+        while (s_finished.size() > kMaxFinished) {
+            s_finished.removeFirst();
+        }
+    }
+    qDebug().noquote() << "Process finished:" << m_usage.describe();
+}
+
+void ProcessSupervisor::sample()
+{
+    if (m_pid <= 0) {
+        return;
+    }
+
+#if defined(Q_OS_LINUX)
+    // stat 第 14、15 项为用户态和内核态时间（时钟滴答），命令名可能含空格，从最后一个 ')' 之后数
+    QByteArray stat = readProcFile(m_pid, "stat");
+    int nameEnd = stat.lastIndexOf(')');
+    if (nameEnd < 0) {
+        return;
+    }
+    QList<QByteArray> fields = stat.mid(nameEnd + 2).split(' ');
+    if (fields.size() > 12) {
+        static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+        qint64 ticks = fields.at(11).toLongLong() + fields.at(12).toLongLong();
+        m_usage.cpuMs = ticks * 1000 / qMax(1L, ticksPerSecond);
+    }
+
+    qint64 peakKb = procField(readProcFile(m_pid, "status"), "VmHWM:");
+    if (peakKb > 0) {
+        m_usage.peakRssBytes = qMax(m_usage.peakRssBytes, peakKb * 1024);
+    }
+
+    // rchar / wchar 包括命中页缓存和管道的读写，更接近进程实际搬动的数据量
+    QByteArray io = readProcFile(m_pid, "io");
+    qint64 readBytes = procField(io, "rchar:");
+    qint64 writeBytes = procField(io, "wchar:");
+    if (readBytes >= 0) {
+        m_usage.readBytes = readBytes;
+    }
+    if (writeBytes >= 0) {
+        m_usage.writeBytes = writeBytes;
+    }
+#elif defined(Q_OS_WIN)
+    HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(m_pid));
+    if (!handle) {
+        return;
+    }
+
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(handle, &creation, &exit, &kernel, &user)) {
+        auto toMs = [](const FILETIME &time) {
+            return ((qint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10000;
+        };
+        m_usage.cpuMs = toMs(kernel) + toMs(user);
+    }
+
+    PROCESS_MEMORY_COUNTERS memory;
+    if (GetProcessMemoryInfo(handle, &memory, sizeof(memory))) {
+        m_usage.peakRssBytes = qMax(m_usage.peakRssBytes, qint64(memory.PeakWorkingSetSize));
+    }
+
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(handle, &io)) {
+        m_usage.readBytes = qint64(io.ReadTransferCount);
+        m_usage.writeBytes = qint64(io.WriteTransferCount);
+    }
+    CloseHandle(handle);
+#endif
+}
+
+void StallDetector::start(qint64 firstUnitMs, bool preemptible)
+{
+    m_preemptible = preemptible;
+    m_preemptedAtProgress = preemptedMs();
+    m_units = 0;
+    m_firstUnitMs = firstUnitMs;
+    m_averageMs = 0;
+    m_longestGapMs = 0;
+    m_sinceProgress.start();
+}
+
+void StallDetector::progress(qint64 units)
+{
+    if (units <= m_units) {
+        return;
+    }
+
+    // 被交互式作业抢占的时间不算作本作业的耗时
+    qint64 preempted = preemptedMs();
+    qint64 gap = qMax<qint64>(0, m_sinceProgress.restart() - (preempted - m_preemptedAtProgress));
+    m_preemptedAtProgress = preempted;
+    // 第一个单位包含模型加载等启动开销，不计入平均
+    if (m_units > 0) {
+        double perUnit = double(gap) / (units - m_units);
+        m_averageMs = m_averageMs > 0 ? 0.8 * m_averageMs + 0.2 * perUnit : perUnit;
+        m_longestGapMs = qMax(m_longestGapMs, gap);
+    }
+    m_units = units;
+}
+
+qint64 StallDetector::idleMs() const
+{
+    if (!m_sinceProgress.isValid()) {
+        return 0;
+    }
+    return qMax<qint64>(0, m_sinceProgress.elapsed() - (preemptedMs() - m_preemptedAtProgress));
+}
+
+qint64 StallDetector::preemptedMs() const
+{
+    return m_preemptible ? PriorityScheduler::preemptedMs() : 0;
+}
+
+qint64 StallDetector::thresholdMs() const
+{
+    if (m_units == 0) {
+        return m_firstUnitMs;
+    }
+    return qMax(kMinStallMs, qMax(qint64(10 * m_averageMs), 3 * m_longestGapMs));
+}
@@ -0,0 +1,95 @@
+#ifndef PROCESSSUPERVISOR_H
+#define PROCESSSUPERVISOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QProcess>
+
+class QTimer;
+
+// 每个经 ProcessLauncher 启动的子进程都挂一个监管对象（作为进程的子对象）：
+// 持续读走 stdout/stderr，只保留最近一段输出，长时间运行的 ffmpeg 不会把日志堆在内存里；
+// 运行期间定时采样 CPU 时间、峰值内存和读写字节数，进程结束后登记到其所属对象名下
+class ProcessSupervisor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Usage {
+        QString label;
+        qint64 wallMs = 0;
+        qint64 cpuMs = 0;
+        qint64 peakRssBytes = 0;
+        qint64 readBytes = 0;
+        qint64 writeBytes = 0;
+        int exitCode = 0;
+
+        QString describe() const;
+    };
+
+    static const int kTailBytes = 64 * 1024;
+    static const int kDefaultGraceMs = 3000;
+
+    // 取得（必要时创建）进程的监管对象，需在进程启动前调用
+    static ProcessSupervisor *attach(QProcess *process);
+    // 不阻塞地结束进程：先 terminate，graceMs 后仍未退出再 kill
+    static void stop(QProcess *process, int graceMs = kDefaultGraceMs);
+    // 取出 owner 及其子对象启动过的、已结束子进程的资源占用
+    static QList<Usage> takeFinished(QObject *owner);
+    // 按程序汇总，每种程序一行
+    static QStringList usageReport(const QList<Usage> &usages);
+
+    void setLabel(const QString &label);
+    QString label() const { return m_usage.label; }
+    // 最近的输出（stdout 与 stderr 按到达顺序合并）
+    QString tail(int maxChars = kTailBytes) const;
+    Usage usage() const { return m_usage; }
+
+signals:
+    // 每次读到的新输出，需要解析进度的调用方连接这个信号而不是直接读进程
+    void outputReady(const QByteArray &data);
+
+private:
+    explicit ProcessSupervisor(QProcess *process);
+    void readOutput();
+    void handleStarted();
+    void handleFinished(int exitCode);
+    void sample();
+
+    QProcess *m_process;
+    QTimer *m_sampleTimer;
+    QElapsedTimer m_wallTimer;
+    QByteArray m_tail;
+    Usage m_usage;
+    qint64 m_pid = 0;
+};
+
+// 卡死判定：第一个单位（帧）出来前按给定时间；之后阈值随观察到的单位耗时变化，
+// 取近期平均耗时的 10 倍和最长间隔的 3 倍中较大者，且不少于 30 秒。
+// 慢速 4K 任务不会被固定超时误杀，快速任务真的卡住也能及时发现。被抢占暂停的时间不计入等待
+class StallDetector
+{
+public:
+    // preemptible 为 true 时（后台优先级的作业）扣除被暂停的时间，其他作业不会被暂停，照常计时
+    void start(qint64 firstUnitMs, bool preemptible = false);
+    // units 为累计完成数
+    void progress(qint64 units);
+    bool isStalled() const { return idleMs() > thresholdMs(); }
+    qint64 idleMs() const;
+    qint64 thresholdMs() const;
+    double averageUnitMs() const { return m_averageMs; }
+
+private:
+    qint64 preemptedMs() const;
+
+    QElapsedTimer m_sinceProgress;
+    bool m_preemptible = false;
+    qint64 m_units = 0;
+    qint64 m_firstUnitMs = 0;
+    double m_averageMs = 0;
+    qint64 m_longestGapMs = 0;
+    qint64 m_preemptedAtProgress = 0; // 上次进展时 PriorityScheduler 的累计抢占时间
+};
+
+#endif // PROCESSSUPERVISOR_H
@@ -0,0 +1,104 @@
+#include "ProgressAggregator.h"
+#include <QMutexLocker>
+
+ProgressAggregator::ProgressAggregator(QObject *parent, int intervalMs)
+    : QObject(parent)
+{
+    m_timer.setInterval(intervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &ProgressAggregator::publish);
+}
+
+void ProgressAggregator::begin(int totalItems)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_state = ProgressSnapshot();
+        m_state.totalItems = totalItems;
+        m_changed.clear();
+        m_dirty = true;
+    }
+    m_timer.start();
+}
+
+void ProgressAggregator::end()
+{
+    m_timer.stop();
+    // 最后一次更新不能丢
+    publish();
+}
+
+void ProgressAggregator::report(int workerId, double percent, const QString &status)
+{
+    QMutexLocker locker(&m_mutex);
+    WorkerProgress &worker = m_state.workers[workerId];
+    worker.percent = qBound(0.0, percent, 100.0);
+    if (!status.isEmpty()) {
+        worker.status = status;
+        m_state.status = status;
+    }
+    m_changed.insert(workerId);
+    m_dirty = true;
+}
+
+void ProgressAggregator::finishWorker(int workerId)
+{
+    QMutexLocker locker(&m_mutex);
+    m_state.workers.remove(workerId);
+    ++m_state.finishedItems;
+    m_changed.insert(workerId);
+    m_dirty = true;
+}
+
+void ProgressAggregator::removeWorker(int workerId)
+{
+    QMutexLocker locker(&m_mutex);
+    m_state.workers.remove(workerId);
+    m_changed.insert(workerId);
+    m_dirty = true;
+}
+
+void ProgressAggregator::setTotalItems(int totalItems)
+{
+    QMutexLocker locker(&m_mutex);
+    m_state.totalItems = totalItems;
+    m_dirty = true;
+}
+
+ProgressSnapshot ProgressAggregator::snapshot() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_state;
+}
+
+void ProgressAggregator::updateOverall()
+{
+    if (m_state.totalItems <= 0) {
+        m_state.overallPercent = 0;
+        return;
+    }
+
+    double sum = m_state.finishedItems * 100.0;
+    for (const WorkerProgress &worker : m_state.workers) {
+        sum += worker.percent;
+    }
+    m_state.overallPercent = qMin(100.0, sum / m_state.totalItems);
+}
+
+void ProgressAggregator::publish()
+{
+    ProgressSnapshot snapshot;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_dirty) {
+            return;
+        }
+        updateOverall();
+        snapshot = m_state;
+        snapshot.changedWorkers = m_changed.values();
+        m_changed.clear();
+        m_dirty = false;
+    }
+
+    // 锁外发信号，槽函数里再调用 report 也不会死锁
+    emit progressChanged(snapshot);
+}
@@ -0,0 +1,62 @@
+#ifndef PROGRESSAGGREGATOR_H
+#define PROGRESSAGGREGATOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QTimer>
+
+struct WorkerProgress {
+    double percent = 0;
+    QString status;
+};
+
+// 某一时刻的整体进度
+struct ProgressSnapshot {
+    int totalItems = 0;
+    int finishedItems = 0;
+    double overallPercent = 0;
+    QString status;
+    // 仍在处理中的条目
+    QHash<int, WorkerProgress> workers;
+    // 自上次发布以来有变化的条目（包括已完成的）
+    QList<int> changedWorkers;
+};
+
+// 合并各个工作项的进度更新，按固定频率向 GUI 发布一次快照。
+// report 可在任意线程调用，只做加锁赋值；发布由 GUI 线程的定时器驱动，
+// 因此无论有多少并发任务，GUI 每秒处理的进度信号数量都是固定的
+class ProgressAggregator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProgressAggregator(QObject *parent = nullptr, int intervalMs = 50);
+
+    // begin/end 需在 GUI 线程调用
+    void begin(int totalItems);
+    void end();
+    bool isActive() const { return m_timer.isActive(); }
+
+    void report(int workerId, double percent, const QString &status = QString());
+    void finishWorker(int workerId);
+    void removeWorker(int workerId);
+    void setTotalItems(int totalItems);
+    ProgressSnapshot snapshot() const;
+
+signals:
+    void progressChanged(const ProgressSnapshot &snapshot);
+
+private:
+    void publish();
+    void updateOverall();
+
+    mutable QMutex m_mutex;
+    ProgressSnapshot m_state;
+    QSet<int> m_changed;
+    bool m_dirty = false;
+    QTimer m_timer;
+};
+
+#endif // PROGRESSAGGREGATOR_H
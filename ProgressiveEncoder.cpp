@@ -0,0 +1,240 @@
+#include "ProgressiveEncoder.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointer>
+#include <QTimer>
+
+namespace {
+// 管道里最多积压的数据量，编码跟不上时不再读入新帧
+const qint64 kMaxBufferedBytes = 16 * 1024 * 1024;
+const int kPollIntervalMs = 500;
+// 帧还在生成时，文件最后修改超过这个时间才认为已写完
+const int kSettleMs = 1000;
+// 关闭管道后等 ffmpeg 写完尾部的时间
+const int kFinishGraceMs = 30000;
+
+bool isFragmentedContainer(const QString &suffix)
+{
+    return suffix == "mp4" || suffix == "mov" || suffix == "m4v";
+}
+}
+
+ProgressiveEncoder::ProgressiveEncoder(QObject *parent)
+    : QObject(parent), m_pollTimer(new QTimer(this))
+{
+    connect(m_pollTimer, &QTimer::timeout, this, &ProgressiveEncoder::feed);
+    // 帧必须按顺序送入管道，同一时间只有一个读取任务
+    m_readPool.setMaxThreadCount(1);
+}
+
+ProgressiveEncoder::~ProgressiveEncoder()
+{
+    m_readPool.waitForDone();
+}
+
+QStringList ProgressiveEncoder::pipeInputArgs(const QString &suffix, const QString &fps)
+{
+    QString decoder = suffix == "jpg" || suffix == "jpeg" ? "mjpeg" : suffix;
+    return QStringList() << "-f" << "image2pipe"
+                         << "-c:v" << decoder
+                         << "-r" << fps
+                         << "-i" << "-";
+}
+
+QStringList ProgressiveEncoder::fragmentArgs(const QString &container, int keyframeInterval)
+{
+    QStringList args;
+    args << "-g" << QString::number(qMax(1, keyframeInterval));
+    if (isFragmentedContainer(container)) {
+        // 文件头里不带样本表，每个关键帧写出一个 moof 分片，播放器读到哪里就能放到哪里
+        args << "-movflags" << "+frag_keyframe+empty_moov+default_base_moof";
+    }
+    return args;
+}
+
+void ProgressiveEncoder::start(const QString &ffmpegPath, const QStringList &arguments,
+                               const QString &frameDir, const QString &suffix, const QString &outputPath)
+{
+    m_frameDir = frameDir;
+    m_suffix = suffix;
+    m_outputPath = outputPath;
+    m_nextFrame = 1;
+    m_totalFrames = -1;
+    m_stopping = false;
+    m_reading = false;
+    ++m_generation;
+    m_firstFragmentMs = -1;
+
+    if (m_process) {
+        m_process->deleteLater();
+    }
+    m_process = new QProcess(this);
+    connect(m_process, &QProcess::bytesWritten, this, &ProgressiveEncoder::feed);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ProgressiveEncoder::handleFinished);
+
+    qDebug() << "Progressive FFmpeg command:" << ffmpegPath << arguments;
+    ProcessLauncher::start(m_process, ffmpegPath, arguments, ProcessLauncher::Encoder);
+    ProcessSupervisor::attach(m_process)->setLabel("ffmpeg (progressive)");
+    m_timer.start();
+    m_pollTimer->start(kPollIntervalMs);
+}
+
+void ProgressiveEncoder::finishInput(int totalFrames)
+{
+    m_totalFrames = totalFrames;
+    feed();
+}
+
+void ProgressiveEncoder::stop()
+{
+    if (!isRunning() || m_stopping) {
+        return;
+    }
+
+    m_stopping = true;
+    m_pollTimer->stop();
+    m_process->closeWriteChannel();
+    QPointer<QProcess> guard(m_process);
+    QTimer::singleShot(kFinishGraceMs, this, [guard]() {
+        ProcessSupervisor::stop(guard);
+    });
+}
+
+bool ProgressiveEncoder::isRunning() const
+{
+    return m_process && m_process->state() != QProcess::NotRunning;
+}
+
+void ProgressiveEncoder::feed()
+{
+    if (!isRunning() || m_stopping || m_reading) {
+        return;
+    }
+
+    if (m_totalFrames >= 0 && m_nextFrame > m_totalFrames) {
+        // 全部送完，关闭管道后 ffmpeg 写出最后一个分片并退出
+        m_stopping = true;
+        m_pollTimer->stop();
+        m_process->closeWriteChannel();
+        return;
+    }
+
+    qint64 budget = kMaxBufferedBytes - m_process->bytesToWrite();
+    if (budget <= 0) {
+        return;
+    }
+
+    m_reading = true;
+    int generation = m_generation;
+    QString frameDir = m_frameDir;
+    QString suffix = m_suffix;
+    int first = m_nextFrame;
+    int totalFrames = m_totalFrames;
+    QString outputPath = m_firstFragmentMs < 0 ? m_outputPath : QString();
+    m_readPool.start([this, generation, frameDir, suffix, first, totalFrames, budget, outputPath]() {
+        Batch batch = readBatch(frameDir, suffix, first, totalFrames, budget, outputPath);
+        QMetaObject::invokeMethod(this, [this, generation, batch]() {
+            if (generation == m_generation) {
+                handleBatch(batch);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ProgressiveEncoder::handleBatch(const Batch &batch)
+{
+    m_reading = false;
+    if (batch.fragmentSeen && m_firstFragmentMs < 0) {
+        m_firstFragmentMs = m_timer.elapsed();
+    }
+    if (!isRunning() || m_stopping || batch.first != m_nextFrame) {
+        return;
+    }
+
+    for (const QByteArray &frame : batch.frames) {
+        m_process->write(frame);
+    }
+    m_nextFrame += batch.frames.size();
+    if (batch.missing && m_totalFrames >= 0) {
+        qWarning() << "Progressive encoder: missing frame" << m_nextFrame;
+        m_totalFrames = m_nextFrame - 1;
+    }
+
+    if (!batch.frames.isEmpty()) {
+        emit framesWrittenChanged(framesWritten());
+    }
+    // 读到了帧说明可能还有更多已就绪，不等轮询直接接着读；全部送完时在 feed 里关闭管道
+    if (!batch.frames.isEmpty() || batch.missing || (m_totalFrames >= 0 && m_nextFrame > m_totalFrames)) {
+        feed();
+    }
+}
+
+ProgressiveEncoder::Batch ProgressiveEncoder::readBatch(const QString &frameDir, const QString &suffix, int first,
+                                                        int totalFrames, qint64 budget, const QString &outputPath)
+{
+    Batch batch;
+    batch.first = first;
+    QDateTime now = QDateTime::currentDateTime();
+    qint64 bytes = 0;
+    for (int index = first; bytes < budget; ++index) {
+        if (totalFrames >= 0 && index > totalFrames) {
+            break;
+        }
+
+        // 放大程序多线程写文件，帧不一定按顺序出现，刚出现的文件可能还没写完
+        QFileInfo info(QDir(frameDir).filePath(QString("frame%1.%2").arg(index, 8, 10, QChar('0')).arg(suffix)));
+        if (!info.exists()) {
+            batch.missing = totalFrames >= 0;
+            break;
+        }
+        if (totalFrames < 0 && (info.size() <= 0 || info.lastModified().msecsTo(now) < kSettleMs)) {
+            break;
+        }
+
+        QFile file(info.filePath());
+        if (!file.open(QIODevice::ReadOnly)) {
+            break;
+        }
+        batch.frames << file.readAll();
+        bytes += batch.frames.last().size();
+    }
+
+    if (!outputPath.isEmpty()) {
+        batch.fragmentSeen = hasFragment(outputPath);
+    }
+    return batch;
+}
+
+bool ProgressiveEncoder::hasFragment(const QString &outputPath)
+{
+    // MP4 的第一个 moof 出现后文件才有可播放的内容；其他封装写出数据即可播放
+    QFile file(outputPath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+    return !isFragmentedContainer(QFileInfo(outputPath).suffix().toLower())
+           || file.read(1024 * 1024).contains("moof");
+}
+
+void ProgressiveEncoder::handleFinished(int exitCode, QProcess::ExitStatus status)
+{
+    m_pollTimer->stop();
+    if (m_firstFragmentMs < 0 && hasFragment(m_outputPath)) {
+        m_firstFragmentMs = m_timer.elapsed();
+    }
+
+    bool ok = status == QProcess::NormalExit && exitCode == 0;
+    QString error;
+    if (!ok) {
+        error = QString("FFmpeg处理失败 (代码 %1): %2")
+                    .arg(exitCode)
+                    .arg(ProcessSupervisor::attach(m_process)->tail(4000));
+    }
+    emit finished(ok, error);
+}
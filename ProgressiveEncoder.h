@@ -0,0 +1,78 @@
+#ifndef PROGRESSIVEENCODER_H
+#define PROGRESSIVEENCODER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QProcess>
+#include <QThreadPool>
+
+class QTimer;
+
+// 边增强边编码：按顺序等待 frame%08d.<suffix> 写完，通过管道送给 ffmpeg。
+// 读帧文件在工作线程里进行，界面线程只把读好的数据交给管道。
+// 输出为分片 MP4，每个关键帧开始一个新分片，处理过程中即可打开观看；
+// 中途停止时关闭管道让 ffmpeg 正常收尾，已编码的部分仍可播放
+class ProgressiveEncoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProgressiveEncoder(QObject *parent = nullptr);
+    ~ProgressiveEncoder();
+
+    // 管道输入的参数：-f image2pipe -c:v <解码器> -r <fps> -i -
+    static QStringList pipeInputArgs(const QString &suffix, const QString &fps);
+    // 固定关键帧间隔；MP4/MOV 另加分片参数，每个关键帧一个分片，其他封装本身可边写边读
+    static QStringList fragmentArgs(const QString &container, int keyframeInterval);
+
+    // arguments 为完整的 ffmpeg 参数，第一个输入须为 pipeInputArgs()；outputPath 用于判断第一个分片何时写出
+    void start(const QString &ffmpegPath, const QStringList &arguments,
+               const QString &frameDir, const QString &suffix, const QString &outputPath);
+    // 帧已全部生成，送完剩余的帧后结束编码
+    void finishInput(int totalFrames);
+    // 提前结束：不再送新帧，让 ffmpeg 写完已收到的部分
+    void stop();
+
+    bool isRunning() const;
+    int framesWritten() const { return m_nextFrame - 1; }
+    // 从 start() 到第一个分片写出的时间，-1 表示还没有
+    qint64 firstFragmentMs() const { return m_firstFragmentMs; }
+    QProcess *process() const { return m_process; }
+
+signals:
+    void framesWrittenChanged(int frames);
+    void finished(bool ok, const QString &error);
+
+private:
+    // 一次读取的结果：从 first 开始连续读到的帧，missing 表示帧已全部生成但缺了下一帧
+    struct Batch {
+        int first = 0;
+        QList<QByteArray> frames;
+        bool missing = false;
+        bool fragmentSeen = false;
+    };
+
+    void feed();
+    void handleBatch(const Batch &batch);
+    void handleFinished(int exitCode, QProcess::ExitStatus status);
+    static Batch readBatch(const QString &frameDir, const QString &suffix, int first, int totalFrames,
+                           qint64 budget, const QString &outputPath);
+    static bool hasFragment(const QString &outputPath);
+
+    QProcess *m_process = nullptr;
+    QTimer *m_pollTimer;
+    QString m_frameDir;
+    QString m_suffix;
+    QString m_outputPath;
+    int m_nextFrame = 1;
+    int m_totalFrames = -1;     // -1 表示帧还在生成
+    bool m_stopping = false;
+    bool m_reading = false;
+    int m_generation = 0;       // 丢弃上一次 start() 遗留的读取结果
+    QElapsedTimer m_timer;
+    qint64 m_firstFragmentMs = -1;
+    QThreadPool m_readPool;
+};
+
+#endif // PROGRESSIVEENCODER_H
@@ -0,0 +1,596 @@
+#include "RangeSplicer.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include "ScratchManager.h"
+#include "ThroughputLedger.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+// 总进度中探测和拼接各占的比例，其余按各段帧数分配
+const double kProbeWeight = 5;
+const double kSpliceWeight = 5;
+// 读取流参数只看文件头，超过这个时间认为 ffprobe 卡住了
+const int kProbeTimeoutMs = 5000;
+
+// 已有输出的编码格式对应的编码器，片段必须与之相同才能流复制拼接
+QString encoderFor(const QString &codecName)
+{
+    static const QHash<QString, QString> encoders = {
+        {"h264", "libx264"},
+        {"hevc", "libx265"},
+        {"vp9", "libvpx-vp9"},
+        {"av1", "libsvtav1"},
+        {"prores", "prores_ks"},
+        {"mpeg4", "mpeg4"},
+    };
+    return encoders.value(codecName);
+}
+
+double parseTime(const QString &text, bool *ok)
+{
+    // [时:]分:秒，秒可带小数
+    QStringList parts = text.trimmed().split(':');
+    *ok = !parts.isEmpty() && parts.size() <= 3;
+    double seconds = 0;
+    for (int i = 0; *ok && i < parts.size(); ++i) {
+        bool partOk = false;
+        double value = parts.at(i).trimmed().toDouble(&partOk);
+        *ok = partOk && value >= 0 && (i == 0 || value < 60);
+        seconds = seconds * 60 + value;
+    }
+    return seconds;
+}
+
+QString quoteConcatPath(const QString &path)
+{
+    QString quoted = QDir::fromNativeSeparators(QFileInfo(path).absoluteFilePath());
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+}
+
+RangeSplicer::RangeSplicer(QObject *parent) : QObject(parent)
+{
+}
+
+RangeSplicer::~RangeSplicer()
+{
+    cancel();
+}
+
+void RangeSplicer::setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath,
+                                      const QString &ffprobePath)
+{
+    m_realesrganPath = realesrganPath;
+    m_ffmpegPath = ffmpegPath;
+    m_ffprobePath = ffprobePath;
+}
+
+void RangeSplicer::setAvailableModels(const QStringList &models)
+{
+    m_availableModels = models;
+}
+
+void RangeSplicer::setEncodeSettings(const VideoProcessor::EncodeSettings &settings)
+{
+    m_encodeSettings = settings;
+}
+
+QList<RangeSplicer::Range> RangeSplicer::parseRanges(const QString &text, bool *ok)
+{
+    QList<Range> ranges;
+    bool valid = true;
+    for (const QString &item : text.split(QRegularExpression("[,;，；]"), Qt::SkipEmptyParts)) {
+        QStringList bounds = item.split('-');
+        if (bounds.size() != 2) {
+            valid = false;
+            break;
+        }
+
+        bool startOk = false;
+        bool endOk = false;
+        Range range;
+        range.startSec = parseTime(bounds.at(0), &startOk);
+        range.endSec = parseTime(bounds.at(1), &endOk);
+        if (!startOk || !endOk || range.endSec <= range.startSec) {
+            valid = false;
+            break;
+        }
+        ranges << range;
+    }
+
+    if (ok) {
+        *ok = valid && !ranges.isEmpty();
+    }
+    return valid ? ranges : QList<Range>();
+}
+
+QString RangeSplicer::formatTimestamp(double seconds)
+{
+    qint64 ms = qRound64(qMax(0.0, seconds) * 1000);
+    return QString("%1:%2:%3.%4")
+        .arg(ms / 3600000, 2, 10, QChar('0'))
+        .arg(ms / 60000 % 60, 2, 10, QChar('0'))
+        .arg(ms / 1000 % 60, 2, 10, QChar('0'))
+        .arg(ms % 1000, 3, 10, QChar('0'));
+}
+
+bool RangeSplicer::start(const QString &inputPath, const QString &previousOutput, const QString &modelName,
+                         const QList<Range> &ranges)
+{
+    if (m_running || ranges.isEmpty()) {
+        return false;
+    }
+
+    m_inputPath = inputPath;
+    m_previousOutput = previousOutput;
+    m_modelName = modelName;
+    m_ranges = ranges;
+    std::sort(m_ranges.begin(), m_ranges.end(), [](const Range &a, const Range &b) {
+        return a.startSec < b.startSec;
+    });
+    m_spans.clear();
+    m_spanIndex = -1;
+    m_doneFrames = 0;
+    m_renderFrames = 0;
+    m_frameTimes.clear();
+    m_keyFrames.clear();
+    m_pendingLine.clear();
+    m_outputPath.clear();
+    m_running = true;
+    m_timer.start();
+
+    emit progressPercentageChanged(0);
+    emit progressUpdated("正在读取已有输出的关键帧...");
+    probeStream(m_previousOutput, "stream=codec_name,width,height,pix_fmt", &RangeSplicer::handleOutputProbed);
+    return true;
+}
+
+void RangeSplicer::startPacketScan()
+{
+    // 逐个数据包列出时间和关键帧标记，只读封装不解码；长视频的输出很多，边读边解析
+    m_process = new QProcess(this);
+    connect(ProcessSupervisor::attach(m_process), &ProcessSupervisor::outputReady, this,
+            [this](const QByteArray &data) {
+                m_pendingLine += data;
+                int end;
+                while ((end = m_pendingLine.indexOf('\n')) >= 0) {
+                    QList<QByteArray> fields = m_pendingLine.left(end).trimmed().split(',');
+                    m_pendingLine.remove(0, end + 1);
+                    bool timeOk = false;
+                    double time = fields.value(0).toDouble(&timeOk);
+                    if (!timeOk) {
+                        continue;
+                    }
+                    m_frameTimes << time;
+                    if (fields.value(1).startsWith('K')) {
+                        m_keyFrames << m_frameTimes.size() - 1;
+                    }
+                }
+            });
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &RangeSplicer::handlePacketsFinished);
+    ProcessLauncher::start(m_process, m_ffprobePath,
+                           QStringList() << "-v" << "error"
+                                         << "-select_streams" << "v:0"
+                                         << "-show_entries" << "packet=pts_time,flags"
+                                         << "-of" << "csv=p=0"
+                                         << m_previousOutput,
+                           ProcessLauncher::Utility);
+}
+
+void RangeSplicer::cancel()
+{
+    m_running = false;
+    releaseProcessor();
+    if (m_process) {
+        disconnect(m_process, nullptr, this, nullptr);
+        ProcessSupervisor::stop(m_process);
+        m_process = nullptr;
+    }
+    if (!m_stagingPath.isEmpty()) {
+        QFile::remove(m_stagingPath);
+        m_stagingPath.clear();
+    }
+    ScratchManager::release(m_tempDir);
+    m_tempDir.clear();
+}
+
+void RangeSplicer::probeStream(const QString &path, const QString &entries,
+                               void (RangeSplicer::*handler)(const QHash<QString, QString> &))
+{
+    m_process = new QProcess(this);
+    QProcess *process = m_process;
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this, process, handler](int exitCode, QProcess::ExitStatus exitStatus) {
+                m_process = nullptr;
+                process->deleteLater();
+                if (!m_running) {
+                    return;
+                }
+                QHash<QString, QString> values;
+                if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+                    for (const QString &line : ProcessSupervisor::attach(process)->tail().split('\n', Qt::SkipEmptyParts)) {
+                        values.insert(line.section('=', 0, 0).trimmed(), line.section('=', 1).trimmed());
+                    }
+                }
+                (this->*handler)(values);
+            });
+    ProcessLauncher::start(process, m_ffprobePath,
+                           QStringList() << "-v" << "error"
+                                         << "-select_streams" << "v:0"
+                                         << "-show_entries" << entries
+                                         << "-of" << "default=noprint_wrappers=1"
+                                         << path,
+                           ProcessLauncher::Utility);
+    QTimer::singleShot(kProbeTimeoutMs, process, [process]() {
+        ProcessSupervisor::stop(process);
+    });
+}
+
+void RangeSplicer::handleOutputProbed(const QHash<QString, QString> &values)
+{
+    m_outputSize = QSize(values.value("width").toInt(), values.value("height").toInt());
+    m_outputCodec = values.value("codec_name");
+    m_pixelFormat = values.value("pix_fmt");
+    if (m_outputSize.isEmpty() || m_outputCodec.isEmpty()) {
+        fail(QString("无法读取已有输出的视频参数: %1").arg(m_previousOutput));
+        return;
+    }
+    if (encoderFor(m_outputCodec).isEmpty()) {
+        fail(QString("已有输出的编码格式 %1 不支持局部重做").arg(m_outputCodec));
+        return;
+    }
+
+    probeStream(m_inputPath, "stream=r_frame_rate", &RangeSplicer::handleInputProbed);
+}
+
+void RangeSplicer::handleInputProbed(const QHash<QString, QString> &values)
+{
+    // 输出的第 n 帧就是原视频的第 n 帧，按原视频的精确帧率换算定位时间
+    QString rate = values.value("r_frame_rate");
+    double numerator = rate.section('/', 0, 0).toDouble();
+    double denominator = rate.section('/', 1, 1).toDouble();
+    m_sourceFps = denominator > 0 ? numerator / denominator : 0;
+    if (m_sourceFps <= 0) {
+        fail("无法获取原视频帧率信息");
+        return;
+    }
+
+    startPacketScan();
+}
+
+void RangeSplicer::handlePacketsFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus)
+
+    QProcess *process = m_process;
+    m_process = nullptr;
+    process->deleteLater();
+    if (!m_running) {
+        return;
+    }
+    if (exitCode != 0 || m_frameTimes.isEmpty()) {
+        fail(QString("无法读取已有输出的关键帧: %1").arg(ProcessSupervisor::attach(process)->tail(2000)));
+        return;
+    }
+
+    // 数据包按解码顺序列出，有 B 帧时需按时间重排为显示顺序
+    QVector<double> keyTimes;
+    for (int frame : m_keyFrames) {
+        keyTimes << m_frameTimes.at(frame);
+    }
+    std::sort(m_frameTimes.begin(), m_frameTimes.end());
+    m_keyFrames.clear();
+    for (double time : keyTimes) {
+        m_keyFrames << int(std::lower_bound(m_frameTimes.begin(), m_frameTimes.end(), time) - m_frameTimes.begin());
+    }
+    std::sort(m_keyFrames.begin(), m_keyFrames.end());
+    m_keyFrames.erase(std::unique(m_keyFrames.begin(), m_keyFrames.end()), m_keyFrames.end());
+
+    planSpans();
+    if (!m_running) {
+        return;
+    }
+
+    QString error;
+    m_tempDir = ScratchManager::allocate(QFileInfo(m_inputPath).completeBaseName() + "_splice", 0, &error);
+    if (m_tempDir.isEmpty()) {
+        fail(error);
+        return;
+    }
+    for (int i = 0; i < m_spans.size(); ++i) {
+        m_spans[i].segmentPath = QDir(m_tempDir).filePath(
+            QString("segment%1.%2").arg(i, 3, 10, QChar('0')).arg(QFileInfo(m_previousOutput).suffix()));
+    }
+
+    emit progressUpdated(QString("%1 个时间段按关键帧对齐为 %2 段，共需重做 %3 / %4 帧")
+                             .arg(m_ranges.size()).arg(m_spans.size())
+                             .arg(m_renderFrames).arg(m_frameTimes.size()));
+    updateProgress(0);
+    startNextSpan();
+}
+
+void RangeSplicer::planSpans()
+{
+    const int total = m_frameTimes.size();
+    for (const Range &range : m_ranges) {
+        int startFrame = int(std::lower_bound(m_frameTimes.begin(), m_frameTimes.end(), range.startSec)
+                             - m_frameTimes.begin());
+        int endFrame = int(std::lower_bound(m_frameTimes.begin(), m_frameTimes.end(), range.endSec)
+                           - m_frameTimes.begin());
+        if (startFrame >= total) {
+            fail(QString("时间段 %1 超出已有输出的长度 %2")
+                     .arg(formatTimestamp(range.startSec), formatTimestamp(frameTime(total))));
+            return;
+        }
+        endFrame = qBound(startFrame + 1, endFrame, total);
+
+        // 向前扩展到起点所在 GOP 的关键帧，向后扩展到终点之后的第一个关键帧
+        auto first = std::upper_bound(m_keyFrames.begin(), m_keyFrames.end(), startFrame);
+        auto last = std::lower_bound(m_keyFrames.begin(), m_keyFrames.end(), endFrame);
+        Span span;
+        span.firstFrame = first == m_keyFrames.begin() ? 0 : *(first - 1);
+        span.frameCount = (last == m_keyFrames.end() ? total : *last) - span.firstFrame;
+        span.requested << range;
+
+        // 扩展后相接或重叠的段合并，避免同一个 GOP 编码两次
+        if (!m_spans.isEmpty() && span.firstFrame <= m_spans.last().firstFrame + m_spans.last().frameCount) {
+            Span &previous = m_spans.last();
+            int end = qMax(previous.firstFrame + previous.frameCount, span.firstFrame + span.frameCount);
+            previous.frameCount = end - previous.firstFrame;
+            previous.requested << range;
+        } else {
+            m_spans << span;
+        }
+    }
+
+    for (const Span &span : m_spans) {
+        m_renderFrames += span.frameCount;
+    }
+}
+
+double RangeSplicer::frameTime(int frame) const
+{
+    if (frame < m_frameTimes.size()) {
+        return m_frameTimes.at(frame);
+    }
+    // 末尾之后按平均帧间隔外推
+    double interval = m_frameTimes.size() > 1
+                          ? (m_frameTimes.last() - m_frameTimes.first()) / (m_frameTimes.size() - 1)
+                          : 1.0 / m_sourceFps;
+    return m_frameTimes.last() + interval * (frame - m_frameTimes.size() + 1);
+}
+
+void RangeSplicer::startNextSpan()
+{
+    if (!m_running) {
+        return;
+    }
+    if (++m_spanIndex >= m_spans.size()) {
+        splice();
+        return;
+    }
+
+    const Span &span = m_spans.at(m_spanIndex);
+    m_spanStage = VideoProcessor::StageExtract;
+    emit progressUpdated(QString("正在重做第 %1/%2 段：%3 - %4（%5 帧）")
+                             .arg(m_spanIndex + 1).arg(m_spans.size())
+                             .arg(formatTimestamp(frameTime(span.firstFrame)),
+                                  formatTimestamp(frameTime(span.firstFrame + span.frameCount)))
+                             .arg(span.frameCount));
+
+    // 编码器、像素格式和封装跟随已有输出；尺寸固定为已有输出的尺寸，换模型时也能直接拼接
+    VideoProcessor::EncodeSettings settings = m_encodeSettings;
+    settings.videoCodec = encoderFor(m_outputCodec);
+    settings.pixelFormat = m_pixelFormat;
+    settings.container = QFileInfo(m_previousOutput).suffix();
+    ScaleTarget target;
+    target.mode = ScaleTarget::Size;
+    target.size = m_outputSize;
+
+    m_processor = new VideoProcessor(this);
+    m_processor->setStageControlled(true);
+    if (!m_realesrganPath.isEmpty()) {
+        m_processor->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+    }
+    m_processor->setEncodeSettings(settings);
+    m_processor->setScaleTarget(target, m_availableModels);
+    // 定位到目标帧前半帧处，避免时间取整后多抽或少抽一帧
+    m_processor->setSegment(qMax(0.0, (span.firstFrame - 0.5) / m_sourceFps), span.frameCount, span.segmentPath);
+    connect(m_processor, &VideoProcessor::errorOccurred, this, &RangeSplicer::fail);
+    connect(m_processor, &VideoProcessor::prepared, this, [this]() {
+        m_processor->runStage(VideoProcessor::StageExtract);
+    });
+    connect(m_processor, &VideoProcessor::stageFinished, this, &RangeSplicer::handleSpanStage);
+    connect(m_processor, &VideoProcessor::progressPercentageChanged, this, [this](double percent) {
+        switch (m_spanStage) {
+        case VideoProcessor::StageExtract: updateProgress(percent * 0.1); break;
+        case VideoProcessor::StageEnhance: updateProgress(10 + percent * 0.8); break;
+        default: updateProgress(90 + percent * 0.1); break;
+        }
+    });
+
+    m_processor->prepare(m_inputPath, m_modelName, ScalePlanner::nativeScale(m_modelName), "png", false);
+}
+
+void RangeSplicer::handleSpanStage(VideoProcessor::Stage stage)
+{
+    const Span &span = m_spans.at(m_spanIndex);
+    if (stage == VideoProcessor::StageExtract && m_processor->frameCount() != span.frameCount) {
+        fail(QString("抽出的帧数与已有输出不一致（预期 %1，实际 %2），原视频可能是可变帧率")
+                 .arg(span.frameCount).arg(m_processor->frameCount()));
+        return;
+    }
+
+    if (stage == VideoProcessor::StageRebuild) {
+        m_doneFrames += span.frameCount;
+        releaseProcessor();
+        QMetaObject::invokeMethod(this, [this]() { startNextSpan(); }, Qt::QueuedConnection);
+        return;
+    }
+
+    // 不在信号发射过程中进入下一阶段
+    m_spanStage = stage + 1;
+    VideoProcessor::Stage next = VideoProcessor::Stage(m_spanStage);
+    QMetaObject::invokeMethod(this, [this, next]() {
+        if (m_running && m_processor) {
+            m_processor->runStage(next);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void RangeSplicer::splice()
+{
+    emit progressUpdated("正在拼接...");
+
+    // 未改动的部分从关键帧到关键帧流复制，重做的段整体替换
+    QString listPath = QDir(m_tempDir).filePath("splice.ffconcat");
+    QFile list(listPath);
+    if (!list.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        fail(QString("无法写入拼接列表: %1").arg(listPath));
+        return;
+    }
+    QTextStream stream(&list);
+    stream << "ffconcat version 1.0\n";
+    const int total = m_frameTimes.size();
+    int cursor = 0;
+    auto appendOriginal = [&](int from, int to) {
+        stream << "file " << quoteConcatPath(m_previousOutput) << "\n";
+        if (from > 0) {
+            stream << "inpoint " << QString::number(frameTime(from), 'f', 6) << "\n";
+        }
+        if (to < total) {
+            stream << "outpoint " << QString::number(frameTime(to), 'f', 6) << "\n";
+        }
+    };
+    for (const Span &span : m_spans) {
+        if (span.firstFrame > cursor) {
+            appendOriginal(cursor, span.firstFrame);
+        }
+        stream << "file " << quoteConcatPath(span.segmentPath) << "\n";
+        cursor = span.firstFrame + span.frameCount;
+    }
+    if (cursor < total) {
+        appendOriginal(cursor, total);
+    }
+    list.close();
+
+    QFileInfo previous(m_previousOutput);
+    m_outputPath = previous.absoluteDir().filePath(previous.completeBaseName() + "_spliced." + previous.suffix());
+    m_stagingPath = ScratchManager::stagingPath(m_outputPath);
+
+    m_process = new QProcess(this);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &RangeSplicer::handleSpliceFinished);
+    QStringList args;
+    args << "-y"
+         << "-f" << "concat"
+         << "-safe" << "0"
+         << "-i" << listPath
+         << "-i" << m_previousOutput
+         << "-map" << "0:v:0"
+         << "-map" << "1:a?"
+         << "-c" << "copy"
+         << m_stagingPath;
+    qDebug() << "FFmpeg command:" << m_ffmpegPath << args;
+    ProcessLauncher::start(m_process, m_ffmpegPath, args, ProcessLauncher::Utility);
+}
+
+void RangeSplicer::handleSpliceFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus)
+
+    QProcess *process = m_process;
+    m_process = nullptr;
+    process->deleteLater();
+    if (!m_running) {
+        return;
+    }
+    if (exitCode != 0) {
+        fail(QString("FFmpeg拼接失败 (代码 %1): %2").arg(exitCode).arg(ProcessSupervisor::attach(process)->tail(4000)));
+        return;
+    }
+
+    QString error;
+    if (!ScratchManager::moveToFinal(m_stagingPath, m_outputPath, &error)) {
+        fail(error);
+        return;
+    }
+    m_stagingPath.clear();
+    ScratchManager::release(m_tempDir);
+    m_tempDir.clear();
+    m_running = false;
+
+    QString text = report();
+    qDebug().noquote() << text;
+    emit progressPercentageChanged(100);
+    emit finished(true, text);
+}
+
+void RangeSplicer::fail(const QString &error)
+{
+    if (!m_running) {
+        return;
+    }
+    qWarning() << "Range re-render failed:" << error;
+    cancel();
+    emit finished(false, QString("局部重做失败: %1").arg(error));
+}
+
+void RangeSplicer::releaseProcessor()
+{
+    if (!m_processor) {
+        return;
+    }
+    VideoProcessor *processor = m_processor;
+    m_processor = nullptr;
+    disconnect(processor, nullptr, this, nullptr);
+    processor->cancelProcessing();
+    processor->deleteLater();
+}
+
+void RangeSplicer::updateProgress(double spanPercent)
+{
+    double frames = m_doneFrames;
+    if (m_spanIndex >= 0 && m_spanIndex < m_spans.size()) {
+        frames += m_spans.at(m_spanIndex).frameCount * spanPercent / 100;
+    }
+    double spans = m_renderFrames > 0 ? frames / m_renderFrames : 0;
+    emit progressPercentageChanged(kProbeWeight + spans * (100 - kProbeWeight - kSpliceWeight));
+}
+
+QString RangeSplicer::report() const
+{
+    QStringList lines;
+    lines << QString("局部重做 %1：%2 个时间段按关键帧对齐为 %3 段")
+                 .arg(QFileInfo(m_previousOutput).fileName())
+                 .arg(m_ranges.size()).arg(m_spans.size());
+    for (const Span &span : m_spans) {
+        QStringList requested;
+        for (const Range &range : span.requested) {
+            requested << QString("%1 - %2").arg(formatTimestamp(range.startSec), formatTimestamp(range.endSec));
+        }
+        lines << QString("%1 - %2：%3 帧（请求 %4）")
+                     .arg(formatTimestamp(frameTime(span.firstFrame)),
+                          formatTimestamp(frameTime(span.firstFrame + span.frameCount)))
+                     .arg(span.frameCount)
+                     .arg(requested.join("，"));
+    }
+
+    const int total = m_frameTimes.size();
+    lines << QString("共重做 %1 / %2 帧（%3%），其余画面和音轨直接复制，耗时 %4")
+                 .arg(m_renderFrames).arg(total)
+                 .arg(total > 0 ? m_renderFrames * 100.0 / total : 0, 0, 'f', 1)
+                 .arg(ThroughputLedger::formatDuration(m_timer.elapsed()));
+    lines << QString("输出: %1").arg(m_outputPath);
+    return lines.join("\n");
+}
@@ -0,0 +1,110 @@
+#ifndef RANGESPLICER_H
+#define RANGESPLICER_H
+
+#include <QObject>
+#include <QList>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QProcess>
+#include <QVector>
+#include "VideoProcessor.h"
+
+// 局部重做：只对原视频中的若干时间段重新抽帧、增强，按已有输出的编码参数编成片段，
+// 再以流复制拼回已有输出。每段向外扩展到已有输出的关键帧，只重新编码切点所在的完整 GOP，
+// 其余部分和音轨原样复制
+class RangeSplicer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Range {
+        double startSec = 0;
+        double endSec = 0;
+    };
+
+    explicit RangeSplicer(QObject *parent = nullptr);
+    ~RangeSplicer();
+
+    void setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath, const QString &ffprobePath);
+    void setAvailableModels(const QStringList &models);
+    // 只取其中的码率/crf；编码器、像素格式和封装跟随已有输出
+    void setEncodeSettings(const VideoProcessor::EncodeSettings &settings);
+
+    // previousOutput 是之前由 inputPath 处理得到的完整输出，结果另存为 *_spliced
+    bool start(const QString &inputPath, const QString &previousOutput, const QString &modelName,
+               const QList<Range> &ranges);
+    void cancel();
+    bool isRunning() const { return m_running; }
+    QString outputPath() const { return m_outputPath; }
+
+    // 格式：起点-终点，逗号分隔；时间可写秒数或 [时:]分:秒
+    static QList<Range> parseRanges(const QString &text, bool *ok = nullptr);
+    static QString formatTimestamp(double seconds);
+
+signals:
+    void progressUpdated(const QString &message);
+    void progressPercentageChanged(double percent);
+    void finished(bool ok, const QString &report);
+
+private:
+    // 已有输出中按关键帧对齐后的一段，帧号按显示顺序计
+    struct Span {
+        int firstFrame = 0;
+        int frameCount = 0;
+        QList<Range> requested;
+        QString segmentPath;
+    };
+
+    // 异步运行 ffprobe 读取流参数（key=value），结束后交给 handler；失败或超时时为空
+    void probeStream(const QString &path, const QString &entries,
+                     void (RangeSplicer::*handler)(const QHash<QString, QString> &));
+    void handleOutputProbed(const QHash<QString, QString> &values);
+    void handleInputProbed(const QHash<QString, QString> &values);
+    void startPacketScan();
+    void handlePacketsFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void planSpans();
+    void startNextSpan();
+    void handleSpanStage(VideoProcessor::Stage stage);
+    void splice();
+    void handleSpliceFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void fail(const QString &error);
+    void releaseProcessor();
+    void updateProgress(double spanPercent);
+    double frameTime(int frame) const;
+    QString report() const;
+
+    QString m_realesrganPath;
+    QString m_ffmpegPath;
+    QString m_ffprobePath;
+    QStringList m_availableModels;
+    VideoProcessor::EncodeSettings m_encodeSettings;
+
+    QString m_inputPath;
+    QString m_previousOutput;
+    QString m_modelName;
+    QList<Range> m_ranges;
+    bool m_running = false;
+
+    // 已有输出的参数
+    QSize m_outputSize;
+    QString m_outputCodec;
+    QString m_pixelFormat;
+    double m_sourceFps = 0;  // 原视频的精确帧率，用于把帧号换算为原视频中的时间
+    QVector<double> m_frameTimes; // 按显示顺序排列的各帧时间
+    QVector<int> m_keyFrames;     // 关键帧的帧号，升序
+    QByteArray m_pendingLine;
+
+    QList<Span> m_spans;
+    int m_spanIndex = -1;
+    int m_spanStage = 0;
+    int m_doneFrames = 0;
+    int m_renderFrames = 0;
+    QString m_tempDir;
+    QString m_outputPath;
+    QString m_stagingPath;
+    QProcess *m_process = nullptr;
+    VideoProcessor *m_processor = nullptr;
+    QElapsedTimer m_timer;
+};
+
+#endif // RANGESPLICER_H
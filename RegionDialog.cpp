@@ -0,0 +1,104 @@
+#include "RegionDialog.h"
+#include "PreviewDialog.h"
+#include "RegionUpscaler.h"
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+RegionDialog::RegionDialog(const QString &imagePath, const QList<QRect> &regions, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("选择放大区域");
+    resize(900, 700);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    m_imageView = new CropSelectView(this);
+    mainLayout->addWidget(m_imageView, 1);
+
+    QHBoxLayout *editLayout = new QHBoxLayout();
+    QPushButton *addButton = new QPushButton("加入选区", this);
+    connect(addButton, &QPushButton::clicked, this, &RegionDialog::addSelection);
+    editLayout->addWidget(addButton);
+    QPushButton *clearButton = new QPushButton("清除", this);
+    connect(clearButton, &QPushButton::clicked, this, &RegionDialog::clearRegions);
+    editLayout->addWidget(clearButton);
+    m_regionEdit = new QLineEdit(this);
+    m_regionEdit->setPlaceholderText("x,y,宽,高; x,y,宽,高（原图坐标）");
+    connect(m_regionEdit, &QLineEdit::editingFinished, this, &RegionDialog::applyText);
+    editLayout->addWidget(m_regionEdit, 1);
+    mainLayout->addLayout(editLayout);
+
+    m_statusLabel = new QLabel(this);
+    m_statusLabel->setWordWrap(true);
+    mainLayout->addWidget(m_statusLabel);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttons, &QDialogButtonBox::accepted, this, [this]() {
+        if (applyText()) {
+            accept();
+        }
+    });
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttons);
+
+    QImage image(imagePath);
+    if (image.isNull()) {
+        m_statusLabel->setText(QString("无法读取图像: %1").arg(imagePath));
+        addButton->setEnabled(false);
+    } else {
+        m_imageSize = image.size();
+        m_imageView->setSourceImage(image.convertToFormat(QImage::Format_RGB888));
+    }
+    updateRegions(regions);
+}
+
+void RegionDialog::addSelection()
+{
+    QRect selection = m_imageView->selection();
+    if (selection.isEmpty()) {
+        return;
+    }
+    updateRegions(m_regions + QList<QRect>{selection});
+}
+
+void RegionDialog::clearRegions()
+{
+    updateRegions(QList<QRect>());
+}
+
+bool RegionDialog::applyText()
+{
+    bool ok = false;
+    QList<QRect> regions = RegionUpscaler::parse(m_regionEdit->text(), &ok);
+    if (!ok) {
+        m_statusLabel->setText("坐标格式无效，应为 x,y,宽,高，多个区域用分号分隔");
+        return false;
+    }
+    updateRegions(regions);
+    return true;
+}
+
+void RegionDialog::updateRegions(const QList<QRect> &regions)
+{
+    m_regions = regions;
+    m_imageView->setMarkedRegions(m_regions);
+    m_regionEdit->setText(RegionUpscaler::format(m_regions));
+    if (m_imageSize.isEmpty()) {
+        return;
+    }
+
+    qint64 area = 0;
+    for (const QRect &region : m_regions) {
+        QRect clipped = region & QRect(QPoint(0, 0), m_imageSize);
+        area += qint64(clipped.width()) * clipped.height();
+    }
+    m_statusLabel->setText(m_regions.isEmpty()
+                               ? QString("图像尺寸 %1x%2，拖拽选择区域后点“加入选区”；不选区域时整图放大")
+                                     .arg(m_imageSize.width()).arg(m_imageSize.height())
+                               : QString("%1 个区域，约占画面 %2%，其余部分快速重采样")
+                                     .arg(m_regions.size())
+                                     .arg(area * 100.0 / (qint64(m_imageSize.width()) * m_imageSize.height()), 0, 'f', 1));
+}
@@ -0,0 +1,37 @@
+#ifndef REGIONDIALOG_H
+#define REGIONDIALOG_H
+
+#include <QDialog>
+#include <QList>
+#include <QRect>
+
+class CropSelectView;
+class QLabel;
+class QLineEdit;
+
+// 为一张图片选择区域放大的范围：拖拽选区后加入列表，也可以直接编辑坐标
+class RegionDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    RegionDialog(const QString &imagePath, const QList<QRect> &regions, QWidget *parent = nullptr);
+
+    QList<QRect> regions() const { return m_regions; }
+
+private slots:
+    void addSelection();
+    void clearRegions();
+    bool applyText();
+
+private:
+    void updateRegions(const QList<QRect> &regions);
+
+    CropSelectView *m_imageView;
+    QLineEdit *m_regionEdit;
+    QLabel *m_statusLabel;
+    QList<QRect> m_regions;
+    QSize m_imageSize;
+};
+
+#endif // REGIONDIALOG_H
@@ -0,0 +1,142 @@
+#include "RegionUpscaler.h"
+#include "ImageResampler.h"
+#include <QRegularExpression>
+#include <QStringList>
+#include <vector>
+
+namespace {
+// 到上下文边缘的距离占过渡带宽度的比例，平滑成 S 形，接缝两侧没有明显的折线
+std::vector<float> edgeWeights(int length, double leadFeather, double trailFeather)
+{
+    std::vector<float> weights(size_t(qMax(0, length)));
+    for (int i = 0; i < length; ++i) {
+        double weight = 1.0;
+        if (leadFeather > 0) {
+            weight = qMin(weight, (i + 0.5) / leadFeather);
+        }
+        if (trailFeather > 0) {
+            weight = qMin(weight, (length - i - 0.5) / trailFeather);
+        }
+        weight = qBound(0.0, weight, 1.0);
+        weights[size_t(i)] = float(weight * weight * (3 - 2 * weight));
+    }
+    return weights;
+}
+}
+
+QList<RegionUpscaler::Crop> RegionUpscaler::plan(const QList<QRect> &regions, const QSize &imageSize, int margin)
+{
+    const QRect frame(QPoint(0, 0), imageSize);
+    QList<Crop> crops;
+    for (const QRect &region : regions) {
+        Crop crop;
+        crop.region = region.normalized() & frame;
+        if (crop.region.isEmpty()) {
+            continue;
+        }
+        crop.context = crop.region.adjusted(-margin, -margin, margin, margin) & frame;
+        crops << crop;
+    }
+
+    // 合并后外接矩形可能又与其他区域重叠，直到没有可合并的为止
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < crops.size() && !merged; ++i) {
+            for (int j = i + 1; j < crops.size(); ++j) {
+                if (crops.at(i).context.intersects(crops.at(j).context)) {
+                    crops[i].region |= crops.at(j).region;
+                    crops[i].context = crops.at(i).region.adjusted(-margin, -margin, margin, margin) & frame;
+                    crops.removeAt(j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    return crops;
+}
+
+void RegionUpscaler::blend(QImage &background, const QImage &upscaled, const Crop &crop, const QSize &sourceSize)
+{
+    const double scaleX = double(background.width()) / sourceSize.width();
+    const double scaleY = double(background.height()) / sourceSize.height();
+    const QRect &context = crop.context;
+    const QRect &region = crop.region;
+
+    int left = qRound(context.x() * scaleX);
+    int top = qRound(context.y() * scaleY);
+    int right = qMin(background.width(), qRound((context.x() + context.width()) * scaleX));
+    int bottom = qMin(background.height(), qRound((context.y() + context.height()) * scaleY));
+    QRect target(left, top, right - left, bottom - top);
+    if (target.isEmpty() || upscaled.isNull()) {
+        return;
+    }
+
+    // 模型倍率与目标倍率不同（如最终还要缩小）时把模型输出重采样到贴回的大小
+    QImage piece = upscaled.size() == target.size() ? upscaled : ImageResampler::resample(upscaled, target.size());
+    piece = piece.convertToFormat(QImage::Format_ARGB32);
+
+    // 画面边界处没有上下文可过渡，直接用模型输出
+    double featherLeft = context.left() > 0 ? (region.left() - context.left()) * scaleX : 0;
+    double featherRight = context.right() < sourceSize.width() - 1 ? (context.right() - region.right()) * scaleX : 0;
+    double featherTop = context.top() > 0 ? (region.top() - context.top()) * scaleY : 0;
+    double featherBottom = context.bottom() < sourceSize.height() - 1 ? (context.bottom() - region.bottom()) * scaleY : 0;
+    std::vector<float> weightX = edgeWeights(target.width(), featherLeft, featherRight);
+    std::vector<float> weightY = edgeWeights(target.height(), featherTop, featherBottom);
+
+    for (int y = 0; y < target.height(); ++y) {
+        const QRgb *source = reinterpret_cast<const QRgb *>(piece.constScanLine(y));
+        QRgb *line = reinterpret_cast<QRgb *>(background.scanLine(target.y() + y)) + target.x();
+        for (int x = 0; x < target.width(); ++x) {
+            float weight = qMin(weightX[size_t(x)], weightY[size_t(y)]);
+            QRgb base = line[x];
+            QRgb model = source[x];
+            // 透明度来自底图，模型只提供颜色
+            line[x] = qRgba(qRed(base) + qRound((qRed(model) - qRed(base)) * weight),
+                            qGreen(base) + qRound((qGreen(model) - qGreen(base)) * weight),
+                            qBlue(base) + qRound((qBlue(model) - qBlue(base)) * weight),
+                            qAlpha(base));
+        }
+    }
+}
+
+QList<QRect> RegionUpscaler::parse(const QString &text, bool *ok)
+{
+    QList<QRect> regions;
+    bool valid = true;
+    for (const QString &item : text.split(QRegularExpression("[;；]"), Qt::SkipEmptyParts)) {
+        QStringList values = item.trimmed().split(QRegularExpression("\\s*[,，]\\s*"));
+        if (item.trimmed().isEmpty()) {
+            continue;
+        }
+        if (values.size() != 4) {
+            valid = false;
+            break;
+        }
+
+        int numbers[4];
+        for (int i = 0; i < 4 && valid; ++i) {
+            numbers[i] = values.at(i).toInt(&valid);
+        }
+        if (!valid || numbers[0] < 0 || numbers[1] < 0 || numbers[2] <= 0 || numbers[3] <= 0) {
+            valid = false;
+            break;
+        }
+        regions << QRect(numbers[0], numbers[1], numbers[2], numbers[3]);
+    }
+
+    if (ok) {
+        *ok = valid;
+    }
+    return valid ? regions : QList<QRect>();
+}
+
+QString RegionUpscaler::format(const QList<QRect> &regions)
+{
+    QStringList items;
+    for (const QRect &region : regions) {
+        items << QString("%1,%2,%3,%4").arg(region.x()).arg(region.y()).arg(region.width()).arg(region.height());
+    }
+    return items.join("; ");
+}
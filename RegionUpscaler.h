@@ -0,0 +1,31 @@
+#ifndef REGIONUPSCALER_H
+#define REGIONUPSCALER_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QString>
+
+// 区域放大：只把选定区域连同四周一圈上下文送进模型，整图用进程内重采样放大作为底图，
+// 模型结果按比例贴回底图。上下文边距既让模型看到区域外的内容，也用作接缝处的渐变过渡带，
+// 区域本身完全是模型输出
+class RegionUpscaler
+{
+public:
+    struct Crop {
+        QRect region;  // 用户选定的区域（合并后为外接矩形），原图坐标
+        QRect context; // 实际送进模型的范围
+    };
+
+    // 区域向外扩展 margin 并裁剪到画面内；扩展后重叠的区域合并，同一块像素只放大一次
+    static QList<Crop> plan(const QList<QRect> &regions, const QSize &imageSize, int margin);
+    // background 为放大到目标尺寸的整图（ARGB32），upscaled 为该上下文的模型输出。
+    // 按原图到目标尺寸的比例定位，上下文边缘在边距宽度内渐变到底图，画面边界处不做过渡
+    static void blend(QImage &background, const QImage &upscaled, const Crop &crop, const QSize &sourceSize);
+
+    // 格式：x,y,宽,高，多个区域用分号分隔
+    static QList<QRect> parse(const QString &text, bool *ok = nullptr);
+    static QString format(const QList<QRect> &regions);
+};
+
+#endif // REGIONUPSCALER_H
@@ -0,0 +1,212 @@
+#include "RenditionWriter.h"
+#include "ImageResampler.h"
+#include "PngWriter.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QSemaphore>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+// 级联缩小时，中间图至少为目标的这么多倍，保证 Lanczos 有足够的采样
+const int kCascadeRatio = 2;
+
+int defaultQuality(const QString &format)
+{
+    if (format == "jpg" || format == "jpeg") {
+        return 95;
+    }
+    if (format == "webp") {
+        return 90;
+    }
+    return -1;
+}
+}
+
+QString RenditionSpec::label() const
+{
+    switch (mode) {
+    case Factor:
+        return QString::number(factor) + "x";
+    case Width:
+        return QString::number(length) + "w";
+    case Height:
+        return QString::number(length) + "h";
+    }
+    return QString();
+}
+
+QSize RenditionSpec::outputSize(const QSize &sourceSize) const
+{
+    if (sourceSize.isEmpty()) {
+        return QSize();
+    }
+
+    switch (mode) {
+    case Factor:
+        return QSize(qMax(1, qRound(sourceSize.width() * factor)), qMax(1, qRound(sourceSize.height() * factor)));
+    case Width:
+        return QSize(length, qMax(1, qRound(double(sourceSize.height()) * length / sourceSize.width())));
+    case Height:
+        return QSize(qMax(1, qRound(double(sourceSize.width()) * length / sourceSize.height())), length);
+    }
+    return QSize();
+}
+
+QList<RenditionSpec> RenditionSpec::parseList(const QString &text, const QString &defaultFormat, bool *ok)
+{
+    static const QStringList formats = {"png", "jpg", "jpeg", "webp"};
+    static const QRegularExpression sizePattern("^(\\d+(?:\\.\\d+)?)\\s*([xXwWhH×])$");
+
+    QList<RenditionSpec> specs;
+    bool valid = true;
+    for (const QString &item : text.split(QRegularExpression("[,;，；]"), Qt::SkipEmptyParts)) {
+        QStringList parts = item.trimmed().split(':');
+        if (parts.first().isEmpty()) {
+            continue;
+        }
+
+        QRegularExpressionMatch match = sizePattern.match(parts.first().trimmed());
+        if (!match.hasMatch()) {
+            valid = false;
+            break;
+        }
+
+        RenditionSpec spec;
+        QString unit = match.captured(2).toLower();
+        if (unit == "w" || unit == "h") {
+            spec.mode = unit == "w" ? Width : Height;
+            spec.length = qRound(match.captured(1).toDouble());
+            valid = spec.length > 0;
+        } else {
+            spec.factor = match.captured(1).toDouble();
+            valid = spec.factor > 0;
+        }
+
+        spec.format = parts.size() > 1 ? parts.at(1).trimmed().toLower() : defaultFormat.toLower();
+        valid = valid && formats.contains(spec.format);
+        spec.quality = defaultQuality(spec.format);
+        if (valid && parts.size() > 2) {
+            spec.quality = parts.at(2).trimmed().toInt(&valid);
+            valid = valid && spec.quality >= 0 && spec.quality <= 100;
+        }
+        if (!valid || parts.size() > 3) {
+            valid = false;
+            break;
+        }
+        specs << spec;
+    }
+
+    if (!valid) {
+        specs.clear();
+    }
+    if (ok) {
+        *ok = valid;
+    }
+    return specs;
+}
+
+RenditionWriter::RenditionWriter(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+    m_driverPool.setMaxThreadCount(1);
+}
+
+RenditionWriter::~RenditionWriter()
+{
+    m_driverPool.waitForDone();
+    m_pool.waitForDone();
+}
+
+void RenditionWriter::start(const QString &upscaledPath, const QImage &alpha, const QSize &sourceSize,
+                            const QString &baseName, const QList<RenditionSpec> &specs)
+{
+    m_running = true;
+    m_alphaElapsedMs = 0;
+    m_driverPool.start([this, upscaledPath, alpha, sourceSize, baseName, specs]() {
+        run(upscaledPath, alpha, sourceSize, baseName, specs);
+    });
+}
+
+void RenditionWriter::run(const QString &upscaledPath, const QImage &alpha, const QSize &sourceSize,
+                          const QString &baseName, const QList<RenditionSpec> &specs)
+{
+    auto finish = [this](bool ok, const QStringList &outputs, const QString &error) {
+        QMetaObject::invokeMethod(this, [this, ok, outputs, error]() {
+            m_running = false;
+            emit finished(ok, outputs, error);
+        }, Qt::QueuedConnection);
+    };
+
+    QImage upscaled(upscaledPath);
+    if (upscaled.isNull()) {
+        finish(false, {}, QString("Failed to read upscaled image: %1").arg(upscaledPath));
+        return;
+    }
+
+    if (!alpha.isNull()) {
+        QElapsedTimer alphaTimer;
+        alphaTimer.start();
+        upscaled = upscaled.convertToFormat(QImage::Format_ARGB32);
+        upscaled.setAlphaChannel(ImageResampler::resample(alpha, upscaled.size(), &m_pool));
+        m_alphaElapsedMs = alphaTimer.elapsed();
+    }
+
+    // 从大到小生成，小规格可以复用已生成的大图
+    QList<int> order;
+    QStringList outputs;
+    for (int i = 0; i < specs.size(); ++i) {
+        order << i;
+        outputs << QString();
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        QSize sa = specs.at(a).outputSize(sourceSize);
+        QSize sb = specs.at(b).outputSize(sourceSize);
+        return qint64(sa.width()) * sa.height() > qint64(sb.width()) * sb.height();
+    });
+
+    QList<QImage> produced;
+    QMutex errorMutex;
+    QString error;
+    QSemaphore encoded;
+
+    for (int index : order) {
+        const RenditionSpec &spec = specs.at(index);
+        QSize size = spec.outputSize(sourceSize);
+
+        // 选尺寸足够大的最小中间图作为输入
+        const QImage *input = &upscaled;
+        for (const QImage &candidate : produced) {
+            if (candidate.width() >= size.width() * kCascadeRatio
+                && candidate.height() >= size.height() * kCascadeRatio
+                && candidate.width() < input->width()) {
+                input = &candidate;
+            }
+        }
+
+        QImage image = ImageResampler::resample(*input, size, &m_pool);
+        produced << image;
+
+        QString path = baseName + "-" + spec.label() + "." + spec.format;
+        outputs[index] = path;
+        m_pool.start([&, image, path, spec]() {
+            bool saved;
+            if (spec.format == "png") {
+                saved = PngWriter::write(image, path, PngWriter::Deliverable);
+            } else if (spec.format == "jpg" || spec.format == "jpeg") {
+                saved = image.convertToFormat(QImage::Format_RGB888).save(path, nullptr, spec.quality);
+            } else {
+                saved = image.save(path, nullptr, spec.quality);
+            }
+            if (!saved) {
+                QMutexLocker locker(&errorMutex);
+                error = QString("Failed to write rendition: %1").arg(path);
+            }
+            encoded.release();
+        });
+    }
+    encoded.acquire(specs.size());
+
+    finish(error.isEmpty(), outputs, error);
+}
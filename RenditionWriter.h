@@ -0,0 +1,62 @@
+#ifndef RENDITIONWRITER_H
+#define RENDITIONWRITER_H
+
+#include <QObject>
+#include <QImage>
+#include <QList>
+#include <QStringList>
+#include <QThreadPool>
+
+// 一个输出规格：尺寸（相对原图倍数 / 固定宽 / 固定高）× 格式 × 质量
+struct RenditionSpec {
+    enum SizeMode {
+        Factor,
+        Width,
+        Height
+    };
+
+    SizeMode mode = Factor;
+    double factor = 1.0;
+    int length = 0;
+    QString format = "png";
+    int quality = -1; // -1 为该格式的默认值
+
+    QString label() const;
+    QSize outputSize(const QSize &sourceSize) const;
+
+    // 例如 "4x, 2x:webp:90, 1.5x:jpg, 256w:jpg:80"，省略格式时使用 defaultFormat
+    static QList<RenditionSpec> parseList(const QString &text, const QString &defaultFormat, bool *ok = nullptr);
+};
+
+// 从一次模型放大的结果生成所有规格的输出。缩放和编码都在线程池中进行，
+// 较小的规格优先从已生成的较大规格再缩小，避免每次都从全尺寸开始
+class RenditionWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenditionWriter(QObject *parent = nullptr);
+    ~RenditionWriter();
+
+    // alpha 非空时先按放大结果的尺寸恢复透明度；输出为 baseName-<label>.<format>
+    void start(const QString &upscaledPath, const QImage &alpha, const QSize &sourceSize,
+               const QString &baseName, const QList<RenditionSpec> &specs);
+    bool isRunning() const { return m_running; }
+    qint64 alphaElapsedMs() const { return m_alphaElapsedMs; }
+
+signals:
+    void finished(bool ok, const QStringList &outputFiles, const QString &error);
+
+private:
+    void run(const QString &upscaledPath, const QImage &alpha, const QSize &sourceSize,
+             const QString &baseName, const QList<RenditionSpec> &specs);
+
+    // 按行带并行缩放、并行编码
+    QThreadPool m_pool;
+    // 串行执行整个任务，不占用 m_pool 的线程
+    QThreadPool m_driverPool;
+    bool m_running = false;
+    qint64 m_alphaElapsedMs = 0;
+};
+
+#endif // RENDITIONWRITER_H
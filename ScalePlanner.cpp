@@ -0,0 +1,269 @@
+#include "ScalePlanner.h"
+#include <QRegularExpression>
+#include <QtMath>
+
+namespace {
+// 输出像素的编码/读写开销（相对推理开销）
+const double kOutputPixelWeight = 0.02;
+// 预缩放比例小于该值才值得额外做一次缩放
+const double kMinPreScaleGain = 0.97;
+
+QSize scaledSize(const QSize &size, double factor)
+{
+    return QSize(qMax(1, qRound(size.width() * factor)),
+                 qMax(1, qRound(size.height() * factor)));
+}
+
+bool covers(const QSize &size, const QSize &target)
+{
+    return size.width() >= target.width() && size.height() >= target.height();
+}
+}
+
+ScaleTarget ScaleTarget::fromText(Mode mode, const QString &text, bool *ok)
+{
+    ScaleTarget target;
+    target.mode = mode;
+    bool valid = true;
+
+    switch (mode) {
+    case Native:
+        break;
+    case Factor:
+        target.factor = text.trimmed().toDouble(&valid);
+        valid = valid && target.factor > 0;
+        break;
+    case Height:
+        target.size = QSize(0, text.trimmed().toInt(&valid));
+        valid = valid && target.size.height() > 0;
+        break;
+    case Size: {
+        QStringList parts = text.trimmed().split(QRegularExpression("[xX×*]"));
+        valid = parts.size() == 2;
+        if (valid) {
+            bool okW = false;
+            bool okH = false;
+            target.size = QSize(parts[0].trimmed().toInt(&okW), parts[1].trimmed().toInt(&okH));
+            valid = okW && okH && !target.size.isEmpty();
+        }
+        break;
+    }
+    }
+
+    if (!valid) {
+        target.mode = Native;
+    }
+    if (ok) {
+        *ok = valid;
+    }
+    return target;
+}
+
+QSize ScaleTarget::resolve(const QSize &input, int nativeScale) const
+{
+    switch (mode) {
+    case Native:
+        return input * nativeScale;
+    case Factor:
+        return scaledSize(input, factor);
+    case Height:
+        return QSize(qMax(1, qRound(input.width() * double(size.height()) / input.height())),
+                     size.height());
+    case Size:
+        return size;
+    }
+    return input * nativeScale;
+}
+
+int ScalePlan::totalScale() const
+{
+    int scale = 1;
+    for (const ScalePass &pass : passes) {
+        scale *= pass.scale;
+    }
+    return scale;
+}
+
+double ScalePlan::savedFraction() const
+{
+    if (baselineWork <= 0) {
+        return 0;
+    }
+    return 1.0 - modelWork / baselineWork;
+}
+
+QString ScalePlan::summary() const
+{
+    if (!valid) {
+        return "无法规划缩放方案";
+    }
+
+    QStringList steps;
+    if (needsPreScale()) {
+        steps << QString("预缩小 %1x%2→%3x%4")
+                     .arg(inputSize.width()).arg(inputSize.height())
+                     .arg(preScaledSize.width()).arg(preScaledSize.height());
+    }
+    for (const ScalePass &pass : passes) {
+        steps << QString("%1 ×%2").arg(pass.modelName).arg(pass.scale);
+    }
+    if (needsFinalResample()) {
+        steps << QString("重采样 %1x%2→%3x%4")
+                     .arg(modelOutputSize.width()).arg(modelOutputSize.height())
+                     .arg(targetSize.width()).arg(targetSize.height());
+    }
+
+    return QString("%1，估算像素工作量节省 %2%")
+        .arg(steps.join(" → "))
+        .arg(qMax(0.0, savedFraction() * 100.0), 0, 'f', 0);
+}
+
+ScalePlanner::ScalePlanner(const QStringList &availableModels)
+{
+    for (const QString &name : availableModels) {
+        m_models << modelInfo(name);
+    }
+}
+
+ScaleModelInfo ScalePlanner::modelInfo(const QString &modelName)
+{
+    ScaleModelInfo info;
+    info.name = modelName;
+    info.family = modelName;
+
+    // realesr-animevideov3-x2 / -x3 / -x4 属于同一系列
+    static const QRegularExpression suffixRegex(R"(^(.*)-x(\d)$)");
+    static const QRegularExpression plusRegex(R"(-x(\d)plus)");
+    QRegularExpressionMatch match = suffixRegex.match(modelName);
+    if (match.hasMatch()) {
+        info.family = match.captured(1);
+        info.scale = match.captured(2).toInt();
+    } else {
+        match = plusRegex.match(modelName);
+        if (match.hasMatch()) {
+            info.scale = match.captured(1).toInt();
+        }
+    }
+
+    // 经验值：RRDB 23 块 > RRDB 6 块 > SRVGG 紧凑模型
+    if (modelName.contains("animevideov3")) {
+        info.costWeight = 0.05;
+    } else if (modelName.contains("anime")) {
+        info.costWeight = 0.3;
+    } else {
+        info.costWeight = 1.0;
+    }
+    return info;
+}
+
+double ScalePlanner::passCost(const ScaleModelInfo &model, const QSize &input) const
+{
+    double inputPixels = double(input.width()) * input.height();
+    return inputPixels * model.costWeight
+           + inputPixels * model.scale * model.scale * kOutputPixelWeight;
+}
+
+ScalePlan ScalePlanner::plan(const QSize &inputSize, const ScaleTarget &target,
+                             const QString &preferredModel) const
+{
+    ScalePlan best;
+    if (inputSize.isEmpty()) {
+        return best;
+    }
+
+    ScaleModelInfo preferred = modelInfo(preferredModel);
+    QSize targetSize = target.resolve(inputSize, preferred.scale);
+
+    // 基准：反复使用所选模型的原生倍率直到覆盖目标，再整体缩小
+    double baselineWork = 0;
+    QSize baselineSize = inputSize;
+    for (int i = 0; i < 3; ++i) {
+        baselineWork += passCost(preferred, baselineSize);
+        baselineSize = baselineSize * preferred.scale;
+        if (covers(baselineSize, targetSize)) {
+            break;
+        }
+    }
+
+    QList<ScaleModelInfo> candidates;
+    candidates << preferred;
+    for (const ScaleModelInfo &model : m_models) {
+        if (model.name == preferred.name) {
+            continue;
+        }
+        if (target.mode == ScaleTarget::Native) {
+            continue;
+        }
+        if (target.allowModelSwitch || model.family == preferred.family) {
+            candidates << model;
+        }
+    }
+
+    // 单次或两次串联
+    QList<QList<ScaleModelInfo>> chains;
+    for (const ScaleModelInfo &first : candidates) {
+        chains << QList<ScaleModelInfo>{first};
+        if (target.mode == ScaleTarget::Native) {
+            continue;
+        }
+        for (const ScaleModelInfo &second : candidates) {
+            chains << QList<ScaleModelInfo>{first, second};
+        }
+    }
+
+    bool bestCovers = false;
+    for (const QList<ScaleModelInfo> &chain : chains) {
+        int totalScale = 1;
+        for (const ScaleModelInfo &model : chain) {
+            totalScale *= model.scale;
+        }
+
+        double need = qMax(double(targetSize.width()) / (inputSize.width() * totalScale),
+                           double(targetSize.height()) / (inputSize.height() * totalScale));
+        QSize preScaled = inputSize;
+        if (target.allowPreDownscale && need < kMinPreScaleGain) {
+            preScaled = QSize(qMax(16, qCeil(inputSize.width() * need)),
+                              qMax(16, qCeil(inputSize.height() * need)));
+            if (preScaled.width() >= inputSize.width() || preScaled.height() >= inputSize.height()) {
+                preScaled = inputSize;
+            }
+        }
+
+        ScalePlan candidate;
+        candidate.valid = true;
+        candidate.inputSize = inputSize;
+        candidate.preScaledSize = preScaled;
+        candidate.targetSize = targetSize;
+        candidate.baselineWork = baselineWork;
+
+        QSize passInput = preScaled;
+        for (const ScaleModelInfo &model : chain) {
+            candidate.passes << ScalePass{model.name, model.scale};
+            candidate.modelWork += passCost(model, passInput);
+            passInput = passInput * model.scale;
+        }
+        candidate.modelOutputSize = passInput;
+
+        // 优先选择无需最终放大的方案，其次比较代价，再其次选择更少的串联次数
+        bool candidateCovers = covers(candidate.modelOutputSize, targetSize);
+        bool better = false;
+        if (!best.valid) {
+            better = true;
+        } else if (candidateCovers != bestCovers) {
+            better = candidateCovers;
+        } else if (!candidateCovers && candidate.totalScale() != best.totalScale()) {
+            better = candidate.totalScale() > best.totalScale();
+        } else if (!qFuzzyCompare(candidate.modelWork, best.modelWork)) {
+            better = candidate.modelWork < best.modelWork;
+        } else {
+            better = candidate.passes.size() < best.passes.size();
+        }
+
+        if (better) {
+            best = candidate;
+            bestCovers = candidateCovers;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,75 @@
+#ifndef SCALEPLANNER_H
+#define SCALEPLANNER_H
+
+#include <QList>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+// 目标尺寸设置：模型原生倍率 / 指定倍数 / 指定高度（保持比例）/ 指定宽高
+struct ScaleTarget {
+    enum Mode {
+        Native,
+        Factor,
+        Height,
+        Size
+    };
+
+    Mode mode = Native;
+    double factor = 2.0;
+    QSize size;
+    bool allowPreDownscale = false; // 输入本身过采样时允许先缩小再放大
+    bool allowModelSwitch = false;  // 允许换用其他系列的模型
+
+    static ScaleTarget fromText(Mode mode, const QString &text, bool *ok = nullptr);
+    QSize resolve(const QSize &input, int nativeScale) const;
+};
+
+struct ScaleModelInfo {
+    QString name;
+    QString family;
+    int scale = 4;
+    double costWeight = 1.0; // 每输入像素的相对推理开销
+};
+
+struct ScalePass {
+    QString modelName;
+    int scale = 1;
+};
+
+struct ScalePlan {
+    bool valid = false;
+    QSize inputSize;
+    QSize preScaledSize;
+    QSize modelOutputSize;
+    QSize targetSize;
+    QList<ScalePass> passes;
+    double modelWork = 0;
+    double baselineWork = 0;
+
+    bool needsPreScale() const { return preScaledSize != inputSize; }
+    bool needsFinalResample() const { return modelOutputSize != targetSize; }
+    int totalScale() const;
+    double savedFraction() const;
+    QString summary() const;
+};
+
+class ScalePlanner
+{
+public:
+    explicit ScalePlanner(const QStringList &availableModels);
+
+    static ScaleModelInfo modelInfo(const QString &modelName);
+    static int nativeScale(const QString &modelName) { return modelInfo(modelName).scale; }
+
+    // 在可用模型中选择代价最小的预缩放/模型/多次串联组合，最终只做一次重采样
+    ScalePlan plan(const QSize &inputSize, const ScaleTarget &target,
+                   const QString &preferredModel) const;
+
+private:
+    double passCost(const ScaleModelInfo &model, const QSize &input) const;
+
+    QList<ScaleModelInfo> m_models;
+};
+
+#endif // SCALEPLANNER_H
@@ -0,0 +1,356 @@
+#include "ScratchManager.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QLocale>
+#include <QLockFile>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <QThreadPool>
+#include <QUuid>
+#include <utility>
+
+namespace {
+const char *kJobPrefix = "job-";
+const char *kTrashPrefix = "trash-";
+const char *kLockName = ".owner.lock";
+
+struct Job {
+    qint64 reserved = 0;
+    bool fast = false;
+    QLockFile *lock = nullptr;
+};
+
+QMutex s_mutex;
+QString s_root;
+#if defined(Q_OS_LINUX)
+QString s_fastRoot = "/dev/shm";
+#else
+QString s_fastRoot;
+#endif
+qint64 s_jobQuota = 0;
+qint64 s_globalQuota = 0;
+QHash<QString, Job> s_jobs;
+
+QThreadPool *reclaimPool()
+{
+    // 单线程即可，删除本身受磁盘限制，多线程只会和放大争 IO
+    static QThreadPool *instance = [] {
+        QThreadPool *threadPool = new QThreadPool;
+        threadPool->setMaxThreadCount(1);
+        return threadPool;
+    }();
+    return instance;
+}
+
+QString formatSize(qint64 bytes)
+{
+    return QLocale().formattedDataSize(bytes);
+}
+
+qint64 reservedTotal(bool fastOnly)
+{
+    qint64 total = 0;
+    for (const Job &job : std::as_const(s_jobs)) {
+        if (!fastOnly || job.fast) {
+            total += job.reserved;
+        }
+    }
+    return total;
+}
+
+qint64 directorySize(const QString &path)
+{
+    qint64 total = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+bool sameFileSystem(const QString &a, const QString &b)
+{
+    QStorageInfo first(a);
+    QStorageInfo second(b);
+    return first.isValid() && second.isValid()
+           && first.rootPath() == second.rootPath() && first.device() == second.device();
+}
+
+QString sanitizedLabel(const QString &label)
+{
+    QString result;
+    for (QChar c : label) {
+        result += (c.isLetterOrNumber() && c.unicode() < 128) || c == '-' || c == '_' ? c : QChar('_');
+    }
+    return result.left(32);
+}
+}
+
+void ScratchManager::setRoot(const QString &path)
+{
+    QMutexLocker locker(&s_mutex);
+    s_root = path;
+}
+
+QString ScratchManager::root()
+{
+    QMutexLocker locker(&s_mutex);
+    if (!s_root.isEmpty()) {
+        return s_root;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation)).filePath("qtRealSR_scratch");
+}
+
+void ScratchManager::setFastRoot(const QString &path)
+{
+    QMutexLocker locker(&s_mutex);
+    s_fastRoot = path;
+}
+
+QString ScratchManager::fastRoot()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_fastRoot.isEmpty() ? QString() : QDir(s_fastRoot).filePath("qtRealSR_scratch");
+}
+
+void ScratchManager::setJobQuota(qint64 bytes)
+{
+    QMutexLocker locker(&s_mutex);
+    s_jobQuota = qMax<qint64>(0, bytes);
+}
+
+void ScratchManager::setGlobalQuota(qint64 bytes)
+{
+    QMutexLocker locker(&s_mutex);
+    s_globalQuota = qMax<qint64>(0, bytes);
+}
+
+void ScratchManager::configureFromArguments(const QStringList &arguments)
+{
+    auto value = [&arguments](const QString &name) {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments.at(index + 1) : QString();
+    };
+    auto gigabytes = [](const QString &text) {
+        return qint64(text.toDouble() * 1024 * 1024 * 1024);
+    };
+
+    if (!value("--scratch").isEmpty()) {
+        setRoot(value("--scratch"));
+    }
+    QString fast = value("--scratch-fast");
+    if (!fast.isEmpty()) {
+        setFastRoot(fast == "off" ? QString() : fast);
+    }
+    if (!value("--scratch-quota").isEmpty()) {
+        setGlobalQuota(gigabytes(value("--scratch-quota")));
+    }
+    if (!value("--job-quota").isEmpty()) {
+        setJobQuota(gigabytes(value("--job-quota")));
+    }
+}
+
+QString ScratchManager::allocate(const QString &label, qint64 estimatedBytes, QString *error)
+{
+    auto fail = [error](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return QString();
+    };
+
+    const QString slowBase = root();
+    const QString fastBase = fastRoot();
+    QMutexLocker locker(&s_mutex);
+
+    if (s_jobQuota > 0 && estimatedBytes > s_jobQuota) {
+        return fail(QString("预计需要 %1 临时空间，超过单个作业上限 %2")
+                        .arg(formatSize(estimatedBytes), formatSize(s_jobQuota)));
+    }
+    qint64 reserved = reservedTotal(false);
+    if (s_globalQuota > 0 && reserved + estimatedBytes > s_globalQuota) {
+        return fail(QString("临时空间不足：其他作业已预留 %1，本作业预计 %2，总上限 %3")
+                        .arg(formatSize(reserved), formatSize(estimatedBytes), formatSize(s_globalQuota)));
+    }
+
+    // 内存盘只接收大小已知且放得下的作业，留一半余量给系统和其他程序
+    bool fast = false;
+    if (!fastBase.isEmpty() && estimatedBytes > 0 && QDir().mkpath(fastBase)) {
+        qint64 available = QStorageInfo(fastBase).bytesAvailable();
+        fast = reservedTotal(true) + estimatedBytes < available / 2;
+    }
+    QString base = fast ? fastBase : slowBase;
+    if (!QDir().mkpath(base)) {
+        return fail(QString("无法创建临时目录: %1").arg(base));
+    }
+    if (!fast && estimatedBytes > 0) {
+        qint64 available = QStorageInfo(base).bytesAvailable();
+        if (available >= 0 && estimatedBytes > available) {
+            return fail(QString("临时目录 %1 剩余 %2，本作业预计需要 %3")
+                            .arg(base, formatSize(available), formatSize(estimatedBytes)));
+        }
+    }
+
+    QString name = QString("%1%2-%3").arg(kJobPrefix, sanitizedLabel(label),
+                                          QUuid::createUuid().toString(QUuid::Id128).left(12));
+    QString path = QDir(base).filePath(name);
+    if (!QDir().mkpath(path)) {
+        return fail(QString("无法创建临时目录: %1").arg(path));
+    }
+
+    // 锁文件记录所属进程，进程不在了下次启动即可判定为遗留目录
+    Job job;
+    job.reserved = estimatedBytes;
+    job.fast = fast;
+    job.lock = new QLockFile(QDir(path).filePath(kLockName));
+    job.lock->setStaleLockTime(0);
+    job.lock->tryLock(0);
+    s_jobs.insert(path, job);
+
+    qDebug() << "Scratch" << path << (fast ? "(tmpfs)" : "") << "estimated" << formatSize(estimatedBytes);
+    return path;
+}
+
+bool ScratchManager::updateUsage(const QString &dir, QString *error)
+{
+    return recordUsage(dir, measureUsage(dir), error);
+}
+
+qint64 ScratchManager::measureUsage(const QString &dir)
+{
+    return directorySize(dir);
+}
+
+bool ScratchManager::recordUsage(const QString &dir, qint64 used, QString *error)
+{
+    QMutexLocker locker(&s_mutex);
+    auto it = s_jobs.find(dir);
+    if (it == s_jobs.end()) {
+        return true;
+    }
+    it->reserved = qMax(it->reserved, used);
+    if (s_jobQuota > 0 && used > s_jobQuota) {
+        if (error) {
+            *error = QString("临时文件已占用 %1，超过单个作业上限 %2")
+                         .arg(formatSize(used), formatSize(s_jobQuota));
+        }
+        return false;
+    }
+    return true;
+}
+
+void ScratchManager::release(const QString &dir)
+{
+    if (dir.isEmpty()) {
+        return;
+    }
+    {
+        QMutexLocker locker(&s_mutex);
+        Job job = s_jobs.take(dir);
+        delete job.lock;
+    }
+    removeAsync(dir);
+}
+
+void ScratchManager::removeAsync(const QString &path)
+{
+    QFileInfo info(path);
+    if (path.isEmpty() || !info.exists()) {
+        return;
+    }
+
+    // 同目录改名是即时的，原路径马上空出来；中途退出时留下的 trash- 目录下次启动再清
+    QString target = info.absoluteDir().filePath(
+        QString("%1%2").arg(kTrashPrefix, QUuid::createUuid().toString(QUuid::Id128)));
+    if (!QDir().rename(info.absoluteFilePath(), target)) {
+        target = info.absoluteFilePath();
+    }
+
+    reclaimPool()->start([target]() {
+        if (QFileInfo(target).isDir()) {
+            QDir(target).removeRecursively();
+        } else {
+            QFile::remove(target);
+        }
+    });
+}
+
+QString ScratchManager::stagingPath(const QString &finalPath)
+{
+    QFileInfo info(finalPath);
+    return info.absoluteDir().filePath(QString(".%1.staging.%2").arg(info.completeBaseName(), info.suffix()));
+}
+
+bool ScratchManager::moveToFinal(const QString &source, const QString &target, QString *error)
+{
+    QString targetDir = QFileInfo(target).absolutePath();
+    if (QFile::exists(target)) {
+        QFile::remove(target);
+    }
+    if (sameFileSystem(QFileInfo(source).absolutePath(), targetDir) && QFile::rename(source, target)) {
+        return true;
+    }
+
+    // 跨设备只能复制：先写到目标目录的临时名，完整后再改名，避免留下半个文件
+    qWarning() << "Cross-device move, copying" << source << "->" << target;
+    QString staging = stagingPath(target);
+    QFile::remove(staging);
+    if (!QFile::copy(source, staging) || !QFile::rename(staging, target)) {
+        QFile::remove(staging);
+        if (error) {
+            *error = QString("Failed to move %1 to %2").arg(source, target);
+        }
+        return false;
+    }
+    QFile::remove(source);
+    return true;
+}
+
+int ScratchManager::reclaimOrphans()
+{
+    int reclaimed = 0;
+    for (const QString &base : {root(), fastRoot()}) {
+        if (base.isEmpty()) {
+            continue;
+        }
+        QDir dir(base);
+        const QStringList entries = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &name : entries) {
+            QString path = dir.filePath(name);
+            if (name.startsWith(kTrashPrefix)) {
+                removeAsync(path);
+                ++reclaimed;
+                continue;
+            }
+            if (!name.startsWith(kJobPrefix)) {
+                continue;
+            }
+            {
+                QMutexLocker locker(&s_mutex);
+                if (s_jobs.contains(path)) {
+                    continue;
+                }
+            }
+            // 其他实例仍在使用的目录拿不到锁；所属进程已退出的锁会被判定为失效
+            QLockFile lock(QDir(path).filePath(kLockName));
+            lock.setStaleLockTime(0);
+            if (!lock.tryLock(0)) {
+                continue;
+            }
+            lock.unlock();
+            removeAsync(path);
+            ++reclaimed;
+        }
+    }
+    if (reclaimed > 0) {
+        qDebug() << "Reclaimed" << reclaimed << "orphaned scratch directories";
+    }
+    return reclaimed;
+}
@@ -0,0 +1,48 @@
+#ifndef SCRATCHMANAGER_H
+#define SCRATCHMANAGER_H
+
+#include <QString>
+#include <QStringList>
+
+// 中间文件（抽出的帧、各遍放大结果、临时 PNG）统一放在可配置的临时根目录下，
+// 不再写到源文件旁边。预计占用能放进内存盘时优先使用内存盘；
+// 按作业和全局配额预留空间，超出时尽早报错而不是写满磁盘。
+// 删除在后台线程进行，程序启动时清理上次异常退出遗留的目录
+class ScratchManager
+{
+public:
+    // 默认是系统临时目录下的 qtRealSR_scratch
+    static void setRoot(const QString &path);
+    static QString root();
+    // 内存盘目录，默认 Linux 上为 /dev/shm，空字符串表示不用
+    static void setFastRoot(const QString &path);
+    static QString fastRoot();
+    // 单个作业 / 所有作业合计的上限（字节），0 表示不限
+    static void setJobQuota(qint64 bytes);
+    static void setGlobalQuota(qint64 bytes);
+
+    // 读取 --scratch 目录、--scratch-fast 目录|off、--scratch-quota GB、--job-quota GB
+    static void configureFromArguments(const QStringList &arguments);
+
+    // 为一个作业创建独立目录并预留 estimatedBytes（0 表示未知），失败返回空字符串
+    static QString allocate(const QString &label, qint64 estimatedBytes, QString *error = nullptr);
+    // 实测作业目录占用并更新预留量，超出作业配额时返回 false
+    static bool updateUsage(const QString &dir, QString *error = nullptr);
+    // updateUsage 的两步：遍历目录可在工作线程进行，登记结果与配额检查在调用方线程
+    static qint64 measureUsage(const QString &dir);
+    static bool recordUsage(const QString &dir, qint64 usedBytes, QString *error = nullptr);
+    // 归还预留并在后台删除目录
+    static void release(const QString &dir);
+    // 先改名移出原位置再在后台删除，调用方不必等待
+    static void removeAsync(const QString &path);
+
+    // 与最终文件同目录的隐藏临时名，写完后可以原子改名到位
+    static QString stagingPath(const QString &finalPath);
+    // 同一文件系统内直接改名；跨设备时先复制到目标目录再改名
+    static bool moveToFinal(const QString &source, const QString &target, QString *error = nullptr);
+
+    // 清理已退出进程遗留的作业目录，返回清理的目录数
+    static int reclaimOrphans();
+};
+
+#endif // SCRATCHMANAGER_H
@@ -0,0 +1,179 @@
+#include "SpriteAtlas.h"
+#include "ImageResampler.h"
+#include <algorithm>
+#include <vector>
+
+QList<SpriteAtlas::Sheet> SpriteAtlas::pack(const QList<QSize> &sizes, int gutter, int maxSide)
+{
+    QList<int> order;
+    for (int i = 0; i < sizes.size(); ++i) {
+        order << i;
+    }
+    // 同一行的高度越接近，浪费的面积越少
+    std::stable_sort(order.begin(), order.end(), [&sizes](int a, int b) {
+        if (sizes.at(a).height() != sizes.at(b).height()) {
+            return sizes.at(a).height() > sizes.at(b).height();
+        }
+        return sizes.at(a).width() > sizes.at(b).width();
+    });
+
+    QList<Sheet> sheets;
+    Sheet current;
+    int x = 0;
+    int shelfY = 0;
+    int shelfHeight = 0;
+    int usedWidth = 0;
+
+    auto finishSheet = [&]() {
+        if (!current.placements.isEmpty()) {
+            current.size = QSize(usedWidth, shelfY + shelfHeight);
+            sheets << current;
+        }
+        current = Sheet();
+        x = 0;
+        shelfY = 0;
+        shelfHeight = 0;
+        usedWidth = 0;
+    };
+
+    for (int item : order) {
+        const QSize &size = sizes.at(item);
+        int cellWidth = size.width() + 2 * gutter;
+        int cellHeight = size.height() + 2 * gutter;
+        if (size.isEmpty() || cellWidth > maxSide || cellHeight > maxSide) {
+            continue;
+        }
+
+        if (x + cellWidth > maxSide) {
+            shelfY += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        if (shelfY + cellHeight > maxSide) {
+            finishSheet();
+        }
+
+        Placement placement;
+        placement.item = item;
+        placement.rect = QRect(x + gutter, shelfY + gutter, size.width(), size.height());
+        current.placements << placement;
+        x += cellWidth;
+        shelfHeight = qMax(shelfHeight, cellHeight);
+        usedWidth = qMax(usedWidth, x);
+    }
+    finishSheet();
+    return sheets;
+}
+
+SpriteAtlas::Composed SpriteAtlas::compose(const Sheet &sheet, const QStringList &paths, int gutter, bool keepAlpha)
+{
+    Composed composed;
+    composed.sheet = QImage(sheet.size, QImage::Format_RGB888);
+    if (composed.sheet.isNull()) {
+        for (const Placement &placement : sheet.placements) {
+            composed.failed << placement.item;
+        }
+        return composed;
+    }
+    composed.sheet.fill(Qt::black);
+
+    for (const Placement &placement : sheet.placements) {
+        QImage image(paths.at(placement.item));
+        if (image.isNull() || image.size() != placement.rect.size()) {
+            composed.failed << placement.item;
+            continue;
+        }
+
+        QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+        if (image.hasAlphaChannel() && keepAlpha) {
+            QImage alpha = argb.convertToFormat(QImage::Format_Alpha8);
+            bool opaque = true;
+            for (int y = 0; opaque && y < alpha.height(); ++y) {
+                const uchar *line = alpha.constScanLine(y);
+                opaque = std::all_of(line, line + alpha.width(), [](uchar a) { return a == 255; });
+            }
+            if (!opaque) {
+                composed.alphas.insert(placement.item, alpha);
+                bleedTransparent(argb, gutter);
+            }
+        }
+
+        // 贴入小图，并把边缘像素向外复制填满间隔
+        const int width = argb.width();
+        const int height = argb.height();
+        for (int y = -gutter; y < height + gutter; ++y) {
+            const QRgb *source = reinterpret_cast<const QRgb *>(argb.constScanLine(qBound(0, y, height - 1)));
+            uchar *target = composed.sheet.scanLine(placement.rect.y() + y) + (placement.rect.x() - gutter) * 3;
+            for (int x = -gutter; x < width + gutter; ++x) {
+                QRgb pixel = source[qBound(0, x, width - 1)];
+                *target++ = uchar(qRed(pixel));
+                *target++ = uchar(qGreen(pixel));
+                *target++ = uchar(qBlue(pixel));
+            }
+        }
+    }
+    return composed;
+}
+
+QImage SpriteAtlas::cut(const QImage &upscaled, const QRect &rect, int scale, const QImage &alpha)
+{
+    QImage piece = upscaled.copy(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
+    if (alpha.isNull() || piece.isNull()) {
+        return piece;
+    }
+
+    piece = piece.convertToFormat(QImage::Format_ARGB32);
+    piece.setAlphaChannel(ImageResampler::resample(alpha, piece.size()));
+    return piece;
+}
+
+void SpriteAtlas::bleedTransparent(QImage &argb, int iterations)
+{
+    const int width = argb.width();
+    const int height = argb.height();
+    std::vector<uchar> known(size_t(width) * height);
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            known[size_t(y) * width + x] = qAlpha(line[x]) > 0;
+        }
+    }
+
+    static const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    std::vector<int> filled;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        filled.clear();
+        for (int y = 0; y < height; ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(argb.scanLine(y));
+            for (int x = 0; x < width; ++x) {
+                if (known[size_t(y) * width + x]) {
+                    continue;
+                }
+                int red = 0, green = 0, blue = 0, count = 0;
+                for (const auto &offset : offsets) {
+                    int nx = x + offset[0];
+                    int ny = y + offset[1];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height || !known[size_t(ny) * width + nx]) {
+                        continue;
+                    }
+                    QRgb neighbour = reinterpret_cast<const QRgb *>(argb.constScanLine(ny))[nx];
+                    red += qRed(neighbour);
+                    green += qGreen(neighbour);
+                    blue += qBlue(neighbour);
+                    ++count;
+                }
+                if (count > 0) {
+                    line[x] = qRgba(red / count, green / count, blue / count, qAlpha(line[x]));
+                    filled.push_back(y * width + x);
+                }
+            }
+        }
+        if (filled.empty()) {
+            break;
+        }
+        // 本圈填好的像素下一圈才作为来源，扩散保持各向均匀
+        for (int index : filled) {
+            known[size_t(index)] = 1;
+        }
+    }
+}
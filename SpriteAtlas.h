@@ -0,0 +1,44 @@
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QStringList>
+
+// 图集模式：把大量小图按行装箱拼进少数几张大图，一次模型调用放大后再切回各自的文件。
+// 每张小图四周留出间隔并用自身边缘像素填充，模型感受野内看不到相邻图片的内容；
+// 透明度平面不进模型，切回时单独重采样后合成
+class SpriteAtlas
+{
+public:
+    struct Placement {
+        int item = -1; // 在 pack 输入列表中的位置
+        QRect rect;    // 小图本身在图集中的位置，不含间隔
+    };
+
+    struct Sheet {
+        QSize size;
+        QList<Placement> placements;
+    };
+
+    struct Composed {
+        QImage sheet;              // RGB888
+        QHash<int, QImage> alphas; // 需要保留透明度的条目，Format_Alpha8
+        QList<int> failed;         // 无法读取或尺寸与装箱时不符的条目
+    };
+
+    // 按高度从大到小装箱，每张图集边长不超过 maxSide；放不下的尺寸需由调用方提前排除
+    static QList<Sheet> pack(const QList<QSize> &sizes, int gutter, int maxSide);
+    // paths 按 Placement::item 索引。keepAlpha 为 false 时透明度直接丢弃（如只输出 JPG）
+    static Composed compose(const Sheet &sheet, const QStringList &paths, int gutter, bool keepAlpha);
+    // 从放大后的图集切出一张，alpha 非空时重采样到放大后的尺寸再合成
+    static QImage cut(const QImage &upscaled, const QRect &rect, int scale, const QImage &alpha);
+
+private:
+    // 把不透明像素的颜色逐圈扩散到全透明区域，避免放大后边缘出现黑边
+    static void bleedTransparent(QImage &argb, int iterations);
+};
+
+#endif // SPRITEATLAS_H
@@ -0,0 +1,395 @@
+#include "TemporalTileProcessor.h"
+#include "PngWriter.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QSemaphore>
+#include <QThread>
+#include <QVector>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEMPORALTILE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+struct TileDifference {
+    quint64 sum = 0;
+    int peak = 0;
+};
+
+// 逐字节绝对差：SSE2 下每次比较 16 字节（4 个像素），同时累加差值和记录最大差值。
+// 最大差值超过 stopPeak 后立即返回，明显变化的块不必比较完
+TileDifference tileDifference(const QImage &a, const QImage &b, const QRect &tile, int stopPeak)
+{
+    TileDifference result;
+    const int bytes = tile.width() * 4;
+    for (int y = tile.top(); y <= tile.bottom() && result.peak < stopPeak; ++y) {
+        const uchar *pa = a.constScanLine(y) + tile.left() * 4;
+        const uchar *pb = b.constScanLine(y) + tile.left() * 4;
+        int x = 0;
+#ifdef TEMPORALTILE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sad = zero;
+        __m128i peak = zero;
+        for (; x + 16 <= bytes; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pa + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb + x));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            sad = _mm_add_epi64(sad, _mm_sad_epu8(diff, zero));
+            peak = _mm_max_epu8(peak, diff);
+        }
+        result.sum += quint64(_mm_cvtsi128_si32(sad)) + quint64(_mm_cvtsi128_si32(_mm_srli_si128(sad, 8)));
+        alignas(16) uchar lanes[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), peak);
+        for (uchar lane : lanes) {
+            result.peak = qMax(result.peak, int(lane));
+        }
+#endif
+        for (; x < bytes; ++x) {
+            int diff = qAbs(int(pa[x]) - int(pb[x]));
+            result.sum += diff;
+            result.peak = qMax(result.peak, diff);
+        }
+    }
+    return result;
+}
+
+// 两张 RGB32 图之间按行复制矩形区域
+void blit(QImage &target, const QPoint &to, const QImage &source, QRect from)
+{
+    from &= source.rect();
+    QRect area = QRect(to, from.size()) & target.rect();
+    from.setSize(area.size());
+    for (int y = 0; y < area.height(); ++y) {
+        std::memcpy(target.scanLine(area.top() + y) + area.left() * 4,
+                    source.constScanLine(from.top() + y) + from.left() * 4,
+                    size_t(area.width()) * 4);
+    }
+}
+
+bool writeFrame(const QImage &image, const QString &path, const QString &format)
+{
+    if (format == "png") {
+        return PngWriter::write(image, path, PngWriter::Intermediate);
+    }
+    return image.save(path, nullptr, 95);
+}
+}
+
+double TemporalTileProcessor::Stats::effectiveSpeedup(qint64 modelMs) const
+{
+    if (processedPixels <= 0 || modelMs <= 0) {
+        return 1.0;
+    }
+    double fullModelMs = double(modelMs) * framePixels / processedPixels;
+    return fullModelMs / double(modelMs + analysisMs + compositeMs);
+}
+
+QString TemporalTileProcessor::Stats::summary(qint64 modelMs) const
+{
+    return QString("时域分块复用：%1 帧中 %2 帧整帧放大，复用 %3% 的分块，送入模型的像素为逐帧放大的 %4%，"
+                   "含分析 %5 秒、合成 %6 秒在内有效加速约 %7 倍")
+        .arg(frames)
+        .arg(fullFrames)
+        .arg(reusedRatio() * 100, 0, 'f', 1)
+        .arg(framePixels > 0 ? processedPixels * 100.0 / framePixels : 100.0, 0, 'f', 1)
+        .arg(analysisMs / 1000.0, 0, 'f', 1)
+        .arg(compositeMs / 1000.0, 0, 'f', 1)
+        .arg(effectiveSpeedup(modelMs), 0, 'f', 2);
+}
+
+TemporalTileProcessor::TemporalTileProcessor(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+    m_driverPool.setMaxThreadCount(1);
+}
+
+TemporalTileProcessor::~TemporalTileProcessor()
+{
+    cancel();
+    m_driverPool.waitForDone();
+    m_pool.waitForDone();
+}
+
+void TemporalTileProcessor::analyze(const QString &frameDir, const QString &workDir)
+{
+    m_cancelled = false;
+    m_driverPool.start([this, frameDir, workDir]() {
+        runAnalyze(frameDir, workDir);
+    });
+}
+
+void TemporalTileProcessor::composite(const QString &upscaledDir, const QString &outputDir,
+                                      const QString &format, int scale)
+{
+    m_cancelled = false;
+    m_driverPool.start([this, upscaledDir, outputDir, format, scale]() {
+        runComposite(upscaledDir, outputDir, format, scale);
+    });
+}
+
+void TemporalTileProcessor::cancel()
+{
+    m_cancelled = true;
+}
+
+void TemporalTileProcessor::reportProgress(int done, int total)
+{
+    if (done != total && done % qMax(1, total / 100) != 0) {
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this, done, total]() { emit progress(done, total); }, Qt::QueuedConnection);
+}
+
+void TemporalTileProcessor::runAnalyze(const QString &frameDir, const QString &workDir)
+{
+    auto finish = [this](bool ok, const QString &error) {
+        QMetaObject::invokeMethod(this, [this, ok, error]() { emit analyzed(ok, error); }, Qt::QueuedConnection);
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    m_plans.clear();
+    m_stats = Stats();
+
+    QDir frames(frameDir);
+    QDir work(workDir);
+    const QStringList names = frames.entryList({"frame*.png"}, QDir::Files, QDir::Name);
+    const Settings settings = m_settings;
+    const int tile = qMax(16, settings.tileSize);
+
+    // 上一次放大时各块对应的源画面。与它比较而不是与上一帧比较，缓慢的渐变累积到阈值后也会重算
+    QImage reference;
+    int sinceKeyframe = 0;
+    const int batchSize = qMax(2, m_pool.maxThreadCount());
+
+    for (int start = 0; start < names.size(); start += batchSize) {
+        if (m_cancelled) {
+            finish(false, "已取消");
+            return;
+        }
+
+        // 一批帧并行解码，比较必须按顺序进行
+        int count = qMin(batchSize, int(names.size()) - start);
+        QVector<QImage> images(count);
+        QSemaphore decoded;
+        for (int i = 0; i < count; ++i) {
+            m_pool.start([&, i]() {
+                images[i] = QImage(frames.filePath(names.at(start + i))).convertToFormat(QImage::Format_RGB32);
+                decoded.release();
+            });
+        }
+        decoded.acquire(count);
+
+        QSemaphore written;
+        int pendingWrites = 0;
+        std::atomic<bool> writeFailed{false};
+
+        for (int i = 0; i < count; ++i) {
+            const QImage &frame = images.at(i);
+            const QString fileName = names.at(start + i);
+            if (frame.isNull()) {
+                written.acquire(pendingWrites);
+                finish(false, QString("无法读取帧 %1").arg(fileName));
+                return;
+            }
+
+            FramePlan plan;
+            plan.name = QFileInfo(fileName).completeBaseName();
+            const int columns = (frame.width() + tile - 1) / tile;
+            const int rows = (frame.height() + tile - 1) / tile;
+            const int tileCount = columns * rows;
+            m_stats.frames++;
+            m_stats.tiles += tileCount;
+            m_stats.framePixels += qint64(frame.width()) * frame.height();
+
+            QVector<bool> changed(tileCount, true);
+            int changedCount = tileCount;
+            bool keyframe = reference.size() != frame.size() || sinceKeyframe >= settings.keyframeInterval;
+            if (!keyframe) {
+                changedCount = 0;
+                for (int row = 0; row < rows; ++row) {
+                    for (int column = 0; column < columns; ++column) {
+                        QRect rect = QRect(column * tile, row * tile, tile, tile) & frame.rect();
+                        TileDifference diff = tileDifference(frame, reference, rect, settings.peakThreshold);
+                        double mean = double(diff.sum) / (qint64(rect.width()) * rect.height() * 3);
+                        bool tileChanged = diff.peak >= settings.peakThreshold || mean > settings.meanThreshold;
+                        changed[row * columns + column] = tileChanged;
+                        changedCount += tileChanged ? 1 : 0;
+                    }
+                }
+            }
+
+            if (keyframe || changedCount > settings.maxChangedRatio * tileCount) {
+                // 整帧放大：源帧直接移入工作目录，不必重新编码
+                QString target = work.filePath(fileName);
+                if (!QFile::rename(frames.filePath(fileName), target) && !QFile::copy(frames.filePath(fileName), target)) {
+                    written.acquire(pendingWrites);
+                    finish(false, QString("无法写入 %1").arg(target));
+                    return;
+                }
+                plan.full = true;
+                reference = frame;
+                sinceKeyframe = 0;
+                m_stats.fullFrames++;
+                m_stats.processedPixels += qint64(frame.width()) * frame.height();
+                m_plans << plan;
+                continue;
+            }
+
+            plan.full = false;
+            ++sinceKeyframe;
+            m_stats.reusedTiles += tileCount - changedCount;
+
+            // 同一行里相邻的变化块合并成一个小块，减少模型的调用次数
+            for (int row = 0; row < rows; ++row) {
+                int column = 0;
+                while (column < columns) {
+                    if (!changed.at(row * columns + column)) {
+                        ++column;
+                        continue;
+                    }
+                    int runStart = column;
+                    while (column < columns && changed.at(row * columns + column)) {
+                        ++column;
+                    }
+
+                    Patch patch;
+                    patch.inner = QRect(runStart * tile, row * tile, (column - runStart) * tile, tile) & frame.rect();
+                    patch.source = patch.inner.adjusted(-settings.margin, -settings.margin,
+                                                        settings.margin, settings.margin) & frame.rect();
+                    patch.name = QString("%1_p%2").arg(plan.name).arg(plan.patches.size(), 3, 10, QChar('0'));
+                    plan.patches << patch;
+                    m_stats.processedPixels += qint64(patch.source.width()) * patch.source.height();
+
+                    blit(reference, patch.inner.topLeft(), frame, patch.inner);
+
+                    QImage image = frame.copy(patch.source);
+                    QString path = work.filePath(patch.name + ".png");
+                    ++pendingWrites;
+                    m_pool.start([image, path, &written, &writeFailed]() {
+                        if (!PngWriter::write(image, path, PngWriter::Intermediate)) {
+                            writeFailed = true;
+                        }
+                        written.release();
+                    });
+                }
+            }
+            m_plans << plan;
+        }
+
+        written.acquire(pendingWrites);
+        if (writeFailed) {
+            finish(false, QString("无法写入分块到 %1").arg(workDir));
+            return;
+        }
+        reportProgress(start + count, names.size());
+    }
+
+    m_stats.analysisMs = timer.elapsed();
+    finish(true, QString());
+}
+
+void TemporalTileProcessor::runComposite(const QString &upscaledDir, const QString &outputDir,
+                                         const QString &format, int scale)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QDir upscaled(upscaledDir);
+    QDir output(outputDir);
+    const int maxInFlight = qMax(1, m_pool.maxThreadCount());
+    QSemaphore slots(maxInFlight);
+    std::atomic<bool> writeFailed{false};
+
+    auto finish = [&](bool ok, const QString &error) {
+        slots.acquire(maxInFlight);
+        if (ok && writeFailed) {
+            ok = false;
+        }
+        m_stats.compositeMs = timer.elapsed();
+        QString message = ok || !error.isEmpty() ? error : QString("无法写入合成帧到 %1").arg(outputDir);
+        QMetaObject::invokeMethod(this, [this, ok, message]() { emit composited(ok, message); }, Qt::QueuedConnection);
+    };
+
+    // 上一帧的增强结果；整帧输出为 PNG 时直接改名，等下一帧需要时才解码
+    QImage previous;
+    QString previousPath;
+
+    for (int i = 0; i < m_plans.size(); ++i) {
+        if (m_cancelled) {
+            finish(false, "已取消");
+            return;
+        }
+
+        const FramePlan &plan = m_plans.at(i);
+        QString target = output.filePath(plan.name + "." + format);
+
+        if (plan.full) {
+            QString source = upscaled.filePath(plan.name + ".png");
+            if (format == "png") {
+                QFile::remove(target);
+                if (!QFile::rename(source, target)) {
+                    finish(false, QString("缺少放大结果 %1").arg(source));
+                    return;
+                }
+                previous = QImage();
+                previousPath = target;
+            } else {
+                previous = QImage(source).convertToFormat(QImage::Format_RGB32);
+                if (previous.isNull()) {
+                    finish(false, QString("缺少放大结果 %1").arg(source));
+                    return;
+                }
+                slots.acquire();
+                QImage frame = previous;
+                m_pool.start([frame, target, format, &slots, &writeFailed]() {
+                    if (!writeFrame(frame, target, format)) {
+                        writeFailed = true;
+                    }
+                    slots.release();
+                });
+            }
+            reportProgress(i + 1, m_plans.size());
+            continue;
+        }
+
+        if (previous.isNull()) {
+            previous = QImage(previousPath).convertToFormat(QImage::Format_RGB32);
+            if (previous.isNull()) {
+                finish(false, QString("缺少参考帧 %1").arg(previousPath));
+                return;
+            }
+        }
+
+        QImage current = previous;
+        for (const Patch &patch : plan.patches) {
+            QString path = upscaled.filePath(patch.name + ".png");
+            QImage image = QImage(path).convertToFormat(QImage::Format_RGB32);
+            if (image.isNull()) {
+                finish(false, QString("缺少放大结果 %1").arg(path));
+                return;
+            }
+            QRect from(QPoint(patch.inner.left() - patch.source.left(), patch.inner.top() - patch.source.top()) * scale,
+                       patch.inner.size() * scale);
+            blit(current, patch.inner.topLeft() * scale, image, from);
+        }
+        previous = current;
+
+        // 编码交给线程池，主循环继续合成下一帧
+        slots.acquire();
+        m_pool.start([current, target, format, &slots, &writeFailed]() {
+            if (!writeFrame(current, target, format)) {
+                writeFailed = true;
+            }
+            slots.release();
+        });
+        reportProgress(i + 1, m_plans.size());
+    }
+
+    finish(true, QString());
+}
@@ -0,0 +1,90 @@
+#ifndef TEMPORALTILEPROCESSOR_H
+#define TEMPORALTILEPROCESSOR_H
+
+#include <QObject>
+#include <QList>
+#include <QRect>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+// 视频的时域分块复用：把每帧切成小块与上一次放大时的源画面比较，
+// 只把变化的块（连同一圈上下文边距）交给模型，其余块直接沿用上一帧的放大结果。
+// 动画里大部分帧只有嘴型或角色在动，背景不必每帧重算。
+// analyze() 在 workDir 里生成待放大的整帧和小块，放大后由 composite() 合成完整的增强帧
+class TemporalTileProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Settings {
+        int tileSize = 64;
+        int margin = 16;             // 小块四周额外带上的像素，给模型足够的感受野
+        double meanThreshold = 1.0;  // 块内平均每通道差值
+        int peakThreshold = 24;      // 块内任一通道的最大差值，捕捉小而明显的变化
+        int keyframeInterval = 120;  // 每隔多少帧整帧重算一次，避免误差累积
+        double maxChangedRatio = 0.6; // 变化块超过这个比例时整帧放大更划算
+    };
+
+    struct Stats {
+        int frames = 0;
+        int fullFrames = 0;
+        qint64 tiles = 0;
+        qint64 reusedTiles = 0;
+        qint64 framePixels = 0;     // 全部帧逐帧放大时的像素总数
+        qint64 processedPixels = 0; // 实际送入模型的像素总数（含边距）
+        qint64 analysisMs = 0;
+        qint64 compositeMs = 0;
+
+        double reusedRatio() const { return tiles > 0 ? double(reusedTiles) / tiles : 0; }
+        // modelMs 为本次模型实际耗时，按像素比例推算逐帧放大的耗时
+        double effectiveSpeedup(qint64 modelMs) const;
+        QString summary(qint64 modelMs) const;
+    };
+
+    explicit TemporalTileProcessor(QObject *parent = nullptr);
+    ~TemporalTileProcessor();
+
+    void setSettings(const Settings &settings) { m_settings = settings; }
+    const Settings &settings() const { return m_settings; }
+    const Stats &stats() const { return m_stats; }
+
+    // frameDir 中的 frame%08d.png 按顺序分析，整帧移入 workDir，变化的小块另存为 PNG
+    void analyze(const QString &frameDir, const QString &workDir);
+    // upscaledDir 为 workDir 放大 scale 倍后的结果，合成帧写入 outputDir/frame%08d.<format>
+    void composite(const QString &upscaledDir, const QString &outputDir, const QString &format, int scale);
+    void cancel();
+
+signals:
+    void progress(int done, int total);
+    void analyzed(bool ok, const QString &error);
+    void composited(bool ok, const QString &error);
+
+private:
+    struct Patch {
+        QString name;  // workDir 中的文件名（不含扩展名）
+        QRect source;  // 小块在源帧中的位置（含边距）
+        QRect inner;   // 需要贴回的区域（不含边距）
+    };
+
+    struct FramePlan {
+        QString name;  // frame%08d
+        bool full = true;
+        QList<Patch> patches;
+    };
+
+    void runAnalyze(const QString &frameDir, const QString &workDir);
+    void runComposite(const QString &upscaledDir, const QString &outputDir, const QString &format, int scale);
+    void reportProgress(int done, int total);
+
+    Settings m_settings;
+    Stats m_stats;
+    QList<FramePlan> m_plans;
+    // 并行解码和编码
+    QThreadPool m_pool;
+    // 帧之间有依赖，整个分析 / 合成过程串行执行
+    QThreadPool m_driverPool;
+    std::atomic<bool> m_cancelled{false};
+};
+
+#endif // TEMPORALTILEPROCESSOR_H
@@ -0,0 +1,327 @@
+#include "ThroughputLedger.h"
+#include "UpscaleBackend.h"
+#include "ProcessLauncher.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <functional>
+
+namespace {
+QString s_path;
+
+// 每个阶段最多参考最近这么多条匹配记录，机器升级或驱动更新后旧数据逐渐淡出
+const int kMaxSamples = 50;
+const char *kStageKeys[] = {"extract", "enhance", "encode"};
+const char *kStageNames[] = {"提取", "增强", "编码"};
+
+QJsonObject toJson(const ThroughputRecord &record)
+{
+    QJsonObject object;
+    object["finished"] = record.finished.toString(Qt::ISODate);
+    object["input"] = record.inputPath;
+    object["model"] = record.modelName;
+    object["plan"] = record.planSummary;
+    object["codec"] = record.codec;
+    object["inputWidth"] = record.inputSize.width();
+    object["inputHeight"] = record.inputSize.height();
+    object["outputWidth"] = record.outputSize.width();
+    object["outputHeight"] = record.outputSize.height();
+    object["frames"] = record.frames;
+    object["concurrency"] = record.concurrency;
+    for (int i = 0; i < ThroughputRecord::StageCount; ++i) {
+        QJsonObject stage;
+        stage["work"] = record.work[i];
+        stage["ms"] = double(record.stageMs[i]);
+        object[kStageKeys[i]] = stage;
+    }
+    object["host"] = record.host;
+    object["cpu"] = record.cpu;
+    object["threads"] = record.threads;
+    object["backend"] = record.backend;
+    object["placement"] = record.placement;
+    return object;
+}
+
+ThroughputRecord fromJson(const QJsonObject &object)
+{
+    ThroughputRecord record;
+    record.finished = QDateTime::fromString(object["finished"].toString(), Qt::ISODate);
+    record.inputPath = object["input"].toString();
+    record.modelName = object["model"].toString();
+    record.planSummary = object["plan"].toString();
+    record.codec = object["codec"].toString();
+    record.inputSize = QSize(object["inputWidth"].toInt(), object["inputHeight"].toInt());
+    record.outputSize = QSize(object["outputWidth"].toInt(), object["outputHeight"].toInt());
+    record.frames = object["frames"].toInt();
+    record.concurrency = qMax(1, object["concurrency"].toInt());
+    for (int i = 0; i < ThroughputRecord::StageCount; ++i) {
+        QJsonObject stage = object[kStageKeys[i]].toObject();
+        record.work[i] = stage["work"].toDouble();
+        record.stageMs[i] = qint64(stage["ms"].toDouble());
+    }
+    record.host = object["host"].toString();
+    record.cpu = object["cpu"].toString();
+    record.threads = object["threads"].toInt();
+    record.backend = object["backend"].toString();
+    record.placement = object["placement"].toString();
+    return record;
+}
+
+// 固定开销 + 单位工作量耗时的最小二乘拟合；样本太少或拟合结果不合理时退回总耗时 / 总工作量
+double fitMs(const QList<QPair<double, double>> &points, double work)
+{
+    double sumWork = 0;
+    double sumMs = 0;
+    for (const auto &point : points) {
+        sumWork += point.first;
+        sumMs += point.second;
+    }
+    if (sumWork <= 0) {
+        return 0;
+    }
+
+    if (points.size() >= 3) {
+        double meanWork = sumWork / points.size();
+        double meanMs = sumMs / points.size();
+        double covariance = 0;
+        double variance = 0;
+        for (const auto &point : points) {
+            covariance += (point.first - meanWork) * (point.second - meanMs);
+            variance += (point.first - meanWork) * (point.first - meanWork);
+        }
+        if (variance > 0) {
+            double slope = covariance / variance;
+            double intercept = meanMs - slope * meanWork;
+            if (slope > 0 && intercept >= 0) {
+                return intercept + slope * work;
+            }
+        }
+    }
+    return sumMs / sumWork * work;
+}
+
+QString csvField(const QString &text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n')) {
+        return text;
+    }
+    return '"' + QString(text).replace("\"", "\"\"") + '"';
+}
+}
+
+qint64 ThroughputEstimate::totalMs() const
+{
+    return stageMs[ThroughputRecord::Extract] + stageMs[ThroughputRecord::Enhance]
+           + stageMs[ThroughputRecord::Encode];
+}
+
+qint64 ThroughputEstimate::remainingMs(int stage, double fraction, qint64 elapsedMs) const
+{
+    // 阶段刚开始时相信历史预测，越往后越相信本次实测速度
+    double current = stageMs[stage];
+    fraction = qBound(0.0, fraction, 1.0);
+    if (fraction > 0.02 && elapsedMs > 0) {
+        double observed = elapsedMs / fraction;
+        current = samples[stage] > 0 ? (1 - fraction) * current + fraction * observed : observed;
+    }
+
+    qint64 remaining = qMax<qint64>(0, qint64(current) - elapsedMs);
+    for (int i = stage + 1; i < ThroughputRecord::StageCount; ++i) {
+        remaining += stageMs[i];
+    }
+    return remaining;
+}
+
+QString ThroughputEstimate::summary() const
+{
+    QStringList parts;
+    int records = 0;
+    for (int i = 0; i < ThroughputRecord::StageCount; ++i) {
+        parts << QString("%1 %2").arg(kStageNames[i],
+                                      samples[i] > 0 ? ThroughputLedger::formatDuration(stageMs[i]) : "未知");
+        records = qMax(records, samples[i]);
+    }
+    return QString("预计耗时：%1，共 %2（参考 %3 条记录）")
+        .arg(parts.join("，"), ThroughputLedger::formatDuration(totalMs()))
+        .arg(records);
+}
+
+QString ThroughputLedger::path()
+{
+    if (!s_path.isEmpty()) {
+        return s_path;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath("throughput.jsonl");
+}
+
+void ThroughputLedger::setPath(const QString &path)
+{
+    s_path = path;
+}
+
+void ThroughputLedger::fillMachineProfile(ThroughputRecord &record)
+{
+    record.host = QSysInfo::machineHostName();
+    record.cpu = QSysInfo::currentCpuArchitecture();
+    record.threads = QThread::idealThreadCount();
+    record.backend = UpscaleBackend::defaultBackend()->name();
+    record.placement = ProcessLauncher::policyName(ProcessLauncher::policy());
+}
+
+bool ThroughputLedger::append(ThroughputRecord record)
+{
+    fillMachineProfile(record);
+    if (!record.finished.isValid()) {
+        record.finished = QDateTime::currentDateTime();
+    }
+
+    QDir().mkpath(QFileInfo(path()).absolutePath());
+    QFile file(path());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Cannot write throughput ledger:" << path();
+        return false;
+    }
+    // 单行追加，多个实例同时写也不会互相覆盖
+    file.write(QJsonDocument(toJson(record)).toJson(QJsonDocument::Compact) + '\n');
+    return true;
+}
+
+QList<ThroughputRecord> ThroughputLedger::records()
+{
+    QList<ThroughputRecord> result;
+    QFile file(path());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+    while (!file.atEnd()) {
+        QJsonObject object = QJsonDocument::fromJson(file.readLine()).object();
+        if (!object.isEmpty()) {
+            result << fromJson(object);
+        }
+    }
+    return result;
+}
+
+ThroughputEstimate ThroughputLedger::predict(ThroughputRecord profile)
+{
+    fillMachineProfile(profile);
+    const QList<ThroughputRecord> all = records();
+
+    // 从最相近的记录开始找：同机器同后端同模型 → 同机器同后端 → 同后端同模型 → 全部
+    using Match = std::function<bool(const ThroughputRecord &)>;
+    auto sameHost = [&profile](const ThroughputRecord &r) { return r.host == profile.host; };
+    auto sameBackend = [&profile](const ThroughputRecord &r) { return r.backend == profile.backend; };
+    auto sameModel = [&profile](const ThroughputRecord &r) { return r.modelName == profile.modelName; };
+    auto sameCodec = [&profile](const ThroughputRecord &r) { return r.codec == profile.codec; };
+    auto any = [](const ThroughputRecord &) { return true; };
+
+    QList<Match> tiers[ThroughputRecord::StageCount];
+    tiers[ThroughputRecord::Extract] = {sameHost, any};
+    tiers[ThroughputRecord::Enhance] = {
+        [=](const ThroughputRecord &r) { return sameHost(r) && sameBackend(r) && sameModel(r); },
+        [=](const ThroughputRecord &r) { return sameHost(r) && sameBackend(r); },
+        [=](const ThroughputRecord &r) { return sameBackend(r) && sameModel(r); },
+        any};
+    tiers[ThroughputRecord::Encode] = {
+        [=](const ThroughputRecord &r) { return sameHost(r) && sameCodec(r); },
+        sameHost, sameCodec, any};
+
+    ThroughputEstimate estimate;
+    for (int stage = 0; stage < ThroughputRecord::StageCount; ++stage) {
+        if (profile.work[stage] <= 0) {
+            continue;
+        }
+        for (const Match &match : tiers[stage]) {
+            QList<QPair<double, double>> points;
+            for (int i = all.size() - 1; i >= 0 && points.size() < kMaxSamples; --i) {
+                const ThroughputRecord &record = all.at(i);
+                if (record.work[stage] > 0 && record.stageMs[stage] > 0 && match(record)) {
+                    points << qMakePair(record.work[stage], double(record.stageMs[stage]));
+                }
+            }
+            if (!points.isEmpty()) {
+                estimate.stageMs[stage] = qint64(fitMs(points, profile.work[stage]));
+                estimate.samples[stage] = points.size();
+                break;
+            }
+        }
+    }
+    return estimate;
+}
+
+bool ThroughputLedger::exportCsv(const QString &path, QString *error)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (error) {
+            *error = QString("无法写入 %1").arg(path);
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "finished,host,cpu,threads,backend,placement,concurrency,input,model,plan,codec,"
+           "input_width,input_height,output_width,output_height,frames,"
+           "extract_work,extract_ms,enhance_work,enhance_ms,encode_work,encode_ms,total_ms\n";
+    for (const ThroughputRecord &record : records()) {
+        QStringList fields;
+        fields << record.finished.toString(Qt::ISODate) << csvField(record.host) << record.cpu
+               << QString::number(record.threads) << record.backend << record.placement
+               << QString::number(record.concurrency) << csvField(record.inputPath)
+               << csvField(record.modelName) << csvField(record.planSummary) << record.codec
+               << QString::number(record.inputSize.width()) << QString::number(record.inputSize.height())
+               << QString::number(record.outputSize.width()) << QString::number(record.outputSize.height())
+               << QString::number(record.frames);
+        for (int i = 0; i < ThroughputRecord::StageCount; ++i) {
+            fields << QString::number(record.work[i], 'f', 3) << QString::number(record.stageMs[i]);
+        }
+        fields << QString::number(record.totalMs());
+        out << fields.join(',') << '\n';
+    }
+    out.flush();
+
+    if (!file.commit()) {
+        if (error) {
+            *error = QString("无法写入 %1").arg(path);
+        }
+        return false;
+    }
+    return true;
+}
+
+int ThroughputLedger::runExport(const QStringList &arguments)
+{
+    int index = arguments.indexOf("--export-ledger");
+    if (index < 0 || index + 1 >= arguments.size()) {
+        qWarning() << "Usage: --export-ledger <file.csv>";
+        return 2;
+    }
+
+    QString error;
+    if (!exportCsv(arguments.at(index + 1), &error)) {
+        qWarning().noquote() << error;
+        return 1;
+    }
+    qInfo().noquote() << QString("Exported %1 records from %2").arg(records().size()).arg(path());
+    return 0;
+}
+
+QString ThroughputLedger::formatDuration(qint64 ms)
+{
+    qint64 seconds = qMax<qint64>(0, (ms + 500) / 1000);
+    if (seconds >= 3600) {
+        return QString("%1 小时 %2 分").arg(seconds / 3600).arg(seconds % 3600 / 60);
+    }
+    if (seconds >= 60) {
+        return QString("%1 分 %2 秒").arg(seconds / 60).arg(seconds % 60);
+    }
+    return QString("%1 秒").arg(seconds);
+}
@@ -0,0 +1,73 @@
+#ifndef THROUGHPUTLEDGER_H
+#define THROUGHPUTLEDGER_H
+
+#include <QDateTime>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+// 每个完成的视频作业一条记录。工作量以“百万像素 × 帧”计：
+// 提取按抽出的帧尺寸，增强按各遍模型输出尺寸之和（乘以同时增强的作业数），编码按最终尺寸
+struct ThroughputRecord {
+    enum Stage { Extract, Enhance, Encode, StageCount };
+
+    QDateTime finished;
+    QString inputPath;
+    QString modelName;
+    QString planSummary;
+    QString codec;
+    QSize inputSize;
+    QSize outputSize;
+    int frames = 0;
+    int concurrency = 1;
+    double work[StageCount] = {0, 0, 0};
+    qint64 stageMs[StageCount] = {0, 0, 0};
+
+    // 机器概况
+    QString host;
+    QString cpu;
+    int threads = 0;
+    QString backend;
+    QString placement;
+
+    qint64 totalMs() const { return stageMs[Extract] + stageMs[Enhance] + stageMs[Encode]; }
+};
+
+// 按历史记录拟合的各阶段耗时，samples 为 0 的阶段没有可用数据
+struct ThroughputEstimate {
+    qint64 stageMs[ThroughputRecord::StageCount] = {0, 0, 0};
+    int samples[ThroughputRecord::StageCount] = {0, 0, 0};
+
+    bool isValid() const { return samples[ThroughputRecord::Enhance] > 0; }
+    qint64 totalMs() const;
+    // 阶段 stage 已完成 fraction、耗时 elapsedMs 时的剩余时间，含后续阶段
+    qint64 remainingMs(int stage, double fraction, qint64 elapsedMs) const;
+    QString summary() const;
+};
+
+// 本地吞吐记录（应用数据目录下的 throughput.jsonl，每行一条），
+// 用于作业开始前和进行中预估各阶段耗时，也可以导出 CSV 汇总整个渲染集群的容量
+class ThroughputLedger
+{
+public:
+    static QString path();
+    static void setPath(const QString &path);
+
+    // 填好机器概况后追加一条记录
+    static bool append(ThroughputRecord record);
+    static QList<ThroughputRecord> records();
+
+    // profile 只需填写模型、编码器、工作量和并发数，机器概况取当前机器
+    static ThroughputEstimate predict(ThroughputRecord profile);
+
+    static bool exportCsv(const QString &path, QString *error = nullptr);
+    // 命令行: qtRealSR_GUI --export-ledger <文件.csv>
+    static int runExport(const QStringList &arguments);
+
+    static QString formatDuration(qint64 ms);
+
+private:
+    static void fillMachineProfile(ThroughputRecord &record);
+};
+
+#endif // THROUGHPUTLEDGER_H
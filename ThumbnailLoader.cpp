@@ -0,0 +1,99 @@
+#include "ThumbnailLoader.h"
+#include <QImageReader>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+// 排队上限：超过后丢弃最早的请求（通常已经滚出视图）
+const int kMaxPending = 128;
+// 默认缓存 32 MB
+const int kDefaultCacheKb = 32 * 1024;
+}
+
+ThumbnailLoader::ThumbnailLoader(const QSize &thumbnailSize, QObject *parent)
+    : QObject(parent), m_size(thumbnailSize), m_placeholder(thumbnailSize)
+{
+    m_placeholder.fill(QColor(128, 128, 128, 60));
+    m_cache.setMaxCost(kDefaultCacheKb);
+    // 解码是 IO 与 CPU 混合负载，不占满所有核心，避免和推理抢资源
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    m_pending.clear();
+    m_pool.waitForDone();
+}
+
+void ThumbnailLoader::setCacheLimit(int kilobytes)
+{
+    m_cache.setMaxCost(kilobytes);
+}
+
+void ThumbnailLoader::clearPending()
+{
+    m_pending.clear();
+}
+
+QPixmap ThumbnailLoader::thumbnail(const QString &path)
+{
+    if (QPixmap *cached = m_cache.object(path)) {
+        return *cached;
+    }
+    if (m_failed.contains(path) || m_inFlight.contains(path)) {
+        return m_placeholder;
+    }
+
+    // 最新请求放到最前面
+    m_pending.removeOne(path);
+    m_pending.prepend(path);
+    while (m_pending.size() > kMaxPending) {
+        m_pending.removeLast();
+    }
+
+    startPending();
+    return m_placeholder;
+}
+
+void ThumbnailLoader::startPending()
+{
+    while (!m_pending.isEmpty() && m_pool.activeThreadCount() < m_pool.maxThreadCount()) {
+        QString path = m_pending.takeFirst();
+        m_inFlight.insert(path);
+
+        QSize size = m_size;
+        m_pool.start([this, path, size]() {
+            // 只读取文件头得到原尺寸，再让解码器直接输出缩小后的图像（JPEG 可在 DCT 阶段缩小）
+            QImageReader reader(path);
+            QSize fullSize = reader.size();
+            if (fullSize.isValid()) {
+                reader.setScaledSize(fullSize.scaled(size, Qt::KeepAspectRatio));
+            }
+            QImage image = reader.read();
+            if (image.isNull()) {
+                qDebug() << "Thumbnail decode failed:" << path << reader.errorString();
+            }
+
+            QMetaObject::invokeMethod(this, [this, path, image]() {
+                handleDecoded(path, image);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void ThumbnailLoader::handleDecoded(const QString &path, const QImage &image)
+{
+    m_inFlight.remove(path);
+
+    if (image.isNull()) {
+        m_failed.insert(path);
+    } else {
+        // QPixmap 只能在 GUI 线程创建；缓存代价按 KB 计算
+        QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+        int cost = qMax(1, pixmap->width() * pixmap->height() * 4 / 1024);
+        m_cache.insert(path, pixmap, cost);
+        emit thumbnailReady(path);
+    }
+
+    startPending();
+}
@@ -0,0 +1,43 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QObject>
+#include <QCache>
+#include <QPixmap>
+#include <QImage>
+#include <QSet>
+#include <QThreadPool>
+
+// 后台线程按缩小尺寸解码缩略图，结果放入有上限的 LRU 缓存。
+// 只解码视图实际请求的行；请求按后进先出处理，快速滚动时跳过已经滚出的行
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailLoader(const QSize &thumbnailSize, QObject *parent = nullptr);
+    ~ThumbnailLoader();
+
+    // 已缓存时直接返回，否则返回占位图并排队解码
+    QPixmap thumbnail(const QString &path);
+    QSize thumbnailSize() const { return m_size; }
+    void setCacheLimit(int kilobytes);
+    void clearPending();
+
+signals:
+    void thumbnailReady(const QString &path);
+
+private:
+    void startPending();
+    void handleDecoded(const QString &path, const QImage &image);
+
+    QSize m_size;
+    QPixmap m_placeholder;
+    QThreadPool m_pool;
+    QCache<QString, QPixmap> m_cache;
+    QList<QString> m_pending;
+    QSet<QString> m_inFlight;
+    QSet<QString> m_failed;
+};
+
+#endif // THUMBNAILLOADER_H
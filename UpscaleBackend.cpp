@@ -0,0 +1,143 @@
+#include "UpscaleBackend.h"
+#include "NcnnUpscaleBackend.h"
+#include "ClusterCoordinator.h"
+#include "ProcessLauncher.h"
+#include "ProcessSupervisor.h"
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QDebug>
+
+namespace {
+UpscaleBackend::Kind g_defaultKind = UpscaleBackend::CliBackend;
+// 错误信息只保留输出末尾
+const int kOutputTailLength = 2000;
+}
+
+UpscaleBackend *UpscaleBackend::instance(Kind kind)
+{
+    static CliUpscaleBackend cliBackend;
+    static NcnnUpscaleBackend ncnnBackend;
+    static ClusterUpscaleBackend clusterBackend;
+
+    switch (kind) {
+    case CliBackend:
+        return &cliBackend;
+    case NcnnCpuBackend:
+        return &ncnnBackend;
+    case ClusterBackend:
+        return &clusterBackend;
+    }
+    return &cliBackend;
+}
+
+UpscaleBackend *UpscaleBackend::defaultBackend()
+{
+    return instance(g_defaultKind);
+}
+
+UpscaleBackend::Kind UpscaleBackend::defaultKind()
+{
+    return g_defaultKind;
+}
+
+void UpscaleBackend::setDefaultKind(Kind kind)
+{
+    g_defaultKind = kind;
+}
+
+QString UpscaleBackend::defaultExecutablePath()
+{
+#ifdef Q_OS_WIN
+    return "realesrgan-ncnn-vulkan.exe";
+#else
+    return "realesrgan-ncnn-vulkan";
+#endif
+}
+
+QString CliUpscaleBackend::executablePath() const
+{
+    return m_executablePath.isEmpty() ? defaultExecutablePath() : m_executablePath;
+}
+
+bool CliUpscaleBackend::isAvailable(QString *reason) const
+{
+    QString path = executablePath();
+    if (!QFileInfo(path).isExecutable() && QStandardPaths::findExecutable(path).isEmpty()) {
+        if (reason) {
+            *reason = QString("未找到 %1").arg(path);
+        }
+        return false;
+    }
+    return true;
+}
+
+UpscaleTask *CliUpscaleBackend::createTask(const UpscaleRequest &request, QObject *parent)
+{
+    UpscaleRequest resolved = request;
+    if (resolved.executablePath.isEmpty()) {
+        resolved.executablePath = executablePath();
+    }
+    return new CliUpscaleTask(resolved, parent);
+}
+
+CliUpscaleTask::CliUpscaleTask(const UpscaleRequest &request, QObject *parent)
+    : UpscaleTask(request, parent), m_process(new QProcess(this))
+{
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(ProcessSupervisor::attach(m_process), &ProcessSupervisor::outputReady,
+            this, &CliUpscaleTask::handleOutput);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &CliUpscaleTask::handleFinished);
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            m_errorString = QString("无法启动 %1").arg(m_process->program());
+            emit finished(false);
+        }
+    });
+}
+
+void CliUpscaleTask::start()
+{
+    QStringList args;
+    args << "-i" << m_request.inputPath
+         << "-o" << m_request.outputPath
+         << "-n" << m_request.modelName
+         << "-s" << QString::number(m_request.scale)
+         << "-f" << m_request.outputFormat;
+
+    qDebug() << "Executing RealESRGAN:" << m_request.executablePath << args;
+    ProcessLauncher::start(m_process, m_request.executablePath, args, ProcessLauncher::Inference);
+}
+
+void CliUpscaleTask::cancel()
+{
+    m_cancelled = true;
+    ProcessSupervisor::stop(m_process);
+}
+
+void CliUpscaleTask::handleOutput(const QByteArray &data)
+{
+    QString output = QString::fromUtf8(data);
+
+    // 一段输出里可能有很多行进度，只取最后一个
+    static const QRegularExpression progressRegex(R"((\d+\.\d+)%)");
+    QRegularExpressionMatchIterator i = progressRegex.globalMatch(output);
+    double percent = -1;
+    while (i.hasNext()) {
+        percent = i.next().captured(1).toDouble();
+    }
+    if (percent >= 0) {
+        emit progress(percent);
+    }
+}
+
+void CliUpscaleTask::handleFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    bool ok = !m_cancelled && exitStatus == QProcess::NormalExit && exitCode == 0;
+    if (!ok) {
+        m_errorString = m_cancelled ? QString("已取消")
+                                    : QString("RealESRGAN failed (code %1): %2").arg(exitCode).arg(ProcessSupervisor::attach(m_process)->tail(kOutputTailLength));
+    }
+    emit finished(ok);
+}
@@ -0,0 +1,110 @@
+#ifndef UPSCALEBACKEND_H
+#define UPSCALEBACKEND_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include "PngWriter.h"
+
+// 一次放大请求；输入输出同为文件或同为目录
+struct UpscaleRequest {
+    QString inputPath;
+    QString outputPath;
+    QString modelName;
+    int scale = 4;
+    // 目录模式下的输出格式
+    QString outputFormat = "png";
+    // 进程内后端写 PNG 时的压缩策略；直接成为交付文件的那一遍设为 Deliverable
+    PngWriter::Purpose purpose = PngWriter::Intermediate;
+    // 仅外部程序后端使用，为空时使用默认路径
+    QString executablePath;
+};
+
+// 正在执行的放大任务。finished 只发出一次，之后调用方负责 deleteLater
+class UpscaleTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UpscaleTask(const UpscaleRequest &request, QObject *parent = nullptr)
+        : QObject(parent), m_request(request) {}
+
+    virtual void start() = 0;
+    virtual void cancel() = 0;
+
+    const UpscaleRequest &request() const { return m_request; }
+    QString errorString() const { return m_errorString; }
+
+signals:
+    // 单文件为当前图片的进度，目录模式为已完成文件的比例
+    void progress(double percent);
+    void finished(bool ok);
+
+protected:
+    UpscaleRequest m_request;
+    QString m_errorString;
+};
+
+// 放大后端。ImageProcessor / VideoProcessor / 预览只通过这个接口创建任务，
+// 外部程序与内置推理可以互换，也可以在基准测试里直接对比
+class UpscaleBackend
+{
+public:
+    enum Kind {
+        CliBackend,
+        NcnnCpuBackend,
+        ClusterBackend
+    };
+
+    virtual ~UpscaleBackend() = default;
+
+    virtual Kind kind() const = 0;
+    virtual QString name() const = 0;
+    virtual bool isAvailable(QString *reason = nullptr) const = 0;
+    virtual UpscaleTask *createTask(const UpscaleRequest &request, QObject *parent) = 0;
+
+    // 后端为进程内单例，模型等资源在多个作业之间共享
+    static UpscaleBackend *instance(Kind kind);
+    static UpscaleBackend *defaultBackend();
+    static Kind defaultKind();
+    static void setDefaultKind(Kind kind);
+    static QString defaultExecutablePath();
+};
+
+// 调用 realesrgan-ncnn-vulkan 可执行文件
+class CliUpscaleBackend : public UpscaleBackend
+{
+public:
+    Kind kind() const override { return CliBackend; }
+    QString name() const override { return "realesrgan-ncnn-vulkan"; }
+    bool isAvailable(QString *reason = nullptr) const override;
+    UpscaleTask *createTask(const UpscaleRequest &request, QObject *parent) override;
+
+    // 请求未指定可执行文件时使用
+    void setExecutablePath(const QString &path) { m_executablePath = path; }
+    QString executablePath() const;
+
+private:
+    QString m_executablePath;
+};
+
+class CliUpscaleTask : public UpscaleTask
+{
+    Q_OBJECT
+
+public:
+    explicit CliUpscaleTask(const UpscaleRequest &request, QObject *parent = nullptr);
+
+    void start() override;
+    void cancel() override;
+
+private slots:
+    void handleOutput(const QByteArray &data);
+    void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    QProcess *m_process;
+    bool m_cancelled = false;
+};
+
+#endif // UPSCALEBACKEND_H
@@ -0,0 +1,452 @@
+#include "VideoJobQueue.h"
+#include "ConcurrencyController.h"
+#include <QFileInfo>
+#include <QDebug>
+
+VideoJobQueue::VideoJobQueue(QObject *parent)
+    : QObject(parent), m_enhanceController(new ConcurrencyController("增强", 1, 1, this))
+{
+    m_enhanceController->setEnabled(false);
+    connect(m_enhanceController, &ConcurrencyController::limitChanged, this, [this]() {
+        if (m_running) {
+            schedule();
+        }
+    });
+}
+
+VideoJobQueue::~VideoJobQueue()
+{
+    cancelAll();
+}
+
+void VideoJobQueue::setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath, const QString &ffprobePath)
+{
+    m_realesrganPath = realesrganPath;
+    m_ffmpegPath = ffmpegPath;
+    m_ffprobePath = ffprobePath;
+}
+
+void VideoJobQueue::setStageLimit(VideoProcessor::Stage stage, int limit)
+{
+    m_stageLimits[stage] = qMax(1, limit);
+    if (stage == VideoProcessor::StageEnhance) {
+        m_enhanceController->setBounds(1, m_stageLimits[stage]);
+    }
+    if (m_running) {
+        schedule();
+    }
+}
+
+int VideoJobQueue::stageLimit(VideoProcessor::Stage stage) const
+{
+    return m_stageLimits[stage];
+}
+
+void VideoJobQueue::setAdaptiveConcurrency(bool enabled)
+{
+    m_adaptive = enabled;
+    m_enhanceController->setEnabled(enabled);
+    if (m_running) {
+        schedule();
+    }
+}
+
+void VideoJobQueue::setMaxBufferedJobs(int count)
+{
+    m_maxBufferedJobs = qMax(1, count);
+    if (m_running) {
+        schedule();
+    }
+}
+
+void VideoJobQueue::setAvailableModels(const QStringList &models)
+{
+    m_availableModels = models;
+}
+
+int VideoJobQueue::addJob(const QString &inputPath, const JobOptions &options)
+{
+    Job job;
+    job.id = m_nextJobId++;
+    job.inputPath = inputPath;
+    job.options = options;
+    m_jobs.append(job);
+
+    emit jobAdded(job.id);
+    if (m_running) {
+        schedule();
+    }
+    return job.id;
+}
+
+bool VideoJobQueue::removeJob(int jobId)
+{
+    for (int i = 0; i < m_jobs.size(); ++i) {
+        if (m_jobs[i].id != jobId) {
+            continue;
+        }
+        // 正在执行的作业不能直接移除
+        if (m_jobs[i].processor) {
+            return false;
+        }
+        m_jobs.removeAt(i);
+        emit jobRemoved(jobId);
+        return true;
+    }
+    return false;
+}
+
+void VideoJobQueue::clearFinished()
+{
+    for (int i = m_jobs.size() - 1; i >= 0; --i) {
+        JobState state = m_jobs[i].state;
+        if (state == Finished || state == Failed || state == Cancelled) {
+            int jobId = m_jobs[i].id;
+            m_jobs.removeAt(i);
+            emit jobRemoved(jobId);
+        }
+    }
+}
+
+void VideoJobQueue::start()
+{
+    if (m_running) {
+        return;
+    }
+
+    m_running = true;
+    m_queueTimer.start();
+    for (Job &job : m_jobs) {
+        if (job.state == Failed || job.state == Cancelled) {
+            job.error.clear();
+            job.percent = 0;
+            setState(job, Pending);
+        }
+    }
+    schedule();
+    checkQueueFinished();
+}
+
+void VideoJobQueue::cancelAll()
+{
+    m_running = false;
+    for (Job &job : m_jobs) {
+        if (job.state == Finished || job.state == Failed) {
+            continue;
+        }
+        releaseProcessor(job);
+        setState(job, Cancelled);
+    }
+}
+
+const VideoJobQueue::Job *VideoJobQueue::job(int jobId) const
+{
+    for (const Job &job : m_jobs) {
+        if (job.id == jobId) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+QList<int> VideoJobQueue::jobIds() const
+{
+    QList<int> ids;
+    for (const Job &job : m_jobs) {
+        ids << job.id;
+    }
+    return ids;
+}
+
+QString VideoJobQueue::stateText(JobState state)
+{
+    switch (state) {
+    case Pending: return "等待中";
+    case Extracting: return "提取中";
+    case Extracted: return "等待增强";
+    case Enhancing: return "增强中";
+    case Enhanced: return "等待编码";
+    case Encoding: return "编码中";
+    case Finished: return "已完成";
+    case Failed: return "失败";
+    case Cancelled: return "已取消";
+    }
+    return QString();
+}
+
+VideoJobQueue::Job *VideoJobQueue::findJob(int jobId)
+{
+    for (Job &job : m_jobs) {
+        if (job.id == jobId) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+VideoJobQueue::Job *VideoJobQueue::findJob(VideoProcessor *processor)
+{
+    for (Job &job : m_jobs) {
+        if (job.processor == processor) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+int VideoJobQueue::countInState(JobState state) const
+{
+    int count = 0;
+    for (const Job &job : m_jobs) {
+        if (job.state == state) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void VideoJobQueue::setState(Job &job, JobState state)
+{
+    job.state = state;
+    updateEnhanceDemand();
+    emit jobStateChanged(job.id, state);
+}
+
+int VideoJobQueue::enhanceLimit() const
+{
+    // 自适应只在上限以内收缩，已在运行的作业不会被打断
+    return m_adaptive ? m_enhanceController->limit() : m_stageLimits[VideoProcessor::StageEnhance];
+}
+
+void VideoJobQueue::updateEnhanceDemand()
+{
+    m_enhanceController->setDemand(countInState(Enhancing) + countInState(Extracted));
+}
+
+void VideoJobQueue::schedule()
+{
+    if (!m_running) {
+        return;
+    }
+
+    // 从母版重新编码的作业不需要提取和增强，直接进入等待编码
+    for (Job &job : m_jobs) {
+        if (job.state != Pending || job.options.masterPath.isEmpty()) {
+            continue;
+        }
+        createProcessor(job);
+        if (job.processor->prepareReencode(job.options.masterPath, job.inputPath, false)) {
+            setState(job, Enhanced);
+        }
+    }
+
+    // 从下游往上游调度：优先让已提取/已增强的作业前进，尽快释放临时空间
+    for (Job &job : m_jobs) {
+        if (countInState(Encoding) >= m_stageLimits[VideoProcessor::StageRebuild]) {
+            break;
+        }
+        if (job.state == Enhanced) {
+            startStage(job, VideoProcessor::StageRebuild);
+        }
+    }
+
+    for (Job &job : m_jobs) {
+        if (countInState(Enhancing) >= enhanceLimit()) {
+            break;
+        }
+        if (job.state == Extracted) {
+            startStage(job, VideoProcessor::StageEnhance);
+        }
+    }
+
+    for (Job &job : m_jobs) {
+        if (countInState(Extracting) >= m_stageLimits[VideoProcessor::StageExtract]) {
+            break;
+        }
+        if (countInState(Extracting) + countInState(Extracted) >= m_maxBufferedJobs) {
+            break;
+        }
+        if (job.state != Pending) {
+            continue;
+        }
+
+        // 元数据探测计入提取阶段，探测期间占用提取名额，prepared 后再开始抽帧
+        createProcessor(job);
+        job.percent = 0;
+        job.stageTimer.start();
+        setState(job, Extracting);
+        job.processor->prepare(job.inputPath, job.options.modelName, job.options.scaleFactor,
+                               job.options.outputFormat, false);
+    }
+}
+
+void VideoJobQueue::createProcessor(Job &job)
+{
+    job.processor = new VideoProcessor(this);
+    configureProcessor(job.processor, job.options);
+
+    VideoProcessor *processor = job.processor;
+    int jobId = job.id;
+    connect(processor, &VideoProcessor::prepared, this, [this, processor]() {
+        Job *job = findJob(processor);
+        if (job && job->state == Extracting) {
+            processor->runStage(VideoProcessor::StageExtract);
+        }
+    });
+    connect(processor, &VideoProcessor::stageFinished, this,
+            [this, processor](VideoProcessor::Stage stage) {
+                handleStageFinished(processor, stage);
+            });
+    connect(processor, &VideoProcessor::errorOccurred, this,
+            [this, processor](const QString &error) {
+                handleJobError(processor, error);
+            });
+    connect(processor, &VideoProcessor::progressPercentageChanged, this,
+            [this, jobId](double percent) {
+                if (Job *job = findJob(jobId)) {
+                    job->percent = percent;
+                    emit jobProgress(jobId, percent, stateText(job->state));
+                }
+            });
+    connect(processor, &VideoProcessor::progressUpdated, this,
+            [this, jobId](const QString &message) {
+                if (Job *job = findJob(jobId)) {
+                    emit jobProgress(jobId, job->percent, message);
+                }
+            });
+    connect(processor, &VideoProcessor::workCompleted, m_enhanceController, &ConcurrencyController::addWork);
+}
+
+void VideoJobQueue::startStage(Job &job, VideoProcessor::Stage stage)
+{
+    static const JobState runningStates[] = {Extracting, Enhancing, Encoding};
+
+    job.percent = 0;
+    job.stageTimer.start();
+    setState(job, runningStates[stage]);
+    job.processor->runStage(stage);
+}
+
+void VideoJobQueue::handleStageFinished(VideoProcessor *processor, VideoProcessor::Stage stage)
+{
+    Job *job = findJob(processor);
+    if (!job) {
+        return;
+    }
+
+    job->stageMs[stage] = job->stageTimer.elapsed();
+
+    switch (stage) {
+    case VideoProcessor::StageExtract:
+        setState(*job, Extracted);
+        break;
+    case VideoProcessor::StageEnhance:
+        setState(*job, Enhanced);
+        break;
+    case VideoProcessor::StageRebuild:
+        job->outputPath = processor->outputPath();
+        job->report = processor->report();
+        job->percent = 100;
+        releaseProcessor(*job);
+        setState(*job, Finished);
+        break;
+    }
+
+    // 不在信号发射过程中重入调度
+    QMetaObject::invokeMethod(this, [this]() {
+        schedule();
+        checkQueueFinished();
+    }, Qt::QueuedConnection);
+}
+
+void VideoJobQueue::handleJobError(VideoProcessor *processor, const QString &error)
+{
+    Job *job = findJob(processor);
+    if (!job) {
+        return;
+    }
+
+    qWarning() << "Video job failed:" << job->inputPath << error;
+    job->error = error;
+    releaseProcessor(*job);
+    setState(*job, Failed);
+    emit jobFailed(job->id, error);
+
+    QMetaObject::invokeMethod(this, [this]() {
+        schedule();
+        checkQueueFinished();
+    }, Qt::QueuedConnection);
+}
+
+void VideoJobQueue::configureProcessor(VideoProcessor *processor, const JobOptions &options)
+{
+    processor->setStageControlled(true);
+    processor->setScaleTarget(options.scaleTarget, m_availableModels);
+    processor->setCropMode(options.cropMode);
+    processor->setEncodeSettings(options.encode);
+    processor->setKeepMaster(options.keepMaster);
+    processor->setTemporalReuse(options.temporalReuse);
+    processor->setProgressiveOutput(options.progressiveOutput);
+    PriorityScheduler::setPriority(processor, options.priority);
+    if (!m_realesrganPath.isEmpty()) {
+        processor->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+    }
+}
+
+void VideoJobQueue::releaseProcessor(Job &job)
+{
+    if (!job.processor) {
+        return;
+    }
+
+    VideoProcessor *processor = job.processor;
+    job.processor = nullptr;
+    disconnect(processor, nullptr, this, nullptr);
+    processor->cancelProcessing();
+    processor->deleteLater();
+}
+
+void VideoJobQueue::checkQueueFinished()
+{
+    if (!m_running) {
+        return;
+    }
+
+    int succeeded = 0;
+    int failed = 0;
+    qint64 stageTotals[3] = {0, 0, 0};
+    for (const Job &job : m_jobs) {
+        switch (job.state) {
+        case Finished:
+            ++succeeded;
+            break;
+        case Failed:
+        case Cancelled:
+            ++failed;
+            break;
+        default:
+            return;
+        }
+        for (int i = 0; i < 3; ++i) {
+            stageTotals[i] += job.stageMs[i];
+        }
+    }
+
+    m_running = false;
+
+    // 各阶段累计耗时之和与实际总耗时的差距即为流水线重叠带来的收益
+    qint64 elapsed = m_queueTimer.elapsed();
+    QString summary = QString("共 %1 个作业，成功 %2，失败 %3，总耗时 %4 秒（阶段累计：提取 %5 秒，增强 %6 秒，编码 %7 秒）")
+                          .arg(succeeded + failed)
+                          .arg(succeeded)
+                          .arg(failed)
+                          .arg(elapsed / 1000.0, 0, 'f', 1)
+                          .arg(stageTotals[0] / 1000.0, 0, 'f', 1)
+                          .arg(stageTotals[1] / 1000.0, 0, 'f', 1)
+                          .arg(stageTotals[2] / 1000.0, 0, 'f', 1);
+    if (m_adaptive) {
+        summary += "；" + m_enhanceController->summary();
+    }
+    qDebug() << "Video queue finished:" << summary;
+    emit queueFinished(succeeded, failed, summary);
+}
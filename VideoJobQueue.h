@@ -0,0 +1,127 @@
+#ifndef VIDEOJOBQUEUE_H
+#define VIDEOJOBQUEUE_H
+
+#include <QObject>
+#include <QList>
+#include <QElapsedTimer>
+#include "VideoProcessor.h"
+#include "PriorityScheduler.h"
+
+class ConcurrencyController;
+
+// 多视频作业队列：提取、增强、编码三个阶段各自限制并发，
+// 不同作业的阶段可以重叠执行（B 提取、A 编码的同时 C 在增强）
+class VideoJobQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum JobState {
+        Pending,
+        Extracting,
+        Extracted,
+        Enhancing,
+        Enhanced,
+        Encoding,
+        Finished,
+        Failed,
+        Cancelled
+    };
+    Q_ENUM(JobState)
+
+    // 每个作业的处理参数
+    struct JobOptions {
+        QString modelName;
+        int scaleFactor = 2;
+        QString outputFormat = "png";
+        ScaleTarget scaleTarget;
+        VideoProcessor::CropMode cropMode = VideoProcessor::CropOff;
+        VideoProcessor::EncodeSettings encode;
+        bool keepMaster = false;
+        bool temporalReuse = false;
+        bool progressiveOutput = false;
+        // 队列作业默认在后台运行，交互式作业运行期间让出资源；Normal 则不被抢占
+        PriorityScheduler::Priority priority = PriorityScheduler::Background;
+        // 非空时为从母版重新编码的作业，只经过编码阶段
+        QString masterPath;
+    };
+
+    struct Job {
+        int id = 0;
+        QString inputPath;
+        JobOptions options;
+        JobState state = Pending;
+        double percent = 0;
+        QString outputPath;
+        QString error;
+        QStringList report;
+        qint64 stageMs[3] = {0, 0, 0};
+        VideoProcessor *processor = nullptr;
+        QElapsedTimer stageTimer;
+    };
+
+    explicit VideoJobQueue(QObject *parent = nullptr);
+    ~VideoJobQueue();
+
+    void setExecutablePaths(const QString &realesrganPath, const QString &ffmpegPath, const QString &ffprobePath);
+    void setStageLimit(VideoProcessor::Stage stage, int limit);
+    int stageLimit(VideoProcessor::Stage stage) const;
+    // 开启后增强并发在 1 到设定上限之间按实测吞吐自动调整
+    void setAdaptiveConcurrency(bool enabled);
+    // 已提取但尚未开始增强的作业上限，避免提取跑得太快占满临时空间
+    void setMaxBufferedJobs(int count);
+
+    void setAvailableModels(const QStringList &models);
+    int addJob(const QString &inputPath, const JobOptions &options);
+    bool removeJob(int jobId);
+    void clearFinished();
+
+    void start();
+    void cancelAll();
+    bool isRunning() const { return m_running; }
+
+    const Job *job(int jobId) const;
+    QList<int> jobIds() const;
+
+    static QString stateText(JobState state);
+
+signals:
+    void jobAdded(int jobId);
+    void jobRemoved(int jobId);
+    void jobStateChanged(int jobId, VideoJobQueue::JobState state);
+    void jobProgress(int jobId, double percent, const QString &message);
+    void jobFailed(int jobId, const QString &error);
+    void queueFinished(int succeeded, int failed, const QString &summary);
+
+private:
+    Job *findJob(int jobId);
+    Job *findJob(VideoProcessor *processor);
+    int countInState(JobState state) const;
+    void setState(Job &job, JobState state);
+    void schedule();
+    int enhanceLimit() const;
+    void updateEnhanceDemand();
+    void startStage(Job &job, VideoProcessor::Stage stage);
+    void handleStageFinished(VideoProcessor *processor, VideoProcessor::Stage stage);
+    void handleJobError(VideoProcessor *processor, const QString &error);
+    void createProcessor(Job &job);
+    void configureProcessor(VideoProcessor *processor, const JobOptions &options);
+    void releaseProcessor(Job &job);
+    void checkQueueFinished();
+
+    QList<Job> m_jobs;
+    int m_nextJobId = 1;
+    int m_stageLimits[3] = {1, 1, 1};
+    int m_maxBufferedJobs = 2;
+    bool m_adaptive = false;
+    ConcurrencyController *m_enhanceController;
+    bool m_running = false;
+    QElapsedTimer m_queueTimer;
+
+    QString m_realesrganPath;
+    QString m_ffmpegPath;
+    QString m_ffprobePath;
+    QStringList m_availableModels;
+};
+
+#endif // VIDEOJOBQUEUE_H
@@ -1,13 +1,34 @@
 #include "VideoProcessor.h"
+#include "CropDetector.h"
+#include "UpscaleBackend.h"
+#include "MasterArchive.h"
+#include "ClusterCoordinator.h"
+#include "ProcessLauncher.h"
+#include "PriorityScheduler.h"
+#include "ProcessSupervisor.h"
+#include "ScratchManager.h"
+#include "TemporalTileProcessor.h"
+#include "ProgressiveEncoder.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QDateTime>
+#include <QHash>
 #include <QRegularExpression>
 #include <QDesktopServices>
 #include <QApplication>
+#include <QLocale>
+#include <algorithm>
+
+namespace {
+// 元数据探测的超时，超时后按默认帧率继续
+const int kMetadataTimeoutMs = 5000;
+
+// 同时处于增强阶段的作业数，写入吞吐记录用于区分独占和共享 GPU 时的速度
+int s_enhancingJobs = 0;
+}
 
 VideoProcessor::VideoProcessor(QObject *parent) : QObject(parent),
-    m_realesrganProcess(nullptr),
+    m_upscaleTask(nullptr),
     m_ffmpegProcess(nullptr),
     m_ffprobeProcess(nullptr),
     m_totalFrames(0),
@@ -28,7 +49,9 @@ VideoProcessor::VideoProcessor(QObject *parent) : QObject(parent),
 
 VideoProcessor::~VideoProcessor()
 {
+    m_ioPool.waitForDone();
     cancelProcessing();
+    setEnhancing(false);
     cleanupTempFiles();
 }
 
@@ -42,6 +65,145 @@ void VideoProcessor::setExecutablePaths(const QString &realesrganPath, const QSt
 void VideoProcessor::processVideo(const QString &inputPath, const QString &modelName,
                                   int scaleFactor, const QString &outputFormat,
                                   bool openOutputDirectory)
+{
+    // 非分阶段模式下 prepare 完成后自动进入提取
+    prepare(inputPath, modelName, scaleFactor, outputFormat, openOutputDirectory);
+}
+
+void VideoProcessor::setScaleTarget(const ScaleTarget &target, const QStringList &availableModels)
+{
+    m_scaleTarget = target;
+    m_availableModels = availableModels;
+}
+
+void VideoProcessor::setCropMode(CropMode mode)
+{
+    m_cropMode = mode;
+}
+
+void VideoProcessor::setTemporalReuse(bool enabled)
+{
+    m_temporalReuse = enabled;
+}
+
+void VideoProcessor::setProgressiveOutput(bool enabled)
+{
+    m_progressiveOutput = enabled;
+}
+
+void VideoProcessor::setStageControlled(bool controlled)
+{
+    m_stageControlled = controlled;
+}
+
+void VideoProcessor::setEncodeSettings(const EncodeSettings &settings)
+{
+    m_encodeSettings = settings;
+}
+
+void VideoProcessor::setKeepMaster(bool keep)
+{
+    m_keepMaster = keep;
+}
+
+bool VideoProcessor::prepareReencode(const QString &masterPath, const QString &inputPath,
+                                     bool openOutputDirectory)
+{
+    m_options.inputPath = inputPath;
+    m_options.openOutputDirectory = openOutputDirectory;
+    m_cancelled = false;
+    m_outputPath.clear();
+    m_report.clear();
+    ProcessSupervisor::takeFinished(this);
+    cleanupTempFiles();
+    m_pendingMasterPath.clear();
+
+    if (!QFileInfo::exists(masterPath)) {
+        emit errorOccurred(QString("母版文件不存在: %1").arg(masterPath));
+        return false;
+    }
+    m_masterSource = masterPath;
+    return true;
+}
+
+void VideoProcessor::reencodeFromMaster(const QString &masterPath, const QString &inputPath,
+                                        bool openOutputDirectory)
+{
+    if (!prepareReencode(masterPath, inputPath, openOutputDirectory)) {
+        return;
+    }
+
+    runStage(StageRebuild);
+}
+
+void VideoProcessor::setOutputTag(const QString &tag)
+{
+    m_outputTag = tag;
+}
+
+void VideoProcessor::setSegment(double startSec, int frameCount, const QString &outputPath)
+{
+    m_segmentStart = qMax(0.0, startSec);
+    m_segmentFrames = qMax(0, frameCount);
+    m_segmentOutput = outputPath;
+}
+
+bool VideoProcessor::prepareShared(const VideoProcessor *source, const QString &modelName, int scaleFactor,
+                                   const QString &outputFormat)
+{
+    m_options.inputPath = source->m_options.inputPath;
+    m_options.modelName = modelName;
+    m_options.scaleFactor = scaleFactor;
+    m_options.outputFormat = outputFormat;
+    m_options.openOutputDirectory = false;
+    m_cancelled = false;
+    m_outputPath.clear();
+    m_report.clear();
+    ProcessSupervisor::takeFinished(this);
+    m_cropChecked = true;
+    m_cropRect = QRect();
+    m_masterSource.clear();
+    m_pendingMasterPath.clear();
+    std::fill(std::begin(m_stageMs), std::end(m_stageMs), 0);
+
+    m_fps = source->m_fps;
+    m_inputSize = source->m_inputSize;
+    m_durationSec = source->m_durationSec;
+    m_totalFrames = source->m_totalFrames;
+    if (source->m_scalePlan.needsPreScale() || !source->m_cropRect.isNull()) {
+        emit errorOccurred("共享的帧经过了裁剪或预缩放，无法用于其他方案");
+        return false;
+    }
+
+    // 帧已经抽好，方案不能再要求预缩放
+    ScalePlanner planner(m_availableModels);
+    m_scalePlan = planner.plan(m_inputSize, m_scaleTarget, modelName);
+    if (!m_scalePlan.valid || m_scalePlan.needsPreScale()) {
+        m_scalePlan = ScalePlan();
+        m_scalePlan.passes << ScalePass{modelName, scaleFactor};
+    } else {
+        m_scalePlan.targetSize = QSize(m_scalePlan.targetSize.width() & ~1,
+                                       m_scalePlan.targetSize.height() & ~1);
+    }
+    qDebug() << "Scale plan (shared frames):" << m_scalePlan.summary();
+
+    m_sharedFrames = true;
+    cleanupTempFiles();
+    m_tempDir = createTempDirectory();
+    if (m_tempDir.isEmpty()) {
+        return false;
+    }
+    m_frameDir = source->m_frameDir;
+    m_enhancedDir = QDir(m_tempDir).filePath("enhanced");
+    QDir().mkpath(m_enhancedDir);
+
+    m_estimate = ThroughputLedger::predict(jobProfile());
+    return true;
+}
+
+void VideoProcessor::prepare(const QString &inputPath, const QString &modelName,
+                             int scaleFactor, const QString &outputFormat,
+                             bool openOutputDirectory)
 {
     m_options.inputPath = inputPath;
     m_options.modelName = modelName;
@@ -49,34 +211,198 @@ void VideoProcessor::processVideo(const QString &inputPath, const QString &model
     m_options.outputFormat = outputFormat;
     m_options.openOutputDirectory = openOutputDirectory;
     m_cancelled = false;
+    m_outputPath.clear();
+    m_report.clear();
+    ProcessSupervisor::takeFinished(this);
+    m_cropChecked = false;
+    m_cropRect = QRect();
+    m_masterSource.clear();
+    m_pendingMasterPath.clear();
+    m_totalFrames = 0;
+    std::fill(std::begin(m_stageMs), std::end(m_stageMs), 0);
+    m_sharedFrames = false;
+
+    emit progressUpdated("正在提取视频元数据...");
+    probeMetadata();
+}
+
+void VideoProcessor::probeMetadata()
+{
+    if (m_ffprobeProcess) {
+        m_ffprobeProcess->deleteLater();
+    }
+
+    m_ffprobeProcess = new QProcess(this);
+    QProcess *process = m_ffprobeProcess;
+    m_inputSize = QSize();
+    m_durationSec = 0;
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this, process](int, QProcess::ExitStatus exitStatus) {
+                handleMetadataProbed(process, exitStatus == QProcess::NormalExit);
+            });
+    // 启动失败时不会有 finished，按探测超时处理
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            handleMetadataProbed(process, false);
+        }
+    });
+    ProcessLauncher::start(process, m_ffprobePath,
+                           QStringList() << "-v" << "error"
+                                         << "-select_streams" << "v:0"
+                                         << "-show_entries" << "stream=width,height,r_frame_rate:format=duration"
+                                         << "-of" << "default=noprint_wrappers=1"
+                                         << m_options.inputPath,
+                           ProcessLauncher::Utility);
+    QTimer::singleShot(kMetadataTimeoutMs, process, [process]() {
+        ProcessSupervisor::stop(process);
+    });
+}
 
-    // 创建临时目录
+void VideoProcessor::handleMetadataProbed(QProcess *process, bool completed)
+{
+    if (process != m_ffprobeProcess) {
+        return;
+    }
+    m_ffprobeProcess = nullptr;
+    process->deleteLater();
+    if (m_cancelled) {
+        return;
+    }
+
+    QString rate;
+    if (completed) {
+        QString output = ProcessSupervisor::attach(process)->tail();
+        for (const QString &line : output.split('\n', Qt::SkipEmptyParts)) {
+            QString key = line.section('=', 0, 0).trimmed();
+            QString value = line.section('=', 1).trimmed();
+            if (key == "width") {
+                m_inputSize.setWidth(value.toInt());
+            } else if (key == "height") {
+                m_inputSize.setHeight(value.toInt());
+            } else if (key == "r_frame_rate") {
+                rate = value;
+            } else if (key == "duration") {
+                m_durationSec = value.toDouble();
+            }
+        }
+    }
+    m_fps = parseFrameRate(rate); // 超时或无法解析时为默认帧率
+
+    if (m_fps.isEmpty()) {
+        emit errorOccurred("无法获取视频帧率信息");
+        return;
+    }
+    if (m_segmentFrames > 0) {
+        // 临时空间和耗时都只按片段估算
+        m_durationSec = m_segmentFrames / m_fps.toDouble();
+    }
+
+    ScalePlanner planner(m_availableModels);
+    m_scalePlan = planner.plan(m_inputSize, m_scaleTarget, m_options.modelName);
+    if (!m_scalePlan.valid) {
+        m_scalePlan = ScalePlan();
+        m_scalePlan.passes << ScalePass{m_options.modelName, m_options.scaleFactor};
+    } else {
+        // yuv420p 编码要求宽高为偶数
+        m_scalePlan.targetSize = QSize(m_scalePlan.targetSize.width() & ~1,
+                                       m_scalePlan.targetSize.height() & ~1);
+        emit progressUpdated(QString("缩放方案: %1").arg(m_scalePlan.summary()));
+    }
+    qDebug() << "Scale plan:" << m_scalePlan.summary();
+
+    // 临时目录按方案估算大小后再分配，放得下时可以用内存盘
+    cleanupTempFiles();
     m_tempDir = createTempDirectory();
+    if (m_tempDir.isEmpty()) {
+        return;
+    }
     m_frameDir = QDir(m_tempDir).filePath("frames");
     m_enhancedDir = QDir(m_tempDir).filePath("enhanced");
 
     QDir().mkpath(m_frameDir);
     QDir().mkpath(m_enhancedDir);
 
-    executePipeline();
+    m_estimate = ThroughputLedger::predict(jobProfile());
+    if (m_estimate.isValid()) {
+        emit progressUpdated(m_estimate.summary());
+    }
+
+    if (m_stageControlled) {
+        emit prepared();
+    } else {
+        runStage(StageExtract);
+    }
+}
+
+void VideoProcessor::runStage(Stage stage)
+{
+    if (m_cancelled) {
+        return;
+    }
+
+    m_currentStage = stage;
+    m_stageTimer.start();
+    switch (stage) {
+    case StageExtract:
+        if (m_cropMode != CropOff && !m_cropChecked && m_scalePlan.valid && m_durationSec > 0) {
+            detectCrop();
+        } else {
+            extractVideoFrames();
+        }
+        break;
+    case StageEnhance:
+        setEnhancing(true);
+        m_passIndex = 0;
+        if (m_progressiveOutput && m_masterSource.isEmpty()) {
+            // 时域复用的帧要等全部放大完、合成后才生成，边增强边编码没有意义
+            if (m_temporalReuse) {
+                m_report << "时域复用开启时增强帧在合成后才生成，渐进输出未启用";
+            } else {
+                startProgressiveEncode();
+            }
+        }
+        if (m_temporalReuse) {
+            analyzeTemporal();
+        } else {
+            enhanceFrames();
+        }
+        break;
+    case StageRebuild:
+        if (m_progressive && m_progressive->isRunning()) {
+            // 编码一直在跟着增强进行，这里只需送完剩余的帧
+            emit progressUpdated("正在完成渐进输出...");
+            m_progressive->finishInput(m_totalFrames);
+        } else {
+            rebuildVideo();
+        }
+        break;
+    }
 }
 
 void VideoProcessor::cancelProcessing()
 {
     m_cancelled = true;
+    setEnhancing(false);
+
+    if (m_upscaleTask) {
+        m_upscaleTask->cancel();
+    }
+
+    // 先请求退出，宽限期后再强制结束，不在界面线程上等待
+    ProcessSupervisor::stop(m_ffmpegProcess);
+    ProcessSupervisor::stop(m_ffprobeProcess);
 
-    if (m_realesrganProcess && m_realesrganProcess->state() == QProcess::Running) {
-        m_realesrganProcess->terminate();
-        m_realesrganProcess->waitForFinished(1000);
-        m_realesrganProcess->kill();
+    if (m_cropDetector) {
+        m_cropDetector->cancel();
     }
 
-    if (m_ffmpegProcess && m_ffmpegProcess->state() == QProcess::Running) {
-        m_ffmpegProcess->kill();
+    if (m_temporal) {
+        m_temporal->cancel();
     }
 
-    if (m_ffprobeProcess && m_ffprobeProcess->state() == QProcess::Running) {
-        m_ffprobeProcess->kill();
+    // 渐进输出不强制结束，让 ffmpeg 写完已收到的帧，留下可播放的前半段
+    if (m_progressive) {
+        m_progressive->stop();
     }
 
     if (m_progressTimer) {
@@ -86,19 +412,57 @@ void VideoProcessor::cancelProcessing()
     }
 }
 
-void VideoProcessor::executePipeline()
+void VideoProcessor::detectCrop()
 {
-    emit progressUpdated("正在提取视频元数据...");
-    m_fps = getVideoMetadata();
+    emit progressUpdated("正在检测黑边...");
 
-    if (m_fps.isEmpty()) {
-        emit errorOccurred("无法获取视频帧率信息");
+    if (!m_cropDetector) {
+        m_cropDetector = new CropDetector(this);
+        connect(m_cropDetector, &CropDetector::finished, this, &VideoProcessor::handleCropDetected);
+    }
+    m_cropDetector->setFfmpegPath(m_ffmpegPath);
+    m_cropDetector->detect(m_options.inputPath, m_inputSize, m_durationSec);
+}
+
+void VideoProcessor::handleCropDetected(const QRect &activeRect, const QString &message)
+{
+    m_cropChecked = true;
+    if (m_cancelled) {
         return;
     }
 
+    emit progressUpdated(message);
+    m_report << message;
+    if (!activeRect.isNull()) {
+        applyCrop(activeRect);
+    }
+
     extractVideoFrames();
 }
 
+void VideoProcessor::applyCrop(const QRect &activeRect)
+{
+    // 整帧方案决定缩放比例，裁剪区域按同样的比例重新规划
+    m_fullTargetSize = m_scalePlan.targetSize;
+    double scaleX = double(m_fullTargetSize.width()) / m_inputSize.width();
+    double scaleY = double(m_fullTargetSize.height()) / m_inputSize.height();
+
+    ScaleTarget cropTarget = m_scaleTarget;
+    cropTarget.mode = ScaleTarget::Size;
+    cropTarget.size = QSize(qRound(activeRect.width() * scaleX) & ~1,
+                            qRound(activeRect.height() * scaleY) & ~1);
+
+    ScalePlanner planner(m_availableModels);
+    ScalePlan plan = planner.plan(activeRect.size(), cropTarget, m_options.modelName);
+    if (!plan.valid) {
+        return;
+    }
+
+    m_cropRect = activeRect;
+    m_scalePlan = plan;
+    emit progressUpdated(QString("缩放方案: %1").arg(m_scalePlan.summary()));
+}
+
 void VideoProcessor::extractVideoFrames()
 {
     emit progressUpdated("正在提取视频帧...");
@@ -108,54 +472,142 @@ void VideoProcessor::extractVideoFrames()
     }
 
     m_ffmpegProcess = new QProcess(this);
-    connect(m_ffmpegProcess, &QProcess::readyReadStandardOutput, this, &VideoProcessor::handleFfmpegOutput);
     connect(m_ffmpegProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
             this, &VideoProcessor::handleFfmpegFinished);
 
     QStringList args;
+    if (m_segmentFrames > 0) {
+        // 转码时输入端定位是精确的：从前一个关键帧解码，丢弃起点之前的帧
+        args << "-ss" << QString::number(m_segmentStart, 'f', 6);
+    }
     args << "-i" << m_options.inputPath
          << "-qscale:v" << "1"
          << "-qmin" << "1"
          << "-qmax" << "1"
-         << "-vsync" << "0"
-         << QDir(m_frameDir).filePath("frame%08d.png");
+         << "-vsync" << "0";
 
-    m_ffmpegProcess->start(m_ffmpegPath, args);
+    QStringList filters;
+    if (!m_cropRect.isNull()) {
+        filters << QString("crop=%1:%2:%3:%4")
+                       .arg(m_cropRect.width()).arg(m_cropRect.height())
+                       .arg(m_cropRect.x()).arg(m_cropRect.y());
+    }
+    if (m_scalePlan.needsPreScale()) {
+        filters << QString("scale=%1:%2:flags=lanczos")
+                       .arg(m_scalePlan.preScaledSize.width())
+                       .arg(m_scalePlan.preScaledSize.height());
+    }
+    if (!filters.isEmpty()) {
+        args << "-vf" << filters.join(",");
+    }
+    if (m_segmentFrames > 0) {
+        args << "-frames:v" << QString::number(m_segmentFrames);
+    }
+    args << QDir(m_frameDir).filePath("frame%08d.png");
+
+    ProcessLauncher::start(m_ffmpegProcess, m_ffmpegPath, args, ProcessLauncher::Utility);
+}
+
+void VideoProcessor::analyzeTemporal()
+{
+    emit progressUpdated("正在分析帧间变化...");
+
+    if (!m_temporal) {
+        m_temporal = new TemporalTileProcessor(this);
+        connect(m_temporal, &TemporalTileProcessor::progress, this, [this](int done, int total) {
+            emit progressPercentageChanged(done * 100.0 / qMax(1, total));
+        });
+        connect(m_temporal, &TemporalTileProcessor::analyzed, this, [this](bool ok, const QString &error) {
+            if (m_cancelled) {
+                return;
+            }
+            if (!ok) {
+                emit errorOccurred(QString("帧间分析失败: %1").arg(error));
+                return;
+            }
+            const TemporalTileProcessor::Stats &stats = m_temporal->stats();
+            emit progressUpdated(QString("%1 帧中 %2 帧需整帧放大，可复用 %3% 的分块")
+                                     .arg(stats.frames)
+                                     .arg(stats.fullFrames)
+                                     .arg(stats.reusedRatio() * 100, 0, 'f', 1));
+            enhanceFrames();
+        });
+        connect(m_temporal, &TemporalTileProcessor::composited, this, [this](bool ok, const QString &error) {
+            if (m_cancelled) {
+                return;
+            }
+            if (!ok) {
+                emit errorOccurred(QString("合成增强帧失败: %1").arg(error));
+                return;
+            }
+            ScratchManager::removeAsync(passOutputDir(m_scalePlan.passes.size() - 1));
+            ScratchManager::removeAsync(temporalTileDir());
+            const TemporalTileProcessor::Stats &stats = m_temporal->stats();
+            m_report << stats.summary(m_stageTimer.elapsed() - stats.analysisMs - stats.compositeMs);
+            finishEnhance();
+        });
+    }
+
+    QString tileDir = temporalTileDir();
+    QDir().mkpath(tileDir);
+    m_temporal->analyze(m_frameDir, tileDir);
+}
+
+QString VideoProcessor::temporalTileDir() const
+{
+    return QDir(m_tempDir).filePath("tiles");
 }
 
 void VideoProcessor::enhanceFrames() {
-    emit progressUpdated("正在增强视频帧...");
+    int passCount = m_scalePlan.passes.size();
+    if (passCount > 1) {
+        emit progressUpdated(QString("正在增强视频帧（第 %1/%2 遍）...").arg(m_passIndex + 1).arg(passCount));
+    } else {
+        emit progressUpdated("正在增强视频帧...");
+    }
+
+    // 多遍串联时中间结果统一使用 PNG
+    bool lastPass = m_passIndex + 1 >= passCount;
+    QString firstInput = m_temporalReuse ? temporalTileDir() : m_frameDir;
+    QString inputDir = m_passIndex == 0 ? firstInput : passOutputDir(m_passIndex - 1);
+    m_passOutputDir = passOutputDir(m_passIndex);
+    m_passOutputFormat = lastPass && !m_temporalReuse ? m_options.outputFormat : "png";
+    QDir().mkpath(m_passOutputDir);
+    const ScalePass &pass = m_scalePlan.passes.at(m_passIndex);
 
     // 重置状态
     m_processingCompleted = false;
-    m_lastProgressTime = QDateTime::currentDateTime();
 
-    // 清理旧进程
-    if (m_realesrganProcess) {
-        m_realesrganProcess->deleteLater();
+    // 清理旧任务
+    if (m_upscaleTask) {
+        m_upscaleTask->deleteLater();
     }
 
-    // 初始化新进程
-    m_realesrganProcess = new QProcess(this);
-    connect(m_realesrganProcess, &QProcess::readyReadStandardOutput,
-            this, &VideoProcessor::handleRealesrganOutput);
-    connect(m_realesrganProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &VideoProcessor::handleRealesrganFinished);
+    UpscaleRequest request;
+    request.inputPath = inputDir;
+    request.outputPath = m_passOutputDir;
+    request.modelName = pass.modelName;
+    request.scale = pass.scale;
+    request.outputFormat = m_passOutputFormat;
+    request.executablePath = m_realesrganPath;
 
-    // 准备参数
-    QStringList args;
-    args << "-i" << m_frameDir
-         << "-o" << m_enhancedDir
-         << "-n" << m_options.modelName
-         << "-s" << QString::number(m_options.scaleFactor)
-         << "-f" << m_options.outputFormat;
-
-    m_realesrganProcess->start(m_realesrganPath, args);
+    // 进度由下面的定时器统计输出目录的帧数
+    m_upscaleTask = UpscaleBackend::defaultBackend()->createTask(request, this);
+    connect(m_upscaleTask, &UpscaleTask::finished, this, &VideoProcessor::handleUpscaleFinished);
+    m_upscaleTask->start();
 
     // 初始化帧数监控
-    m_totalFrames = QDir(m_frameDir).entryList({"*.png"}, QDir::Files).count();
+    m_passInputCount = QDir(inputDir).entryList({"*.png"}, QDir::Files).count();
     m_processedFrames = 0;
 
+    // 第一帧之前要加载模型，CPU 推理更慢；有历史记录时按预计单帧耗时放宽
+    qint64 firstFrameMs = UpscaleBackend::defaultKind() == UpscaleBackend::CliBackend ? 120000 : 600000;
+    if (m_estimate.samples[ThroughputRecord::Enhance] > 0 && m_totalFrames > 0) {
+        qint64 perFrameMs = m_estimate.stageMs[ThroughputRecord::Enhance] / (m_totalFrames * passCount);
+        firstFrameMs = qMax(firstFrameMs, 20 * perFrameMs);
+    }
+    m_stall.start(firstFrameMs, PriorityScheduler::priorityOf(this) == PriorityScheduler::Background);
+
     // 清理旧定时器
     if (m_progressTimer) {
         m_progressTimer->stop();
@@ -168,29 +620,34 @@ void VideoProcessor::enhanceFrames() {
         if (m_cancelled || m_processingCompleted) return;
 
         // 获取当前已处理帧数
-        int newCount = QDir(m_enhancedDir)
-                           .entryList({"*." + m_options.outputFormat}, QDir::Files)
+        int newCount = QDir(m_passOutputDir)
+                           .entryList({"*." + m_passOutputFormat}, QDir::Files)
                            .count();
 
         // 更新进度
         if (newCount > m_processedFrames) {
+            double frameMegapixels = m_inputSize.isEmpty() ? 1.0 : m_inputSize.width() * double(m_inputSize.height()) / 1e6;
+            emit workCompleted((newCount - m_processedFrames) * frameMegapixels);
             m_processedFrames = newCount;
-            m_lastProgressTime = QDateTime::currentDateTime();
-            updateProgress(m_processedFrames, m_totalFrames);
+            m_stall.progress(newCount);
+            updateProgress(m_processedFrames, m_passInputCount);
         }
 
         // 检查是否完成
-        if (m_processedFrames >= m_totalFrames) {
+        if (m_processedFrames >= m_passInputCount) {
             m_progressTimer->stop();
             m_processingCompleted = true;
             return;
         }
 
-        // 超时检测（30秒）
-        if (m_lastProgressTime.secsTo(QDateTime::currentDateTime()) > 30) {
-            emit errorOccurred("处理超时，30秒内无新进度");
+        // 超时阈值随实测单帧耗时调整
+        if (m_stall.isStalled()) {
+            QString message = QString("处理超时，%1 秒内无新进度").arg(m_stall.idleMs() / 1000);
+            if (m_stall.averageUnitMs() > 0) {
+                message += QString("（此前平均每帧 %1 秒）").arg(m_stall.averageUnitMs() / 1000.0, 0, 'f', 1);
+            }
             cancelProcessing();
-            m_progressTimer->stop();
+            emit errorOccurred(message);
         }
     });
 
@@ -198,6 +655,74 @@ void VideoProcessor::enhanceFrames() {
 }
 
 
+void VideoProcessor::startProgressiveEncode()
+{
+    if (!m_progressive) {
+        m_progressive = new ProgressiveEncoder(this);
+        connect(m_progressive, &ProgressiveEncoder::framesWrittenChanged, this, [this](int frames) {
+            if (m_currentStage == StageRebuild && m_totalFrames > 0) {
+                emit progressPercentageChanged(frames * 100.0 / m_totalFrames);
+            }
+        });
+        connect(m_progressive, &ProgressiveEncoder::finished, this, [this](bool ok, const QString &error) {
+            if (m_cancelled) {
+                // 中止的作业保留已写出的部分，母版不完整则丢弃
+                if (!m_pendingMasterPath.isEmpty()) {
+                    QFile::remove(m_pendingMasterPath);
+                    m_pendingMasterPath.clear();
+                }
+                if (ok && m_progressive->framesWritten() > 0) {
+                    emit progressUpdated(QString("已中止，前 %1 帧已写入 %2，可直接播放")
+                                             .arg(m_progressive->framesWritten())
+                                             .arg(m_outputPath));
+                }
+                return;
+            }
+            if (!ok) {
+                if (!m_pendingMasterPath.isEmpty()) {
+                    QFile::remove(m_pendingMasterPath);
+                    m_pendingMasterPath.clear();
+                }
+                cancelProcessing();
+                emit errorOccurred(error);
+                return;
+            }
+            if (m_currentStage != StageRebuild) {
+                // 没有送完全部帧就退出了，交给常规编码重新生成
+                qWarning() << "Progressive encoder exited early, falling back to full rebuild";
+                return;
+            }
+            if (m_progressive->firstFragmentMs() >= 0) {
+                m_report << QString("渐进输出：开始增强后 %1 输出文件即可打开观看")
+                                .arg(ThroughputLedger::formatDuration(m_progressive->firstFragmentMs()));
+            }
+            finishJob();
+        });
+    }
+
+    m_outputPath = generateOutputPath();
+    m_pendingMasterPath.clear();
+
+    // 输出文件边写边看：MP4/MOV 用分片封装，约 2 秒一个关键帧即一个分片
+    QStringList args;
+    args << "-y" << ProgressiveEncoder::pipeInputArgs(m_options.outputFormat, m_fps)
+         << "-i" << m_options.inputPath
+         << "-map" << "0:v:0"
+         << "-map" << "1:a:0?";
+    QStringList filters = videoFilters();
+    if (!filters.isEmpty()) {
+        args << "-vf" << filters.join(",");
+    }
+    appendEncoderArgs(args);
+    args << ProgressiveEncoder::fragmentArgs(m_encodeSettings.container, qMax(1, qRound(2 * m_fps.toDouble())))
+         << "-shortest"
+         << m_outputPath;
+    appendMasterArgs(args, filters);
+
+    m_progressive->start(m_ffmpegPath, args, m_enhancedDir, m_options.outputFormat, m_outputPath);
+    emit progressUpdated(QString("渐进输出到 %1，处理过程中即可打开观看").arg(m_outputPath));
+}
+
 void VideoProcessor::rebuildVideo() {
     emit progressUpdated("正在合并视频...");
 
@@ -206,75 +731,192 @@ void VideoProcessor::rebuildVideo() {
     }
 
     m_ffmpegProcess = new QProcess(this);
-    connect(m_ffmpegProcess, &QProcess::readyReadStandardOutput, this, &VideoProcessor::handleFfmpegOutput);
     connect(m_ffmpegProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
             this, &VideoProcessor::handleFfmpegFinished);
 
     m_outputPath = generateOutputPath();
+    m_pendingMasterPath.clear();
 
     QStringList args;
+    if (!m_masterSource.isEmpty()) {
+        // 母版已经是最终画面（含缩放和补边），直接转码
+        emit progressUpdated("正在从母版重新编码...");
+        args << "-y"
+             << "-i" << m_masterSource
+             << "-map" << "0:v:0"
+             << "-map" << "0:a?";
+        appendEncoderArgs(args);
+        args << m_outputPath;
+        qDebug() << "FFmpeg command:" << m_ffmpegPath << args;
+        ProcessLauncher::start(m_ffmpegProcess, m_ffmpegPath, args, ProcessLauncher::Encoder);
+        return;
+    }
+
+    if (m_segmentFrames > 0) {
+        // 片段只含画面，音轨在拼接时从原输出整条复制
+        args << "-y"
+             << "-r" << m_fps
+             << "-i" << QDir(m_enhancedDir).filePath("frame%08d." + m_options.outputFormat)
+             << "-map" << "0:v:0";
+        QStringList filters = videoFilters();
+        if (!filters.isEmpty()) {
+            args << "-vf" << filters.join(",");
+        }
+        appendEncoderArgs(args);
+        args << "-an" << m_outputPath;
+        qDebug() << "FFmpeg command:" << m_ffmpegPath << args;
+        ProcessLauncher::start(m_ffmpegProcess, m_ffmpegPath, args, ProcessLauncher::Encoder);
+        return;
+    }
+
     args << "-y"
          << "-r" << m_fps
          << "-i" << QDir(m_enhancedDir).filePath("frame%08d." + m_options.outputFormat)
          << "-i" << m_options.inputPath
          << "-map" << "0:v:0"
-         << "-map" << "1:a:0?"
-         << "-c:a" << "copy";
-
-    // 检测 libx264
-    QProcess encoderCheck;
-    encoderCheck.start(m_ffmpegPath, QStringList() << "-encoders");
-    encoderCheck.waitForFinished();
-    QString encoderOutput = QString::fromUtf8(encoderCheck.readAllStandardOutput());
-    bool hasLibx264 = encoderOutput.contains("libx264");
-
-    if (hasLibx264) {
-        args << "-c:v" << "libx264"
-             << "-pix_fmt" << "yuv420p";
-    } else {
-        qWarning() << "libx264 not available, falling back to mpeg4";
-        args << "-c:v" << "mpeg4"
-             << "-q:v" << "2";
-    }
+         << "-map" << "1:a:0?";
 
+    QStringList filters = videoFilters();
+    if (!filters.isEmpty()) {
+        args << "-vf" << filters.join(",");
+    }
+    appendEncoderArgs(args);
     args << m_outputPath;
+    appendMasterArgs(args, filters);
+
     qDebug() << "FFmpeg command:" << m_ffmpegPath << args;
-    m_ffmpegProcess->start(m_ffmpegPath, args);
+    ProcessLauncher::start(m_ffmpegProcess, m_ffmpegPath, args, ProcessLauncher::Encoder);
 }
 
+QStringList VideoProcessor::videoFilters() const
+{
+    QStringList filters;
+    if (m_scalePlan.needsFinalResample()) {
+        filters << QString("scale=%1:%2:flags=lanczos")
+                       .arg(m_scalePlan.targetSize.width())
+                       .arg(m_scalePlan.targetSize.height());
+    }
+    if (!m_cropRect.isNull() && m_cropMode == CropPadBack) {
+        // 按原始画面比例补回黑边
+        const QSize &active = m_scalePlan.targetSize;
+        int padX = qRound(m_cropRect.x() * double(m_fullTargetSize.width()) / m_inputSize.width()) & ~1;
+        int padY = qRound(m_cropRect.y() * double(m_fullTargetSize.height()) / m_inputSize.height()) & ~1;
+        padX = qBound(0, padX, m_fullTargetSize.width() - active.width());
+        padY = qBound(0, padY, m_fullTargetSize.height() - active.height());
+        filters << QString("pad=%1:%2:%3:%4:black")
+                       .arg(m_fullTargetSize.width()).arg(m_fullTargetSize.height())
+                       .arg(padX).arg(padY);
+    }
+    return filters;
+}
 
-void VideoProcessor::cleanupTempFiles()
+void VideoProcessor::appendMasterArgs(QStringList &args, const QStringList &filters)
 {
-    if (!m_tempDir.isEmpty() && QDir(m_tempDir).exists()) {
-        QDir(m_tempDir).removeRecursively();
+    // 同一次解码再输出一份 FFV1 无损母版，每帧独立编码便于随机定位
+    if (m_keepMaster) {
+        QDir().mkpath(MasterArchive::directory());
+        QString key = MasterArchive::keyFor(m_options.inputPath, m_options.modelName,
+                                            MasterArchive::settingsFor(m_scaleTarget, m_cropMode));
+        m_pendingMasterPath = MasterArchive::masterPathFor(key) + ".partial";
+        args << "-map" << "0:v:0"
+             << "-map" << "1:a:0?"
+             << "-c:a" << "copy";
+        if (!filters.isEmpty()) {
+            args << "-vf" << filters.join(",");
+        }
+        args << "-c:v" << "ffv1"
+             << "-level" << "3"
+             << "-g" << "1"
+             << "-slices" << "16"
+             << "-slicecrc" << "1"
+             << "-f" << "matroska"
+             << m_pendingMasterPath;
     }
 }
 
-QString VideoProcessor::getVideoMetadata()
+void VideoProcessor::appendEncoderArgs(QStringList &args)
 {
-    if (m_ffprobeProcess) {
-        m_ffprobeProcess->deleteLater();
+    QString codec = m_encodeSettings.videoCodec;
+    if (codec.isEmpty()) {
+        // 检测 libx264，每个 ffmpeg 只检测一次
+        static QHash<QString, QString> detectedCodecs;
+        codec = detectedCodecs.value(m_ffmpegPath);
+        if (codec.isEmpty()) {
+            QProcess encoderCheck;
+            ProcessLauncher::start(&encoderCheck, m_ffmpegPath, QStringList() << "-encoders", ProcessLauncher::Utility);
+            encoderCheck.waitForFinished();
+            QString encoderOutput = ProcessSupervisor::attach(&encoderCheck)->tail();
+            codec = encoderOutput.contains("libx264") ? "libx264" : "mpeg4";
+            if (codec == "mpeg4") {
+                qWarning() << "libx264 not available, falling back to mpeg4";
+            }
+            detectedCodecs.insert(m_ffmpegPath, codec);
+        }
     }
 
-    m_ffprobeProcess = new QProcess(this);
-    m_ffprobeProcess->start(m_ffprobePath, QStringList()
-                                               << "-v" << "error"
-                                               << "-select_streams" << "v:0"
-                                               << "-show_entries" << "stream=r_frame_rate"
-                                               << "-of" << "default=noprint_wrappers=1:nokey=1"
-                                               << m_options.inputPath);
+    args << "-c:v" << codec;
+    QString pixelFormat = m_encodeSettings.pixelFormat;
+    if (codec == "mpeg4") {
+        if (m_encodeSettings.bitrate.isEmpty()) {
+            args << "-q:v" << "2";
+        }
+    } else if (pixelFormat.isEmpty()) {
+        pixelFormat = codec.startsWith("prores") ? "yuv422p10le" : "yuv420p";
+    }
+    if (!pixelFormat.isEmpty()) {
+        args << "-pix_fmt" << pixelFormat;
+    }
+
+    if (!m_encodeSettings.bitrate.isEmpty()) {
+        args << "-b:v" << m_encodeSettings.bitrate;
+    } else if (m_encodeSettings.crf >= 0 && codec != "mpeg4") {
+        args << "-crf" << QString::number(m_encodeSettings.crf);
+    }
+
+    // WebM 只接受 Opus/Vorbis 音频，其余封装直接复制原音轨
+    args << "-c:a" << (m_encodeSettings.container == "webm" ? "libopus" : "copy");
+}
 
-    if (!m_ffprobeProcess->waitForFinished(5000)) {
-        return "30"; // 默认帧率
+void VideoProcessor::finalizeMaster()
+{
+    if (m_pendingMasterPath.isEmpty()) {
+        return;
     }
 
-    QString output = QString::fromUtf8(m_ffprobeProcess->readAllStandardOutput());
-    return parseFrameRate(output);
+    QString masterPath = m_pendingMasterPath;
+    masterPath.chop(QString(".partial").size());
+    m_pendingMasterPath.clear();
+    QFile::remove(masterPath);
+    if (!QFile::rename(masterPath + ".partial", masterPath)) {
+        m_report << QString("无法保存无损母版: %1").arg(masterPath);
+        return;
+    }
+
+    MasterEntry entry;
+    entry.settings = MasterArchive::settingsFor(m_scaleTarget, m_cropMode);
+    entry.key = MasterArchive::keyFor(m_options.inputPath, m_options.modelName, entry.settings);
+    entry.inputPath = QFileInfo(m_options.inputPath).absoluteFilePath();
+    entry.modelName = m_options.modelName;
+    entry.masterPath = masterPath;
+    entry.summary = m_scalePlan.summary();
+    entry.size = (!m_cropRect.isNull() && m_cropMode == CropPadBack) ? m_fullTargetSize : m_scalePlan.targetSize;
+    entry.bytes = QFileInfo(masterPath).size();
+    entry.created = QDateTime::currentDateTime();
+    MasterArchive::record(entry);
+    m_report << QString("已保存无损母版 (%1): %2").arg(QLocale().formattedDataSize(entry.bytes), masterPath);
+}
+
+
+void VideoProcessor::cleanupTempFiles()
+{
+    // 删除在后台进行，析构和作业切换都不会被成千上万个帧文件拖住
+    ScratchManager::release(m_tempDir);
+    m_tempDir.clear();
 }
 
-QString VideoProcessor::parseFrameRate(const QString &output)
+QString VideoProcessor::parseFrameRate(const QString &rate)
 {
-    QString trimmed = output.trimmed();
+    QString trimmed = rate.trimmed();
     QStringList parts = trimmed.split('/');
 
     if (parts.size() != 2) {
@@ -294,58 +936,158 @@ QString VideoProcessor::parseFrameRate(const QString &output)
 
 QString VideoProcessor::createTempDirectory()
 {
-    QFileInfo inputInfo(m_options.inputPath);
-    QString baseDir = inputInfo.absolutePath();
-    QString safeBase = baseDir.replace(" ", "_")
-                           .replace("(", "")
-                           .replace(")", "")
-                           .replace("&", "");
+    QString error;
+    QString path = ScratchManager::allocate(QFileInfo(m_options.inputPath).completeBaseName(),
+                                            estimateScratchBytes(), &error);
+    if (path.isEmpty()) {
+        emit errorOccurred(error);
+    }
+    return path;
+}
 
-    QString tempDirName = QString("tmp_%1").arg(QUuid::createUuid().toString(QUuid::Id128));
-    QString fullPath = QDir(safeBase).filePath(tempDirName);
+qint64 VideoProcessor::estimateScratchBytes() const
+{
+    if (m_durationSec <= 0 || m_inputSize.isEmpty()) {
+        return 0;
+    }
 
-    if (!QDir().mkpath(fullPath)) {
-        emit errorOccurred(QString("无法创建临时目录: %1").arg(fullPath));
-        return QString();
+    // 按每像素约 1.5 字节的 PNG 估算：抽出的帧、每一遍的输出各一份，多遍时中间结果会提前释放
+    double frames = m_durationSec * m_fps.toDouble();
+    QSize size = m_scalePlan.needsPreScale() ? m_scalePlan.preScaledSize : m_inputSize;
+    double pixels = double(size.width()) * size.height();
+    double peak = pixels;
+    double previous = 0;
+    for (const ScalePass &pass : m_scalePlan.passes) {
+        double output = pixels * pass.scale * pass.scale;
+        peak = qMax(peak, pixels + previous + output);
+        previous = pixels;
+        pixels = output;
     }
+    // 分块复用时合成前后的最终结果同时存在（按最坏情况每帧都整帧放大估算）
+    if (m_temporalReuse) {
+        peak += pixels;
+    }
+    // 共享的帧由提供方计入
+    if (m_sharedFrames) {
+        peak -= double(size.width()) * size.height();
+    }
+    return qint64(frames * peak * 1.5);
+}
+
+ThroughputRecord VideoProcessor::jobProfile() const
+{
+    ThroughputRecord profile;
+    profile.inputPath = QFileInfo(m_options.inputPath).absoluteFilePath();
+    profile.modelName = m_options.modelName;
+    profile.planSummary = m_scalePlan.summary();
+    profile.codec = m_encodeSettings.videoCodec.isEmpty() ? "auto" : m_encodeSettings.videoCodec;
+    profile.inputSize = m_inputSize;
+    profile.frames = m_totalFrames > 0 ? m_totalFrames : qRound(m_durationSec * m_fps.toDouble());
+    // 尚未进入增强阶段时按当前正在增强的作业数估计
+    profile.concurrency = m_enhancing || m_stageMs[StageEnhance] > 0 ? m_concurrency : s_enhancingJobs + 1;
+
+    // 抽出的帧已经过裁剪和预缩放
+    QSize size = m_scalePlan.needsPreScale() ? m_scalePlan.preScaledSize
+                 : !m_cropRect.isNull()      ? m_cropRect.size()
+                                             : m_inputSize;
+    double frames = profile.frames;
+    double pixels = double(size.width()) * size.height();
+    profile.work[ThroughputRecord::Extract] = frames * pixels / 1e6;
+
+    double enhancedPixels = 0;
+    QSize passSize = size;
+    for (const ScalePass &pass : m_scalePlan.passes) {
+        passSize *= pass.scale;
+        enhancedPixels += double(passSize.width()) * passSize.height();
+    }
+    profile.work[ThroughputRecord::Enhance] = frames * enhancedPixels / 1e6 * profile.concurrency;
+
+    profile.outputSize = (!m_cropRect.isNull() && m_cropMode == CropPadBack) ? m_fullTargetSize
+                         : m_scalePlan.valid                                 ? m_scalePlan.targetSize
+                                                                             : passSize;
+    profile.work[ThroughputRecord::Encode] =
+        frames * double(profile.outputSize.width()) * profile.outputSize.height() / 1e6;
+    return profile;
+}
+
+void VideoProcessor::setEnhancing(bool enhancing)
+{
+    if (enhancing == m_enhancing) {
+        return;
+    }
+    m_enhancing = enhancing;
+    s_enhancingJobs += enhancing ? 1 : -1;
+    if (enhancing) {
+        m_concurrency = s_enhancingJobs;
+    }
+}
+
+void VideoProcessor::recordThroughput()
+{
+    // 从母版重新编码的作业没有提取和增强阶段，不记录
+    if (!m_masterSource.isEmpty() || m_stageMs[StageEnhance] <= 0) {
+        return;
+    }
+
+    ThroughputRecord record = jobProfile();
+    for (int i = 0; i < ThroughputRecord::StageCount; ++i) {
+        record.stageMs[i] = m_stageMs[i];
+    }
+    // 渐进输出的编码与增强重叠进行，编码阶段只剩收尾时间，不作为编码速度的样本
+    if (m_progressive) {
+        record.work[ThroughputRecord::Encode] = 0;
+    }
+    ThroughputLedger::append(record);
+
+    QString actual = QString("实际耗时：提取 %1，增强 %2，编码 %3")
+                         .arg(ThroughputLedger::formatDuration(record.stageMs[ThroughputRecord::Extract]),
+                              ThroughputLedger::formatDuration(record.stageMs[ThroughputRecord::Enhance]),
+                              ThroughputLedger::formatDuration(record.stageMs[ThroughputRecord::Encode]));
+    if (m_estimate.isValid()) {
+        actual += QString("（预计共 %1）").arg(ThroughputLedger::formatDuration(m_estimate.totalMs()));
+    }
+    m_report << actual;
+}
 
-    return fullPath;
+QString VideoProcessor::passOutputDir(int passIndex) const
+{
+    if (passIndex + 1 >= m_scalePlan.passes.size()) {
+        // 分块复用时最后一遍输出的是小块，合成后才写入 enhanced
+        return m_temporalReuse ? QDir(m_tempDir).filePath("temporal") : m_enhancedDir;
+    }
+    return QDir(m_tempDir).filePath(QString("pass%1").arg(passIndex + 1));
 }
 
 QString VideoProcessor::generateOutputPath()
 {
+    if (m_segmentFrames > 0) {
+        return m_segmentOutput;
+    }
     QFileInfo inputInfo(m_options.inputPath);
+    QString suffix = m_masterSource.isEmpty() ? "_enhanced" : "_enhanced_reencoded";
+    if (!m_outputTag.isEmpty()) {
+        suffix += "_" + m_outputTag;
+    }
     return QDir(inputInfo.absolutePath())
-        .filePath(inputInfo.completeBaseName() + "_enhanced.mp4");
+        .filePath(inputInfo.completeBaseName() + suffix + "." + m_encodeSettings.container);
 }
 
 void VideoProcessor::updateProgress(int processed, int total)
 {
     double percent = processed * 100.0 / total;
     emit progressPercentageChanged(percent);
-    emit progressUpdated(QString("已处理: %1/%2").arg(processed).arg(total));
-}
 
-void VideoProcessor::handleRealesrganOutput()
-{
-    QString output = QString::fromUtf8(m_realesrganProcess->readAllStandardOutput());
-    qDebug() << "RealESRGAN output:" << output;
-
-    // 解析进度
-    QRegularExpression progressRegex(R"((\d+\.\d+)%)");
-    QRegularExpressionMatchIterator i = progressRegex.globalMatch(output);
-
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        double progress = match.captured(1).toDouble();
-        emit progressPercentageChanged(progress);
-    }
+    // 多遍串联时按遍数折算增强阶段的完成比例
+    int passCount = qMax(1, int(m_scalePlan.passes.size()));
+    double fraction = (m_passIndex + double(processed) / total) / passCount;
+    qint64 remaining = m_estimate.remainingMs(ThroughputRecord::Enhance, fraction, m_stageTimer.elapsed());
+    emit progressUpdated(QString("已处理: %1/%2，预计剩余 %3")
+                             .arg(processed).arg(total)
+                             .arg(ThroughputLedger::formatDuration(remaining)));
 }
 
-void VideoProcessor::handleRealesrganFinished(int exitCode, QProcess::ExitStatus exitStatus)
+void VideoProcessor::handleUpscaleFinished(bool ok)
 {
-    Q_UNUSED(exitStatus)
-
     if (m_progressTimer) {
         m_progressTimer->stop();
         m_progressTimer->deleteLater();
@@ -357,30 +1099,57 @@ void VideoProcessor::handleRealesrganFinished(int exitCode, QProcess::ExitStatus
         return;
     }
 
-    if (exitCode != 0) {
-        QString error = QString::fromUtf8(m_realesrganProcess->readAllStandardError());
-        emit errorOccurred(QString("RealESRGAN处理失败 (代码 %1): %2").arg(exitCode).arg(error));
+    if (!ok) {
+        emit errorOccurred(QString("RealESRGAN处理失败: %1").arg(m_upscaleTask->errorString()));
         return;
     }
 
     // 检查处理后的帧数
-    int enhancedCount = QDir(m_enhancedDir).entryList(QStringList() << "*." + m_options.outputFormat, QDir::Files).count();
-    if (enhancedCount != m_totalFrames) {
-        emit errorOccurred(QString("帧数不匹配，预期 %1，实际 %2").arg(m_totalFrames).arg(enhancedCount));
+    int enhancedCount = QDir(m_passOutputDir).entryList(QStringList() << "*." + m_passOutputFormat, QDir::Files).count();
+    if (enhancedCount != m_passInputCount) {
+        emit errorOccurred(QString("帧数不匹配，预期 %1，实际 %2").arg(m_passInputCount).arg(enhancedCount));
         return;
     }
 
-    if (exitCode == 0) {
-        rebuildVideo();
-    } else {
-        emit errorOccurred("帧增强失败");
+    if (auto *clusterTask = qobject_cast<ClusterUpscaleTask *>(m_upscaleTask)) {
+        m_report << clusterTask->report();
+    }
+
+    if (m_passIndex + 1 < m_scalePlan.passes.size()) {
+        // 上一遍的中间结果已经用完，提前释放临时空间
+        if (m_passIndex > 0) {
+            ScratchManager::removeAsync(passOutputDir(m_passIndex - 1));
+        }
+        ++m_passIndex;
+        enhanceFrames();
+        return;
     }
+
+    if (m_temporalReuse) {
+        // 分块按各遍倍率的乘积贴回
+        int scale = 1;
+        for (const ScalePass &pass : m_scalePlan.passes) {
+            scale *= pass.scale;
+        }
+        emit progressUpdated("正在合成增强帧...");
+        m_temporal->composite(m_passOutputDir, m_enhancedDir, m_options.outputFormat, scale);
+        return;
+    }
+
+    finishEnhance();
 }
 
-void VideoProcessor::handleFfmpegOutput()
+void VideoProcessor::finishEnhance()
 {
-    QString output = QString::fromUtf8(m_ffmpegProcess->readAllStandardOutput());
-    qDebug() << "FFmpeg output:" << output;
+    m_stageMs[StageEnhance] = m_stageTimer.elapsed();
+    setEnhancing(false);
+
+    if (m_stageControlled) {
+        emit stageFinished(StageEnhance);
+        return;
+    }
+
+    runStage(StageRebuild);
 }
 
 void VideoProcessor::handleFfmpegFinished(int exitCode, QProcess::ExitStatus exitStatus)
@@ -392,32 +1161,82 @@ void VideoProcessor::handleFfmpegFinished(int exitCode, QProcess::ExitStatus exi
     }
 
     if (exitCode != 0) {
-        QString error = QString::fromUtf8(m_ffmpegProcess->readAllStandardError());
+        if (!m_pendingMasterPath.isEmpty()) {
+            QFile::remove(m_pendingMasterPath);
+            m_pendingMasterPath.clear();
+        }
+        QString error = ProcessSupervisor::attach(m_ffmpegProcess)->tail(4000);
         emit errorOccurred(QString("FFmpeg处理失败 (代码 %1): %2").arg(exitCode).arg(error));
         return;
     }
 
-    // 根据当前操作判断下一步
-    if (m_ffmpegProcess->arguments().contains("-qscale:v")) {
-        // 这是提取帧的操作
-        enhanceFrames();
+    // 根据当前阶段判断下一步
+    if (m_currentStage == StageExtract) {
+        // 帧数和压缩率只有抽完才知道，遍历成千上万个帧文件放到线程池里
+        m_stageMs[StageExtract] = m_stageTimer.elapsed();
+        QString tempDir = m_tempDir;
+        QString frameDir = m_frameDir;
+        m_ioPool.start([this, tempDir, frameDir]() {
+            qint64 used = ScratchManager::measureUsage(tempDir);
+            int frameCount = QDir(frameDir).entryList({"*.png"}, QDir::Files).count();
+            QMetaObject::invokeMethod(this, [this, tempDir, used, frameCount]() {
+                handleExtractMeasured(tempDir, used, frameCount);
+            }, Qt::QueuedConnection);
+        });
+    } else {
+        finishJob();
+    }
+}
+
+void VideoProcessor::handleExtractMeasured(const QString &tempDir, qint64 usedBytes, int frameCount)
+{
+    if (m_cancelled || tempDir != m_tempDir) {
+        return;
+    }
+
+    // 用实测占用校正预留量
+    QString quotaError;
+    if (!ScratchManager::recordUsage(m_tempDir, usedBytes, &quotaError)) {
+        emit errorOccurred(quotaError);
+        return;
+    }
+    // 用实际帧数重新预估后续阶段
+    m_totalFrames = frameCount;
+    m_estimate = ThroughputLedger::predict(jobProfile());
+    if (m_stageControlled) {
+        emit stageFinished(StageExtract);
     } else {
-        // 这是合并视频的操作
-        emit progressUpdated(QString("视频处理完成，输出路径: %1").arg(m_outputPath));
-        emit progressPercentageChanged(100);
+        runStage(StageEnhance);
+    }
+}
 
-        if (m_options.openOutputDirectory) {
-            QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(m_outputPath).absolutePath()));
-        }
+void VideoProcessor::finishJob()
+{
+    m_stageMs[StageRebuild] = m_stageTimer.elapsed();
+    finalizeMaster();
+    recordThroughput();
+    m_report << ProcessSupervisor::usageReport(ProcessSupervisor::takeFinished(this));
+    QString message = QString("视频处理完成，输出路径: %1").arg(m_outputPath);
+    if (!m_report.isEmpty()) {
+        message += "\n" + m_report.join("\n");
+    }
+    emit progressUpdated(message);
+    emit progressPercentageChanged(100);
 
-        emit processingFinished(m_outputPath);
-        cleanupTempFiles();
-        QTimer::singleShot(0, this, []() {
-            QWidget *parent = QApplication::activeWindow();
-            QMessageBox::information(parent, "完成", "视频处理完成");
-        });
+    if (m_options.openOutputDirectory) {
+        QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(m_outputPath).absolutePath()));
+    }
 
+    emit processingFinished(m_outputPath);
+    cleanupTempFiles();
+    if (m_stageControlled) {
+        emit stageFinished(StageRebuild);
+        return;
     }
+    QTimer::singleShot(0, this, []() {
+        QWidget *parent = QApplication::activeWindow();
+        QMessageBox::information(parent, "完成", "视频处理完成");
+    });
 }
 
 
@@ -7,13 +7,50 @@
 #include <QDir>
 #include <QDebug>
 #include <QTimer>
+#include <QThreadPool>
+#include <QElapsedTimer>
 #include <QUuid>
+#include <QSize>
+#include <QRect>
+#include "ScalePlanner.h"
+#include "ThroughputLedger.h"
+#include "ProcessSupervisor.h"
+
+class CropDetector;
+class ProgressiveEncoder;
+class TemporalTileProcessor;
+class UpscaleTask;
 
 class VideoProcessor : public QObject
 {
     Q_OBJECT
 
 public:
+    // 处理阶段，供外部队列按阶段调度
+    enum Stage {
+        StageExtract,
+        StageEnhance,
+        StageRebuild
+    };
+    Q_ENUM(Stage)
+
+    // 黑边处理：关闭 / 只增强有效区域后补回黑边 / 直接输出裁剪后的画面
+    enum CropMode {
+        CropOff,
+        CropPadBack,
+        CropOutput
+    };
+    Q_ENUM(CropMode)
+
+    // 最终编码参数，videoCodec 为空时自动选择 libx264（不可用时退回 mpeg4）
+    struct EncodeSettings {
+        QString videoCodec;
+        QString bitrate; // 例如 8M，为空时按 crf 或编码器默认值
+        int crf = -1;
+        QString container = "mp4";
+        QString pixelFormat; // 为空时按编码器选择
+    };
+
     explicit VideoProcessor(QObject *parent = nullptr);
     ~VideoProcessor();
 
@@ -23,17 +60,56 @@ public:
 
     void cancelProcessing();
 
+    // 分阶段模式：每个阶段完成后只发出 stageFinished，由调用方决定何时进入下一阶段
+    void setStageControlled(bool controlled);
+    // 异步探测元数据并分配临时目录，完成后发出 prepared，失败时发出 errorOccurred
+    void prepare(const QString &inputPath, const QString &modelName, int scaleFactor,
+                 const QString &outputFormat, bool openOutputDirectory);
+    void runStage(Stage stage);
+    QString outputPath() const { return m_outputPath; }
+    void setScaleTarget(const ScaleTarget &target, const QStringList &availableModels);
+    const ScalePlan &scalePlan() const { return m_scalePlan; }
+    void setCropMode(CropMode mode);
+    // 作业报告：黑边裁剪等各环节的统计信息
+    QStringList report() const { return m_report; }
+    void setEncodeSettings(const EncodeSettings &settings);
+    // 编码时同时输出一份无损母版并登记到 MasterArchive
+    void setKeepMaster(bool keep);
+    // 从母版重新编码：跳过提取和增强，只执行 StageRebuild
+    bool prepareReencode(const QString &masterPath, const QString &inputPath, bool openOutputDirectory);
+    void reencodeFromMaster(const QString &masterPath, const QString &inputPath, bool openOutputDirectory);
+    // 时域分块复用：只放大与上一帧相比有变化的分块，适合背景静止的动画
+    void setTemporalReuse(bool enabled);
+    // 渐进输出：增强开始时就启动编码，按顺序把已完成的帧写入分片 MP4，处理中即可观看
+    void setProgressiveOutput(bool enabled);
+    // 按吞吐记录预估的各阶段耗时，抽帧完成后按实际帧数更新
+    const ThroughputEstimate &estimate() const { return m_estimate; }
+    // 共享抽帧：直接读取 source 已抽好的帧，只为本作业的增强结果分配临时目录，
+    // 之后只需执行 StageEnhance 和 StageRebuild。source 的帧要保留到本作业增强完成
+    bool prepareShared(const VideoProcessor *source, const QString &modelName, int scaleFactor,
+                       const QString &outputFormat);
+    // 非空时加在输出文件名后，同一输入的多个版本互不覆盖
+    void setOutputTag(const QString &tag);
+    // 片段模式：只抽取从 startSec 开始的 frameCount 帧，增强后编码为不含音轨的片段写到 outputPath，
+    // 由调用方拼回已有的输出。需在 prepare 之前设置，frameCount 为 0 时恢复整段处理
+    void setSegment(double startSec, int frameCount, const QString &outputPath);
+    qint64 stageMs(Stage stage) const { return m_stageMs[stage]; }
+    int frameCount() const { return m_totalFrames; }
+
 signals:
     void progressUpdated(const QString &message);
     void progressPercentageChanged(double percent);
+    // 增强阶段新完成的工作量（按输入帧的百万像素计）
+    void workCompleted(double megapixels);
     void errorOccurred(const QString &error);
     void processingFinished(const QString &outputPath);
+    void prepared();
+    void stageFinished(VideoProcessor::Stage stage);
 
 private slots:
-    void handleRealesrganOutput();
-    void handleRealesrganFinished(int exitCode, QProcess::ExitStatus exitStatus);
-    void handleFfmpegOutput();
+    void handleUpscaleFinished(bool ok);
     void handleFfmpegFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void handleExtractMeasured(const QString &tempDir, qint64 usedBytes, int frameCount);
 
 private:
     struct VideoProcessingOptions {
@@ -44,19 +120,36 @@ private:
         bool openOutputDirectory;
     };
 
-    void executePipeline();
+    void detectCrop();
+    void handleCropDetected(const QRect &activeRect, const QString &message);
+    void applyCrop(const QRect &activeRect);
     void extractVideoFrames();
+    void analyzeTemporal();
     void enhanceFrames();
+    void finishEnhance();
+    void startProgressiveEncode();
     void rebuildVideo();
+    QStringList videoFilters() const;
+    void appendMasterArgs(QStringList &args, const QStringList &filters);
+    void appendEncoderArgs(QStringList &args);
+    void finalizeMaster();
+    void finishJob();
     void cleanupTempFiles();
 
-    QString getVideoMetadata();
-    QString parseFrameRate(const QString &output);
+    void probeMetadata();
+    void handleMetadataProbed(QProcess *process, bool completed);
+    QString parseFrameRate(const QString &rate);
     QString createTempDirectory();
+    qint64 estimateScratchBytes() const;
+    ThroughputRecord jobProfile() const;
+    void setEnhancing(bool enhancing);
+    void recordThroughput();
     QString generateOutputPath();
+    QString passOutputDir(int passIndex) const;
+    QString temporalTileDir() const;
     void updateProgress(int processed, int total);
 
-    QProcess *m_realesrganProcess;
+    UpscaleTask *m_upscaleTask;
     QProcess *m_ffmpegProcess;
     QProcess *m_ffprobeProcess;
 
@@ -66,19 +159,62 @@ private:
 
     QString m_tempDir;
     QString m_frameDir;
+    bool m_sharedFrames = false; // 帧目录属于另一个作业
+    QString m_outputTag;
+    double m_segmentStart = 0;
+    int m_segmentFrames = 0;     // 大于 0 时为片段模式
+    QString m_segmentOutput;
     QString m_enhancedDir;
     QString m_outputPath;
     QString m_fps;
+    QSize m_inputSize;
+    double m_durationSec = 0;
+
+    CropMode m_cropMode = CropOff;
+    CropDetector *m_cropDetector = nullptr;
+    bool m_cropChecked = false;
+    QRect m_cropRect;
+    QSize m_fullTargetSize;
+    QStringList m_report;
+
+    EncodeSettings m_encodeSettings;
+    bool m_keepMaster = false;
+    QString m_masterSource;      // 非空时为从母版重新编码
+    QString m_pendingMasterPath; // 编码成功前母版写在 .partial 文件里
+
+    ScaleTarget m_scaleTarget;
+    QStringList m_availableModels;
+    ScalePlan m_scalePlan;
+    int m_passIndex = 0;
+    QString m_passOutputDir;
+    QString m_passOutputFormat;
+    int m_passInputCount = 0;   // 本遍输入的图片数，分块复用时与帧数不同
+
+    bool m_temporalReuse = false;
+    TemporalTileProcessor *m_temporal = nullptr;
+    bool m_progressiveOutput = false;
+    ProgressiveEncoder *m_progressive = nullptr;
 
     int m_totalFrames;
     int m_processedFrames;
 
     VideoProcessingOptions m_options;
     bool m_cancelled;
+    bool m_stageControlled = false;
+    Stage m_currentStage = StageExtract;
+
+    // 各阶段实际耗时，作业完成后写入 ThroughputLedger
+    QElapsedTimer m_stageTimer;
+    qint64 m_stageMs[3] = {0, 0, 0};
+    ThroughputEstimate m_estimate;
+    bool m_enhancing = false;
+    int m_concurrency = 1;
 
-    QDateTime m_lastProgressTime;
+    StallDetector m_stall;
     bool m_processingCompleted = false;
     QTimer* m_progressTimer = nullptr;
+    // 统计临时目录占用和帧数，帧文件多时不在界面线程遍历
+    QThreadPool m_ioPool;
 };
 
 #endif // VIDEOPROCESSOR_H
@@ -7,11 +7,83 @@
 #include <QComboBox>
 #include <QGuiApplication>
 #include <QStyleHints>
+#include <QDebug>
+#include "UpscaleBackend.h"
+#include "NcnnUpscaleBackend.h"
+#include "BenchmarkRunner.h"
+#include "ClusterCoordinator.h"
+#include "ClusterWorker.h"
+#include "ProcessLauncher.h"
+#include "PriorityScheduler.h"
+#include "ScratchManager.h"
+#include "ThroughputLedger.h"
 
 int main(int argc, char *argv[])
 {
+    // --worker <主机:端口> 作为分布式工作节点运行，机架上的机器通常没有显示器
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--worker") == 0) {
+            QCoreApplication app(argc, argv);
+            return ClusterWorker::runFromArguments(app.arguments());
+        }
+    }
+
     QApplication a(argc, argv);
 
+    // --backend cli|cpu 指定默认推理后端
+    QStringList arguments = a.arguments();
+    // --placement off|numa [--inference-slots N] [--encoder-cores N] 子进程的 CPU / NUMA 放置
+    ProcessLauncher::configureFromArguments(arguments);
+    // --preempt off|renice|suspend 交互式作业运行期间如何让后台作业让出资源
+    PriorityScheduler::configureFromArguments(arguments);
+    // --scratch 目录 [--scratch-fast 目录|off] [--scratch-quota GB] [--job-quota GB] 中间文件的位置和上限
+    ScratchManager::configureFromArguments(arguments);
+    ScratchManager::reclaimOrphans();
+    int backendIndex = arguments.indexOf("--backend");
+    if (backendIndex >= 0 && backendIndex + 1 < arguments.size()) {
+        UpscaleBackend::setDefaultKind(arguments.at(backendIndex + 1) == "cpu"
+                                           ? UpscaleBackend::NcnnCpuBackend
+                                           : UpscaleBackend::CliBackend);
+    }
+    // --adaptive-threads CPU 推理的分块线程数按实测吞吐自动调整
+    if (arguments.contains("--adaptive-threads")) {
+        static_cast<NcnnUpscaleBackend *>(UpscaleBackend::instance(UpscaleBackend::NcnnCpuBackend))
+            ->setAdaptiveThreads(true);
+    }
+
+    // --export-ledger <文件.csv> 导出吞吐记录，用于集群容量规划
+    if (arguments.contains("--export-ledger")) {
+        return ThroughputLedger::runExport(arguments);
+    }
+
+    // --benchmark <图片> 只跑后端对比，不显示界面
+    if (arguments.contains("--benchmark")) {
+        return BenchmarkRunner::runFromArguments(arguments);
+    }
+
+    // --cluster-test <帧目录> 在本机启动若干工作进程跑一遍分布式增强
+    if (arguments.contains("--cluster-test")) {
+        return ClusterCoordinator::runLocalTest(arguments);
+    }
+
+    // --coordinator <端口> [--local-workers N] [--shared] 作为协调端接收工作节点
+    int coordinatorIndex = arguments.indexOf("--coordinator");
+    if (coordinatorIndex >= 0) {
+        ClusterCoordinator *coordinator = ClusterCoordinator::instance();
+        quint16 port = coordinatorIndex + 1 < arguments.size() ? arguments.at(coordinatorIndex + 1).toUShort() : 0;
+        QString error;
+        if (coordinator->listen(port, &error)) {
+            coordinator->setSharedStorage(arguments.contains("--shared"));
+            int localIndex = arguments.indexOf("--local-workers");
+            if (localIndex >= 0 && localIndex + 1 < arguments.size()) {
+                coordinator->spawnLocalWorkers(arguments.at(localIndex + 1).toInt());
+            }
+            UpscaleBackend::setDefaultKind(UpscaleBackend::ClusterBackend);
+        } else {
+            qWarning() << error;
+        }
+    }
+
     MainWindow w;
     w.setWindowIcon(QIcon(":/icons/logo.ico"));
 
@@ -44,10 +116,52 @@ int main(int argc, char *argv[])
                              );
                      });
 
+    QComboBox *backendComboBox = new QComboBox(&w);
+    backendComboBox->setToolTip("推理后端");
+    backendComboBox->addItem("外部程序推理", UpscaleBackend::CliBackend);
+    QString ncnnReason;
+    if (UpscaleBackend::instance(UpscaleBackend::NcnnCpuBackend)->isAvailable(&ncnnReason)) {
+        backendComboBox->addItem("内置 CPU 推理", UpscaleBackend::NcnnCpuBackend);
+    } else {
+        backendComboBox->setToolTip("推理后端（内置 CPU 不可用: " + ncnnReason + "）");
+    }
+    if (UpscaleBackend::instance(UpscaleBackend::ClusterBackend)->isAvailable()) {
+        ClusterCoordinator *coordinator = ClusterCoordinator::instance();
+        backendComboBox->addItem("分布式推理", UpscaleBackend::ClusterBackend);
+        int clusterIndex = backendComboBox->count() - 1;
+        auto updateClusterText = [backendComboBox, clusterIndex, coordinator](int workers) {
+            backendComboBox->setItemText(clusterIndex, QString("分布式推理（%1 个节点）").arg(workers));
+            backendComboBox->setItemData(clusterIndex, coordinator->statsReport(), Qt::ToolTipRole);
+        };
+        updateClusterText(coordinator->workerCount());
+        QObject::connect(coordinator, &ClusterCoordinator::workersChanged, backendComboBox, updateClusterText);
+    }
+    backendComboBox->setCurrentIndex(qMax(0, backendComboBox->findData(UpscaleBackend::defaultKind())));
+
+    QObject::connect(backendComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+                     [backendComboBox](int index) {
+                         UpscaleBackend::setDefaultKind(
+                             UpscaleBackend::Kind(backendComboBox->itemData(index).toInt()));
+                     });
+
+    QComboBox *placementComboBox = new QComboBox(&w);
+    placementComboBox->addItem("不限制核心", ProcessLauncher::NoPlacement);
+    placementComboBox->addItem("按 NUMA 绑定", ProcessLauncher::NumaPinned);
+    placementComboBox->setCurrentIndex(placementComboBox->findData(ProcessLauncher::policy()));
+    placementComboBox->setToolTip(ProcessLauncher::planDescription().join("\n"));
+    QObject::connect(placementComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+                     [placementComboBox](int index) {
+                         ProcessLauncher::setPolicy(
+                             ProcessLauncher::Policy(placementComboBox->itemData(index).toInt()));
+                         placementComboBox->setToolTip(ProcessLauncher::planDescription().join("\n"));
+                     });
+
     QAction *exitAction = new QAction("退出", &w);
     QAction *aboutAction = new QAction("关于", &w);
 
     toolBar->addWidget(themeComboBox);
+    toolBar->addWidget(backendComboBox);
+    toolBar->addWidget(placementComboBox);
     toolBar->addSeparator();
     toolBar->addAction(exitAction);
     toolBar->addAction(aboutAction);
@@ -1,6 +1,11 @@
 # include "mainwindow.h"
 # include "ui_mainwindow.h"
 # include "VideoProcessor.h"
+# include "PreviewDialog.h"
+# include "RegionDialog.h"
+# include "UpscaleBackend.h"
+# include "PngWriter.h"
+# include "MasterArchive.h"
 # include <QFileDialog>
 # include <QMessageBox>
 # include <QDir>
@@ -17,13 +22,22 @@
 # include <QDragEnterEvent>
 # include <QDropEvent>
 # include <QStyleHints>
+# include <QRegularExpression>
+# include <algorithm>
 
 
 MainWindow::MainWindow(QWidget* parent)
 	: QMainWindow(parent)
 	, ui(new Ui::MainWindow)
+	, m_batchModel(new BatchQueueModel(this))
+	, m_folderScanner(new FolderScanner(this))
 	, m_imageProcessor(new ImageProcessor(this)) // 初始化 ImageProcessor
 	, m_videoProcessor(new VideoProcessor(this))
+	, m_videoJobQueue(new VideoJobQueue(this))
+	, m_modelFanout(new ModelFanout(this))
+	, m_rangeSplicer(new RangeSplicer(this))
+	, m_imageProgress(new ProgressAggregator(this))
+	, m_videoQueueProgress(new ProgressAggregator(this))
 {
 	ui->setupUi(this);
 
@@ -32,14 +46,28 @@ MainWindow::MainWindow(QWidget* parent)
 	// 初始化UI组件
 	initializeModules();
 	validateDependencies();
+	initializeVideoQueue();
+	initializeBatchQueue();
+	initializeImageProcessing();
 
 }
 
 MainWindow::~MainWindow()
 {
-	delete ui;
-	delete m_imageProcessor;
+	// 处理器析构时会取消任务并发出状态信号，回调里还会访问 ui，ui 必须最后释放
+	disconnect(m_videoJobQueue, nullptr, this, nullptr);
+	disconnect(m_videoProcessor, nullptr, this, nullptr);
+	disconnect(m_imageProcessor, nullptr, this, nullptr);
+	disconnect(m_modelFanout, nullptr, this, nullptr);
+	disconnect(m_rangeSplicer, nullptr, this, nullptr);
+	disconnect(m_folderScanner, nullptr, this, nullptr);
+	m_modelFanout->cancel();
+	m_rangeSplicer->cancel();
+	m_folderScanner->cancel();
+	delete m_videoJobQueue;
 	delete m_videoProcessor;
+	delete m_imageProcessor;
+	delete ui;
 }
 
 // 初始化模块和下拉框
@@ -66,10 +94,52 @@ void MainWindow::initializeModules()
 	ui->video_comboBox_module->addItems(videoModules);
 	ui->video_comboBox_module->setCurrentIndex(0);
 
+	m_availableModels = imageModules;
+	for (const QString& module : videoModules) {
+		if (!m_availableModels.contains(module))
+		{
+			m_availableModels << module;
+		}
+	}
+	initializeScaleTargets();
+
+	// 黑边处理
+	ui->video_comboBox_crop->addItem("关闭", VideoProcessor::CropOff);
+	ui->video_comboBox_crop->addItem("裁剪后补回", VideoProcessor::CropPadBack);
+	ui->video_comboBox_crop->addItem("输出裁剪", VideoProcessor::CropOutput);
+	ui->video_comboBox_crop->setCurrentIndex(0);
+
+	// 视频编码
+	ui->video_comboBox_codec->addItem("自动", QString());
+	for (const QString& codec : { "libx264", "libx265", "libvpx-vp9", "libsvtav1", "prores_ks" })
+	{
+		ui->video_comboBox_codec->addItem(codec, codec);
+	}
+	ui->video_comboBox_container->addItems({ "mp4", "mkv", "mov", "webm" });
+
+	// 时域复用的帧在合成后才生成，与渐进输出互斥
+	connect(ui->video_checkBox_temporal, &QCheckBox::toggled, this, [this](bool checked) {
+		if (checked)
+		{
+			ui->video_checkBox_progressive->setChecked(false);
+		}
+		ui->video_checkBox_progressive->setEnabled(!checked);
+	});
+
 	// 图像类型
 	QStringList imageTypes = { "JPG", "PNG", "WEBP" };
 	ui->comboBox_imgType->addItems(imageTypes);
 	ui->comboBox_imgType->setCurrentIndex(0);
+
+	// 最终 PNG 的压缩级别
+	ui->comboBox_pngLevel->addItem("最快", PngWriter::Fastest);
+	ui->comboBox_pngLevel->addItem("均衡", PngWriter::Balanced);
+	ui->comboBox_pngLevel->addItem("最小", PngWriter::Smallest);
+	ui->comboBox_pngLevel->setCurrentIndex(ui->comboBox_pngLevel->findData(PngWriter::deliverableLevel()));
+	connect(ui->comboBox_pngLevel, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+		[this](int index) {
+			PngWriter::setDeliverableLevel(static_cast<PngWriter::Level>(ui->comboBox_pngLevel->itemData(index).toInt()));
+		});
 	//StatusBar
 	ui->progressBar->setValue(0);
 	ui->video_progressBar->setValue(0);
@@ -79,6 +149,53 @@ void MainWindow::initializeModules()
 	ui->video_status->setText("就绪");
 }
 
+// 目标尺寸下拉框：模型原生 / 倍数 / 高度 / 宽x高
+void MainWindow::initializeScaleTargets()
+{
+	struct TargetWidgets
+	{
+		QComboBox* combo;
+		QLineEdit* edit;
+	};
+	const QVector<TargetWidgets> widgets = {
+		{ ui->comboBox_target, ui->lineEdit_target },
+		{ ui->video_comboBox_target, ui->video_lineEdit_target }
+	};
+
+	for (const TargetWidgets& w : widgets) {
+		w.combo->addItem("模型原生", ScaleTarget::Native);
+		w.combo->addItem("倍数", ScaleTarget::Factor);
+		w.combo->addItem("高度", ScaleTarget::Height);
+		w.combo->addItem("宽x高", ScaleTarget::Size);
+		w.combo->setCurrentIndex(0);
+
+		QLineEdit* edit = w.edit;
+		QComboBox* combo = w.combo;
+		connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+			[edit, combo](int) {
+				static const QStringList placeholders = { "", "2", "1080", "1920x1080" };
+				int mode = combo->currentData().toInt();
+				edit->setEnabled(mode != ScaleTarget::Native);
+				edit->setPlaceholderText(placeholders.value(mode));
+			});
+	}
+}
+
+ScaleTarget MainWindow::readScaleTarget(bool video, bool* ok) const
+{
+	QComboBox* combo = video ? ui->video_comboBox_target : ui->comboBox_target;
+	QLineEdit* edit = video ? ui->video_lineEdit_target : ui->lineEdit_target;
+
+	ScaleTarget::Mode mode = static_cast<ScaleTarget::Mode>(combo->currentData().toInt());
+	QString text = edit->text().isEmpty() ? edit->placeholderText() : edit->text();
+	ScaleTarget target = ScaleTarget::fromText(mode, text, ok);
+	target.allowPreDownscale = video ? ui->video_checkBox_preDownscale->isChecked()
+		: ui->checkBox_preDownscale->isChecked();
+	target.allowModelSwitch = video ? ui->video_checkBox_modelSwitch->isChecked()
+		: ui->checkBox_modelSwitch->isChecked();
+	return target;
+}
+
 // 验证依赖项是否存在
 void MainWindow::validateDependencies()
 {
@@ -116,6 +233,8 @@ void MainWindow::validateDependencies()
 				true
 			}
 	};
+	// 内置 CPU 后端可用时外部程序不再是必需的
+	dependencies[0].required = !UpscaleBackend::instance(UpscaleBackend::NcnnCpuBackend)->isAvailable();
 
 	// 设置各平台的安装提示
 # ifdef Q_OS_WIN
@@ -200,8 +319,210 @@ void MainWindow::validateDependencies()
 	m_realesrganPath = foundPaths["realesrgan-ncnn-vulkan"];
 	m_ffmpegPath = foundPaths["ffmpeg"];
 	m_ffprobePath = foundPaths["ffprobe"];
+
+	auto *cliBackend = static_cast<CliUpscaleBackend*>(UpscaleBackend::instance(UpscaleBackend::CliBackend));
+	if (!m_realesrganPath.isEmpty())
+	{
+		cliBackend->setExecutablePath(m_realesrganPath);
+	}
+	else if (!dependencies[0].required)
+	{
+		UpscaleBackend::setDefaultKind(UpscaleBackend::NcnnCpuBackend);
+	}
+}
+
+
+// 初始化视频作业队列
+void MainWindow::initializeVideoQueue()
+{
+	if (!m_realesrganPath.isEmpty() && !m_ffmpegPath.isEmpty() && !m_ffprobePath.isEmpty())
+	{
+		m_videoJobQueue->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+	}
+	m_videoJobQueue->setAvailableModels(m_availableModels);
+
+	connect(ui->video_spinBox_extractLimit, QOverload<int>::of(&QSpinBox::valueChanged), this,
+		[this](int value) { m_videoJobQueue->setStageLimit(VideoProcessor::StageExtract, value); });
+	connect(ui->video_spinBox_bufferLimit, QOverload<int>::of(&QSpinBox::valueChanged), m_videoJobQueue, &VideoJobQueue::setMaxBufferedJobs);
+	m_videoJobQueue->setMaxBufferedJobs(ui->video_spinBox_bufferLimit->value());
+	connect(ui->video_spinBox_enhanceLimit, QOverload<int>::of(&QSpinBox::valueChanged), this,
+		[this](int value) { m_videoJobQueue->setStageLimit(VideoProcessor::StageEnhance, value); });
+	connect(ui->video_checkBox_adaptiveLimit, &QCheckBox::toggled, m_videoJobQueue, &VideoJobQueue::setAdaptiveConcurrency);
+	connect(ui->video_spinBox_encodeLimit, QOverload<int>::of(&QSpinBox::valueChanged), this,
+		[this](int value) { m_videoJobQueue->setStageLimit(VideoProcessor::StageRebuild, value); });
+
+	// 状态切换直接刷新；帧级进度先写入聚合器，按固定频率只刷新有变化的行
+	connect(m_videoJobQueue, &VideoJobQueue::jobStateChanged, this,
+		[this](int jobId, VideoJobQueue::JobState state) {
+			if (state == VideoJobQueue::Finished || state == VideoJobQueue::Failed || state == VideoJobQueue::Cancelled)
+			{
+				m_videoQueueProgress->finishWorker(jobId);
+			}
+			updateQueueItem(jobId);
+		});
+	connect(m_videoJobQueue, &VideoJobQueue::jobProgress, m_videoQueueProgress,
+		[this](int jobId, double percent, const QString& message) {
+			// 各阶段进度按大致耗时比例折算为作业整体进度
+			double overall = percent;
+			if (const VideoJobQueue::Job* job = m_videoJobQueue->job(jobId))
+			{
+				switch (job->state) {
+				case VideoJobQueue::Extracting: overall = percent * 0.1; break;
+				case VideoJobQueue::Extracted: overall = 10; break;
+				case VideoJobQueue::Enhancing: overall = 10 + percent * 0.8; break;
+				case VideoJobQueue::Enhanced: overall = 90; break;
+				case VideoJobQueue::Encoding: overall = 90 + percent * 0.1; break;
+				default: break;
+				}
+			}
+			m_videoQueueProgress->report(jobId, overall, message);
+		});
+	connect(m_videoQueueProgress, &ProgressAggregator::progressChanged, this,
+		[this](const ProgressSnapshot& snapshot) {
+			for (int jobId : snapshot.changedWorkers) {
+				if (snapshot.workers.contains(jobId))
+				{
+					updateQueueItem(jobId, snapshot.workers.value(jobId).status);
+				}
+			}
+			ui->video_progressBar->setValue(static_cast<int>(snapshot.overallPercent));
+		});
+	connect(m_videoJobQueue, &VideoJobQueue::jobRemoved, this,
+		[this](int jobId) {
+			for (int i = 0; i < ui->video_listWidget_queue->count(); ++i) {
+				if (ui->video_listWidget_queue->item(i)->data(Qt::UserRole).toInt() == jobId)
+				{
+					delete ui->video_listWidget_queue->takeItem(i);
+					break;
+				}
+			}
+		});
+	connect(m_videoJobQueue, &VideoJobQueue::queueFinished, this,
+		[this](int, int failed, const QString& summary) {
+			m_videoQueueProgress->end();
+			ui->video_btn_startQueue->setEnabled(true);
+			ui->video_btn_clearQueue->setEnabled(true);
+			ui->video_status->setText(summary);
+			if (failed > 0)
+			{
+				QMessageBox::warning(this, "队列完成", summary);
+			}
+			else
+			{
+				QMessageBox::information(this, "队列完成", summary);
+			}
+		});
+
+	connect(m_modelFanout, &ModelFanout::progressUpdated, this,
+		[this](const QString& message) { ui->video_status->setText(message); });
+	connect(m_modelFanout, &ModelFanout::progressPercentageChanged, this,
+		[this](double percent) { ui->video_progressBar->setValue(static_cast<int>(percent)); });
+	connect(m_modelFanout, &ModelFanout::finished, this,
+		[this](bool ok, const QString& report) {
+			toggleVideoControls(true);
+			ui->video_status->setText(ok ? "多模型对比完成" : "多模型对比失败");
+			if (ok)
+			{
+				QMessageBox::information(this, "多模型对比", report);
+			}
+			else
+			{
+				QMessageBox::warning(this, "多模型对比", report);
+			}
+		});
+
+	connect(m_rangeSplicer, &RangeSplicer::progressUpdated, this,
+		[this](const QString& message) { ui->video_status->setText(message); });
+	connect(m_rangeSplicer, &RangeSplicer::progressPercentageChanged, this,
+		[this](double percent) { ui->video_progressBar->setValue(static_cast<int>(percent)); });
+	connect(m_rangeSplicer, &RangeSplicer::finished, this,
+		[this](bool ok, const QString& report) {
+			toggleVideoControls(true);
+			if (ok)
+			{
+				ui->video_status->setText("局部重做完成");
+				ui->video_lineEdit_input_2->setText(m_rangeSplicer->outputPath());
+				ui->video_btn_openDir->setEnabled(true);
+				QMessageBox::information(this, "局部重做", report);
+			}
+			else
+			{
+				ui->video_status->setText("局部重做失败");
+				QMessageBox::warning(this, "局部重做", report);
+			}
+		});
 }
 
+void MainWindow::addVideoToQueue(const QString& filePath)
+{
+	QString modelName = ui->video_comboBox_module->currentText();
+	bool targetOk = false;
+	ScaleTarget target = readScaleTarget(true, &targetOk);
+	if (!targetOk)
+	{
+		statusBar()->showMessage("目标尺寸格式无效，使用模型原生倍率", 3000);
+	}
+	VideoJobQueue::JobOptions options;
+	options.modelName = modelName;
+	options.scaleFactor = ScalePlanner::nativeScale(modelName);
+	options.outputFormat = "png";
+	options.scaleTarget = target;
+	options.cropMode = static_cast<VideoProcessor::CropMode>(ui->video_comboBox_crop->currentData().toInt());
+	options.encode = readEncodeSettings();
+	options.keepMaster = ui->video_checkBox_keepMaster->isChecked();
+	options.temporalReuse = ui->video_checkBox_temporal->isChecked();
+	options.progressiveOutput = ui->video_checkBox_progressive->isChecked();
+	int jobId = m_videoJobQueue->addJob(filePath, options);
+	if (m_videoQueueProgress->isActive())
+	{
+		m_videoQueueProgress->setTotalItems(m_videoQueueProgress->snapshot().totalItems + 1);
+	}
+
+	QListWidgetItem* item = new QListWidgetItem(ui->video_listWidget_queue);
+	item->setData(Qt::UserRole, jobId);
+	item->setToolTip(filePath);
+	updateQueueItem(jobId);
+}
+
+void MainWindow::updateQueueItem(int jobId, const QString& message)
+{
+	const VideoJobQueue::Job* job = m_videoJobQueue->job(jobId);
+	if (!job)
+	{
+		return;
+	}
+
+	for (int i = 0; i < ui->video_listWidget_queue->count(); ++i) {
+		QListWidgetItem* item = ui->video_listWidget_queue->item(i);
+		if (item->data(Qt::UserRole).toInt() != jobId)
+		{
+			continue;
+		}
+
+		QString text = QString("[%1] %2 (%3)")
+			.arg(VideoJobQueue::stateText(job->state))
+			.arg(QFileInfo(job->inputPath).fileName())
+			.arg(job->options.modelName);
+		if (job->state == VideoJobQueue::Failed)
+		{
+			text += " - " + job->error;
+		}
+		else if (job->state == VideoJobQueue::Finished)
+		{
+			text += " -> " + job->outputPath;
+			if (!job->report.isEmpty())
+			{
+				item->setToolTip(job->inputPath + "\n" + job->report.join("\n"));
+			}
+		}
+		else if (!message.isEmpty())
+		{
+			text += QString(" - %1 %2%").arg(message).arg(job->percent, 0, 'f', 1);
+		}
+		item->setText(text);
+		break;
+	}
+}
 
 QString MainWindow::findExecutable(const QString& name)
 {
@@ -250,7 +571,7 @@ void MainWindow::on_btn_browse_clicked()
 
 	if (dialog.exec())
 	{
-		m_selectedImageFiles = dialog.selectedFiles();
+		m_batchModel->setFiles(dialog.selectedFiles());
 		ui->progressBar->setValue(0);
 		updateFileDisplay();
 	}
@@ -273,29 +594,41 @@ void MainWindow::on_video_btn_browse_clicked()
 // 更新文件显示
 void MainWindow::updateFileDisplay()
 {
-	int count = m_selectedImageFiles.size();
+	int count = m_batchModel->count();
 	if (count > 1)
 	{
 		ui->lineEdit_input->setText(QString("(%1个文件)").arg(count));
 	}
 	else if (count == 1)
 	{
-		ui->lineEdit_input->setText(m_selectedImageFiles.first());
+		ui->lineEdit_input->setText(m_batchModel->paths().first());
 	}
 	else
 	{
 		ui->lineEdit_input->clear();
 	}
+	ui->label_batchCount->setText(count > 0 ? QString("共 %1 个文件").arg(count) : QString());
 }
 
 // 开始处理图片
 void MainWindow::on_btn_start_clicked()
 {
-	if (m_selectedImageFiles.isEmpty())
+	// 正在处理时不允许再次启动
+	if (m_imageProgress->isActive())
+	{
+		return;
+	}
+	if (m_batchModel->count() == 0)
 	{
 		QMessageBox::warning(this, "提示", "请先选择要处理的图片文件");
 		return;
 	}
+	// 处理过程中按行号回报结果，队列在此期间不能再变化
+	if (m_folderScanner->isRunning())
+	{
+		QMessageBox::warning(this, "提示", "正在扫描文件夹，请等待扫描完成");
+		return;
+	}
 	if (ui->progressBar->value() == 100)
 	{
 		QMessageBox::StandardButton reply;
@@ -307,13 +640,9 @@ void MainWindow::on_btn_start_clicked()
 		}
 	}
 	// 初始化进度
-	m_totalFiles = m_selectedImageFiles.size();
-	m_filesProcessed = 0;
-	m_currentFileProgress = 0;
-
+	m_batchModel->resetStatus();
 	ui->progressBar->setValue(0);
 	ui->progressBar->setMaximum(100);
-	qApp->processEvents();
 
 	// 禁用控件
 	toggleImageControls(false);
@@ -323,55 +652,36 @@ void MainWindow::on_btn_start_clicked()
 	QString outputFormat = ui->comboBox_imgType->currentText();
 	bool openOutputDirectory = ui->checkBox_openDir->isChecked();
 
-	// 进度更新连接
-	connect(m_imageProcessor, &ImageProcessor::progressUpdate, this,
-		[this](int percent, const QString) {
-			m_currentFileProgress = percent;
+	bool targetOk = false;
+	ScaleTarget target = readScaleTarget(false, &targetOk);
+	if (!targetOk)
+	{
+		QMessageBox::warning(this, "提示", "目标尺寸格式无效");
+		toggleImageControls(true);
+		return;
+	}
+	m_imageProcessor->setScaleTarget(target, m_availableModels);
 
-			// 计算整体进度
-			int overall = (m_filesProcessed * 100 + m_currentFileProgress) / m_totalFiles;
+	bool renditionsOk = false;
+	QList<RenditionSpec> renditions = RenditionSpec::parseList(ui->lineEdit_renditions->text(), outputFormat, &renditionsOk);
+	if (!renditionsOk)
+	{
+		QMessageBox::warning(this, "提示", "多规格输出格式无效");
+		toggleImageControls(true);
+		return;
+	}
+	m_imageProcessor->setRenditions(renditions);
+	m_imageProcessor->setAtlasMode(ui->checkBox_atlas->isChecked());
+	m_imageProcessor->setRegions(m_batchModel->regions());
 
-			ui->progressBar->setValue(overall);
-			ui->status_label->setText(
-				QString("正在处理第%1/%2个文件")
-				.arg(m_filesProcessed + 1)
-				.arg(m_totalFiles)
-			);
-			qApp->processEvents();
-		}, Qt::QueuedConnection);
+	m_imageProgress->begin(m_batchModel->count());
 
-	// 文件完成处理连接
-	connect(m_imageProcessor, &ImageProcessor::fileProcessed, this,
-		[this]() {
-			m_filesProcessed++;
-			m_currentFileProgress = 0;
-		}, Qt::QueuedConnection);
-
-	// 全部完成连接
-	connect(m_imageProcessor, &ImageProcessor::processingFinished, this,
-		[this](const QStringList& outputFiles) {
-			ui->progressBar->setValue(100);
-			if (!outputFiles.isEmpty())
-			{
-				ui->lineEdit_output->setText(outputFiles.last());
-				ui->btn_openDir->setEnabled(true);
-			}
-			ui->status_label->setText(QString("已完成 %1 个文件").arg(outputFiles.size()));
-			QMessageBox::information(this, "完成", QString("已完成 %1 个文件").arg(outputFiles.size()));
-			toggleImageControls(true);
-			disconnect(m_imageProcessor, nullptr, this, nullptr);
-		}, Qt::QueuedConnection);
-
-	// 错误处理
-	connect(m_imageProcessor, &ImageProcessor::errorOccurred, this,
-		[this](const QString& error) {
-			QMessageBox::critical(this, "错误", error);
-			toggleImageControls(true);
-			disconnect(m_imageProcessor, nullptr, this, nullptr);
-		}, Qt::QueuedConnection);
+	// 少量图片按交互式处理，期间暂停后台视频队列；大批量不抢占
+	m_imageProcessor->setPriority(m_batchModel->count() <= 16 ? PriorityScheduler::Interactive
+	                                                          : PriorityScheduler::Normal);
 
 	// 开始处理
-	m_imageProcessor->processImages(m_selectedImageFiles, modelName, outputFormat, openOutputDirectory);
+	m_imageProcessor->processImages(m_batchModel->paths(), modelName, outputFormat, openOutputDirectory);
 }
 
 
@@ -398,9 +708,167 @@ void MainWindow::on_btn_start_video_clicked()
 		QMessageBox::warning(this, "错误", "视频文件不存在");
 		return;
 	}
+	connectVideoProcessor();
+
+	QString modelName = ui->video_comboBox_module->currentText();
+	bool openOutputDirectory = ui->video_checkBox_open->isChecked();
+	bool targetOk = false;
+	ScaleTarget target = readScaleTarget(true, &targetOk);
+	if (!targetOk)
+	{
+		QMessageBox::warning(this, "提示", "目标尺寸格式无效");
+		return;
+	}
+	m_videoProcessor->setScaleTarget(target, m_availableModels);
+	m_videoProcessor->setCropMode(static_cast<VideoProcessor::CropMode>(ui->video_comboBox_crop->currentData().toInt()));
+	m_videoProcessor->setEncodeSettings(readEncodeSettings());
+	m_videoProcessor->setKeepMaster(ui->video_checkBox_keepMaster->isChecked());
+	m_videoProcessor->setTemporalReuse(ui->video_checkBox_temporal->isChecked());
+	m_videoProcessor->setProgressiveOutput(ui->video_checkBox_progressive->isChecked());
+	// 重置UI状态
+	ui->video_progressBar->setValue(0);
+	ui->video_status->setText("正在处理...");
+	ui->video_btn_openDir->setEnabled(false);
+	toggleVideoControls(false);
+	// 开始处理视频
+	m_videoProcessor->processVideo(videoPath, modelName, ScalePlanner::nativeScale(modelName), "png", openOutputDirectory);
+}
+
+void MainWindow::on_video_btn_reencode_clicked()
+{
+	QString videoPath = ui->video_lineEdit_input->text();
+	if (videoPath.isEmpty() || !QFile::exists(videoPath))
+	{
+		QMessageBox::warning(this, "提示", "请先选择要处理的视频文件");
+		return;
+	}
+
+	bool targetOk = false;
+	ScaleTarget target = readScaleTarget(true, &targetOk);
+	if (!targetOk)
+	{
+		QMessageBox::warning(this, "提示", "目标尺寸格式无效");
+		return;
+	}
+	// 母版按当前的目标尺寸和黑边设置查找，换了设置的旧母版分辨率不对
+	QString settings = MasterArchive::settingsFor(target, ui->video_comboBox_crop->currentData().toInt());
+	MasterEntry entry = MasterArchive::find(videoPath, ui->video_comboBox_module->currentText(), settings);
+	if (!entry.isValid())
+	{
+		QMessageBox::information(this, "提示", "没有找到该视频在当前模型和目标尺寸、黑边设置下的无损母版，请先勾选“保留无损母版”完整处理一次");
+		return;
+	}
+
+	connectVideoProcessor();
+	m_videoProcessor->setEncodeSettings(readEncodeSettings());
+	m_videoProcessor->setKeepMaster(false);
+	ui->video_progressBar->setValue(0);
+	ui->video_status->setText("正在从母版重新编码...");
+	ui->video_btn_openDir->setEnabled(false);
+	toggleVideoControls(false);
+	m_videoProcessor->reencodeFromMaster(entry.masterPath, videoPath, ui->video_checkBox_open->isChecked());
+}
+
+void MainWindow::on_video_btn_fanout_clicked()
+{
+	QString videoPath = ui->video_lineEdit_input->text();
+	if (videoPath.isEmpty() || !QFile::exists(videoPath))
+	{
+		QMessageBox::warning(this, "提示", "请先选择要处理的视频文件");
+		return;
+	}
+
+	bool ok = false;
+	QList<ModelFanout::Variant> variants = ModelFanout::parseVariants(ui->video_lineEdit_fanout->text(), &ok);
+	if (!ok)
+	{
+		QMessageBox::warning(this, "提示", "对比方案格式无效，应为“模型:倍率”并用逗号分隔，倍率可省略");
+		return;
+	}
+	for (const ModelFanout::Variant& variant : variants) {
+		if (!m_availableModels.contains(variant.modelName))
+		{
+			QMessageBox::warning(this, "提示", QString("找不到模型 %1").arg(variant.modelName));
+			return;
+		}
+	}
+
+	if (!m_realesrganPath.isEmpty() && !m_ffmpegPath.isEmpty() && !m_ffprobePath.isEmpty())
+	{
+		m_modelFanout->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+	}
+	m_modelFanout->setAvailableModels(m_availableModels);
+	m_modelFanout->setEncodeSettings(readEncodeSettings());
+	m_modelFanout->setParallelism(ui->video_spinBox_fanoutParallel->value());
+	ui->video_progressBar->setValue(0);
+	ui->video_status->setText(QString("多模型对比：%1 个方案共用一次抽帧").arg(variants.size()));
+	ui->video_btn_openDir->setEnabled(false);
+	toggleVideoControls(false);
+	if (!m_modelFanout->start(videoPath, variants))
+	{
+		toggleVideoControls(true);
+	}
+}
+
+void MainWindow::on_video_btn_rerender_clicked()
+{
+	QString videoPath = ui->video_lineEdit_input->text();
+	if (videoPath.isEmpty() || !QFile::exists(videoPath))
+	{
+		QMessageBox::warning(this, "提示", "请先选择要处理的视频文件");
+		return;
+	}
+
+	bool ok = false;
+	QList<RangeSplicer::Range> ranges = RangeSplicer::parseRanges(ui->video_lineEdit_ranges->text(), &ok);
+	if (!ok)
+	{
+		QMessageBox::warning(this, "提示", "时间段格式无效，应为“起点-终点”并用逗号分隔，时间可写秒数或 分:秒");
+		return;
+	}
+
+	// 默认拼回上次的输出，没有时让用户选择之前处理好的文件
+	QString previousOutput = ui->video_lineEdit_input_2->text();
+	if (previousOutput.isEmpty() || !QFile::exists(previousOutput))
+	{
+		previousOutput = QFileDialog::getOpenFileName(this, "选择之前增强好的视频",
+			QFileInfo(videoPath).absolutePath(), "视频文件 (*.mp4 *.mkv *.mov *.webm)");
+		if (previousOutput.isEmpty())
+		{
+			return;
+		}
+	}
+
+	if (!m_realesrganPath.isEmpty() && !m_ffmpegPath.isEmpty() && !m_ffprobePath.isEmpty())
+	{
+		m_rangeSplicer->setExecutablePaths(m_realesrganPath, m_ffmpegPath, m_ffprobePath);
+	}
+	m_rangeSplicer->setAvailableModels(m_availableModels);
+	m_rangeSplicer->setEncodeSettings(readEncodeSettings());
+	ui->video_progressBar->setValue(0);
+	ui->video_btn_openDir->setEnabled(false);
+	toggleVideoControls(false);
+	if (!m_rangeSplicer->start(videoPath, previousOutput, ui->video_comboBox_module->currentText(), ranges))
+	{
+		toggleVideoControls(true);
+	}
+}
+
+VideoProcessor::EncodeSettings MainWindow::readEncodeSettings() const
+{
+	VideoProcessor::EncodeSettings settings;
+	settings.videoCodec = ui->video_comboBox_codec->currentData().toString();
+	settings.bitrate = ui->video_lineEdit_bitrate->text().trimmed();
+	settings.container = ui->video_comboBox_container->currentText();
+	return settings;
+}
+
+void MainWindow::connectVideoProcessor()
+{
 	// 断开旧连接
 	disconnect(m_videoProcessor, &VideoProcessor::processingFinished, this, nullptr);
 	disconnect(m_videoProcessor, &VideoProcessor::progressUpdated, this, nullptr);
+	disconnect(m_videoProcessor, &VideoProcessor::progressPercentageChanged, this, nullptr);
 	disconnect(m_videoProcessor, &VideoProcessor::errorOccurred, this, nullptr);
 
 	connect(m_videoProcessor, &VideoProcessor::progressUpdated,
@@ -422,18 +890,312 @@ void MainWindow::on_btn_start_video_clicked()
 			ui->video_btn_openDir->setEnabled(true);
 			toggleVideoControls(true);
 		});
+}
 
-	QString modelName = ui->video_comboBox_module->currentText();
-	bool openOutputDirectory = ui->video_checkBox_open->isChecked();
-	// 重置UI状态
-	ui->video_progressBar->setValue(0);
-	ui->video_status->setText("正在处理...");
-	ui->video_btn_openDir->setEnabled(false);
-	toggleVideoControls(false);
-	// 开始处理视频
-	m_videoProcessor->processVideo(videoPath, modelName, 2, "png", openOutputDirectory);
+
+void MainWindow::on_video_btn_addQueue_clicked()
+{
+	QString videoPath = ui->video_lineEdit_input->text();
+	if (!videoPath.isEmpty() && QFile::exists(videoPath))
+	{
+		addVideoToQueue(videoPath);
+		ui->video_lineEdit_input->clear();
+		return;
+	}
+
+	QStringList videoFiles = QFileDialog::getOpenFileNames(this, "选择视频文件", "",
+		"视频文件 (*.mp4 *.avi *.mov *.mkv *.flv *.webm);;所有文件 (*.*)");
+	for (const QString& file : videoFiles) {
+		addVideoToQueue(file);
+	}
+}
+
+void MainWindow::on_video_btn_clearQueue_clicked()
+{
+	if (m_videoJobQueue->isRunning())
+	{
+		QMessageBox::StandardButton reply;
+		reply = QMessageBox::question(this, "清空队列", "队列正在运行，是否取消所有作业？", QMessageBox::Yes | QMessageBox::No);
+		if (reply == QMessageBox::No)
+		{
+			return;
+		}
+		m_videoJobQueue->cancelAll();
+		ui->video_btn_startQueue->setEnabled(true);
+	}
+
+	for (int jobId : m_videoJobQueue->jobIds()) {
+		m_videoJobQueue->removeJob(jobId);
+	}
+}
+
+void MainWindow::on_video_btn_startQueue_clicked()
+{
+	if (m_videoJobQueue->jobIds().isEmpty())
+	{
+		QMessageBox::warning(this, "提示", "请先将视频加入队列");
+		return;
+	}
+
+	m_videoJobQueue->setStageLimit(VideoProcessor::StageExtract, ui->video_spinBox_extractLimit->value());
+	m_videoJobQueue->setMaxBufferedJobs(ui->video_spinBox_bufferLimit->value());
+	m_videoJobQueue->setStageLimit(VideoProcessor::StageEnhance, ui->video_spinBox_enhanceLimit->value());
+	m_videoJobQueue->setStageLimit(VideoProcessor::StageRebuild, ui->video_spinBox_encodeLimit->value());
+	m_videoJobQueue->setAdaptiveConcurrency(ui->video_checkBox_adaptiveLimit->isChecked());
+
+	ui->video_btn_startQueue->setEnabled(false);
+	ui->video_status->setText("队列处理中...");
+	int pendingJobs = 0;
+	for (int jobId : m_videoJobQueue->jobIds()) {
+		if (m_videoJobQueue->job(jobId)->state == VideoJobQueue::Pending)
+		{
+			++pendingJobs;
+		}
+	}
+	m_videoQueueProgress->begin(pendingJobs);
+	m_videoJobQueue->start();
+}
+
+// 图片处理信号只在这里连接一次，进度经聚合器以固定频率刷新界面
+void MainWindow::initializeImageProcessing()
+{
+	m_imageProcessor->setProgressAggregator(m_imageProgress);
+
+	connect(m_imageProgress, &ProgressAggregator::progressChanged, this,
+		[this](const ProgressSnapshot& snapshot) {
+			ui->progressBar->setValue(static_cast<int>(snapshot.overallPercent));
+			ui->status_label->setText(
+				QString("正在处理第%1/%2个文件")
+				.arg(qMin(snapshot.finishedItems + 1, snapshot.totalItems))
+				.arg(snapshot.totalItems)
+			);
+		});
+
+	connect(m_imageProcessor, &ImageProcessor::planReady, this,
+		[this](const QString& inputPath, const QString& summary) {
+			statusBar()->showMessage(QString("%1: %2").arg(QFileInfo(inputPath).fileName(), summary), 5000);
+		});
+
+	// 队列中每一项的状态
+	connect(m_imageProcessor, &ImageProcessor::itemStarted, m_batchModel, &BatchQueueModel::setItemStarted);
+	connect(m_imageProcessor, &ImageProcessor::itemFinished, m_batchModel, &BatchQueueModel::setItemFinished);
+	connect(m_imageProcessor, &ImageProcessor::itemFailed, m_batchModel, &BatchQueueModel::setItemFailed);
+	connect(m_imageProcessor, &ImageProcessor::itemNote, m_batchModel, &BatchQueueModel::setItemNote);
+
+	// 完成和出错时会弹窗，排队执行避免在处理器回调里嵌套事件循环
+	connect(m_imageProcessor, &ImageProcessor::processingFinished, this,
+		[this](const QStringList& outputFiles) {
+			m_imageProgress->end();
+			ui->progressBar->setValue(100);
+			if (!outputFiles.isEmpty())
+			{
+				ui->lineEdit_output->setText(outputFiles.last());
+				ui->btn_openDir->setEnabled(true);
+			}
+			QString summary = QString("已完成 %1 个文件").arg(outputFiles.size());
+			if (m_imageProcessor->alphaTimeSavedMs() > 0)
+			{
+				summary += QString("，透明通道分离约节省 %1 秒").arg(m_imageProcessor->alphaTimeSavedMs() / 1000.0, 0, 'f', 1);
+			}
+			if (!m_imageProcessor->atlasReport().isEmpty())
+			{
+				summary += "\n" + m_imageProcessor->atlasReport();
+			}
+			ui->status_label->setText(summary);
+			toggleImageControls(true);
+			QMessageBox::information(this, "完成", summary);
+		}, Qt::QueuedConnection);
+
+	connect(m_imageProcessor, &ImageProcessor::errorOccurred, this,
+		[this](const QString& error) {
+			m_imageProgress->end();
+			toggleImageControls(true);
+			QMessageBox::critical(this, "错误", error);
+		}, Qt::QueuedConnection);
+}
+
+// 图片批处理队列视图
+void MainWindow::initializeBatchQueue()
+{
+	ui->listView_batch->setModel(m_batchModel);
+	// 固定行高后视图无需逐行测量，十万条也能即时滚动
+	ui->listView_batch->setUniformItemSizes(true);
+	ui->listView_batch->setIconSize(QSize(64, 64));
+
+	connect(m_batchModel, &QAbstractItemModel::rowsInserted, this, &MainWindow::updateFileDisplay);
+	connect(m_batchModel, &QAbstractItemModel::rowsRemoved, this, &MainWindow::updateFileDisplay);
+	connect(m_batchModel, &QAbstractItemModel::modelReset, this, &MainWindow::updateFileDisplay);
+
+	// 扫描结果分批追加，窗口在扫描期间保持响应
+	connect(m_folderScanner, &FolderScanner::filesFound, this, [this](const QStringList& paths) {
+		// 处理期间不会开始扫描，这里只防备取消前已发出的结果
+		if (m_imageProgress->isActive())
+		{
+			return;
+		}
+		if (m_scanSingleFile)
+		{
+			m_batchModel->setFiles(QStringList{ paths.first() });
+			m_folderScanner->cancel();
+			return;
+		}
+		m_batchModel->appendFiles(paths);
+	});
+	connect(m_folderScanner, &FolderScanner::progress, this, [this](int scanned, int accepted) {
+		statusBar()->showMessage(QString("正在扫描：已检查 %1 个文件，找到 %2 张图片").arg(scanned).arg(accepted));
+	});
+	connect(m_folderScanner, &FolderScanner::finished, this, [this](int scanned, int accepted, bool cancelled) {
+		statusBar()->showMessage(QString("扫描%1：检查 %2 个文件，找到 %3 张图片")
+			.arg(cancelled ? "已停止" : "完成").arg(scanned).arg(accepted), 5000);
+	});
+}
+
+// 在后台线程识别并过滤图片，逐批加入队列
+void MainWindow::scanImagePaths(const QStringList& paths)
+{
+	FolderScanner::Filter filter;
+	filter.suffixes = ui->lineEdit_scanSuffixes->text().split(QRegularExpression("[\\s,;]+"), Qt::SkipEmptyParts);
+	filter.minSide = ui->spinBox_scanMinSide->value();
+	filter.maxBytes = qint64(ui->spinBox_scanMaxMB->value()) * 1024 * 1024;
+
+	m_scanSingleFile = !ui->checkBox_multiSelect->isChecked();
+	ui->progressBar->setValue(0);
+	statusBar()->showMessage("正在扫描...");
+	m_folderScanner->start(paths, filter);
+}
+
+void MainWindow::moveBatchSelection(int offset)
+{
+	QModelIndex current = ui->listView_batch->currentIndex();
+	if (!current.isValid())
+	{
+		return;
+	}
+
+	int row = current.row();
+	int target = row + offset;
+	if (target < 0 || target >= m_batchModel->count())
+	{
+		return;
+	}
+
+	// moveRows 的目标行是移动前的插入位置
+	m_batchModel->moveRows(QModelIndex(), row, 1, QModelIndex(), offset > 0 ? target + 1 : target);
+	ui->listView_batch->setCurrentIndex(m_batchModel->index(target));
+}
+
+void MainWindow::on_btn_batchUp_clicked()
+{
+	moveBatchSelection(-1);
+}
+
+void MainWindow::on_btn_batchDown_clicked()
+{
+	moveBatchSelection(1);
+}
+
+void MainWindow::on_btn_batchRemove_clicked()
+{
+	QList<int> rows;
+	for (const QModelIndex& index : ui->listView_batch->selectionModel()->selectedIndexes()) {
+		rows << index.row();
+	}
+	std::sort(rows.begin(), rows.end(), std::greater<int>());
+
+	// 从后往前合并连续行，减少模型信号次数
+	int i = 0;
+	while (i < rows.size()) {
+		int last = rows[i];
+		int first = last;
+		while (i + 1 < rows.size() && rows[i + 1] == first - 1) {
+			first = rows[++i];
+		}
+		m_batchModel->removeRows(first, last - first + 1);
+		++i;
+	}
+}
+
+// 选中多张时使用同一组区域，适合版式相同的扫描件
+void MainWindow::on_btn_batchRegions_clicked()
+{
+	QModelIndex current = ui->listView_batch->currentIndex();
+	if (!current.isValid())
+	{
+		QMessageBox::warning(this, "提示", "请先在队列中选择图片");
+		return;
+	}
+
+	RegionDialog dialog(current.data(BatchQueueModel::PathRole).toString(),
+		m_batchModel->itemRegions(current.row()), this);
+	if (dialog.exec() != QDialog::Accepted)
+	{
+		return;
+	}
+
+	QList<int> rows{ current.row() };
+	for (const QModelIndex& index : ui->listView_batch->selectionModel()->selectedIndexes()) {
+		if (!rows.contains(index.row()))
+		{
+			rows << index.row();
+		}
+	}
+	for (int row : rows) {
+		m_batchModel->setItemRegions(row, dialog.regions());
+	}
 }
 
+void MainWindow::on_btn_batchClear_clicked()
+{
+	m_folderScanner->cancel();
+	m_batchModel->clear();
+	ui->progressBar->setValue(0);
+}
+
+// 递归添加文件夹中的图片
+void MainWindow::on_btn_addFolder_clicked()
+{
+	QString dir = QFileDialog::getExistingDirectory(this, "选择图片文件夹");
+	if (!dir.isEmpty())
+	{
+		scanImagePaths(QStringList{ dir });
+	}
+}
+
+// 对选中区域同时试跑多个模型
+void MainWindow::on_btn_preview_clicked()
+{
+	if (m_batchModel->count() == 0)
+	{
+		QMessageBox::warning(this, "提示", "请先选择图片文件");
+		return;
+	}
+
+	// 优先预览队列中当前选中的文件
+	QModelIndex current = ui->listView_batch->currentIndex();
+	QString imagePath = current.isValid() ? current.data(BatchQueueModel::PathRole).toString()
+		: m_batchModel->paths().first();
+	PreviewDialog* dialog = new PreviewDialog(imagePath, false, m_availableModels, this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->setExecutablePaths(m_realesrganPath, m_ffmpegPath);
+	dialog->setCheckedModels({ ui->comboBox_module->currentText() });
+	dialog->show();
+}
+
+void MainWindow::on_video_btn_preview_clicked()
+{
+	QString videoPath = ui->video_lineEdit_input->text();
+	if (videoPath.isEmpty())
+	{
+		QMessageBox::warning(this, "提示", "请先选择视频文件");
+		return;
+	}
+
+	PreviewDialog* dialog = new PreviewDialog(videoPath, true, m_availableModels, this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->setExecutablePaths(m_realesrganPath, m_ffmpegPath);
+	dialog->setCheckedModels({ ui->video_comboBox_module->currentText() });
+	dialog->show();
+}
 
 // 打开输出目录
 void MainWindow::on_btn_openDir_clicked()
@@ -481,9 +1243,17 @@ void MainWindow::toggleImageControls(bool enabled)
 	ui->comboBox_module->setEnabled(enabled);
 	ui->comboBox_imgType->setEnabled(enabled);
 	ui->btn_browse->setEnabled(enabled);
+	ui->btn_addFolder->setEnabled(enabled);
 	ui->checkBox_multiSelect->setEnabled(enabled);
+	ui->checkBox_atlas->setEnabled(enabled);
 	ui->checkBox_openDir->setEnabled(enabled);
-	ui->btn_start->setEnabled(enabled && !m_selectedImageFiles.isEmpty());
+	ui->lineEdit_renditions->setEnabled(enabled);
+	ui->btn_batchUp->setEnabled(enabled);
+	ui->btn_batchDown->setEnabled(enabled);
+	ui->btn_batchRemove->setEnabled(enabled);
+	ui->btn_batchRegions->setEnabled(enabled);
+	ui->btn_batchClear->setEnabled(enabled);
+	ui->btn_start->setEnabled(enabled && m_batchModel->count() > 0);
 }
 
 void MainWindow::toggleVideoControls(bool enabled)
@@ -491,17 +1261,30 @@ void MainWindow::toggleVideoControls(bool enabled)
 	ui->video_comboBox_module->setEnabled(enabled);
 	ui->video_btn_browse->setEnabled(enabled);
 	ui->video_checkBox_open->setEnabled(enabled);
+	ui->video_comboBox_crop->setEnabled(enabled);
+	ui->video_checkBox_temporal->setEnabled(enabled);
+	ui->video_checkBox_progressive->setEnabled(enabled && !ui->video_checkBox_temporal->isChecked());
+	ui->video_comboBox_codec->setEnabled(enabled);
+	ui->video_lineEdit_bitrate->setEnabled(enabled);
+	ui->video_comboBox_container->setEnabled(enabled);
+	ui->video_checkBox_keepMaster->setEnabled(enabled);
+	ui->video_btn_reencode->setEnabled(enabled);
+	ui->video_lineEdit_fanout->setEnabled(enabled);
+	ui->video_spinBox_fanoutParallel->setEnabled(enabled);
+	ui->video_btn_fanout->setEnabled(enabled);
+	ui->video_lineEdit_ranges->setEnabled(enabled);
+	ui->video_btn_rerender->setEnabled(enabled);
 	ui->btn_start_video->setEnabled(enabled);
 }
 
 void MainWindow::dragEnterEvent(QDragEnterEvent* event)
 {
 	if (event->mimeData()->hasUrls()) {
-		// 检查拖入的文件是否是我们支持的格式
+		// 只看是否为本地路径，不在界面线程访问文件系统；是否为图片由后台扫描判断
+		bool imageBusy = m_imageProgress->isActive();
 		bool hasValidFile = false;
 		foreach(const QUrl & url, event->mimeData()->urls()) {
-			QString fileName = url.toLocalFile();
-			if (isSupportedImageFile(fileName) || isSupportedVideoFile(fileName))
+			if (url.isLocalFile() && (!imageBusy || isSupportedVideoFile(url.toLocalFile())))
 			{
 				hasValidFile = true;
 				break;
@@ -519,16 +1302,47 @@ void MainWindow::dragEnterEvent(QDragEnterEvent* event)
 
 void MainWindow::dropEvent(QDropEvent* event)
 {
+	// 视频只按扩展名区分；其余文件和文件夹交给后台扫描，按文件头识别图片
+	QStringList scanPaths;
+	QStringList videoFiles;
 	foreach(const QUrl & url, event->mimeData()->urls()) {
 		QString filePath = url.toLocalFile();
+		if (filePath.isEmpty())
+		{
+			continue;
+		}
+
+		if (isSupportedVideoFile(filePath))
+		{
+			videoFiles << filePath;
+		}
+		else
+		{
+			scanPaths << filePath;
+		}
+	}
 
-		if (isSupportedImageFile(filePath))
+	if (!scanPaths.isEmpty())
+	{
+		if (m_imageProgress->isActive())
 		{
-			handleDroppedImage(filePath);
+			statusBar()->showMessage("图片正在处理，完成后再添加", 3000);
 		}
-		else if (isSupportedVideoFile(filePath))
+		else
 		{
-			handleDroppedVideo(filePath);
+			scanImagePaths(scanPaths);
+		}
+	}
+
+	// 一次拖入多个视频时直接加入队列
+	if (videoFiles.size() == 1)
+	{
+		handleDroppedVideo(videoFiles.first());
+	}
+	else
+	{
+		for (const QString& filePath : videoFiles) {
+			addVideoToQueue(filePath);
 		}
 	}
 }
@@ -551,21 +1365,6 @@ bool MainWindow::isSupportedVideoFile(const QString& filePath)
 	return supportedFormats.contains(suffix);
 }
 
-void MainWindow::handleDroppedImage(const QString& filePath)
-{
-	if (ui->checkBox_multiSelect->isChecked()) {
-		m_selectedImageFiles.append(filePath);
-		ui->progressBar->setValue(0);
-	}
-	else
-	{
-		m_selectedImageFiles = QStringList{ filePath };
-        ui->progressBar->setValue(0);
-	}
-	updateFileDisplay();
-	statusBar()->showMessage(tr("已添加图片文件: %1").arg(QFileInfo(filePath).fileName()), 3000);
-}
-
 void MainWindow::handleDroppedVideo(const QString& filePath)
 {
 	ui->video_lineEdit_input->setText(filePath);
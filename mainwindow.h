@@ -6,6 +6,13 @@
 #include <QProcess>
 #include "ImageProcessor.h"
 #include "VideoProcessor.h"
+#include "VideoJobQueue.h"
+#include "ModelFanout.h"
+#include "RangeSplicer.h"
+#include "ScalePlanner.h"
+#include "BatchQueueModel.h"
+#include "FolderScanner.h"
+#include "ProgressAggregator.h"
 #include <QMessageBox>
 #include <QCloseEvent>
 
@@ -53,29 +60,58 @@ private slots:
     QString findExecutable(const QString& name);
     void on_btn_start_video_clicked();
     void on_video_btn_browse_clicked();
+    void on_video_btn_addQueue_clicked();
+    void on_video_btn_clearQueue_clicked();
+    void on_video_btn_startQueue_clicked();
+    void on_btn_preview_clicked();
+    void on_btn_batchUp_clicked();
+    void on_btn_batchDown_clicked();
+    void on_btn_batchRemove_clicked();
+    void on_btn_batchRegions_clicked();
+    void on_btn_batchClear_clicked();
+    void on_btn_addFolder_clicked();
+    void on_video_btn_preview_clicked();
+    void on_video_btn_reencode_clicked();
+    void on_video_btn_fanout_clicked();
+    void on_video_btn_rerender_clicked();
 
 private:
     Ui::MainWindow *ui;
-    QStringList m_selectedImageFiles;
+    BatchQueueModel *m_batchModel;
+    FolderScanner *m_folderScanner;
+    bool m_scanSingleFile = false; // 未勾选多选时只取扫描到的第一张
     QString m_currentImageType = "png";
     ImageProcessor *m_imageProcessor; // 添加 ImageProcessor 成员变量
     VideoProcessor *m_videoProcessor;
+    VideoJobQueue *m_videoJobQueue;
+    ModelFanout *m_modelFanout;
+    RangeSplicer *m_rangeSplicer;
 
     bool isSupportedImageFile(const QString &filePath);
     bool isSupportedVideoFile(const QString &filePath);
-    void handleDroppedImage(const QString &filePath);
+    void scanImagePaths(const QStringList &paths);
     void handleDroppedVideo(const QString &filePath);
 
     QString m_realesrganPath;
     QString m_ffmpegPath;
     QString m_ffprobePath;
+    QStringList m_availableModels;
 
-    int m_filesProcessed = 0;
-    int m_currentFileProgress = 0;
-    int m_totalFiles = 0;
+    ProgressAggregator *m_imageProgress;
+    ProgressAggregator *m_videoQueueProgress;
     // 初始化函数
     void initializeModules();
     void validateDependencies();
+    void initializeVideoQueue();
+    void initializeBatchQueue();
+    void initializeImageProcessing();
+    void moveBatchSelection(int offset);
+    void initializeScaleTargets();
+    ScaleTarget readScaleTarget(bool video, bool *ok = nullptr) const;
+    void addVideoToQueue(const QString &filePath);
+    VideoProcessor::EncodeSettings readEncodeSettings() const;
+    void connectVideoProcessor();
+    void updateQueueItem(int jobId, const QString &message = QString());
 
 };
 #endif // MAINWINDOW_H
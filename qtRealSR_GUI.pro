@@ -1,10 +1,9 @@
 TEMPLATE = app
 TARGET = qtRealSR_GUI
-QT += core gui widgets
+QT += core gui widgets network
 CONFIG += c++17 static
 CONFIG += static
-DEFINES += QT_NO_NETWORK \
-           QT_NO_MULTIMEDIA \
+DEFINES += QT_NO_MULTIMEDIA \
            QT_NO_SVG \
            QT_NO_QUICK
 
@@ -22,12 +21,74 @@ SOURCES += \
     VideoProcessor.cpp \
     main.cpp \
     mainwindow.cpp \
-    ImageProcessor.cpp
+    ImageProcessor.cpp \
+    VideoJobQueue.cpp \
+    ScalePlanner.cpp \
+    CropDetector.cpp \
+    PreviewDialog.cpp \
+    ThumbnailLoader.cpp \
+    BatchQueueModel.cpp \
+    ProgressAggregator.cpp \
+    UpscaleBackend.cpp \
+    NcnnUpscaleBackend.cpp \
+    BenchmarkRunner.cpp \
+    ImageResampler.cpp \
+    RenditionWriter.cpp \
+    PngWriter.cpp \
+    MasterArchive.cpp \
+    ClusterConnection.cpp \
+    ClusterCoordinator.cpp \
+    ClusterWorker.cpp \
+    ProcessLauncher.cpp \
+    ScratchManager.cpp \
+    ThroughputLedger.cpp \
+    ProcessSupervisor.cpp \
+    TemporalTileProcessor.cpp \
+    ProgressiveEncoder.cpp \
+    PriorityScheduler.cpp \
+    ConcurrencyController.cpp \
+    FolderScanner.cpp \
+    SpriteAtlas.cpp \
+    ModelFanout.cpp \
+    RangeSplicer.cpp \
+    RegionUpscaler.cpp \
+    RegionDialog.cpp
 
 HEADERS += \
     VideoProcessor.h \
     mainwindow.h \
-    ImageProcessor.h
+    ImageProcessor.h \
+    VideoJobQueue.h \
+    ScalePlanner.h \
+    CropDetector.h \
+    PreviewDialog.h \
+    ThumbnailLoader.h \
+    BatchQueueModel.h \
+    ProgressAggregator.h \
+    UpscaleBackend.h \
+    NcnnUpscaleBackend.h \
+    BenchmarkRunner.h \
+    ImageResampler.h \
+    RenditionWriter.h \
+    PngWriter.h \
+    MasterArchive.h \
+    ClusterConnection.h \
+    ClusterCoordinator.h \
+    ClusterWorker.h \
+    ProcessLauncher.h \
+    ScratchManager.h \
+    ThroughputLedger.h \
+    ProcessSupervisor.h \
+    TemporalTileProcessor.h \
+    ProgressiveEncoder.h \
+    PriorityScheduler.h \
+    ConcurrencyController.h \
+    FolderScanner.h \
+    SpriteAtlas.h \
+    ModelFanout.h \
+    RangeSplicer.h \
+    RegionUpscaler.h \
+    RegionDialog.h
 
 # UI 文件
 FORMS += mainwindow.ui
@@ -38,9 +99,23 @@ RESOURCES += res.qrc
 
 win32 {
     RC_ICONS = "icons/logo.ico"
-    LIBS += -lwinmm -lws2_32 -liphlpapi -luser32 -lgdi32 -ladvapi32 -lshell32
+    LIBS += -lwinmm -lws2_32 -liphlpapi -luser32 -lgdi32 -ladvapi32 -lshell32 -lpsapi
 }
 
+# 可选：qmake CONFIG+=ncnn 启用内置 CPU 推理后端（需 ncnn 头文件与库在搜索路径中）
+ncnn {
+    DEFINES += HAVE_NCNN
+    LIBS += -lncnn -fopenmp
+}
+# zlib：PngWriter 分带并行压缩 PNG。Qt 使用系统 zlib 时直接链接，
+# 否则用 Qt 自带的 zlib（符号由 QtCore 导出，头文件在 QtZlib 私有模块）
+qtConfig(system-zlib) {
+    DEFINES += HAVE_ZLIB
+    QMAKE_USE += zlib
+} else {
+    QT += zlib-private
+    DEFINES += HAVE_ZLIB HAVE_QT_ZLIB
+}
 
 greaterThan(QT_MAJOR_VERSION, 5) {
     message("Using Qt6...")